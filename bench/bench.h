@@ -0,0 +1,44 @@
+#ifndef BENCH_H
+#define BENCH_H 1
+
+/*
+ * Minimal helpers for the hawkc micro benchmarks.
+ *
+ * Include this header before any system header because it needs
+ * POSIX clocks, which -std=c99 hides otherwise.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Monotonic time in nanoseconds.
+ */
+static double bench_now_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/*
+ * Run stmt n times and store the average nanoseconds per run in ns.
+ */
+#define BENCH(n,ns,stmt) do { long bench_i_; double bench_t0_ = bench_now_ns(); \
+	for(bench_i_ = 0; bench_i_ < (n); bench_i_++) { stmt; } \
+	(ns) = (bench_now_ns() - bench_t0_) / (double)(n); } while(0)
+
+#define BENCH_REPORT(name,label,ns) printf("  %s: %-40s %10.1f ns/op\n", (name), (label), (ns))
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* !defined BENCH_H */
@@ -0,0 +1,107 @@
+#include "bench.h"
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+
+/*
+ * Compares validating eight requests with precomputed keys one at a time
+ * with validating them in one call to hawkc_validate_hmac_batch().
+ *
+ * Then compares validating one request against ROTATION_KEYS candidate keys
+ * with hawkc_validate_hmac() per key and with hawkc_validate_hmac_any().
+ */
+
+#define ITERATIONS 200000
+#define N 8
+#define ROTATION_KEYS 3
+
+static struct HawkcContext ctxs[N];
+static HawkcContext ctx_ptrs[N];
+
+static int setup(HawkcAlgorithm algorithm, HawkcKey key) {
+	char *h = "Hawk id=\"1\", ts=\"1353788437\", nonce=\"k3j4h2\", mac=\"zy79QQ5/EYFmQqutVnYb73gAc/U=\"";
+	char path[16];
+	int i;
+
+	for(i = 0; i < N; i++) {
+		ctx_ptrs[i] = &ctxs[i];
+		hawkc_context_init(&ctxs[i]);
+		hawkc_context_set_key(&ctxs[i],key);
+		hawkc_context_set_algorithm(&ctxs[i],algorithm);
+		hawkc_context_set_method(&ctxs[i],(unsigned char*)"GET",3);
+		snprintf(path,sizeof(path),"/r/%d",i);
+		hawkc_context_set_path(&ctxs[i],(unsigned char*)path,strlen(path));
+		hawkc_context_set_host(&ctxs[i],(unsigned char*)"example.com",11);
+		hawkc_context_set_port(&ctxs[i],(unsigned char*)"80",2);
+		if(hawkc_parse_authorization_header(&ctxs[i],(unsigned char*)h,strlen(h)) != HAWKC_OK) {
+			printf("Unable to parse header: %s\n", hawkc_get_error(&ctxs[i]));
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void validate_loop(void) {
+	int i, is_valid;
+	for(i = 0; i < N; i++) {
+		hawkc_validate_hmac(&ctxs[i],&is_valid);
+	}
+}
+
+static void validate_each(HawkcKey *keys) {
+	int i, is_valid;
+	for(i = 0; i < ROTATION_KEYS; i++) {
+		hawkc_context_set_key(&ctxs[0],keys[i]);
+		hawkc_validate_hmac(&ctxs[0],&is_valid);
+	}
+}
+
+static int bench_algorithm(const char *name, HawkcAlgorithm algorithm) {
+	char *pwd = "werxhqb98rpaxn39848xrunpaw3489ruxnpa98w4rxn";
+	struct HawkcContext ctx;
+	HawkcKey key;
+	unsigned char valid[(N + 7) / 8];
+	HawkcKey keys[ROTATION_KEYS];
+	double loop_ns, batch_ns, each_ns, any_ns;
+	char label[64];
+	int i, matched;
+
+	hawkc_context_init(&ctx);
+	if(hawkc_key_create(&ctx,algorithm,(unsigned char*)pwd,strlen(pwd),&key) != HAWKC_OK) {
+		printf("Unable to create key: %s\n", hawkc_get_error(&ctx));
+		return 1;
+	}
+	if(setup(algorithm,key) != 0) {
+		return 1;
+	}
+	BENCH(ITERATIONS,loop_ns,validate_loop());
+	BENCH(ITERATIONS,batch_ns,hawkc_validate_hmac_batch(ctx_ptrs,N,valid));
+
+	for(i = 0; i < ROTATION_KEYS; i++) {
+		keys[i] = key;
+	}
+	BENCH(ITERATIONS,each_ns,validate_each(keys));
+	BENCH(ITERATIONS,any_ns,hawkc_validate_hmac_any(&ctxs[0],keys,ROTATION_KEYS,&matched));
+	hawkc_key_free(&ctx,key);
+
+	snprintf(label,sizeof(label),"%s validate %d one at a time",name,N);
+	BENCH_REPORT("bench_batch",label,loop_ns);
+	snprintf(label,sizeof(label),"%s validate %d as batch",name,N);
+	BENCH_REPORT("bench_batch",label,batch_ns);
+	printf("  bench_batch: %s speedup %.2fx\n",name,loop_ns / batch_ns);
+	snprintf(label,sizeof(label),"%s validate with %d keys one at a time",name,ROTATION_KEYS);
+	BENCH_REPORT("bench_batch",label,each_ns);
+	snprintf(label,sizeof(label),"%s validate with any of %d keys",name,ROTATION_KEYS);
+	BENCH_REPORT("bench_batch",label,any_ns);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if(bench_algorithm("sha1",HAWKC_SHA_1) != 0) {
+		return 1;
+	}
+	if(bench_algorithm("sha256",HAWKC_SHA_256) != 0) {
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,116 @@
+#include "bench.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include "hawkc.h"
+#include "common.h"
+
+/*
+ * Lookups in a credential store of IDS credentials, first alone and then
+ * while another thread keeps building and publishing new sets of the
+ * same size. The lookup latency should hardly change during reloads.
+ *
+ * Then the same credentials are written to a credential file, which is
+ * opened and looked up in. Opening should take the same time for any
+ * number of credentials.
+ */
+
+#define IDS 1000000
+#define LOOKUPS 5000000
+#define FILE_PATH "bench/bench_credentials.hcf"
+
+static HawkcCredentialStore store;
+static HawkcCredentialFile file;
+static volatile int stop;
+static int reloads;
+
+static HawkcCredentials build(HawkcContext ctx) {
+	HawkcCredentials credentials;
+	char id[32];
+	int i;
+
+	if(hawkc_credentials_create(ctx,IDS,&credentials) != HAWKC_OK) {
+		printf("Unable to create credentials: %s\n", hawkc_get_error(ctx));
+		exit(1);
+	}
+	for(i = 0; i < IDS; i++) {
+		snprintf(id,sizeof(id),"client-%d",i);
+		hawkc_credentials_add(ctx,credentials,(unsigned char*)id,strlen(id),HAWKC_SHA_256,(unsigned char*)id,strlen(id));
+	}
+	return credentials;
+}
+
+static void lookups(void) {
+	struct HawkcContext ctx;
+	struct HawkcKey key;
+	char id[32];
+	long i;
+	HawkcError e;
+
+	hawkc_context_init(&ctx);
+	for(i = 0; i < LOOKUPS; i++) {
+		snprintf(id,sizeof(id),"client-%ld",(i * 7919) % IDS);
+		if(file != NULL) {
+			e = hawkc_credential_file_lookup(&ctx,file,(unsigned char*)id,strlen(id),&key);
+		} else {
+			e = hawkc_credential_store_lookup(&ctx,store,(unsigned char*)id,strlen(id),&key);
+		}
+		if(e != HAWKC_OK) {
+			printf("Lookup failed: %s\n", hawkc_get_error(&ctx));
+			exit(1);
+		}
+	}
+}
+
+static void *reloader(void *arg) {
+	struct HawkcContext ctx;
+
+	hawkc_context_init(&ctx);
+	while(!stop) {
+		hawkc_credential_store_publish(&ctx,store,build(&ctx));
+		reloads++;
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	struct HawkcContext ctx;
+	HawkcCredentials credentials;
+	pthread_t thread;
+	double ns;
+
+	hawkc_context_init(&ctx);
+	hawkc_credential_store_create(&ctx,&store);
+
+	BENCH(1,ns,hawkc_credential_store_publish(&ctx,store,build(&ctx)));
+	BENCH_REPORT("bench_credentials","build and publish 1M credentials",ns);
+
+	BENCH(1,ns,lookups());
+	BENCH_REPORT("bench_credentials","lookup",ns / LOOKUPS);
+
+	pthread_create(&thread,NULL,reloader,NULL);
+	BENCH(1,ns,lookups());
+	stop = 1;
+	pthread_join(thread,NULL);
+	BENCH_REPORT("bench_credentials","lookup during reloads",ns / LOOKUPS);
+	printf("  bench_credentials: %d reloads during lookups\n",reloads);
+
+	hawkc_credential_store_free(&ctx,store);
+
+	credentials = build(&ctx);
+	BENCH(1,ns,hawkc_credential_file_write(&ctx,credentials,FILE_PATH));
+	BENCH_REPORT("bench_credentials","write credential file of 1M credentials",ns);
+	hawkc_credentials_free(&ctx,credentials);
+
+	BENCH(1,ns,hawkc_credential_file_open(&ctx,FILE_PATH,&file));
+	BENCH_REPORT("bench_credentials","open credential file",ns);
+	if(file == NULL) {
+		printf("Unable to open credential file: %s\n", hawkc_get_error(&ctx));
+		return 1;
+	}
+	BENCH(1,ns,lookups());
+	BENCH_REPORT("bench_credentials","credential file lookup",ns / LOOKUPS);
+
+	hawkc_credential_file_close(&ctx,file);
+	remove(FILE_PATH);
+	return 0;
+}
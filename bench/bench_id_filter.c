@@ -0,0 +1,81 @@
+#include "bench.h"
+#include <stdlib.h>
+#include "hawkc.h"
+
+/*
+ * Checks of unknown ids against an id filter of IDS ids, compared to
+ * parsing a header and to a miss in a credential store of the same ids.
+ */
+
+#define IDS 1000000
+#define CHECKS 5000000
+
+static char (*ids)[24];
+static const unsigned char **id_ptrs;
+static size_t *id_lens;
+static int passed;
+
+static void checks(HawkcIdFilter filter) {
+	char id[24];
+	long i;
+
+	for(i = 0; i < CHECKS; i++) {
+		snprintf(id,sizeof(id),"flood-%ld",i);
+		passed += hawkc_id_filter_contains(filter,(unsigned char*)id,strlen(id));
+	}
+}
+
+static void misses(HawkcContext ctx, HawkcCredentialStore store) {
+	struct HawkcKey key;
+	char id[24];
+	long i;
+
+	for(i = 0; i < CHECKS; i++) {
+		snprintf(id,sizeof(id),"flood-%ld",i);
+		hawkc_credential_store_lookup(ctx,store,(unsigned char*)id,strlen(id),&key);
+	}
+}
+
+int main(int argc, char **argv) {
+	struct HawkcContext ctx;
+	HawkcIdFilter filter;
+	HawkcIdFilterStats stats;
+	HawkcCredentialStore store;
+	HawkcCredentials credentials;
+	char *h = "Hawk id=\"flood-1234567\",mac=\"t81/bBJPDw53kKCs5u5YeSmL7cs=\",ts=\"1373805459\",nonce=\"abc\", ext=\"foo\"";
+	double ns;
+	int i;
+
+	hawkc_context_init(&ctx);
+	ids = malloc(IDS * sizeof(*ids));
+	id_ptrs = malloc(IDS * sizeof(*id_ptrs));
+	id_lens = malloc(IDS * sizeof(*id_lens));
+	hawkc_credentials_create(&ctx,IDS,&credentials);
+	for(i = 0; i < IDS; i++) {
+		snprintf(ids[i],sizeof(ids[i]),"client-%d",i);
+		id_ptrs[i] = (unsigned char*)ids[i];
+		id_lens[i] = strlen(ids[i]);
+		hawkc_credentials_add(&ctx,credentials,id_ptrs[i],id_lens[i],HAWKC_SHA_256,id_ptrs[i],id_lens[i]);
+	}
+	hawkc_credential_store_create(&ctx,&store);
+	hawkc_credential_store_publish(&ctx,store,credentials);
+
+	hawkc_id_filter_create(&ctx,&filter);
+	BENCH(1,ns,hawkc_id_filter_rebuild(&ctx,filter,id_ptrs,id_lens,IDS,0));
+	BENCH_REPORT("bench_id_filter","build filter of 1M ids",ns);
+
+	BENCH(1,ns,checks(filter));
+	BENCH_REPORT("bench_id_filter","check unknown id",ns / CHECKS);
+	BENCH(1,ns,misses(&ctx,store));
+	BENCH_REPORT("bench_id_filter","credential store miss",ns / CHECKS);
+	BENCH(CHECKS,ns,hawkc_parse_authorization_header(&ctx,(unsigned char*)h,strlen(h)));
+	BENCH_REPORT("bench_id_filter","parse header",ns);
+
+	hawkc_id_filter_stats(filter,&stats);
+	printf("  bench_id_filter: %lu of %lu unknown ids passed (%.2f%%), filter %lu bytes\n",
+			(unsigned long)passed, (unsigned long)stats.checks, 100.0 * passed / stats.checks, (unsigned long)stats.size);
+
+	hawkc_id_filter_free(&ctx,filter);
+	hawkc_credential_store_free(&ctx,store);
+	return 0;
+}
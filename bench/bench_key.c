@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+
+/*
+ * Compares HMAC validation of a short base string using password and
+ * algorithm (key setup on every call) with validation using a
+ * precomputed HawkcKey.
+ */
+
+#define ITERATIONS 1000000
+
+static struct HawkcContext ctx;
+
+static int setup(HawkcAlgorithm algorithm, const char *header) {
+	char *pwd = "werxhqb98rpaxn39848xrunpaw3489ruxnpa98w4rxn";
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_password(&ctx,(unsigned char*)pwd, strlen(pwd));
+	hawkc_context_set_algorithm(&ctx,algorithm);
+	hawkc_context_set_method(&ctx,(unsigned char*)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char*)"/r/1",4);
+	hawkc_context_set_host(&ctx,(unsigned char*)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char*)"80",2);
+	if(hawkc_parse_authorization_header(&ctx,(unsigned char*)header,strlen(header)) != HAWKC_OK) {
+		printf("Unable to parse header: %s\n", hawkc_get_error(&ctx));
+		return 1;
+	}
+	return 0;
+}
+
+static int bench_algorithm(const char *name, HawkcAlgorithm algorithm) {
+	char *h = "Hawk id=\"1\", ts=\"1353788437\", nonce=\"k3j4h2\", mac=\"zy79QQ5/EYFmQqutVnYb73gAc/U=\"";
+	char *pwd = "werxhqb98rpaxn39848xrunpaw3489ruxnpa98w4rxn";
+	HawkcKey key;
+	int is_valid;
+	double password_ns, key_ns;
+	char label[64];
+
+	if(setup(algorithm,h) != 0) {
+		return 1;
+	}
+	BENCH(ITERATIONS,password_ns,hawkc_validate_hmac(&ctx,&is_valid));
+
+	if(hawkc_key_create(&ctx,algorithm,(unsigned char*)pwd,strlen(pwd),&key) != HAWKC_OK) {
+		printf("Unable to create key: %s\n", hawkc_get_error(&ctx));
+		return 1;
+	}
+	hawkc_context_set_key(&ctx,key);
+	BENCH(ITERATIONS,key_ns,hawkc_validate_hmac(&ctx,&is_valid));
+	hawkc_key_free(&ctx,key);
+
+	snprintf(label,sizeof(label),"%s validate with password",name);
+	BENCH_REPORT("bench_key",label,password_ns);
+	snprintf(label,sizeof(label),"%s validate with key",name);
+	BENCH_REPORT("bench_key",label,key_ns);
+	printf("  bench_key: %s speedup %.2fx\n",name,password_ns / key_ns);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	if(bench_algorithm("sha1",HAWKC_SHA_1) != 0) {
+		return 1;
+	}
+	if(bench_algorithm("sha256",HAWKC_SHA_256) != 0) {
+		return 1;
+	}
+	if(bench_algorithm("sha512",HAWKC_SHA_512) != 0) {
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,38 @@
+#include "bench.h"
+#include "hawkc.h"
+
+/*
+ * Key lookups of a key deriver for ids that are in the cache and for ids
+ * that have to be derived.
+ */
+
+#define LOOKUPS 1000000
+#define CACHE_SIZE 1024
+
+static void lookups(HawkcContext ctx, HawkcKeyDeriver deriver, long nids) {
+	struct HawkcKey key;
+	char id[32];
+	long i;
+
+	for(i = 0; i < LOOKUPS; i++) {
+		snprintf(id,sizeof(id),"client-%ld",(i * 7919) % nids);
+		hawkc_key_deriver_lookup(ctx,deriver,(unsigned char*)id,strlen(id),&key);
+	}
+}
+
+int main(int argc, char **argv) {
+	struct HawkcContext ctx;
+	HawkcKeyDeriver deriver;
+	double ns;
+
+	hawkc_context_init(&ctx);
+	hawkc_key_deriver_create(&ctx,HAWKC_SHA_256,(unsigned char*)"master secret",13,CACHE_SIZE,&deriver);
+
+	BENCH(1,ns,lookups(&ctx,deriver,CACHE_SIZE / 2));
+	BENCH_REPORT("bench_key_deriver","lookup, cached",ns / LOOKUPS);
+	BENCH(1,ns,lookups(&ctx,deriver,LOOKUPS));
+	BENCH_REPORT("bench_key_deriver","lookup, derived",ns / LOOKUPS);
+
+	hawkc_key_deriver_free(&ctx,deriver);
+	return 0;
+}
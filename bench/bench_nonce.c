@@ -0,0 +1,76 @@
+#include "bench.h"
+#include <pthread.h>
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+
+/*
+ * Compares taking every nonce from the crypto backend's random source,
+ * as hawkc_generate_nonce() did before, with the per-thread nonce
+ * generator, in one thread and in THREADS threads at once.
+ */
+
+#define ITERATIONS 1000000
+#define THREADS 4
+
+static void backend_nonce(HawkcContext ctx, unsigned char *buf) {
+	unsigned char bytes[MAX_NONCE_BYTES];
+	hawkc_random_bytes(ctx,bytes,MAX_NONCE_BYTES);
+	hawkc_bytes_to_hex(bytes,MAX_NONCE_BYTES,buf);
+}
+
+static void run(int use_pool) {
+	struct HawkcContext ctx;
+	unsigned char buf[MAX_NONCE_HEX_BYTES];
+	long i;
+
+	hawkc_context_init(&ctx);
+	for(i = 0; i < ITERATIONS; i++) {
+		if(use_pool) {
+			hawkc_generate_nonce(&ctx,MAX_NONCE_BYTES,buf);
+		} else {
+			backend_nonce(&ctx,buf);
+		}
+	}
+}
+
+static void *thread_main(void *arg) {
+	run(*(int*)arg);
+	return NULL;
+}
+
+/*
+ * Run THREADS threads generating ITERATIONS nonces each and return the
+ * wall clock nanoseconds per nonce.
+ */
+static double run_threads(int use_pool) {
+	pthread_t threads[THREADS];
+	double t0;
+	int i;
+
+	t0 = bench_now_ns();
+	for(i = 0; i < THREADS; i++) {
+		pthread_create(&threads[i],NULL,thread_main,&use_pool);
+	}
+	for(i = 0; i < THREADS; i++) {
+		pthread_join(threads[i],NULL);
+	}
+	return (bench_now_ns() - t0) / ((double)ITERATIONS * THREADS);
+}
+
+int main(int argc, char **argv) {
+	double ns;
+	char label[64];
+
+	BENCH(1,ns,run(0));
+	BENCH_REPORT("bench_nonce","nonce from backend",ns / ITERATIONS);
+	BENCH(1,ns,run(1));
+	BENCH_REPORT("bench_nonce","nonce from pool",ns / ITERATIONS);
+
+	snprintf(label,sizeof(label),"nonce from backend, %d threads",THREADS);
+	BENCH_REPORT("bench_nonce",label,run_threads(0));
+	snprintf(label,sizeof(label),"nonce from pool, %d threads",THREADS);
+	BENCH_REPORT("bench_nonce",label,run_threads(1));
+
+	return 0;
+}
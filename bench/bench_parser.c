@@ -0,0 +1,183 @@
+#include "bench.h"
+#include "hawkc.h"
+#include "common.h"
+#include "scan.h"
+
+/*
+ * Parsing an Authorization header with an iron sealed id of about 450
+ * bytes with each scanner kernel, parsing headers with the Hawk specific
+ * parser compared to the generic parser with parameter callbacks, and
+ * parsing headers that arrive in chunks by copying the chunks together
+ * compared to feeding them to the incremental parser.
+ */
+
+#define ITERATIONS 2000000
+
+/*
+ * The parameter callback that hawkc_parse_authorization_header() used
+ * with the generic parser.
+ */
+static HawkcError callback_param(HawkcContext ctx, HawkcString key, HawkcString value, void *data) {
+	AuthorizationHeader h = (AuthorizationHeader)data;
+	if(key.len == 2 && !memcmp(key.data,"id",key.len)) {
+		h->id = value;
+	} else if(key.len == 3 && !memcmp(key.data,"mac",key.len)) {
+		h->mac = value;
+	} else if(key.len == 4 && !memcmp(key.data,"hash",key.len)) {
+		h->hash = value;
+	} else if(key.len == 5 && !memcmp(key.data,"nonce",key.len)) {
+		h->nonce = value;
+	} else if(key.len == 2 && !memcmp(key.data,"ts",key.len)) {
+		return hawkc_parse_time(ctx,value,&(h->ts));
+	} else if(key.len == 3 && !memcmp(key.data,"ext",key.len)) {
+		h->ext = value;
+	} else if(key.len == 3 && !memcmp(key.data,"app",key.len)) {
+		h->app = value;
+	} else if(key.len == 3 && !memcmp(key.data,"dlg",key.len)) {
+		h->dlg = value;
+	}
+	return HAWKC_OK;
+}
+
+static HawkcError callback_scheme(HawkcContext ctx, HawkcString scheme, void *data) {
+	if((scheme.len != 4) || memcmp(scheme.data,"Hawk",4) != 0) {
+		return hawkc_set_error(ctx, HAWKC_BAD_SCHEME_ERROR, "Unsupported authentication scheme");
+	}
+	return HAWKC_OK;
+}
+
+/*
+ * Best of ROUNDS alternating rounds, to keep noise from other processes
+ * out of the comparison.
+ */
+#define ROUNDS 10
+
+static void bench_dispatch(HawkcContext ctx, const char *label, char *h) {
+	size_t len = strlen(h);
+	double callback_ns = 0, hawk_ns = 0, ns;
+	char buf[64];
+	int r;
+
+	for(r = 0; r < ROUNDS; r++) {
+		BENCH(ITERATIONS / ROUNDS,ns,hawkc_parse_auth_header(ctx,(unsigned char*)h,len,callback_scheme,callback_param,&(ctx->header_in)));
+		if(r == 0 || ns < callback_ns) {
+			callback_ns = ns;
+		}
+		BENCH(ITERATIONS / ROUNDS,ns,hawkc_parse_hawk_authorization_header(ctx,(unsigned char*)h,len,&(ctx->header_in)));
+		if(r == 0 || ns < hawk_ns) {
+			hawk_ns = ns;
+		}
+	}
+
+	snprintf(buf,sizeof(buf),"%s callbacks",label);
+	BENCH_REPORT("bench_parser",buf,callback_ns);
+	snprintf(buf,sizeof(buf),"%s hawk parser",label);
+	BENCH_REPORT("bench_parser",buf,hawk_ns);
+	printf("  bench_parser: %s speedup %.2fx\n",label,callback_ns / hawk_ns);
+}
+
+/*
+ * Chunk size of the fragmented headers.
+ */
+#define CHUNK 64
+
+static unsigned char reassembled[1024];
+
+static HawkcError reassemble(HawkcContext ctx, const char *h, size_t len) {
+	size_t i, n;
+
+	for(i = 0; i < len; i += n) {
+		n = len - i < CHUNK ? len - i : CHUNK;
+		memcpy(reassembled + i,h + i,n);
+	}
+	return hawkc_parse_authorization_header(ctx,reassembled,len);
+}
+
+static HawkcError feed(HawkcContext ctx, HawkcParser parser, const char *h, size_t len) {
+	HawkcError e;
+	size_t i, n;
+
+	hawkc_parser_reset(parser);
+	for(i = 0; i < len; i += n) {
+		n = len - i < CHUNK ? len - i : CHUNK;
+		if( (e = hawkc_parser_feed(ctx,parser,(const unsigned char*)h + i,n)) != HAWKC_OK) {
+			return e;
+		}
+	}
+	return hawkc_parser_finish(ctx,parser);
+}
+
+static void bench_fragments(HawkcContext ctx, HawkcParser parser, const char *label, char *h) {
+	size_t len = strlen(h);
+	double reassemble_ns = 0, feed_ns = 0, ns;
+	char buf[64];
+	int r;
+
+	for(r = 0; r < ROUNDS; r++) {
+		BENCH(ITERATIONS / ROUNDS,ns,reassemble(ctx,h,len));
+		if(r == 0 || ns < reassemble_ns) {
+			reassemble_ns = ns;
+		}
+		BENCH(ITERATIONS / ROUNDS,ns,feed(ctx,parser,h,len));
+		if(r == 0 || ns < feed_ns) {
+			feed_ns = ns;
+		}
+	}
+
+	snprintf(buf,sizeof(buf),"%s reassembled",label);
+	BENCH_REPORT("bench_parser",buf,reassemble_ns);
+	snprintf(buf,sizeof(buf),"%s fed",label);
+	BENCH_REPORT("bench_parser",buf,feed_ns);
+	printf("  bench_parser: %s speedup %.2fx\n",label,reassemble_ns / feed_ns);
+}
+
+static const char *kernel_names[] = { "portable", "ssse3", "avx2" };
+
+int main(int argc, char **argv) {
+	struct HawkcContext ctx;
+	HawkcParser parser;
+	char h[1024];
+	char *typical = "Hawk id=\"dh37fgj492je\", ts=\"1353832234\", nonce=\"j4h3g2\", ext=\"some-app-ext-data\", mac=\"6R4rV5iE+NPoym+WwjeHzjAGXUtLNIxmo1vpMofpLAE=\"";
+	char id[460];
+	size_t len, i;
+	int k;
+	double ns;
+
+	for(i = 0; i < sizeof(id) - 1; i++) {
+		id[i] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"[(i * 7) % 64];
+	}
+	id[sizeof(id) - 1] = '\0';
+	memcpy(id,"Fe26.2**",8);
+	len = snprintf(h,sizeof(h),"Hawk id=\"%s\", ts=\"1353788437\", nonce=\"k3j4h2\", ext=\"some-app-data\", mac=\"Zs4xz5DmYkhJvUbUmXlMPNt9I14ek1fVvlFsgiUVz/s=\"",id);
+
+	hawkc_context_init(&ctx);
+	for(k = HAWKC_SCAN_KERNEL_PORTABLE; k <= HAWKC_SCAN_KERNEL_AVX2; k++) {
+		if(!hawkc_scan_use_kernel((HawkcScanKernel)k)) {
+			printf("  bench_parser: %s not supported by this CPU\n",kernel_names[k]);
+			continue;
+		}
+		if(hawkc_parse_authorization_header(&ctx,(unsigned char*)h,len) != HAWKC_OK) {
+			printf("Unable to parse header: %s\n", hawkc_get_error(&ctx));
+			return 1;
+		}
+		BENCH(ITERATIONS,ns,hawkc_parse_authorization_header(&ctx,(unsigned char*)h,len));
+		BENCH_REPORT("bench_parser",kernel_names[k],ns);
+	}
+
+	/* The loop above leaves the widest supported kernel selected */
+	bench_dispatch(&ctx,"typical",typical);
+	bench_dispatch(&ctx,"sealed id",h);
+
+	if(hawkc_parser_create(&ctx,sizeof(reassembled),&parser) != HAWKC_OK) {
+		printf("Unable to create parser: %s\n", hawkc_get_error(&ctx));
+		return 1;
+	}
+	if(feed(&ctx,parser,h,len) != HAWKC_OK) {
+		printf("Unable to parse header: %s\n", hawkc_get_error(&ctx));
+		return 1;
+	}
+	bench_fragments(&ctx,parser,"typical",typical);
+	bench_fragments(&ctx,parser,"sealed id",h);
+	hawkc_parser_free(&ctx,parser);
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include "bench.h"
+#include <pthread.h>
+#include "hawkc.h"
+#include "common.h"
+
+/*
+ * Inserts and lookups of the replay cache with 1 to MAX_THREADS threads.
+ * Every thread inserts OPS distinct nonces and then looks each of them up
+ * again, so half of the operations are inserts and half detect a replay.
+ * Throughput should grow with the number of threads up to the number of
+ * cores.
+ */
+
+#define OPS 500000
+#define MAX_THREADS 8
+
+static HawkcReplayCache cache;
+static time_t now;
+
+static void *worker(void *arg) {
+	int t = *(int*)arg;
+	unsigned char nonce[MAX_NONCE_HEX_BYTES];
+	int i;
+
+	for(i = 0; i < OPS; i++) {
+		hawkc_bytes_to_hex((unsigned char*)&i,4,nonce);
+		hawkc_bytes_to_hex((unsigned char*)&t,2,nonce + 8);
+		hawkc_replay_cache_add(cache,(unsigned char*)"client",6,nonce,MAX_NONCE_HEX_BYTES,now,now);
+	}
+	for(i = 0; i < OPS; i++) {
+		hawkc_bytes_to_hex((unsigned char*)&i,4,nonce);
+		hawkc_bytes_to_hex((unsigned char*)&t,2,nonce + 8);
+		hawkc_replay_cache_add(cache,(unsigned char*)"client",6,nonce,MAX_NONCE_HEX_BYTES,now,now);
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv) {
+	struct HawkcContext ctx;
+	pthread_t threads[MAX_THREADS];
+	int ids[MAX_THREADS];
+	int nthreads, i;
+	double t0, ns;
+	char label[64];
+
+	hawkc_context_init(&ctx);
+	time(&now);
+
+	for(nthreads = 1; nthreads <= MAX_THREADS; nthreads *= 2) {
+		if(hawkc_replay_cache_create(&ctx,(size_t)OPS * nthreads,1,&cache) != HAWKC_OK) {
+			printf("Unable to create replay cache: %s\n", hawkc_get_error(&ctx));
+			return 1;
+		}
+		t0 = bench_now_ns();
+		for(i = 0; i < nthreads; i++) {
+			ids[i] = i;
+			pthread_create(&threads[i],NULL,worker,&ids[i]);
+		}
+		for(i = 0; i < nthreads; i++) {
+			pthread_join(threads[i],NULL);
+		}
+		ns = bench_now_ns() - t0;
+		hawkc_replay_cache_free(&ctx,cache);
+
+		snprintf(label,sizeof(label),"%d threads",nthreads);
+		BENCH_REPORT("bench_replay",label,ns / (2.0 * OPS * nthreads));
+		printf("  bench_replay: %d threads %.1f Mops/s\n",nthreads,2.0 * OPS * nthreads / ns * 1e3);
+	}
+
+	return 0;
+}
@@ -0,0 +1,49 @@
+#include "bench.h"
+#include "hawkc.h"
+#include "common.h"
+#include "scan.h"
+
+/*
+ * Scanning a request head as sent by a browser, with the Authorization
+ * header after long Accept, User-Agent and Cookie headers, with each
+ * scanner kernel.
+ */
+
+#define ITERATIONS 1000000
+
+static const char *kernel_names[] = { "portable", "ssse3", "avx2" };
+
+int main(int argc, char **argv) {
+	struct HawkcContext ctx;
+	char *request =
+		"GET /resource/1?b=1&a=2 HTTP/1.1\r\n"
+		"Host: example.com:8000\r\n"
+		"User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+		"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+		"Accept-Language: en-US,en;q=0.5\r\n"
+		"Accept-Encoding: gzip, deflate, br, zstd\r\n"
+		"Connection: keep-alive\r\n"
+		"Cookie: session=8f14e45fceea167a5a36dedd4bea2543; prefs=eyJ0aGVtZSI6ImRhcmsiLCJsYW5nIjoiZW4ifQ; _ga=GA1.2.1234567890.1353832234\r\n"
+		"Sec-Fetch-Dest: document\r\n"
+		"Sec-Fetch-Mode: navigate\r\n"
+		"Authorization: Hawk id=\"dh37fgj492je\", ts=\"1353832234\", nonce=\"j4h3g2\", ext=\"some-app-ext-data\", mac=\"6R4rV5iE+NPoym+WwjeHzjAGXUtLNIxmo1vpMofpLAE=\"\r\n"
+		"\r\n";
+	size_t len = strlen(request), head_len;
+	int k;
+	double ns;
+
+	hawkc_context_init(&ctx);
+	for(k = HAWKC_SCAN_KERNEL_PORTABLE; k <= HAWKC_SCAN_KERNEL_AVX2; k++) {
+		if(!hawkc_scan_use_kernel((HawkcScanKernel)k)) {
+			printf("  bench_request: %s not supported by this CPU\n",kernel_names[k]);
+			continue;
+		}
+		if(hawkc_parse_request_head(&ctx,(unsigned char*)request,len,0,&head_len) != HAWKC_OK) {
+			printf("Unable to parse request: %s\n", hawkc_get_error(&ctx));
+			return 1;
+		}
+		BENCH(ITERATIONS,ns,hawkc_parse_request_head(&ctx,(unsigned char*)request,len,0,&head_len));
+		BENCH_REPORT("bench_request",kernel_names[k],ns);
+	}
+	return 0;
+}
@@ -230,7 +230,7 @@ void help(void) {
 	printf("    -P <path>        URI path to use for request\n");
 	printf("    -M <method>      HTTP method to use; defaults to 'GET'\n");
 	printf("    -O <port>        Port to use for request; defaults to '80'\n");
-	printf("    -a <algorithm>   Algorithm to use for HMAC generation; defaults to sha1\n");
+	printf("    -a <algorithm>   Algorithm to use for HMAC generation: sha1, sha256, sha384 or sha512; defaults to sha1\n");
 	printf("    -e <ext>         Arbitrary string to put into 'ext' header parameter\n");
 	printf("    -o <offset>      Number of seconds to use for clock offset\n");
 	printf("    -m <mode>        Output mode. Can be 'plain' (default), 'curl','blitz','header' or 'qheader'\n");
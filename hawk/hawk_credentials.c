@@ -0,0 +1,150 @@
+#include <getopt.h>
+#include <stdio.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hawkc.h"
+
+#define LINE_SIZE 4096
+
+/*
+ * hawk_credentials - Building a credential file from a text file of
+ * credentials, one per line:
+ *
+ *   <id> <algorithm> <password>
+ *
+ * Fields are separated by single spaces, the password is the rest of the
+ * line. Empty lines and lines starting with '#' are skipped.
+ */
+
+void usage(void);
+void help(void);
+
+static void fail(HawkcContext ctx, const char *what) {
+	fprintf(stderr,"%s: %s\n",what,hawkc_get_error(ctx));
+	exit(3);
+}
+
+int main(int argc, char **argv) {
+#ifdef __cplusplus
+	_HawkcContext ctx;
+#else
+	struct HawkcContext ctx;
+#endif
+	HawkcCredentials credentials;
+	HawkcCredentialFile file;
+	HawkcAlgorithm algorithm;
+	char *input = NULL;
+	char *output = NULL;
+	char line[LINE_SIZE];
+	char *id, *alg, *password, *end;
+	unsigned long lineno = 0;
+	unsigned long count = 0;
+	int check = 0;
+	int option;
+	FILE *in;
+
+	hawkc_context_init(&ctx);
+
+	opterr = 0;
+
+	while ((option = getopt(argc, argv, "i:o:ch")) != EOF) {
+		switch (option) {
+		case 'i': input = optarg; break;
+		case 'o': output = optarg; break;
+		case 'c': check = 1; break;
+		case 'h':
+			help();
+			exit(0);
+		case '?':
+			usage();
+			exit(1);
+		}
+	}
+
+	if(output == NULL) {
+		usage();
+		exit(1);
+	}
+	if(input == NULL || strcmp(input,"-") == 0) {
+		in = stdin;
+	} else if( (in = fopen(input,"r")) == NULL) {
+		fprintf(stderr,"Unable to open %s: %s\n",input,strerror(errno));
+		exit(2);
+	}
+
+	if(hawkc_credentials_create(&ctx,1024,&credentials) != HAWKC_OK) {
+		fail(&ctx,"Unable to create credentials");
+	}
+	while(fgets(line,sizeof(line),in) != NULL) {
+		lineno++;
+		if( (end = strchr(line,'\n')) == NULL && !feof(in)) {
+			fprintf(stderr,"Line %lu is too long\n",lineno);
+			exit(2);
+		}
+		if(end != NULL) {
+			*end = '\0';
+			if(end > line && *(end - 1) == '\r') {
+				*(end - 1) = '\0';
+			}
+		}
+		if(line[0] == '\0' || line[0] == '#') {
+			continue;
+		}
+		id = line;
+		if( (alg = strchr(id,' ')) == NULL || (password = strchr(alg + 1,' ')) == NULL) {
+			fprintf(stderr,"Line %lu is not '<id> <algorithm> <password>'\n",lineno);
+			exit(2);
+		}
+		*alg++ = '\0';
+		*password++ = '\0';
+		if( (algorithm = hawkc_algorithm_by_name(alg,strlen(alg))) == NULL) {
+			fprintf(stderr,"Algorithm not known in line %lu: %s\n",lineno,alg);
+			exit(2);
+		}
+		if(hawkc_credentials_add(&ctx,credentials,(unsigned char*)id,strlen(id),algorithm,
+				(unsigned char*)password,strlen(password)) != HAWKC_OK) {
+			fprintf(stderr,"Line %lu: %s\n",lineno,hawkc_get_error(&ctx));
+			exit(2);
+		}
+		count++;
+	}
+	if(in != stdin) {
+		fclose(in);
+	}
+
+	if(hawkc_credential_file_write(&ctx,credentials,output) != HAWKC_OK) {
+		fail(&ctx,"Unable to write credential file");
+	}
+
+	if(check) {
+		if(hawkc_credential_file_open(&ctx,output,&file) != HAWKC_OK) {
+			fail(&ctx,"Unable to open credential file");
+		}
+		hawkc_credential_file_close(&ctx,file);
+	}
+	fprintf(stdout,"%lu credentials written to %s\n",count,output);
+
+	hawkc_credentials_free(&ctx,credentials);
+	return 0;
+}
+
+void usage(void) {
+	printf("Usage: hawk_credentials -o <file> [-i <credentials>] [-ch]\n");
+}
+
+void help(void) {
+	printf("\n");
+	printf("hawk_credentials - Building a credential file for hawkc_credential_file_open()\n\n");
+	printf(" \n");
+
+	usage();
+
+	printf("Options:\n");
+	printf("    -h                 Show this screen\n");
+	printf("    -i <credentials>   Text file with lines '<id> <algorithm> <password>'; defaults to stdin\n");
+	printf("    -o <file>          Credential file to write; replaced atomically if it exists\n");
+	printf("    -c                 Open the written file to check it\n");
+	printf("\n");
+}
@@ -6,71 +6,45 @@
 #include "hawkc.h"
 #include "common.h"
 #include "crypto.h"
+#include "base64.h"
+#include "scan.h"
 
 static const char *HAWK_HEADER_PREFIX = "hawk.1.header";
+static const char *HAWK_HEADER_PREFIX_LINE = "hawk.1.header\n";
 static const char LF = '\n';
 
 /*
- * Scheme callback for parsing authorization header.
+ * Parse an authorization header with the Hawk specific parser.
  */
-static HawkcError authorization_scheme_handler(HawkcContext ctx,HawkcString scheme,void *data) {
-	if((scheme.len != 4) || memcmp(scheme.data,"Hawk",4) != 0) {
-		return hawkc_set_error(ctx,
-					HAWKC_BAD_SCHEME_ERROR, "Unsupported authentication scheme '%.*s'" , scheme.len,scheme.data);
+HawkcError hawkc_parse_authorization_header(HawkcContext ctx, unsigned char *value, size_t len) {
+	HawkcError e;
+	/* The key resolved for the previous request must not sign this one */
+	ctx->request_key = NULL;
+	if( (e = hawkc_parse_hawk_authorization_header(ctx,value,len,&(ctx->header_in))) != HAWKC_OK) {
+		return e;
 	}
-	return HAWKC_OK;
-}
-
-/*
- * Parameter callback for parsing authorization header.
- */
-static HawkcError param_handler(HawkcContext ctx,HawkcString key, HawkcString value,void *data) {
-
-	AuthorizationHeader h = (AuthorizationHeader)data;
-	if(key.len == 2 && !memcmp(key.data,"id",key.len)) {
-		h->id.data = value.data;
-		h->id.len = value.len;
-	} else if(key.len == 3 && !memcmp(key.data,"mac",key.len)) {
-		h->mac.data = value.data;
-		h->mac.len = value.len;
-	} else if(key.len == 4 && !memcmp(key.data,"hash",key.len)) {
-		h->hash.data = value.data;
-		h->hash.len = value.len;
-	} else if(key.len == 5 && !memcmp(key.data,"nonce",key.len)) {
-		h->nonce.data = value.data;
-		h->nonce.len = value.len;
-	} else if(key.len == 2 && !memcmp(key.data,"ts",key.len)) {
-		HawkcError e;
-		if( (e = hawkc_parse_time(ctx,value,&(h->ts))) != HAWKC_OK) {
-			return e;
-		}
-	} else if(key.len == 3 && !memcmp(key.data,"ext",key.len)) {
-		h->ext.data = value.data;
-		h->ext.len = value.len;
-	} else if(key.len == 3 && !memcmp(key.data,"app",key.len)) {
-		h->app.data = value.data;
-		h->app.len = value.len;
-	} else if(key.len == 3 && !memcmp(key.data,"dlg",key.len)) {
-		h->dlg.data = value.data;
-		h->dlg.len = value.len;
-	} else {
-		; /* ignore unknown parameter */
+	/*
+	 * Reject unknown ids before anything else is done for the request.
+	 */
+	if(ctx->id_filter != NULL && !hawkc_id_filter_contains(ctx->id_filter,ctx->header_in.id.data,ctx->header_in.id.len)) {
+		return hawkc_set_error(ctx, HAWKC_UNKNOWN_ID_ERROR, "No credentials for id %.*s", (int)ctx->header_in.id.len, ctx->header_in.id.data);
 	}
-
 	return HAWKC_OK;
 }
 
 
+
 /*
- * Parse an authorization header. Using the internal auth header parser with the
- * appropriate callbacks.
+ * Count the bytes of value that are a or b.
  */
-HawkcError hawkc_parse_authorization_header(HawkcContext ctx, unsigned char *value, size_t len) {
-	return hawkc_parse_auth_header(ctx,value,len,authorization_scheme_handler, param_handler,&(ctx->header_in));
+static size_t count_bytes(HawkcString value, unsigned char a, unsigned char b) {
+	size_t i, n = 0;
+	for(i = 0; i < value.len; i++) {
+		n += (value.data[i] == a || value.data[i] == b);
+	}
+	return n;
 }
 
-
-
 /*
  * Calculate the number of bytes needed to store the base string.
  */
@@ -92,9 +66,10 @@ size_t hawkc_calculate_base_string_length(HawkcContext ctx, AuthorizationHeader
 	n += ctx->port.len;
 	n++; /* 1 for \n */
 
-	n++; /* Body hash always empty, but 1 for \n. See https://github.com/algermissen/hawkc/issues/1 */
+	n += header->hash.len;
+	n++; /* 1 for \n */
 
-	n += header->ext.len;
+	n += header->ext.len + count_bytes(header->ext,'\\',LF);
 	n++; /* 1 for \n */
 	if( header->app.len > 0) {
 		n += header->app.len;
@@ -106,60 +81,182 @@ size_t hawkc_calculate_base_string_length(HawkcContext ctx, AuthorizationHeader
 }
 
 /*
- * Create the base string for HMAC signature generation.
+ * Pass a request or header field followed by a line feed to the sink.
  */
-void hawkc_create_base_string(HawkcContext ctx, AuthorizationHeader header, unsigned char* buf, size_t *len) {
-	unsigned char *ptr;
+static void emit_line(HawkcBaseStringSink sink, void *data, HawkcString value) {
+	if(value.len > 0) {
+		sink(value.data,value.len,data);
+	}
+	sink((const unsigned char *)&LF,1,data);
+}
+
+/*
+ * Pass ext followed by a line feed to the sink. Like the reference
+ * implementation, the base string has \\ for \ and \n for line feeds.
+ */
+static void emit_ext_line(HawkcBaseStringSink sink, void *data, HawkcString ext) {
+	size_t i, start = 0;
+
+	for(i = 0; i < ext.len; i++) {
+		if(ext.data[i] == '\\' || ext.data[i] == LF) {
+			if(i > start) {
+				sink(ext.data + start,i - start,data);
+			}
+			sink((const unsigned char *)(ext.data[i] == LF ? "\\n" : "\\\\"),2,data);
+			start = i + 1;
+		}
+	}
+	if(ext.len > start) {
+		sink(ext.data + start,ext.len - start,data);
+	}
+	sink((const unsigned char *)&LF,1,data);
+}
+
+/*
+ * Produce the base string for HMAC signature generation segment by segment.
+ */
+void hawkc_emit_base_string(HawkcContext ctx, AuthorizationHeader header, HawkcBaseStringSink sink, void *data) {
+	/* Room for the digits of any time_t value, a sign and the line feed */
+	unsigned char ts_buf[24];
 	size_t n;
-	ptr = buf;
 
-	memcpy(ptr,HAWK_HEADER_PREFIX,strlen(HAWK_HEADER_PREFIX));
-	ptr += strlen(HAWK_HEADER_PREFIX);
-	*ptr = LF; ptr++;
+	sink((const unsigned char *)HAWK_HEADER_PREFIX_LINE,strlen(HAWK_HEADER_PREFIX_LINE),data);
 
-	n = hawkc_ttoa(ptr,header->ts); ptr += n;
-	*ptr = LF; ptr++;
+	n = hawkc_ttoa(ts_buf,header->ts);
+	ts_buf[n++] = LF;
+	sink(ts_buf,n,data);
 
-	memcpy(ptr,header->nonce.data,header->nonce.len);
-	ptr += header->nonce.len;
-	*ptr = LF; ptr++;
+	emit_line(sink,data,header->nonce);
+	emit_line(sink,data,ctx->method);
+	emit_line(sink,data,ctx->path);
+	emit_line(sink,data,ctx->host);
+	emit_line(sink,data,ctx->port);
 
-	memcpy(ptr,ctx->method.data,ctx->method.len);
-	ptr += ctx->method.len;
-	*ptr = LF; ptr++;
+	emit_line(sink,data,header->hash);
+	emit_ext_line(sink,data,header->ext);
 
-	memcpy(ptr,ctx->path.data,ctx->path.len);
-	ptr += ctx->path.len;
-	*ptr = LF; ptr++;
+	if(header->app.len > 0) {
+		emit_line(sink,data,header->app);
+		emit_line(sink,data,header->dlg);
+	}
+}
 
-	memcpy(ptr,ctx->host.data,ctx->host.len);
-	ptr += ctx->host.len;
-	*ptr = LF; ptr++;
+/*
+ * Base string sink that copies the segments to a buffer.
+ */
+static void copy_sink(const unsigned char *segment, size_t len, void *data) {
+	unsigned char **ptr = (unsigned char **)data;
+	memcpy(*ptr,segment,len);
+	*ptr += len;
+}
 
-	memcpy(ptr,ctx->port.data,ctx->port.len);
-	ptr += ctx->port.len;
-	*ptr = LF; ptr++;
+/*
+ * State of the bounded copy sink.
+ */
+typedef struct BoundedCopy {
+	unsigned char *buf;
+	size_t size;
+	size_t len;
+} BoundedCopy;
 
-	/* Body hash always empty. See https://github.com/algermissen/hawkc/issues/1 */
-	*ptr = LF; ptr++;
+/*
+ * Base string sink that copies the segments to a fixed size buffer. len
+ * counts all bytes, also those that did not fit.
+ */
+static void bounded_copy_sink(const unsigned char *segment, size_t len, void *data) {
+	BoundedCopy *b = (BoundedCopy *)data;
+	if(b->len + len <= b->size) {
+		memcpy(b->buf + b->len,segment,len);
+	}
+	b->len += len;
+}
 
-	memcpy(ptr,header->ext.data,header->ext.len);
-	ptr += header->ext.len;
-	*ptr = LF; ptr++;
+/*
+ * State of the HMAC base string sink.
+ *
+ * Most base string segments are only a few bytes long (line feeds, port,
+ * method) and every digest update has a fixed cost. Short segments are
+ * therefore collected in a small staging buffer and passed to the HMAC
+ * together. Segments that do not fit, typically long paths or ext data,
+ * go to the HMAC directly.
+ */
+typedef struct HmacSink {
+	HawkcHmacCtx hmac_ctx;
+	size_t len;
+	unsigned char buf[64];
+} HmacSink;
+
+static void hmac_sink_flush(HmacSink *s) {
+	if(s->len > 0) {
+		hawkc_hmac_update(&(s->hmac_ctx),s->buf,s->len);
+		s->len = 0;
+	}
+}
 
-	if(header->app.len > 0) {
-		memcpy(ptr,header->app.data,header->app.len);
-		ptr += header->app.len;
-		*ptr = LF; ptr++;
-		memcpy(ptr,header->dlg.data,header->dlg.len);
-		ptr += header->dlg.len;
-		*ptr = LF; ptr++;
+/*
+ * Base string sink that feeds the segments into an HMAC computation.
+ */
+static void hmac_sink(const unsigned char *segment, size_t len, void *data) {
+	HmacSink *s = (HmacSink *)data;
+	if(s->len + len > sizeof(s->buf)) {
+		hmac_sink_flush(s);
+		if(len > sizeof(s->buf)) {
+			hawkc_hmac_update(&(s->hmac_ctx),segment,len);
+			return;
+		}
 	}
+	memcpy(s->buf + s->len,segment,len);
+	s->len += len;
+}
 
+/*
+ * Create the base string for HMAC signature generation.
+ */
+void hawkc_create_base_string(HawkcContext ctx, AuthorizationHeader header, unsigned char* buf, size_t *len) {
+	unsigned char *ptr = buf;
+	hawkc_emit_base_string(ctx,header,copy_sink,&ptr);
 	*len = ptr - buf;
-	/* FIXME
-	fprintf(stderr,"\n---------------------------\n%.*s\n---------------------------\n" , *len , buf);
-	*/
+}
+
+/*
+ * Feed the base string of the given header into an HMAC computation
+ * without materializing the base string.
+ */
+static HawkcError base_string_hmac_update(HawkcContext ctx, AuthorizationHeader header, HmacSink *sink) {
+	HawkcError e;
+
+	if( (e = hawkc_context_hmac_init(ctx,&(sink->hmac_ctx))) != HAWKC_OK) {
+		return e;
+	}
+	sink->len = 0;
+	hawkc_emit_base_string(ctx,header,hmac_sink,sink);
+	hmac_sink_flush(sink);
+	return HAWKC_OK;
+}
+
+/*
+ * Calculate the base64 encoded HMAC for the base string of the given header.
+ */
+static HawkcError base_string_hmac(HawkcContext ctx, AuthorizationHeader header) {
+	HawkcError e;
+	HmacSink sink;
+
+	if( (e = base_string_hmac_update(ctx,header,&sink)) != HAWKC_OK) {
+		return e;
+	}
+	return hawkc_hmac_final(ctx,&(sink.hmac_ctx),ctx->hmac.data,&(ctx->hmac.len));
+}
+
+/*
+ * Decode the mac of the parsed header into buf, which must hold
+ * MAX_HMAC_BYTES_B64 / 4 * 3 bytes. Values that are too long for any
+ * algorithm or not canonical base64 are rejected.
+ */
+static HawkcError decode_mac(HawkcContext ctx, unsigned char *buf, size_t *len) {
+	if(ctx->header_in.mac.len > MAX_HMAC_BYTES_B64) {
+		return hawkc_set_error(ctx, HAWKC_BASE64_ERROR, "mac value too long: %d bytes", (int)ctx->header_in.mac.len);
+	}
+	return hawkc_base64_decode_strict(ctx,ctx->header_in.mac.data,ctx->header_in.mac.len,buf,len);
 }
 
 /*
@@ -176,10 +273,6 @@ void hawkc_create_base_string(HawkcContext ctx, AuthorizationHeader header, unsi
 HawkcError hawkc_calculate_authorization_header_length(HawkcContext ctx, size_t *required_len) {
 
 		HawkcError e;
-		size_t base_len,required_size;
-		unsigned char base_buf[BASE_BUFFER_SIZE];
-		unsigned char *base_buf_ptr = base_buf;
-		unsigned char *dyn_base_buf = NULL;
 		AuthorizationHeader ah = &(ctx->header_out);
 
 		size_t n;
@@ -195,9 +288,7 @@ HawkcError hawkc_calculate_authorization_header_length(HawkcContext ctx, size_t
 		 * here. Otherwise we cannot generate the base string.
 		 */
 		if(ah->ts == 0) {
-			time_t t;
-			time( &t );
-			ah->ts = t + ctx->offset;
+			ah->ts = hawkc_context_time(ctx) + hawkc_context_clock_offset(ctx);
 		}
 		/*
 		 * If the caller has not yet supplied a nonce, we do that
@@ -211,39 +302,10 @@ HawkcError hawkc_calculate_authorization_header_length(HawkcContext ctx, size_t
 		}
 
 		/*
-		 * If the required size exceeds the static base string buffer, allocate
-		 * a temporary larger buffer. But only, if the allocation size stays
-		 * below HAWKC_REQUIRED_BUFFER_TOO_LARGE limit.
-		 */
-		required_size = hawkc_calculate_base_string_length(ctx,ah);
-
-		if(required_size > sizeof(base_buf)) {
-			if(required_size > MAX_DYN_BASE_BUFFER_SIZE) {
-				return hawkc_set_error(ctx,
-						HAWKC_REQUIRED_BUFFER_TOO_LARGE, "Required base string buffer of %d bytes exceeds MAX_DYN_BASE_BUFFER_SIZE" , required_size);
-			}
-			if( (dyn_base_buf = (unsigned char *)hawkc_calloc(ctx,1,required_size)) == NULL) {
-				return hawkc_set_error(ctx,
-						HAWKC_NO_MEM, "Unable to allocate %d bytes for dynamic base buffer" , required_size);
-			}
-			base_buf_ptr = dyn_base_buf;
-		}
-
-		/*
-		 * Create base string and HMAC.
+		 * Stream the base string into the HMAC.
 		 */
-		hawkc_create_base_string(ctx,ah,base_buf_ptr,&base_len);
+		e = base_string_hmac(ctx,ah);
 
-		e = hawkc_hmac(ctx, ctx->algorithm, ctx->password.data, ctx->password.len, base_buf_ptr, base_len,ctx->hmac.data,&(ctx->hmac.len));
-		/*
-		 * Free dynamic buffer immediately when it is not needed anymore.
-		 */
-		if(dyn_base_buf != NULL) {
-			hawkc_free(ctx,dyn_base_buf);
-			/* Prevent dangling pointers */
-			dyn_base_buf = NULL;
-			base_buf_ptr = base_buf;
-		}
 		/*
 		 * If HMAC generation failed, report error.
 		 */
@@ -276,10 +338,16 @@ HawkcError hawkc_calculate_authorization_header_length(HawkcContext ctx, size_t
 		n += 5; /* ts="" */
 		n += hawkc_number_of_digits(ah->ts);
 
+		if(ah->hash.len > 0) {
+			n++; /* , */
+			n += 7; /* hash="" */
+			n += ah->hash.len;
+		}
+
 		if(ah->ext.len > 0) {
 			n++; /* , */
 			n += 6; /* ext="" */
-			n += ah->ext.len;
+			n += ah->ext.len + count_bytes(ah->ext,'"','\\');
 		}
 
 		if(ah->app.len > 0) {
@@ -298,6 +366,25 @@ HawkcError hawkc_calculate_authorization_header_length(HawkcContext ctx, size_t
 		return HAWKC_OK;
 }
 
+/*
+ * Write value to p with " and \ escaped, return the end.
+ */
+static unsigned char *write_escaped(unsigned char *p, HawkcString value) {
+	size_t i = 0, run;
+
+	while(i < value.len) {
+		run = hawkc_scan_quoted(value.data + i,value.len - i);
+		memcpy(p,value.data + i,run);
+		p += run;
+		i += run;
+		if(i < value.len) {
+			*p++ = '\\';
+			*p++ = value.data[i++];
+		}
+	}
+	return p;
+}
+
 /*
  * Create an authorization header value from the internal state of the context and
  * its header_out struct.
@@ -323,11 +410,13 @@ HawkcError hawkc_create_authorization_header(HawkcContext ctx, unsigned char* bu
 	memcpy(p,"\",ts=\"",6); p += 6;
 	n = hawkc_ttoa(p,ah->ts); p+= n;
 
-	/* Body hash always empty. See https://github.com/algermissen/hawkc/issues/1 */
-
+	if(ah->hash.len > 0) {
+		memcpy(p,"\",hash=\"",8); p += 8;
+		memcpy(p,ah->hash.data,ah->hash.len); p += ah->hash.len;
+	}
 	if(ah->ext.len > 0) {
 		memcpy(p,"\",ext=\"",7); p += 7;
-		memcpy(p,ah->ext.data,ah->ext.len); p += ah->ext.len;
+		p = write_escaped(p,ah->ext);
 	}
 	if(ah->app.len > 0) {
 		memcpy(p,"\",app=\"",7); p += 7;
@@ -346,13 +435,42 @@ HawkcError hawkc_create_authorization_header(HawkcContext ctx, unsigned char* bu
 	return HAWKC_OK;
 }
 
+/*
+ * Compute the HMAC of header_in with the key of the context and compare it
+ * to the decoded mac.
+ */
+static HawkcError compare_hmac(HawkcContext ctx, unsigned char *mac, size_t mac_len, int *is_valid) {
+	HawkcError e;
+	HmacSink sink;
+
+	/*
+	 * Stream the base string into the HMAC.
+	 */
+	if( (e = base_string_hmac_update(ctx,&(ctx->header_in),&sink)) != HAWKC_OK) {
+		return e;
+	}
+	hawkc_hmac_final_raw(&(sink.hmac_ctx),ctx->hmac_digest,&(ctx->hmac_digest_len));
+	ctx->hmac.len = 0;
+
+	/*
+	 * Compare the raw HMACs
+	 */
+	if(mac_len == ctx->hmac_digest_len && hawkc_fixed_time_equal(mac,ctx->hmac_digest,mac_len) ) {
+		*is_valid = 1;
+	}
+	return HAWKC_OK;
+}
+
 /*
  * Validate the HMAC of the context's header_in struct.
  * This assumes a header has been parsed and thus that the
  * header_in struct has been populated. It is also
  * required that the caller has set password and algorithm
  * on the context, as well as the reuqest parameters that
- * go into the base string (method,path,host,port)
+ * go into the base string (method,path,host,port).
+ * Instead of password and algorithm a precomputed key may be
+ * set using hawkc_context_set_key(), or a credential store to
+ * look the key up in by the id of the header.
  *
  * This function will then calculate an hmac from this data
  * and compare it to the hmac value parsed into header_in
@@ -360,61 +478,339 @@ HawkcError hawkc_create_authorization_header(HawkcContext ctx, unsigned char* bu
  */
 HawkcError hawkc_validate_hmac(HawkcContext ctx,int *is_valid) {
 	HawkcError e;
-	/* FIXME better names */
-	size_t base_len,required_size;
-	unsigned char base_buf[BASE_BUFFER_SIZE];
-	unsigned char *base_buf_ptr = base_buf;
-	unsigned char *dyn_base_buf = NULL;
+	unsigned char mac[MAX_HMAC_BYTES_B64 / 4 * 3];
+	size_t mac_len;
+
+	*is_valid = 0;
 
 	/*
-	 * If the required size exceeds the static base string buffer, allocate
-	 * a temporary larger buffer. But only, if the allocation size stays
-	 * below HAWKC_REQUIRED_BUFFER_TOO_LARGE limit.
+	 * Reject malformed mac values before doing any hashing.
 	 */
-	required_size = hawkc_calculate_base_string_length(ctx,&(ctx->header_in));
-	if(required_size > sizeof(base_buf)) {
-		if(required_size > MAX_DYN_BASE_BUFFER_SIZE) {
-			return hawkc_set_error(ctx,
-					HAWKC_REQUIRED_BUFFER_TOO_LARGE, "Required base string buffer of %d bytes exceeds MAX_DYN_BASE_BUFFER_SIZE" , required_size);
-		}
-		if( (dyn_base_buf = (unsigned char *)hawkc_calloc(ctx,1,required_size)) == NULL) {
-			return hawkc_set_error(ctx,
-					HAWKC_NO_MEM, "Unable to allocate %d bytes for dynamic base buffer" , required_size);
-		}
-		base_buf_ptr = dyn_base_buf;
+	if( (e = decode_mac(ctx,mac,&mac_len)) != HAWKC_OK) {
+		return e;
 	}
 
+	if( (e = hawkc_context_resolve_key(ctx)) != HAWKC_OK) {
+		return e;
+	}
+	return compare_hmac(ctx,mac,mac_len,is_valid);
+}
+
+/*
+ * Map an error of a step of hawkc_authenticate() to its result.
+ */
+static HawkcAuthResult auth_error(HawkcError e) {
+	switch(e) {
+	case HAWKC_UNKNOWN_ID_ERROR:
+		return HAWKC_AUTH_UNKNOWN_ID;
+	case HAWKC_PARSE_ERROR:
+	case HAWKC_BAD_SCHEME_ERROR:
+	case HAWKC_TIME_VALUE_ERROR:
+	case HAWKC_BASE64_ERROR:
+	case HAWKC_OVERFLOW_ERROR:
+		return HAWKC_AUTH_MALFORMED;
+	default:
+		return HAWKC_AUTH_ERROR;
+	}
+}
+
+HawkcAuthResult hawkc_authenticate(HawkcContext ctx, unsigned char *value, size_t len, time_t skew,
+		HawkcReplayCache replay_cache) {
+	HawkcError e;
+	AuthorizationHeader h = &(ctx->header_in);
+	unsigned char mac[MAX_HMAC_BYTES_B64 / 4 * 3];
+	size_t mac_len;
+	time_t now;
+	int is_valid = 0;
+	int r;
+
 	/*
-	 * Create base string and HMAC.
-	 */
-	hawkc_create_base_string(ctx,&(ctx->header_in),base_buf_ptr,&base_len);
-	e = hawkc_hmac(ctx, ctx->algorithm, ctx->password.data, ctx->password.len, base_buf_ptr, base_len,ctx->hmac.data,&(ctx->hmac.len));
-	/*
-	 * Free dynamic buffer immediately when it is not needed anymore.
+	 * Parameters and the resolved key of an earlier request must not fill
+	 * in missing ones.
 	 */
-	if(dyn_base_buf != NULL) {
-		hawkc_free(ctx,dyn_base_buf);
-		/* Prevent dangling pointers */
-		dyn_base_buf = NULL;
-		base_buf_ptr = base_buf;
+	memset(h,0,sizeof(*h));
+	ctx->request_key = NULL;
+	if( (e = hawkc_parse_authorization_header(ctx,value,len)) != HAWKC_OK) {
+		return auth_error(e);
+	}
+	if(h->id.len == 0 || h->ts == 0 || h->nonce.len == 0 || h->mac.len == 0) {
+		hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Authorization header lacks id, ts, nonce or mac");
+		return HAWKC_AUTH_MALFORMED;
+	}
+	if( (e = decode_mac(ctx,mac,&mac_len)) != HAWKC_OK) {
+		return auth_error(e);
+	}
+
+	now = hawkc_context_time(ctx);
+	if(h->ts < now - skew || h->ts > now + skew) {
+		/*
+		 * Suggest our time to the client. The WWW-Authenticate header
+		 * is signed with the client's key, so resolve it first.
+		 */
+		if( (e = hawkc_context_resolve_key(ctx)) != HAWKC_OK) {
+			return auth_error(e);
+		}
+		hawkc_www_authenticate_header_set_ts(ctx,now);
+		hawkc_set_error(ctx, HAWKC_TOKEN_VALIDATION_ERROR, "Timestamp %ld is more than %ld seconds off", (long)h->ts, (long)skew);
+		return HAWKC_AUTH_STALE_TIMESTAMP;
 	}
+
 	/*
-	 * If HMAC generation failed, report error.
+	 * Only look the nonce up for now. Remembering it before the mac has been
+	 * validated would let anyone block the nonces of other clients.
 	 */
-	if(e != HAWKC_OK) {
+	if(replay_cache != NULL
+			&& hawkc_replay_cache_seen(replay_cache,h->id.data,h->id.len,h->nonce.data,h->nonce.len,h->ts,now) == HAWKC_REPLAY_SEEN) {
+		hawkc_set_error(ctx, HAWKC_TOKEN_VALIDATION_ERROR, "Nonce %.*s has been used before", (int)h->nonce.len, h->nonce.data);
+		return HAWKC_AUTH_REPLAYED;
+	}
+
+	if( (e = hawkc_context_resolve_key(ctx)) != HAWKC_OK) {
+		return auth_error(e);
+	}
+	if( (e = compare_hmac(ctx,mac,mac_len,&is_valid)) != HAWKC_OK) {
+		return auth_error(e);
+	}
+	if(!is_valid) {
+		hawkc_set_error(ctx, HAWKC_TOKEN_VALIDATION_ERROR, "Invalid mac");
+		return HAWKC_AUTH_INVALID_MAC;
+	}
+
+	if(replay_cache != NULL) {
+		r = hawkc_replay_cache_add(replay_cache,h->id.data,h->id.len,h->nonce.data,h->nonce.len,h->ts,now);
+		if(r == HAWKC_REPLAY_FULL) {
+			hawkc_set_error(ctx, HAWKC_NO_MEM, "Replay cache bucket for ts %ld is full", (long)h->ts);
+			return HAWKC_AUTH_ERROR;
+		}
+		if(r != HAWKC_REPLAY_FRESH) {
+			/* A concurrent request with the same nonce was faster */
+			hawkc_set_error(ctx, HAWKC_TOKEN_VALIDATION_ERROR, "Nonce %.*s has been used before", (int)h->nonce.len, h->nonce.data);
+			return HAWKC_AUTH_REPLAYED;
+		}
+	}
+	return HAWKC_AUTH_OK;
+}
+
+void hawkc_encode_validated_hmac(HawkcContext ctx) {
+	hawkc_base64_encode(ctx->hmac_digest,ctx->hmac_digest_len,ctx->hmac.data,&(ctx->hmac.len));
+}
+
+/*
+ * Base strings up to this size are materialized for batch validation.
+ * Longer ones, usually due to long paths or ext data, are streamed into
+ * the HMAC by hawkc_validate_hmac() instead.
+ */
+#define BATCH_BASE_STRING_SIZE 512
+
+/*
+ * Validate the HMACs of up to HAWKC_HMAC_BATCH_SIZE contexts with a single
+ * hawkc_key_hmac_batch() call. Results go to the valid bitmap starting at
+ * bit offset first.
+ */
+static HawkcError validate_hmac_batch(HawkcContext *ctxs, size_t n, unsigned char *valid, size_t first) {
+	HawkcError e;
+	HawkcError error = HAWKC_OK;
+#if __cplusplus
+	struct _HawkcKey password_keys[HAWKC_HMAC_BATCH_SIZE];
+#else
+	struct HawkcKey password_keys[HAWKC_HMAC_BATCH_SIZE];
+#endif
+	unsigned char base_strings[HAWKC_HMAC_BATCH_SIZE][BATCH_BASE_STRING_SIZE];
+	HawkcKey keys[HAWKC_HMAC_BATCH_SIZE];
+	const unsigned char *data[HAWKC_HMAC_BATCH_SIZE];
+	size_t data_len[HAWKC_HMAC_BATCH_SIZE];
+	unsigned char *digests[HAWKC_HMAC_BATCH_SIZE];
+	unsigned char macs[HAWKC_HMAC_BATCH_SIZE][MAX_HMAC_BYTES_B64 / 4 * 3];
+	size_t mac_lens[HAWKC_HMAC_BATCH_SIZE];
+	size_t lane_index[HAWKC_HMAC_BATCH_SIZE];
+	size_t i, nlanes = 0;
+	int is_valid;
+
+	for(i = 0; i < n; i++) {
+		HawkcContext ctx = ctxs[i];
+		BoundedCopy b;
+
+		if( (e = decode_mac(ctx,macs[nlanes],&(mac_lens[nlanes]))) != HAWKC_OK) {
+			if(error == HAWKC_OK) {
+				error = e;
+			}
+			continue;
+		}
+
+		b.buf = base_strings[nlanes];
+		b.size = BATCH_BASE_STRING_SIZE;
+		b.len = 0;
+		hawkc_emit_base_string(ctx,&(ctx->header_in),bounded_copy_sink,&b);
+		if(b.len > BATCH_BASE_STRING_SIZE) {
+			is_valid = 0;
+			if( (e = hawkc_validate_hmac(ctx,&is_valid)) != HAWKC_OK && error == HAWKC_OK) {
+				error = e;
+			}
+			if(is_valid) {
+				valid[(first + i) / 8] |= 1 << ((first + i) % 8);
+			}
+			continue;
+		}
+
+		if( (e = hawkc_context_resolve_key(ctx)) != HAWKC_OK) {
+			if(error == HAWKC_OK) {
+				error = e;
+			}
+			continue;
+		}
+		if( (keys[nlanes] = hawkc_context_active_key(ctx)) == NULL) {
+			if( (e = hawkc_key_init(ctx,&(password_keys[nlanes]),ctx->algorithm,ctx->password.data,ctx->password.len)) != HAWKC_OK) {
+				if(error == HAWKC_OK) {
+					error = e;
+				}
+				continue;
+			}
+			keys[nlanes] = &(password_keys[nlanes]);
+		}
+		data[nlanes] = base_strings[nlanes];
+		data_len[nlanes] = b.len;
+		digests[nlanes] = ctx->hmac_digest;
+		lane_index[nlanes] = i;
+		nlanes++;
+	}
+
+	hawkc_key_hmac_batch(keys,data,data_len,nlanes,digests);
+
+	for(i = 0; i < nlanes; i++) {
+		HawkcContext ctx = ctxs[lane_index[i]];
+		size_t bit = first + lane_index[i];
+		ctx->hmac_digest_len = keys[i]->algorithm->digest_size;
+		ctx->hmac.len = 0;
+		if(mac_lens[i] == ctx->hmac_digest_len && hawkc_fixed_time_equal(macs[i],ctx->hmac_digest,mac_lens[i]) ) {
+			valid[bit / 8] |= 1 << (bit % 8);
+		}
+	}
+
+	hawkc_cleanse(password_keys,sizeof(password_keys));
+
+	return error;
+}
+
+/*
+ * State of the base string sink that feeds several HMAC computations of
+ * the same base string, see hmac_sink.
+ */
+typedef struct MultiHmacSink {
+	HawkcHmacCtx hmac_ctxs[HAWKC_HMAC_BATCH_SIZE];
+	size_t n;
+	size_t len;
+	unsigned char buf[64];
+} MultiHmacSink;
+
+static void multi_hmac_sink_update(MultiHmacSink *s, const unsigned char *data, size_t len) {
+	size_t i;
+	for(i = 0; i < s->n; i++) {
+		hawkc_hmac_update(&(s->hmac_ctxs[i]),data,len);
+	}
+}
+
+static void multi_hmac_sink(const unsigned char *segment, size_t len, void *data) {
+	MultiHmacSink *s = (MultiHmacSink *)data;
+	if(s->len + len > sizeof(s->buf)) {
+		multi_hmac_sink_update(s,s->buf,s->len);
+		s->len = 0;
+		if(len > sizeof(s->buf)) {
+			multi_hmac_sink_update(s,segment,len);
+			return;
+		}
+	}
+	memcpy(s->buf + s->len,segment,len);
+	s->len += len;
+}
+
+/*
+ * Validate the HMAC of the context against several keys, see hawkc.h. Base
+ * strings that fit BATCH_BASE_STRING_SIZE are built once and hashed under
+ * up to HAWKC_HMAC_BATCH_SIZE keys per hawkc_key_hmac_batch() call. Longer
+ * ones are streamed into the HMACs of a group of keys at once.
+ */
+HawkcError hawkc_validate_hmac_any(HawkcContext ctx, const HawkcKey *keys, size_t n, int *matched) {
+	HawkcError e;
+	unsigned char mac[MAX_HMAC_BYTES_B64 / 4 * 3];
+	unsigned char base_string[BATCH_BASE_STRING_SIZE];
+	unsigned char digests[HAWKC_HMAC_BATCH_SIZE][MAX_HMAC_BYTES];
+	unsigned char *digest_ptrs[HAWKC_HMAC_BATCH_SIZE];
+	const unsigned char *data[HAWKC_HMAC_BATCH_SIZE];
+	size_t data_len[HAWKC_HMAC_BATCH_SIZE];
+	size_t mac_len, first, i, m, digest_len;
+	BoundedCopy b;
+	MultiHmacSink sink;
+
+	*matched = -1;
+
+	if( (e = decode_mac(ctx,mac,&mac_len)) != HAWKC_OK) {
 		return e;
 	}
 
-	/*
-	 * Compare HMACs
-	 */
-	if(ctx->header_in.mac.len == ctx->hmac.len && hawkc_fixed_time_equal(ctx->header_in.mac.data,ctx->hmac.data,ctx->hmac.len) ) {
-		*is_valid = 1;
-	} else {
-		*is_valid = 0;
+	b.buf = base_string;
+	b.size = sizeof(base_string);
+	b.len = 0;
+	hawkc_emit_base_string(ctx,&(ctx->header_in),bounded_copy_sink,&b);
+
+	for(i = 0; i < HAWKC_HMAC_BATCH_SIZE; i++) {
+		data[i] = base_string;
+		data_len[i] = b.len;
+		digest_ptrs[i] = digests[i];
 	}
+
+	for(first = 0; first < n; first += HAWKC_HMAC_BATCH_SIZE) {
+		m = n - first < HAWKC_HMAC_BATCH_SIZE ? n - first : HAWKC_HMAC_BATCH_SIZE;
+		if(b.len <= sizeof(base_string)) {
+			hawkc_key_hmac_batch(keys + first,data,data_len,m,digest_ptrs);
+		} else {
+			for(i = 0; i < m; i++) {
+				if( (e = hawkc_hmac_init(ctx,&(sink.hmac_ctxs[i]),keys[first + i])) != HAWKC_OK) {
+					return e;
+				}
+			}
+			sink.n = m;
+			sink.len = 0;
+			hawkc_emit_base_string(ctx,&(ctx->header_in),multi_hmac_sink,&sink);
+			multi_hmac_sink_update(&sink,sink.buf,sink.len);
+			for(i = 0; i < m; i++) {
+				hawkc_hmac_final_raw(&(sink.hmac_ctxs[i]),digests[i],&digest_len);
+			}
+		}
+
+		/*
+		 * Every key is compared, so the time taken does not depend on
+		 * which key matches.
+		 */
+		for(i = 0; i < m; i++) {
+			digest_len = keys[first + i]->algorithm->digest_size;
+			if(mac_len == digest_len && hawkc_fixed_time_equal(mac,digests[i],mac_len) && *matched < 0) {
+				*matched = (int)(first + i);
+				memcpy(ctx->hmac_digest,digests[i],digest_len);
+				ctx->hmac_digest_len = digest_len;
+			}
+		}
+	}
+	ctx->hmac.len = 0;
 	return HAWKC_OK;
 }
 
+/*
+ * Validate the HMACs of several contexts, see hawkc.h. The contexts are
+ * processed in groups of HAWKC_HMAC_BATCH_SIZE so the backend can hash the
+ * base strings of a group in parallel.
+ */
+HawkcError hawkc_validate_hmac_batch(HawkcContext *ctxs, size_t n, unsigned char *valid) {
+	HawkcError e;
+	HawkcError error = HAWKC_OK;
+	size_t first;
 
+	memset(valid,0,(n + 7) / 8);
 
+	for(first = 0; first < n; first += HAWKC_HMAC_BATCH_SIZE) {
+		size_t m = n - first < HAWKC_HMAC_BATCH_SIZE ? n - first : HAWKC_HMAC_BATCH_SIZE;
+		if( (e = validate_hmac_batch(ctxs + first,m,valid,first)) != HAWKC_OK && error == HAWKC_OK) {
+			error = e;
+		}
+	}
+	return error;
+}
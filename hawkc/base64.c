@@ -35,6 +35,7 @@
 
  */
 #include "base64.h"
+#include "common.h"
 
 const static char* b64="ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" ;
 
@@ -158,3 +159,95 @@ unsigned char *hawkc_base64_decode(const unsigned char* safeAsciiPtr, size_t len
 	  return bin ;
 
 }
+
+
+/*
+ * Values of the base64 alphabet characters, 255 for all other characters.
+ */
+const static unsigned char strict_unb64[]={
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255,  62, 255, 255, 255,  63,  52,  53,
+  54,  55,  56,  57,  58,  59,  60,  61, 255, 255,
+ 255, 255, 255, 255, 255,   0,   1,   2,   3,   4,
+   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+  15,  16,  17,  18,  19,  20,  21,  22,  23,  24,
+  25, 255, 255, 255, 255, 255, 255,  26,  27,  28,
+  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,
+  39,  40,  41,  42,  43,  44,  45,  46,  47,  48,
+  49,  50,  51, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+ 255, 255, 255, 255, 255, 255,
+};
+
+HawkcError hawkc_base64_decode_strict(HawkcContext ctx, const unsigned char *data, size_t data_len,
+		unsigned char *result, size_t *result_len) {
+
+	size_t cb = 0;
+	size_t charNo;
+	size_t pad = 0;
+	unsigned char A, B, C, D;
+
+	if(data_len % 4 != 0) {
+		return hawkc_set_error(ctx, HAWKC_BASE64_ERROR, "Base64 encoded length %d is not a multiple of 4", (int)data_len);
+	}
+	if(data_len == 0) {
+		*result_len = 0;
+		return HAWKC_OK;
+	}
+	if(data[data_len - 1] == '=') {
+		pad = data[data_len - 2] == '=' ? 2 : 1;
+	}
+
+	for(charNo = 0; charNo + 4 < data_len; charNo += 4) {
+		A = strict_unb64[data[charNo]];
+		B = strict_unb64[data[charNo + 1]];
+		C = strict_unb64[data[charNo + 2]];
+		D = strict_unb64[data[charNo + 3]];
+		if((A | B | C | D) == 255) {
+			return hawkc_set_error(ctx, HAWKC_BASE64_ERROR, "Invalid character in base64 encoded data");
+		}
+		result[cb++] = (A << 2) | (B >> 4);
+		result[cb++] = (B << 4) | (C >> 2);
+		result[cb++] = (C << 6) | D;
+	}
+
+	/*
+	 * Last quantum. Padding characters count as zero, the bits they and
+	 * the last data character leave over must be zero, too, so that every
+	 * value has exactly one valid encoding.
+	 */
+	A = strict_unb64[data[charNo]];
+	B = strict_unb64[data[charNo + 1]];
+	C = pad == 2 ? 0 : strict_unb64[data[charNo + 2]];
+	D = pad >= 1 ? 0 : strict_unb64[data[charNo + 3]];
+	if((A | B | C | D) == 255) {
+		return hawkc_set_error(ctx, HAWKC_BASE64_ERROR, "Invalid character or padding in base64 encoded data");
+	}
+	if((pad == 2 && (B & 0x0f) != 0) || (pad == 1 && (C & 0x03) != 0)) {
+		return hawkc_set_error(ctx, HAWKC_BASE64_ERROR, "Non-zero padding bits in base64 encoded data");
+	}
+	result[cb++] = (A << 2) | (B >> 4);
+	if(pad < 2) {
+		result[cb++] = (B << 4) | (C >> 2);
+	}
+	if(pad < 1) {
+		result[cb++] = (C << 6) | D;
+	}
+
+	*result_len = cb;
+	return HAWKC_OK;
+}
@@ -37,6 +37,20 @@ unsigned char* HAWKCAPI hawkc_base64_encode( const unsigned char *data, size_t d
  */
 unsigned char* HAWKCAPI hawkc_base64_decode( const unsigned char *data, size_t data_len, unsigned char *result, size_t *result_len );
 
+/** Base64 decode the given data and validate it.
+ *
+ * Unlike hawkc_base64_decode() this function only accepts canonical
+ * encodings: the length must be a multiple of 4, all characters must be
+ * from the base64 alphabet, '=' may only appear as padding at the end and
+ * the bits that padding leaves over must be zero. Otherwise HAWKC_BASE64_ERROR
+ * is returned and the context's error is set.
+ *
+ * The result buffer must hold data_len * 3/4 bytes.
+ *
+ * The result will not be \0-terminated.
+ */
+HawkcError HAWKCAPI hawkc_base64_decode_strict(HawkcContext ctx, const unsigned char *data, size_t data_len, unsigned char *result, size_t *result_len);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,58 @@
+/*
+ * Clock sources.
+ *
+ * Request timestamps have a resolution of one second, so the default clock
+ * reads the coarse realtime clock where there is one. On Linux the kernel
+ * updates it once per tick and the vDSO reads it without a system call or
+ * reading the time stamp counter, so it costs a few nanoseconds per call.
+ * Elsewhere it falls back to time().
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <time.h>
+
+#include "hawkc.h"
+#include "common.h"
+
+time_t hawkc_coarse_clock(void *data) {
+#ifdef CLOCK_REALTIME_COARSE
+	struct timespec ts;
+	if(clock_gettime(CLOCK_REALTIME_COARSE,&ts) == 0) {
+		return ts.tv_sec;
+	}
+#endif
+	return time(NULL);
+}
+
+time_t hawkc_fake_clock(void *data) {
+	HawkcFakeClock *clock = (HawkcFakeClock*)data;
+	time_t now = clock->now;
+	clock->now += clock->step;
+	return now;
+}
+
+void hawkc_context_set_clock(HawkcContext ctx, HawkcClock clock, void *data) {
+	ctx->clock = clock;
+	ctx->clock_data = data;
+}
+
+time_t hawkc_context_time(HawkcContext ctx) {
+	if(ctx->clock == NULL) {
+		return hawkc_coarse_clock(NULL);
+	}
+	return (ctx->clock)(ctx->clock_data);
+}
+
+HawkcError hawkc_check_timestamp(HawkcContext ctx, time_t skew, int *is_valid) {
+	time_t now = hawkc_context_time(ctx);
+	time_t ts = ctx->header_in.ts;
+
+	*is_valid = ts >= now - skew && ts <= now + skew;
+	if(!*is_valid) {
+		/* Suggest our time to the client */
+		hawkc_www_authenticate_header_set_ts(ctx,now);
+	}
+	return HAWKC_OK;
+}
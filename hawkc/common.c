@@ -3,29 +3,11 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include "hawkc.h"
 #include "common.h"
 #include "crypto.h"
-
-/**
- * Algorithms provided by hawkc.
- *
- * If you add more algorithms here, you need to check and maybe adjust the
- * buffer size constants defined in common.h
- *
- * Also, you must add to the selection if-cascades in crypto_openssl.c for them
- * to be recognized.
- */
-#if __cplusplus
-struct _HawkcAlgorithm _HAWKC_SHA_256 = { "sha256" };
-struct _HawkcAlgorithm _HAWKC_SHA_1 = { "sha1" };
-#else
-struct HawkcAlgorithm _HAWKC_SHA_256 = { "sha256" };
-struct HawkcAlgorithm _HAWKC_SHA_1 = { "sha1" };
-#endif
-
-HawkcAlgorithm HAWKC_SHA_256 = &_HAWKC_SHA_256;
-HawkcAlgorithm HAWKC_SHA_1 = &_HAWKC_SHA_1;
+#include "base64.h"
 
 /** Error strings used by hawkc_strerror
  * Must correspond to the array of codes in hawkc.h
@@ -43,11 +25,13 @@ static char *error_strings[] = {
 		"Unspecific error", /* HAWKC_ERROR */
 		"Unexpected string length or padding in base64 en- or decoding", /* HAWKC_BASE64_ERROR */
         "Unexpected number value would cause integer overflow", /* HAWKC_OVERFLOW_ERROR */
+		"No credentials for the id", /* HAWKC_UNKNOWN_ID_ERROR */
+		"Input ends before the end of the request head", /* HAWKC_INCOMPLETE_ERROR */
 		NULL
 };
 
 char* hawkc_strerror(HawkcError e) {
-	assert(e >= HAWKC_OK && e <= HAWKC_ERROR);
+	assert(e >= HAWKC_OK && e <= HAWKC_INCOMPLETE_ERROR);
 	return error_strings[e];
 }
 
@@ -124,6 +108,113 @@ void hawkc_context_set_algorithm(HawkcContext ctx,HawkcAlgorithm algorithm) {
 	ctx->algorithm = algorithm;
 }
 
+HawkcError hawkc_key_create(HawkcContext ctx, HawkcAlgorithm algorithm, unsigned char *password, size_t len, HawkcKey *key) {
+	HawkcError e;
+	HawkcKey k;
+#ifdef __cplusplus
+	if( (k = (HawkcKey)hawkc_calloc(ctx,1,sizeof(struct _HawkcKey))) == NULL) {
+#else
+	if( (k = (HawkcKey)hawkc_calloc(ctx,1,sizeof(struct HawkcKey))) == NULL) {
+#endif
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate key");
+	}
+	if( (e = hawkc_key_init(ctx,k,algorithm,password,len)) != HAWKC_OK) {
+		hawkc_free(ctx,k);
+		return e;
+	}
+	*key = k;
+	return HAWKC_OK;
+}
+
+void hawkc_key_free(HawkcContext ctx, HawkcKey key) {
+	if(key == NULL) {
+		return;
+	}
+	/* Do not leave the key material behind in freed memory */
+	hawkc_cleanse(key,sizeof(*key));
+	hawkc_free(ctx,key);
+}
+
+void hawkc_context_set_key(HawkcContext ctx, HawkcKey key) {
+	ctx->key = key;
+	ctx->request_key = NULL;
+	if(key != NULL) {
+		ctx->algorithm = key->algorithm;
+	}
+}
+
+void hawkc_context_set_key_resolver(HawkcContext ctx, HawkcKeyResolver resolver, void *data) {
+	ctx->resolver = resolver;
+	ctx->resolver_data = data;
+	ctx->request_key = NULL;
+}
+
+HawkcError hawkc_context_resolve_key(HawkcContext ctx) {
+	HawkcError e;
+	ctx->request_key = NULL;
+	if(ctx->resolver == NULL) {
+		return HAWKC_OK;
+	}
+	if( (e = ctx->resolver(ctx,ctx->header_in.id.data,ctx->header_in.id.len,&(ctx->resolved_key),ctx->resolver_data)) != HAWKC_OK) {
+		if(e == HAWKC_UNKNOWN_ID_ERROR && ctx->id_filter != NULL) {
+			hawkc_id_filter_false_positive(ctx->id_filter);
+		}
+		return e;
+	}
+	ctx->request_key = &(ctx->resolved_key);
+	return HAWKC_OK;
+}
+
+HawkcKey hawkc_context_active_key(HawkcContext ctx) {
+	return ctx->request_key != NULL ? ctx->request_key : ctx->key;
+}
+
+HawkcAlgorithm hawkc_context_active_algorithm(HawkcContext ctx) {
+	HawkcKey key = hawkc_context_active_key(ctx);
+	return key != NULL ? key->algorithm : ctx->algorithm;
+}
+
+void hawkc_key_export(HawkcKey key, unsigned char *buf) {
+	key->algorithm->export_chain(key->inner.bytes,buf);
+	key->algorithm->export_chain(key->outer.bytes,buf + key->algorithm->chain_size);
+}
+
+void hawkc_key_import(HawkcKey key, HawkcAlgorithm algorithm, const unsigned char *buf) {
+	key->algorithm = algorithm;
+	algorithm->import_chain(key->inner.bytes,buf);
+	algorithm->import_chain(key->outer.bytes,buf + algorithm->chain_size);
+}
+
+HawkcError hawkc_context_hmac_init(HawkcContext ctx, HawkcHmacCtx *hmac_ctx) {
+	HawkcError e;
+	HawkcKey key = hawkc_context_active_key(ctx);
+	if(key != NULL) {
+		return hawkc_hmac_init(ctx, hmac_ctx, key);
+	}
+	if( (e = hawkc_key_init(ctx, &(hmac_ctx->password_key), ctx->algorithm, ctx->password.data, ctx->password.len)) != HAWKC_OK) {
+		return e;
+	}
+	return hawkc_hmac_init(ctx, hmac_ctx, &(hmac_ctx->password_key));
+}
+
+HawkcError hawkc_hmac_final(HawkcContext ctx, HawkcHmacCtx *hmac_ctx, unsigned char *result, size_t *result_len) {
+	unsigned char buf[MAX_HMAC_BYTES];
+	size_t len;
+	hawkc_hmac_final_raw(hmac_ctx, buf, &len);
+	hawkc_base64_encode(buf, len, result, result_len);
+	return HAWKC_OK;
+}
+
+HawkcError hawkc_context_hmac(HawkcContext ctx, const unsigned char *data, size_t data_len, unsigned char *result, size_t *result_len) {
+	HawkcError e;
+	HawkcHmacCtx hmac_ctx;
+	if( (e = hawkc_context_hmac_init(ctx, &hmac_ctx)) != HAWKC_OK) {
+		return e;
+	}
+	hawkc_hmac_update(&hmac_ctx, data, data_len);
+	return hawkc_hmac_final(ctx, &hmac_ctx, result, result_len);
+}
+
 void hawkc_context_set_id(HawkcContext ctx,unsigned char *id, size_t len) {
 	ctx->header_out.id.data = id;
 	ctx->header_out.id.len = len;
@@ -144,6 +235,11 @@ void hawkc_context_set_ext(HawkcContext ctx,unsigned char *ext, size_t len) {
 	ctx->header_out.ext.len = len;
 }
 
+void hawkc_context_set_hash(HawkcContext ctx,unsigned char *hash, size_t len) {
+	ctx->header_out.hash.data = hash;
+	ctx->header_out.hash.len = len;
+}
+
 void hawkc_context_set_method(HawkcContext ctx,unsigned char *method, size_t len) {
 	ctx->method.data = method;
 	ctx->method.len = len;
@@ -165,25 +261,42 @@ void hawkc_context_set_port(HawkcContext ctx,unsigned char *port, size_t len) {
 }
 
 HawkcAlgorithm hawkc_algorithm_by_name(char *name, size_t len) {
-	if (len == strlen(HAWKC_SHA_1->name) && strncmp(name, HAWKC_SHA_1->name, len) == 0) {
-		return HAWKC_SHA_1;
-	} else if (len == strlen(HAWKC_SHA_256->name) && strncmp(name, HAWKC_SHA_256->name, len) == 0) {
-		return HAWKC_SHA_256;
-	} else {
-		return NULL;
+	int i;
+	for(i = 0; hawkc_algorithms[i] != NULL; i++) {
+		if (len == strlen(hawkc_algorithms[i]->name) && strncmp(name, hawkc_algorithms[i]->name, len) == 0) {
+			return hawkc_algorithms[i];
+		}
 	}
+	return NULL;
 }
 
+/*
+ * Compares a machine word at a time and accumulates the differences instead
+ * of branching on them, so the running time only depends on len.
+ */
 int hawkc_fixed_time_equal(unsigned char *lhs, unsigned char * rhs, size_t len) {
-	int equal = 1;
+	size_t diff = 0;
+	size_t a, b;
 	size_t i;
-	/* FIXME: try to remove casts - I fail to see why they are needed. Implicit cast by op?*/
-	for(i = 0; (int)i<(int)len;i++) {
-		if(lhs[i] != rhs[i]) {
-			equal = 0;
-		}
+	for(i = 0; i + sizeof(size_t) <= len; i += sizeof(size_t)) {
+		memcpy(&a,lhs + i,sizeof(a));
+		memcpy(&b,rhs + i,sizeof(b));
+		diff |= a ^ b;
 	}
-	return equal;
+	for(; i < len; i++) {
+		diff |= (size_t)(lhs[i] ^ rhs[i]);
+	}
+	return diff == 0;
+}
+
+/*
+ * Calling memset through a volatile function pointer keeps the compiler
+ * from dropping the call as a dead store, like OPENSSL_cleanse() does.
+ */
+static void *(*const volatile cleanse_memset)(void *, int, size_t) = memset;
+
+void hawkc_cleanse(void *p, size_t len) {
+	cleanse_memset(p,0,len);
 }
 
 
@@ -218,7 +331,7 @@ HawkcError hawkc_parse_time(HawkcContext ctx, HawkcString ts, time_t *tp) {
 	while(i < ts.len) {
 		if(!isdigit(*p)) {
 			return hawkc_set_error(ctx,
-					HAWKC_TIME_VALUE_ERROR, "'%.*s' is not a valid integer" , ts.len,ts.data);
+					HAWKC_TIME_VALUE_ERROR, "'%.*s' is not a valid integer" , (int)ts.len,ts.data);
 		}
 		t = (t * 10) + hawkc_my_digittoint(*p);
 
@@ -287,3 +400,90 @@ size_t hawkc_ttoa(unsigned char* buf, time_t value) {
 
 
 
+
+/*
+ * XXH64 primes.
+ */
+#define P1 0x9E3779B185EBCA87ULL
+#define P2 0xC2B2AE3D27D4EB4FULL
+#define P3 0x165667B19E3779F9ULL
+#define P4 0x85EBCA77C2B2AE63ULL
+#define P5 0x27D4EB2F165667C5ULL
+
+#define ROTL64(x,n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+static uint64_t read64le(const unsigned char *p) {
+	return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24
+			| (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40 | (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+static uint64_t read32le(const unsigned char *p) {
+	return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16 | (uint64_t)p[3] << 24;
+}
+
+static uint64_t hash_round(uint64_t acc, uint64_t input) {
+	acc += input * P2;
+	acc = ROTL64(acc,31);
+	return acc * P1;
+}
+
+static uint64_t hash_merge(uint64_t h, uint64_t acc) {
+	h ^= hash_round(0,acc);
+	return h * P1 + P4;
+}
+
+/*
+ * XXH64. The four accumulators of the main loop are independent, so long
+ * inputs are hashed 32 bytes per iteration with four multiplications in
+ * flight, which compilers also map to vector instructions where available.
+ */
+uint64_t hawkc_hash_bytes(const unsigned char *data, size_t len, uint64_t seed) {
+	const unsigned char *p = data;
+	const unsigned char *end = data + len;
+	uint64_t h;
+
+	if(len >= 32) {
+		uint64_t acc[4];
+		int i;
+		acc[0] = seed + P1 + P2;
+		acc[1] = seed + P2;
+		acc[2] = seed;
+		acc[3] = seed - P1;
+		do {
+			for(i = 0; i < 4; i++) {
+				acc[i] = hash_round(acc[i],read64le(p + 8 * i));
+			}
+			p += 32;
+		} while(end - p >= 32);
+		h = ROTL64(acc[0],1) + ROTL64(acc[1],7) + ROTL64(acc[2],12) + ROTL64(acc[3],18);
+		for(i = 0; i < 4; i++) {
+			h = hash_merge(h,acc[i]);
+		}
+	} else {
+		h = seed + P5;
+	}
+	h += (uint64_t)len;
+
+	while(end - p >= 8) {
+		h ^= hash_round(0,read64le(p));
+		h = ROTL64(h,27) * P1 + P4;
+		p += 8;
+	}
+	if(end - p >= 4) {
+		h ^= read32le(p) * P1;
+		h = ROTL64(h,23) * P2 + P3;
+		p += 4;
+	}
+	while(p < end) {
+		h ^= *p * P5;
+		h = ROTL64(h,11) * P1;
+		p++;
+	}
+
+	h ^= h >> 33;
+	h *= P2;
+	h ^= h >> 29;
+	h *= P3;
+	h ^= h >> 32;
+	return h;
+}
@@ -3,6 +3,7 @@
 
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
 #include "config.h"
 #include "hawkc.h"
 
@@ -16,7 +17,44 @@ extern "C" {
 typedef HawkcError (*HawkcSchemeHandler) (HawkcContext ctx, HawkcString scheme, void*data);
 typedef HawkcError (*HawkcParamHandler) (HawkcContext ctx, HawkcString key, HawkcString value, void*data);
 
+/*
+ * Callback function type receiving the segments of a base string.
+ */
+typedef void (*HawkcBaseStringSink) (const unsigned char *segment, size_t len, void *data);
+
+/*
+ * Digest functions of an algorithm. state points to a HawkcDigestState
+ * (see crypto.h) holding the backend's hash context.
+ */
+typedef void (*HawkcDigestInitFunc) (void *state);
+typedef void (*HawkcDigestUpdateFunc) (void *state, const unsigned char *data, size_t len);
+typedef void (*HawkcDigestFinalFunc) (void *state, unsigned char *digest);
+
+/*
+ * Compute the outer hash of an HMAC in one step. outer_state is the state
+ * after hashing the outer key pad, digest holds the inner digest on input
+ * and the HMAC on output. outer_state is not modified.
+ */
+typedef void (*HawkcDigestHmacOuterFunc) (const void *outer_state, unsigned char *digest);
+
+/*
+ * Store and restore the chaining value of a state that has hashed exactly
+ * one block, such as the key pad states of a HawkcKey. The chaining value
+ * is chain_size bytes in big-endian word order, which is the same for all
+ * backends. Importing initializes the state completely.
+ */
+typedef void (*HawkcDigestExportFunc) (const void *state, unsigned char *chain);
+typedef void (*HawkcDigestImportFunc) (void *state, const unsigned char *chain);
+
 /** Structure for the Algorithm typedef in hawkc.h
+ *
+ * The algorithms are defined by the crypto backend, which also provides
+ * their digest functions. hmac_outer is optional, the HMAC code uses
+ * update and final on a copy of the outer state if it is NULL.
+ *
+ * chain_size, export_chain and import_chain allow storing a key in
+ * 2 * chain_size bytes instead of two complete digest states, see
+ * hawkc_key_export().
  */
 
 #if __cplusplus
@@ -25,25 +63,32 @@ struct _HawkcAlgorithm {
 struct HawkcAlgorithm {
 #endif
 	const char* name;
+	size_t digest_size;
+	size_t block_size;
+	HawkcDigestInitFunc init;
+	HawkcDigestUpdateFunc update;
+	HawkcDigestFinalFunc final;
+	HawkcDigestHmacOuterFunc hmac_outer;
+	size_t chain_size;
+	HawkcDigestExportFunc export_chain;
+	HawkcDigestImportFunc import_chain;
 };
 
 /*
- * Size of the static base string buffer used to generate HMACs.
- * This value should be large enough to hold Hawk base strings
- * containing URLs of common sizes.
- *
- * For occasional larger sizes hawkc will dynamically allocate
- * and free a larger buffer. See MAX_DYN_BASE_BUFFER_SIZE.
+ * Largest block size of all algorithms, the size of the HMAC key pads.
  */
-#define BASE_BUFFER_SIZE 512
+#define MAX_DIGEST_BLOCK_BYTES 128
 
 /*
- * In the case of base strings that exceed the static BASE_BUFFER_SIZE hawkc
- * will dynamically allocate a buffer to hold the base string. In order to
- * prevent very long URLs (possibly attacks) from leading to very large allocations
- * MAX_DYN_BASE_BUFFER_SIZE sets the upper bounds of dynamic allocation.
+ * Largest chaining value of all algorithms (SHA-384 and SHA-512).
  */
-#define MAX_DYN_BASE_BUFFER_SIZE 2048
+#define MAX_DIGEST_CHAIN_BYTES 64
+
+/*
+ * The algorithms provided by the crypto backend, terminated by NULL.
+ * Searched by hawkc_algorithm_by_name().
+ */
+extern HawkcAlgorithm hawkc_algorithms[];
 
 /*
  * Size for timestamp base string buffers. Buffer must be
@@ -55,9 +100,14 @@ struct HawkcAlgorithm {
 #define TS_BASE_BUFFER_SIZE 30
 
 /**
- * Set the context error for error retrieval by the caller.
+ * Set the context error for error retrieval by the caller. GCC and Clang
+ * check the arguments against the format.
  */
-HawkcError HAWKCAPI hawkc_set_error(HawkcContext ctx, HawkcError e, const char *fmt, ...);
+HawkcError HAWKCAPI hawkc_set_error(HawkcContext ctx, HawkcError e, const char *fmt, ...)
+#if defined(__GNUC__)
+	__attribute__((format(printf,3,4)))
+#endif
+	;
 
 /**
  * Create the base string for signing.
@@ -65,6 +115,21 @@ HawkcError HAWKCAPI hawkc_set_error(HawkcContext ctx, HawkcError e, const char *
  */
 void HAWKCAPI hawkc_create_base_string(HawkcContext ctx, AuthorizationHeader header, unsigned char* buf, size_t *len);
 
+/**
+ * Calculate the number of bytes of the base string.
+ * (Exported for testing)
+ */
+size_t HAWKCAPI hawkc_calculate_base_string_length(HawkcContext ctx, AuthorizationHeader header);
+
+/**
+ * Produce the base string for signing as a sequence of segments that are
+ * passed to the sink in order. Request and header fields are passed as they
+ * are, without copying them, so the sink can feed them straight into an
+ * incremental HMAC computation. Only ext is passed in pieces, with \ and
+ * line feeds escaped like the reference implementation does.
+ */
+void HAWKCAPI hawkc_emit_base_string(HawkcContext ctx, AuthorizationHeader header, HawkcBaseStringSink sink, void *data);
+
 
 /** Parse an Authorization or WWW-Authenticate header.
  *
@@ -80,15 +145,42 @@ void HAWKCAPI hawkc_create_base_string(HawkcContext ctx, AuthorizationHeader hea
  *
  * Caveat: This means that extracted quoted strings will contain the escape characters. It is
  * the responsibility of the caller to make a copy of the quoted string and remove the \.
+ * The Hawk specific parsers below do that.
  */
 HawkcError HAWKCAPI hawkc_parse_auth_header(HawkcContext ctx, unsigned char *value, size_t len, HawkcSchemeHandler scheme_handler, HawkcParamHandler param_handler, void *data);
 
+/** Parse a Hawk Authorization or Server-Authorization header into h.
+ *
+ * Same syntax as hawkc_parse_auth_header(), but the parameters are
+ * dispatched on their length and first character and stored directly in
+ * h, without callbacks. The scheme must be Hawk. Unknown parameters are
+ * ignored, duplicate parameters are rejected with HAWKC_PARSE_ERROR.
+ * Fields of parameters not present in the header are left unchanged.
+ *
+ * Values without escapes point into value. Quoted values with escapes are
+ * unescaped into the context's unescape buffer and point there until the
+ * next header is parsed with the context.
+ */
+HawkcError HAWKCAPI hawkc_parse_hawk_authorization_header(HawkcContext ctx, unsigned char *value, size_t len, AuthorizationHeader h);
+
+/** Parse a Hawk WWW-Authenticate header into h, like
+ * hawkc_parse_hawk_authorization_header().
+ */
+HawkcError HAWKCAPI hawkc_parse_hawk_www_authenticate_header(HawkcContext ctx, unsigned char *value, size_t len, WwwAuthenticateHeader h);
+
 /** Fixed time byte-wise comparision.
  *
  * Return 1 if the supplied byte sequences are byte-wise equal, 0 otherwise.
  */
 int HAWKCAPI hawkc_fixed_time_equal(unsigned char *lhs, unsigned char * rhs, size_t len);
 
+/** Overwrite memory that held key material with zeros.
+ *
+ * Unlike a plain memset() this is not removed as a dead store when the
+ * memory is not read again, e.g. before a return or free().
+ */
+void HAWKCAPI hawkc_cleanse(void *p, size_t len);
+
 /** Turn an unsigned char array into an array of hex-encoded bytes.
  *
  * The result will encode each bye as a two-chars hex value (00 to ff)
@@ -114,6 +206,99 @@ unsigned int HAWKCAPI hawkc_number_of_digits(time_t t);
 HawkcError HAWKCAPI hawkc_parse_time(HawkcContext ctx, HawkcString ts, time_t *tp);
 
 
+/*
+ * Hash len bytes at data with the seed (XXH64). Used for the hash tables
+ * of the library. Not a cryptographic hash, tables that are filled from
+ * requests use a random seed.
+ */
+uint64_t HAWKCAPI hawkc_hash_bytes(const unsigned char *data, size_t len, uint64_t seed);
+
+/*
+ * Function called by hawkc_credentials_each() for every credential of a
+ * set with its id and the chaining values of its key (see
+ * hawkc_key_export()).
+ */
+typedef HawkcError (*HawkcCredentialVisitor) (HawkcContext ctx, const unsigned char *id, size_t id_len,
+		HawkcAlgorithm algorithm, const unsigned char *chain, void *data);
+
+/*
+ * Call the visitor for every credential of the set in the order they were
+ * added. Stops at the first error the visitor returns. Implemented in
+ * credentials.c.
+ */
+HawkcError HAWKCAPI hawkc_credentials_each(HawkcContext ctx, HawkcCredentials credentials, HawkcCredentialVisitor visitor, void *data);
+
+/*
+ * Number of credentials in the set.
+ */
+size_t HAWKCAPI hawkc_credentials_count(HawkcCredentials credentials);
+
+/*
+ * Reader tracking for data that is replaced while threads read it, like
+ * the sets of a credential store. Readers register in a per-thread slot
+ * under the parity of the epoch, the publisher swaps the data, flips the
+ * parity and waits for the readers of the old parity to leave. See
+ * credentials.c, where these functions are implemented.
+ */
+#define HAWKC_READER_SLOTS 64
+
+typedef struct HawkcReaderSlot {
+	unsigned long count[2];
+	unsigned char pad[64 - 2 * sizeof(unsigned long)];
+} HawkcReaderSlot;
+
+typedef struct HawkcReaders {
+	HawkcReaderSlot slots[HAWKC_READER_SLOTS];
+	unsigned long epoch;
+	int publishing;
+} HawkcReaders;
+
+/*
+ * Index of the reader slot of the calling thread, below
+ * HAWKC_READER_SLOTS. Threads are assigned to slots round robin.
+ */
+unsigned int HAWKCAPI hawkc_reader_slot_index(void);
+
+/*
+ * Register as reader, returns the parity to pass to hawkc_readers_leave().
+ */
+unsigned long HAWKCAPI hawkc_readers_enter(HawkcReaders *readers, HawkcReaderSlot *slot);
+
+void HAWKCAPI hawkc_readers_leave(HawkcReaderSlot *slot, unsigned long parity);
+
+/*
+ * Serialize publishers. Between hawkc_readers_lock() and
+ * hawkc_readers_drain() the publisher swaps the data pointer. When
+ * hawkc_readers_drain() returns, no reader uses the old data anymore.
+ */
+void HAWKCAPI hawkc_readers_lock(HawkcReaders *readers);
+
+void HAWKCAPI hawkc_readers_drain(HawkcReaders *readers);
+
+/*
+ * If a key resolver has been set on the context, look up the key for the
+ * id of header_in and make it the key of the current request. The key and
+ * algorithm set on the context are left alone.
+ */
+HawkcError HAWKCAPI hawkc_context_resolve_key(HawkcContext ctx);
+
+/*
+ * The key to sign and validate the current request with: the resolved key,
+ * else the key set on the context, else NULL to use password and algorithm.
+ */
+HawkcKey HAWKCAPI hawkc_context_active_key(HawkcContext ctx);
+
+/*
+ * The algorithm of hawkc_context_active_key(), or that set on the context.
+ */
+HawkcAlgorithm HAWKCAPI hawkc_context_active_algorithm(HawkcContext ctx);
+
+/*
+ * The clock offset to sign with: the skew estimator's offset for the host
+ * of the context if it has one, the offset set on the context otherwise.
+ */
+int HAWKCAPI hawkc_context_clock_offset(HawkcContext ctx);
+
 /*
  * On some target environments I had problems compiling since digittoint wasn't
  * available. Here I provide my own implementation of digittoint.
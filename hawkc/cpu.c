@@ -0,0 +1,92 @@
+/*
+ * x86 CPU feature detection.
+ */
+#include <stddef.h>
+#include "cpu.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+
+#include <cpuid.h>
+
+/*
+ * Results are cached after the first call, racing first calls compute the
+ * same values.
+ */
+static int cpu_features_known = 0;
+static int cpu_sse2 = 0;
+static int cpu_ssse3 = 0;
+static int cpu_avx2 = 0;
+static int cpu_shani = 0;
+
+static void detect_cpu_features(void) {
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int max_leaf = __get_cpuid_max(0,NULL);
+	int sse41 = 0, os_avx = 0;
+
+	if(max_leaf >= 1) {
+		__cpuid(1,eax,ebx,ecx,edx);
+		cpu_sse2 = (edx >> 26) & 1;
+		cpu_ssse3 = (ecx >> 9) & 1;
+		sse41 = (ecx >> 19) & 1;
+		/* OSXSAVE and AVX: check that the OS saves the ymm registers */
+		if( ((ecx >> 27) & 1) && ((ecx >> 28) & 1) ) {
+			unsigned int xcr0_lo, xcr0_hi;
+			__asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+			os_avx = (xcr0_lo & 0x6) == 0x6;
+		}
+	}
+	if(max_leaf >= 7) {
+		__cpuid_count(7,0,eax,ebx,ecx,edx);
+		cpu_shani = ((ebx >> 29) & 1) && sse41 && cpu_ssse3;
+		cpu_avx2 = ((ebx >> 5) & 1) && ((ebx >> 3) & 1) && ((ebx >> 8) & 1) && os_avx;
+	}
+	cpu_features_known = 1;
+}
+
+int hawkc_cpu_has_sse2(void) {
+	if(!cpu_features_known) {
+		detect_cpu_features();
+	}
+	return cpu_sse2;
+}
+
+int hawkc_cpu_has_ssse3(void) {
+	if(!cpu_features_known) {
+		detect_cpu_features();
+	}
+	return cpu_ssse3;
+}
+
+int hawkc_cpu_has_avx2(void) {
+	if(!cpu_features_known) {
+		detect_cpu_features();
+	}
+	return cpu_avx2;
+}
+
+int hawkc_cpu_has_shani(void) {
+	if(!cpu_features_known) {
+		detect_cpu_features();
+	}
+	return cpu_shani;
+}
+
+#else
+
+int hawkc_cpu_has_sse2(void) {
+	return 0;
+}
+
+int hawkc_cpu_has_ssse3(void) {
+	return 0;
+}
+
+int hawkc_cpu_has_avx2(void) {
+	return 0;
+}
+
+int hawkc_cpu_has_shani(void) {
+	return 0;
+}
+
+#endif
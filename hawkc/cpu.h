@@ -0,0 +1,22 @@
+#ifndef HAWKC_CPU_H
+#define HAWKC_CPU_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * x86 CPU feature detection (cpu.c), shared by the SHA kernels of the
+ * native crypto backend and the header parser. The results are cached after
+ * the first call. On other architectures all functions return 0.
+ */
+int hawkc_cpu_has_sse2(void);
+int hawkc_cpu_has_ssse3(void);
+int hawkc_cpu_has_avx2(void);
+int hawkc_cpu_has_shani(void);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* !defined HAWKC_CPU_H */
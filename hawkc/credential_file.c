@@ -0,0 +1,487 @@
+/*
+ * Credential files.
+ *
+ * A credential file holds a set of credentials in a form that is used in
+ * place after mapping the file read-only, so opening it takes constant
+ * time and the pages are shared by all processes that map it.
+ *
+ * Layout, all fields in native byte order and 8 byte aligned:
+ *
+ *   header          FileHeader
+ *   displacements   uint32_t[nbuckets]
+ *   index           uint32_t[count], record offset / 8 for every position
+ *   records         FileRecord, chaining values of the key (see
+ *                   hawkc_key_export()) and id, for every credential
+ *
+ * The index is a minimal perfect hash of the ids (hash and displace): an
+ * id's hash selects a bucket, and the bucket's displacement selects the
+ * position of the id in the index. The builder chooses the displacements
+ * so that the ids of a bucket go to positions no other id uses. A lookup
+ * reads one displacement, one index entry and one record, and compares the
+ * id, since ids that are not in the file map to some position as well.
+ */
+/*
+ * mkstemp() is POSIX.1-2008.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+
+/*
+ * "HAWKCRD1" read as little endian number. A file written on a machine of
+ * the other byte order fails the check.
+ */
+#define FILE_MAGIC 0x314452434b574148ULL
+
+/*
+ * Average number of ids per bucket. Larger buckets mean a smaller
+ * displacement table and a longer build.
+ */
+#define BUCKET_LOAD 4
+
+#define RECORD_ALIGN 8
+#define ALIGN8(n) (((n) + 7) & ~(uint64_t)7)
+
+/*
+ * Attempts with a new seed if no displacement is found for a bucket, which
+ * only happens if two ids of a bucket have the same 64-bit hash.
+ */
+#define MAX_SEEDS 8
+
+typedef struct FileHeader {
+	uint64_t magic;
+	uint64_t seed;
+	uint64_t count;
+	uint64_t nbuckets;
+	uint64_t displacements_offset;
+	uint64_t index_offset;
+	uint64_t records_offset;
+	uint64_t size;
+} FileHeader;
+
+typedef struct FileRecord {
+	uint32_t id_len;
+	uint32_t algorithm; /* index into algorithm_names + 1 */
+	unsigned char data[]; /* inner and outer chaining values, then the id */
+} FileRecord;
+
+/*
+ * Algorithm codes of the file format, independent of the crypto backend.
+ */
+static const char *algorithm_names[] = { "sha1", "sha256", "sha384", "sha512" };
+#define NALGORITHMS (sizeof(algorithm_names) / sizeof(algorithm_names[0]))
+
+#if __cplusplus
+struct _HawkcCredentialFile {
+#else
+struct HawkcCredentialFile {
+#endif
+	const unsigned char *map;
+	size_t size;
+	const FileHeader *header;
+	const uint32_t *displacements;
+	const uint32_t *index;
+	const unsigned char *records;
+	uint64_t records_size;
+	HawkcAlgorithm algorithms[NALGORITHMS + 1];
+};
+
+static uint64_t mix64(uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+/*
+ * Map x uniformly to [0, n) without a division.
+ */
+static uint32_t fastrange32(uint32_t x, uint32_t n) {
+	return (uint32_t)(((uint64_t)x * n) >> 32);
+}
+
+static uint32_t bucket_of(uint64_t h, uint64_t nbuckets) {
+	return fastrange32((uint32_t)(h >> 32),(uint32_t)nbuckets);
+}
+
+static uint32_t position_of(uint64_t h, uint32_t displacement, uint64_t count) {
+	return fastrange32((uint32_t)mix64(h ^ (displacement * 0x9E3779B97F4A7C15ULL)),(uint32_t)count);
+}
+
+static uint64_t record_size(size_t chain_size, size_t id_len) {
+	return ALIGN8(offsetof(FileRecord,data) + 2 * chain_size + id_len);
+}
+
+static uint32_t algorithm_code(HawkcAlgorithm algorithm) {
+	uint32_t i;
+	for(i = 0; i < NALGORITHMS; i++) {
+		if(strcmp(algorithm->name,algorithm_names[i]) == 0) {
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * State of building a file.
+ */
+typedef struct Builder {
+	uint64_t seed;
+	uint64_t count;
+	uint64_t nbuckets;
+	uint64_t *hashes;
+	uint32_t *record_units;
+	uint64_t records_size;
+	size_t next;
+	FILE *out;
+} Builder;
+
+static HawkcError hash_visitor(HawkcContext ctx, const unsigned char *id, size_t id_len,
+		HawkcAlgorithm algorithm, const unsigned char *chain, void *data) {
+	Builder *b = (Builder*)data;
+
+	if(algorithm_code(algorithm) == 0) {
+		return hawkc_set_error(ctx, HAWKC_ERROR_UNKNOWN_ALGORITHM, "Algorithm %s cannot be stored in a credential file", algorithm->name);
+	}
+	if(b->records_size / RECORD_ALIGN > UINT32_MAX) {
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Too many credentials for a credential file");
+	}
+	b->hashes[b->next] = hawkc_hash_bytes(id,id_len,b->seed);
+	b->record_units[b->next] = (uint32_t)(b->records_size / RECORD_ALIGN);
+	b->records_size += record_size(algorithm->chain_size,id_len);
+	b->next++;
+	return HAWKC_OK;
+}
+
+static HawkcError write_visitor(HawkcContext ctx, const unsigned char *id, size_t id_len,
+		HawkcAlgorithm algorithm, const unsigned char *chain, void *data) {
+	Builder *b = (Builder*)data;
+	unsigned char buf[sizeof(FileRecord) + 2 * MAX_DIGEST_CHAIN_BYTES + RECORD_ALIGN];
+	FileRecord *r = (FileRecord*)buf;
+	size_t size = (size_t)record_size(algorithm->chain_size,id_len);
+	size_t head = offsetof(FileRecord,data) + 2 * algorithm->chain_size;
+
+	memset(buf,0,sizeof(buf));
+	r->id_len = (uint32_t)id_len;
+	r->algorithm = algorithm_code(algorithm);
+	memcpy(r->data,chain,2 * algorithm->chain_size);
+	if(fwrite(buf,1,head,b->out) != head || fwrite(id,1,id_len,b->out) != id_len
+			|| fwrite(buf + sizeof(buf) - RECORD_ALIGN,1,size - head - id_len,b->out) != size - head - id_len) {
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Unable to write credential file: %s", strerror(errno));
+	}
+	return HAWKC_OK;
+}
+
+/*
+ * Find a displacement for every bucket, largest buckets first while most
+ * positions are still free. Returns 0 if some bucket has no displacement
+ * that works, because two of its ids have the same hash.
+ */
+static int place(Builder *b, uint32_t *displacements, uint32_t *index, uint32_t *bucket_start,
+		uint32_t *members, uint32_t *order, unsigned char *taken) {
+	uint32_t positions[64];
+	uint64_t i, nonempty;
+	uint32_t max_size = 0, size;
+
+	/* Bucket the ids by counting sort */
+	memset(bucket_start,0,(b->nbuckets + 1) * sizeof(uint32_t));
+	for(i = 0; i < b->count; i++) {
+		bucket_start[bucket_of(b->hashes[i],b->nbuckets) + 1]++;
+	}
+	for(i = 0; i < b->nbuckets; i++) {
+		if(bucket_start[i + 1] > max_size) {
+			max_size = bucket_start[i + 1];
+		}
+		bucket_start[i + 1] += bucket_start[i];
+	}
+	if(max_size > sizeof(positions) / sizeof(positions[0])) {
+		return 0;
+	}
+	{
+		uint32_t *fill = order; /* temporarily the fill pointers */
+		memcpy(fill,bucket_start,b->nbuckets * sizeof(uint32_t));
+		for(i = 0; i < b->count; i++) {
+			members[fill[bucket_of(b->hashes[i],b->nbuckets)]++] = (uint32_t)i;
+		}
+	}
+	/* Order the non-empty buckets by decreasing size */
+	nonempty = 0;
+	for(size = max_size; size > 0; size--) {
+		uint64_t k;
+		for(k = 0; k < b->nbuckets; k++) {
+			if(bucket_start[k + 1] - bucket_start[k] == size) {
+				order[nonempty++] = (uint32_t)k;
+			}
+		}
+	}
+
+	memset(taken,0,(size_t)b->count);
+	memset(displacements,0,b->nbuckets * sizeof(uint32_t));
+	for(i = 0; i < nonempty; i++) {
+		uint32_t bucket = order[i];
+		uint32_t *m = members + bucket_start[bucket];
+		uint32_t n = bucket_start[bucket + 1] - bucket_start[bucket];
+		uint32_t d = 0, j, k;
+
+		for(;;) {
+			for(j = 0; j < n; j++) {
+				positions[j] = position_of(b->hashes[m[j]],d,b->count);
+				if(taken[positions[j]]) {
+					break;
+				}
+				for(k = 0; k < j && positions[k] != positions[j]; k++) {
+				}
+				if(k < j) {
+					break;
+				}
+			}
+			if(j == n) {
+				break;
+			}
+			if(++d == 0) {
+				return 0;
+			}
+		}
+		for(j = 0; j < n; j++) {
+			taken[positions[j]] = 1;
+			index[positions[j]] = b->record_units[m[j]];
+		}
+		displacements[bucket] = d;
+	}
+	return 1;
+}
+
+HawkcError hawkc_credential_file_write(HawkcContext ctx, HawkcCredentials credentials, const char *path) {
+	HawkcError e = HAWKC_OK;
+	Builder b;
+	FileHeader header;
+	uint32_t *displacements = NULL, *index = NULL, *bucket_start = NULL, *members = NULL, *order = NULL;
+	unsigned char *taken = NULL;
+	char *tmp_path = NULL;
+	static const unsigned char zeros[RECORD_ALIGN];
+	int attempt, placed = 0, fd;
+
+	memset(&b,0,sizeof(b));
+	b.count = hawkc_credentials_count(credentials);
+	if(b.count > UINT32_MAX) {
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Too many credentials for a credential file");
+	}
+	b.nbuckets = b.count / BUCKET_LOAD + 1;
+
+	if( (b.hashes = (uint64_t*)hawkc_malloc(ctx,(b.count + 1) * sizeof(uint64_t))) == NULL
+			|| (b.record_units = (uint32_t*)hawkc_malloc(ctx,(b.count + 1) * sizeof(uint32_t))) == NULL
+			|| (index = (uint32_t*)hawkc_calloc(ctx,b.count + 1,sizeof(uint32_t))) == NULL
+			|| (members = (uint32_t*)hawkc_malloc(ctx,(b.count + 1) * sizeof(uint32_t))) == NULL
+			|| (taken = (unsigned char*)hawkc_malloc(ctx,b.count + 1)) == NULL
+			|| (displacements = (uint32_t*)hawkc_malloc(ctx,b.nbuckets * sizeof(uint32_t))) == NULL
+			|| (bucket_start = (uint32_t*)hawkc_malloc(ctx,(b.nbuckets + 1) * sizeof(uint32_t))) == NULL
+			|| (order = (uint32_t*)hawkc_malloc(ctx,b.nbuckets * sizeof(uint32_t))) == NULL
+			|| (tmp_path = (char*)hawkc_malloc(ctx,strlen(path) + 8)) == NULL) {
+		e = hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate index for %lu credentials", (unsigned long)b.count);
+		goto done;
+	}
+
+	for(attempt = 0; attempt < MAX_SEEDS && !placed; attempt++) {
+		if( (e = hawkc_random_bytes(ctx,(unsigned char*)&(b.seed),sizeof(b.seed))) != HAWKC_OK) {
+			goto done;
+		}
+		b.next = 0;
+		b.records_size = 0;
+		if( (e = hawkc_credentials_each(ctx,credentials,hash_visitor,&b)) != HAWKC_OK) {
+			goto done;
+		}
+		placed = place(&b,displacements,index,bucket_start,members,order,taken);
+	}
+	if(!placed) {
+		e = hawkc_set_error(ctx, HAWKC_ERROR, "Unable to build credential file index");
+		goto done;
+	}
+
+	memset(&header,0,sizeof(header));
+	header.magic = FILE_MAGIC;
+	header.seed = b.seed;
+	header.count = b.count;
+	header.nbuckets = b.nbuckets;
+	header.displacements_offset = sizeof(FileHeader);
+	header.index_offset = header.displacements_offset + ALIGN8(b.nbuckets * sizeof(uint32_t));
+	header.records_offset = header.index_offset + ALIGN8(b.count * sizeof(uint32_t));
+	header.size = header.records_offset + b.records_size;
+
+	/*
+	 * Write to a temporary file and rename it, so processes that open the
+	 * file never see it half written and those that have the old file
+	 * mapped keep it. mkstemp() creates a new file that only the owner can
+	 * read, the chaining values are as secret as the passwords, and does
+	 * not follow symlinks planted at its name.
+	 */
+	sprintf(tmp_path,"%s.XXXXXX",path);
+	if( (fd = mkstemp(tmp_path)) < 0) {
+		e = hawkc_set_error(ctx, HAWKC_ERROR, "Unable to create %s: %s", tmp_path, strerror(errno));
+		goto done;
+	}
+	if( (b.out = fdopen(fd,"wb")) == NULL) {
+		e = hawkc_set_error(ctx, HAWKC_ERROR, "Unable to open %s: %s", tmp_path, strerror(errno));
+		close(fd);
+		remove(tmp_path);
+		goto done;
+	}
+	if(fwrite(&header,sizeof(header),1,b.out) != 1
+			|| fwrite(displacements,sizeof(uint32_t),b.nbuckets,b.out) != b.nbuckets
+			|| fwrite(zeros,1,header.index_offset - header.displacements_offset - b.nbuckets * sizeof(uint32_t),b.out)
+				!= header.index_offset - header.displacements_offset - b.nbuckets * sizeof(uint32_t)
+			|| fwrite(index,sizeof(uint32_t),b.count,b.out) != b.count
+			|| fwrite(zeros,1,header.records_offset - header.index_offset - b.count * sizeof(uint32_t),b.out)
+				!= header.records_offset - header.index_offset - b.count * sizeof(uint32_t)) {
+		e = hawkc_set_error(ctx, HAWKC_ERROR, "Unable to write %s: %s", tmp_path, strerror(errno));
+	} else {
+		e = hawkc_credentials_each(ctx,credentials,write_visitor,&b);
+	}
+	if(fclose(b.out) != 0 && e == HAWKC_OK) {
+		e = hawkc_set_error(ctx, HAWKC_ERROR, "Unable to write %s: %s", tmp_path, strerror(errno));
+	}
+	if(e == HAWKC_OK && rename(tmp_path,path) != 0) {
+		e = hawkc_set_error(ctx, HAWKC_ERROR, "Unable to rename %s to %s: %s", tmp_path, path, strerror(errno));
+	}
+	if(e != HAWKC_OK) {
+		remove(tmp_path);
+	}
+
+done:
+	hawkc_free(ctx,b.hashes);
+	hawkc_free(ctx,b.record_units);
+	hawkc_free(ctx,index);
+	hawkc_free(ctx,members);
+	hawkc_free(ctx,taken);
+	hawkc_free(ctx,displacements);
+	hawkc_free(ctx,bucket_start);
+	hawkc_free(ctx,order);
+	hawkc_free(ctx,tmp_path);
+	return e;
+}
+
+HawkcError hawkc_credential_file_open(HawkcContext ctx, const char *path, HawkcCredentialFile *file) {
+	HawkcCredentialFile f;
+	const FileHeader *h;
+	struct stat st;
+	void *map;
+	size_t i;
+	int fd;
+
+	if( (fd = open(path,O_RDONLY)) < 0) {
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Unable to open %s: %s", path, strerror(errno));
+	}
+	if(fstat(fd,&st) != 0) {
+		close(fd);
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Unable to stat %s: %s", path, strerror(errno));
+	}
+	if((size_t)st.st_size < sizeof(FileHeader)) {
+		close(fd);
+		return hawkc_set_error(ctx, HAWKC_ERROR, "%s is not a credential file", path);
+	}
+	map = mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Unable to map %s: %s", path, strerror(errno));
+	}
+
+	h = (const FileHeader*)map;
+	if(h->magic != FILE_MAGIC || h->size != (uint64_t)st.st_size || h->count > UINT32_MAX
+			|| h->nbuckets == 0 || h->nbuckets > UINT32_MAX
+			|| h->displacements_offset != sizeof(FileHeader)
+			|| h->index_offset != h->displacements_offset + ALIGN8(h->nbuckets * sizeof(uint32_t))
+			|| h->records_offset != h->index_offset + ALIGN8(h->count * sizeof(uint32_t))
+			|| h->records_offset > h->size) {
+		munmap(map,(size_t)st.st_size);
+		return hawkc_set_error(ctx, HAWKC_ERROR, "%s is not a credential file or is damaged", path);
+	}
+
+#if __cplusplus
+	if( (f = (HawkcCredentialFile)hawkc_calloc(ctx,1,sizeof(struct _HawkcCredentialFile))) == NULL) {
+#else
+	if( (f = (HawkcCredentialFile)hawkc_calloc(ctx,1,sizeof(struct HawkcCredentialFile))) == NULL) {
+#endif
+		munmap(map,(size_t)st.st_size);
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate credential file");
+	}
+	f->map = (const unsigned char*)map;
+	f->size = (size_t)st.st_size;
+	f->header = h;
+	f->displacements = (const uint32_t*)(f->map + h->displacements_offset);
+	f->index = (const uint32_t*)(f->map + h->index_offset);
+	f->records = f->map + h->records_offset;
+	f->records_size = h->size - h->records_offset;
+	for(i = 0; i < NALGORITHMS; i++) {
+		f->algorithms[i + 1] = hawkc_algorithm_by_name((char*)algorithm_names[i],strlen(algorithm_names[i]));
+	}
+
+	/* Lookups go to random pages, read-ahead would only waste memory */
+	posix_madvise(map,(size_t)st.st_size,POSIX_MADV_RANDOM);
+
+	*file = f;
+	return HAWKC_OK;
+}
+
+void hawkc_credential_file_close(HawkcContext ctx, HawkcCredentialFile file) {
+	if(file == NULL) {
+		return;
+	}
+	munmap((void*)file->map,file->size);
+	hawkc_free(ctx,file);
+}
+
+HawkcError hawkc_credential_file_lookup(HawkcContext ctx, HawkcCredentialFile file,
+		const unsigned char *id, size_t id_len, HawkcKey key) {
+	const FileHeader *h = file->header;
+	const FileRecord *r;
+	HawkcAlgorithm algorithm;
+	uint64_t hash, offset;
+
+	if(h->count == 0) {
+		return hawkc_set_error(ctx, HAWKC_UNKNOWN_ID_ERROR, "No credentials for id %.*s", (int)id_len, id);
+	}
+	hash = hawkc_hash_bytes(id,id_len,h->seed);
+	offset = (uint64_t)file->index[position_of(hash,file->displacements[bucket_of(hash,h->nbuckets)],h->count)] * RECORD_ALIGN;
+
+	/*
+	 * The record is checked against the bounds of the file, so a damaged
+	 * file cannot make the lookup read outside of the mapping.
+	 */
+	if(offset + sizeof(FileRecord) > file->records_size) {
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Credential file is damaged");
+	}
+	r = (const FileRecord*)(file->records + offset);
+	if(r->algorithm == 0 || r->algorithm > NALGORITHMS || (algorithm = file->algorithms[r->algorithm]) == NULL
+			|| offset + record_size(algorithm->chain_size,r->id_len) > file->records_size) {
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Credential file is damaged");
+	}
+	if(r->id_len != id_len || memcmp(r->data + 2 * algorithm->chain_size,id,id_len) != 0) {
+		return hawkc_set_error(ctx, HAWKC_UNKNOWN_ID_ERROR, "No credentials for id %.*s", (int)id_len, id);
+	}
+	hawkc_key_import(key,algorithm,r->data);
+	return HAWKC_OK;
+}
+
+static HawkcError file_resolver(HawkcContext ctx, const unsigned char *id, size_t id_len, HawkcKey key, void *data) {
+	return hawkc_credential_file_lookup(ctx,(HawkcCredentialFile)data,id,id_len,key);
+}
+
+void hawkc_context_set_credential_file(HawkcContext ctx, HawkcCredentialFile file) {
+	hawkc_context_set_key_resolver(ctx,file != NULL ? file_resolver : NULL,file);
+}
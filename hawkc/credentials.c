@@ -0,0 +1,400 @@
+/*
+ * Credential store.
+ *
+ * A set of credentials is an open addressing hash table of 64-bit slots,
+ * each holding a 32-bit tag of the id's hash and the position of a record
+ * in an arena. A record holds the algorithm, the chaining values of the
+ * key pad states (see hawkc_key_export()) and the id. A lookup usually
+ * touches one slot and one record.
+ *
+ * Sets are immutable once published. The store points to the current set
+ * and a new set replaces it with an atomic pointer swap. The previous set
+ * is released when no reader uses it anymore, which is tracked with two
+ * reader counts per slot of an array of cache line sized reader slots, one
+ * count for each parity of the store's epoch. A reader increments the
+ * count of the current parity around its lookup. The publisher swaps the
+ * pointer, flips the parity and waits for the counts of the old parity to
+ * drain. Readers never wait, the publisher waits for lookups in progress,
+ * which take well below a microsecond.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <sched.h>
+
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+
+#if !defined(__GNUC__)
+#error "The credential store requires the __atomic builtins of GCC or Clang"
+#endif
+
+#define MIN_SLOTS 16
+#define RECORD_ALIGN 8
+#define TAG(h) ((uint32_t)((h) >> 32))
+#define SLOT_REF(s) ((s) & 0xffffffff)
+
+typedef struct Record {
+	HawkcAlgorithm algorithm;
+	uint32_t id_len;
+	unsigned char data[]; /* inner and outer chaining values, then the id */
+} Record;
+
+#if __cplusplus
+struct _HawkcCredentials {
+#else
+struct HawkcCredentials {
+#endif
+	uint64_t seed;
+	uint64_t *slots;
+	size_t mask;
+	size_t count;
+	unsigned char *arena;
+	size_t arena_len;
+	size_t arena_size;
+};
+
+#if __cplusplus
+struct _HawkcCredentialStore {
+#else
+struct HawkcCredentialStore {
+#endif
+	HawkcReaders readers;
+	HawkcCredentials current;
+};
+
+static size_t record_size(size_t chain_size, size_t id_len) {
+	size_t size = offsetof(Record,data) + 2 * chain_size + id_len;
+	return (size + RECORD_ALIGN - 1) & ~(size_t)(RECORD_ALIGN - 1);
+}
+
+static Record *record_at(HawkcCredentials set, uint64_t slot) {
+	return (Record*)(set->arena + (SLOT_REF(slot) - 1) * RECORD_ALIGN);
+}
+
+static const unsigned char *record_id(const Record *r) {
+	return r->data + 2 * r->algorithm->chain_size;
+}
+
+static size_t table_size_for(size_t count) {
+	size_t n = MIN_SLOTS;
+	while(n < 2 * count) {
+		n *= 2;
+	}
+	return n;
+}
+
+/*
+ * Find the slot of id. Returns the index of the slot holding it or of the
+ * empty slot ending the probe sequence.
+ */
+static size_t probe(HawkcCredentials set, const unsigned char *id, size_t id_len, uint64_t h) {
+	size_t i = (size_t)h & set->mask;
+	uint64_t s;
+
+	while( (s = set->slots[i]) != 0) {
+		if((uint32_t)(s >> 32) == TAG(h)) {
+			Record *r = record_at(set,s);
+			if(r->id_len == id_len && memcmp(record_id(r),id,id_len) == 0) {
+				return i;
+			}
+		}
+		i = (i + 1) & set->mask;
+	}
+	return i;
+}
+
+static HawkcError grow_table(HawkcContext ctx, HawkcCredentials set) {
+	size_t nslots = 2 * (set->mask + 1);
+	uint64_t *slots;
+	size_t i, j;
+
+	if( (slots = (uint64_t*)hawkc_calloc(ctx,nslots,sizeof(uint64_t))) == NULL) {
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate %lu credential slots", (unsigned long)nslots);
+	}
+	for(i = 0; i <= set->mask; i++) {
+		uint64_t s = set->slots[i];
+		Record *r;
+		uint64_t h;
+		if(s == 0) {
+			continue;
+		}
+		r = record_at(set,s);
+		h = hawkc_hash_bytes(record_id(r),r->id_len,set->seed);
+		j = (size_t)h & (nslots - 1);
+		while(slots[j] != 0) {
+			j = (j + 1) & (nslots - 1);
+		}
+		slots[j] = s;
+	}
+	hawkc_free(ctx,set->slots);
+	set->slots = slots;
+	set->mask = nslots - 1;
+	return HAWKC_OK;
+}
+
+static HawkcError grow_arena(HawkcContext ctx, HawkcCredentials set, size_t needed) {
+	size_t size = set->arena_size;
+	unsigned char *arena;
+
+	while(size - set->arena_len < needed) {
+		size *= 2;
+	}
+	if( (arena = (unsigned char*)hawkc_malloc(ctx,size)) == NULL) {
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate %lu bytes of credentials", (unsigned long)size);
+	}
+	memcpy(arena,set->arena,set->arena_len);
+	hawkc_cleanse(set->arena,set->arena_len);
+	hawkc_free(ctx,set->arena);
+	set->arena = arena;
+	set->arena_size = size;
+	return HAWKC_OK;
+}
+
+HawkcError hawkc_credentials_create(HawkcContext ctx, size_t expected, HawkcCredentials *credentials) {
+	HawkcError e;
+	HawkcCredentials set;
+	size_t nslots = table_size_for(expected);
+
+#if __cplusplus
+	if( (set = (HawkcCredentials)hawkc_calloc(ctx,1,sizeof(struct _HawkcCredentials))) == NULL) {
+#else
+	if( (set = (HawkcCredentials)hawkc_calloc(ctx,1,sizeof(struct HawkcCredentials))) == NULL) {
+#endif
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate credentials");
+	}
+	/*
+	 * Ids are chosen by clients, a random seed keeps them from
+	 * provoking long probe sequences.
+	 */
+	if( (e = hawkc_random_bytes(ctx,(unsigned char*)&(set->seed),sizeof(set->seed))) != HAWKC_OK) {
+		hawkc_free(ctx,set);
+		return e;
+	}
+	set->arena_size = record_size(32,32) * (expected > MIN_SLOTS ? expected : MIN_SLOTS);
+	if( (set->slots = (uint64_t*)hawkc_calloc(ctx,nslots,sizeof(uint64_t))) == NULL
+			|| (set->arena = (unsigned char*)hawkc_malloc(ctx,set->arena_size)) == NULL) {
+		hawkc_credentials_free(ctx,set);
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate credentials for %lu ids", (unsigned long)expected);
+	}
+	set->mask = nslots - 1;
+	*credentials = set;
+	return HAWKC_OK;
+}
+
+HawkcError hawkc_credentials_add(HawkcContext ctx, HawkcCredentials credentials,
+		const unsigned char *id, size_t id_len, HawkcAlgorithm algorithm, const unsigned char *password, size_t password_len) {
+	HawkcError e;
+#if __cplusplus
+	struct _HawkcKey key;
+#else
+	struct HawkcKey key;
+#endif
+	HawkcCredentials set = credentials;
+	uint64_t h;
+	size_t i, size;
+	Record *r;
+
+	if( (e = hawkc_key_init(ctx,&key,algorithm,password,password_len)) != HAWKC_OK) {
+		return e;
+	}
+	if(id_len > UINT32_MAX) {
+		e = hawkc_set_error(ctx, HAWKC_ERROR, "Id of %lu bytes is too long", (unsigned long)id_len);
+		goto done;
+	}
+	if(2 * (set->count + 1) > set->mask + 1 && (e = grow_table(ctx,set)) != HAWKC_OK) {
+		goto done;
+	}
+	h = hawkc_hash_bytes(id,id_len,set->seed);
+	i = probe(set,id,id_len,h);
+	if(set->slots[i] != 0) {
+		e = hawkc_set_error(ctx, HAWKC_ERROR, "Duplicate id %.*s", (int)id_len, id);
+		goto done;
+	}
+
+	size = record_size(algorithm->chain_size,id_len);
+	if(set->arena_size - set->arena_len < size && (e = grow_arena(ctx,set,size)) != HAWKC_OK) {
+		goto done;
+	}
+	if((set->arena_len + size) / RECORD_ALIGN >= UINT32_MAX) {
+		e = hawkc_set_error(ctx, HAWKC_ERROR, "Too many credentials");
+		goto done;
+	}
+	r = (Record*)(set->arena + set->arena_len);
+	r->algorithm = algorithm;
+	r->id_len = (uint32_t)id_len;
+	hawkc_key_export(&key,r->data);
+	memcpy(r->data + 2 * algorithm->chain_size,id,id_len);
+
+	set->slots[i] = (uint64_t)TAG(h) << 32 | (set->arena_len / RECORD_ALIGN + 1);
+	set->arena_len += size;
+	set->count++;
+
+done:
+	/* Do not leave the key material behind on the stack */
+	hawkc_cleanse(&key,sizeof(key));
+	return e;
+}
+
+void hawkc_credentials_free(HawkcContext ctx, HawkcCredentials credentials) {
+	if(credentials == NULL) {
+		return;
+	}
+	if(credentials->arena != NULL) {
+		/* Do not leave the key material behind in freed memory */
+		hawkc_cleanse(credentials->arena,credentials->arena_len);
+	}
+	hawkc_free(ctx,credentials->arena);
+	hawkc_free(ctx,credentials->slots);
+	hawkc_free(ctx,credentials);
+}
+
+HawkcError hawkc_credentials_each(HawkcContext ctx, HawkcCredentials credentials, HawkcCredentialVisitor visitor, void *data) {
+	HawkcError e;
+	size_t offset = 0;
+
+	while(offset < credentials->arena_len) {
+		Record *r = (Record*)(credentials->arena + offset);
+		if( (e = visitor(ctx,record_id(r),r->id_len,r->algorithm,r->data,data)) != HAWKC_OK) {
+			return e;
+		}
+		offset += record_size(r->algorithm->chain_size,r->id_len);
+	}
+	return HAWKC_OK;
+}
+
+size_t hawkc_credentials_count(HawkcCredentials credentials) {
+	return credentials->count;
+}
+
+HawkcError hawkc_credential_store_create(HawkcContext ctx, HawkcCredentialStore *store) {
+	HawkcCredentialStore s;
+#if __cplusplus
+	if( (s = (HawkcCredentialStore)hawkc_calloc(ctx,1,sizeof(struct _HawkcCredentialStore))) == NULL) {
+#else
+	if( (s = (HawkcCredentialStore)hawkc_calloc(ctx,1,sizeof(struct HawkcCredentialStore))) == NULL) {
+#endif
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate credential store");
+	}
+	*store = s;
+	return HAWKC_OK;
+}
+
+void hawkc_credential_store_free(HawkcContext ctx, HawkcCredentialStore store) {
+	if(store == NULL) {
+		return;
+	}
+	hawkc_credentials_free(ctx,store->current);
+	hawkc_free(ctx,store);
+}
+
+HawkcError hawkc_credential_store_publish(HawkcContext ctx, HawkcCredentialStore store, HawkcCredentials credentials) {
+	HawkcCredentials old;
+
+	hawkc_readers_lock(&(store->readers));
+	old = __atomic_exchange_n(&(store->current),credentials,__ATOMIC_SEQ_CST);
+	hawkc_readers_drain(&(store->readers));
+
+	hawkc_credentials_free(ctx,old);
+	return HAWKC_OK;
+}
+
+#ifdef HAVE_THREAD_LOCAL
+static unsigned int next_reader_slot;
+static __thread int reader_slot = -1;
+
+unsigned int hawkc_reader_slot_index(void) {
+	if(reader_slot < 0) {
+		reader_slot = (int)(__atomic_fetch_add(&next_reader_slot,1,__ATOMIC_RELAXED) & (HAWKC_READER_SLOTS - 1));
+	}
+	return (unsigned int)reader_slot;
+}
+#else
+unsigned int hawkc_reader_slot_index(void) {
+	return 0;
+}
+#endif
+
+/*
+ * Register as reader under the current parity. If the parity flips in
+ * between, the publisher may already be waiting for the other parity, so
+ * the registration is repeated.
+ */
+unsigned long hawkc_readers_enter(HawkcReaders *readers, HawkcReaderSlot *slot) {
+	unsigned long parity;
+	for(;;) {
+		parity = __atomic_load_n(&(readers->epoch),__ATOMIC_SEQ_CST) & 1;
+		__atomic_fetch_add(&(slot->count[parity]),1,__ATOMIC_SEQ_CST);
+		if((__atomic_load_n(&(readers->epoch),__ATOMIC_SEQ_CST) & 1) == parity) {
+			return parity;
+		}
+		__atomic_fetch_sub(&(slot->count[parity]),1,__ATOMIC_RELAXED);
+	}
+}
+
+void hawkc_readers_leave(HawkcReaderSlot *slot, unsigned long parity) {
+	__atomic_fetch_sub(&(slot->count[parity]),1,__ATOMIC_RELEASE);
+}
+
+void hawkc_readers_lock(HawkcReaders *readers) {
+	while(__atomic_exchange_n(&(readers->publishing),1,__ATOMIC_ACQUIRE)) {
+		sched_yield();
+	}
+}
+
+void hawkc_readers_drain(HawkcReaders *readers) {
+	unsigned long parity;
+	int i;
+
+	/*
+	 * A reader that loaded the old data registered under the old parity
+	 * before (see hawkc_readers_enter()), so once its counts are zero the
+	 * old data is unused.
+	 */
+	parity = __atomic_fetch_add(&(readers->epoch),1,__ATOMIC_SEQ_CST) & 1;
+	for(i = 0; i < HAWKC_READER_SLOTS; i++) {
+		while(__atomic_load_n(&(readers->slots[i].count[parity]),__ATOMIC_ACQUIRE) != 0) {
+			sched_yield();
+		}
+	}
+	__atomic_store_n(&(readers->publishing),0,__ATOMIC_RELEASE);
+}
+
+HawkcError hawkc_credential_store_lookup(HawkcContext ctx, HawkcCredentialStore store,
+		const unsigned char *id, size_t id_len, HawkcKey key) {
+	HawkcReaderSlot *slot = &(store->readers.slots[hawkc_reader_slot_index()]);
+	unsigned long parity = hawkc_readers_enter(&(store->readers),slot);
+	HawkcCredentials set = __atomic_load_n(&(store->current),__ATOMIC_SEQ_CST);
+	int found = 0;
+
+	if(set != NULL) {
+		uint64_t h = hawkc_hash_bytes(id,id_len,set->seed);
+		uint64_t s = set->slots[probe(set,id,id_len,h)];
+		if(s != 0) {
+			Record *r = record_at(set,s);
+			hawkc_key_import(key,r->algorithm,r->data);
+			found = 1;
+		}
+	}
+	hawkc_readers_leave(slot,parity);
+
+	if(!found) {
+		return hawkc_set_error(ctx, HAWKC_UNKNOWN_ID_ERROR, "No credentials for id %.*s", (int)id_len, id);
+	}
+	return HAWKC_OK;
+}
+
+static HawkcError store_resolver(HawkcContext ctx, const unsigned char *id, size_t id_len, HawkcKey key, void *data) {
+	return hawkc_credential_store_lookup(ctx,(HawkcCredentialStore)data,id,id_len,key);
+}
+
+void hawkc_context_set_credential_store(HawkcContext ctx, HawkcCredentialStore store) {
+	hawkc_context_set_key_resolver(ctx,store != NULL ? store_resolver : NULL,store);
+}
@@ -7,6 +7,143 @@
 extern "C" {
 #endif
 
+/*
+ * Besides the functions declared below, a backend defines the algorithm
+ * objects HAWKC_SHA_1, HAWKC_SHA_256, HAWKC_SHA_384 and HAWKC_SHA_512 with
+ * their digest functions and registers them in hawkc_algorithms[] (see
+ * common.h).
+ *
+ * Backends keep their native hash contexts in a HawkcDigestState (see
+ * hawkc.h), which must be large enough for the largest context of all
+ * supported algorithms.
+ */
+
+/*
+ * State of an incremental HMAC computation. See hawkc_hmac_init().
+ *
+ * password_key is storage for a key set up on the fly when an HMAC is
+ * computed from a password rather than from a precomputed key.
+ */
+typedef struct HawkcHmacCtx {
+	HawkcKey key;
+#if __cplusplus
+	struct _HawkcKey password_key;
+#else
+	struct HawkcKey password_key;
+#endif
+	HawkcDigestState state;
+} HawkcHmacCtx;
+
+/**
+ * Fill buf with nbytes from a cryptographically secure random source.
+ * This is a system call or takes a lock in most backends, so it is only
+ * used to seed the nonce generator, see nonce.c.
+ */
+HawkcError hawkc_random_bytes(HawkcContext ctx, unsigned char *buf, size_t nbytes);
+
+/**
+ * Compute an HMAC of the supplied data using the specified algorithm.
+ */
+HawkcError hawkc_hmac(HawkcContext ctx, HawkcAlgorithm algorithm,
+		const unsigned char *password, size_t password_len,
+		const unsigned char *data, size_t data_len, unsigned char *result,
+		size_t *result_len);
+
+/**
+ * Initialize a key for the specified algorithm and password by
+ * precomputing the inner and outer HMAC digest states.
+ */
+HawkcError hawkc_key_init(HawkcContext ctx, HawkcKey key, HawkcAlgorithm algorithm,
+		const unsigned char *password, size_t password_len);
+
+/**
+ * Start an incremental HMAC computation using a precomputed key.
+ *
+ * Data is then added with any number of hawkc_hmac_update() calls and the
+ * result obtained with hawkc_hmac_final(). The key must stay valid until
+ * hawkc_hmac_final() has been called. No memory is allocated.
+ */
+HawkcError hawkc_hmac_init(HawkcContext ctx, HawkcHmacCtx *hmac_ctx, HawkcKey key);
+
+/**
+ * Add data to an incremental HMAC computation.
+ */
+void hawkc_hmac_update(HawkcHmacCtx *hmac_ctx, const unsigned char *data, size_t data_len);
+
+/**
+ * Finish an incremental HMAC computation and store the raw digest in the
+ * provided buffer, which must be at least MAX_HMAC_BYTES bytes long. Its
+ * length, the digest size of the key's algorithm, is stored in digest_len.
+ */
+void hawkc_hmac_final_raw(HawkcHmacCtx *hmac_ctx, unsigned char *digest, size_t *digest_len);
+
+/**
+ * Compute an HMAC of the supplied data using a precomputed key. Like
+ * hawkc_hmac() the result is base64 encoded.
+ */
+HawkcError hawkc_key_hmac(HawkcContext ctx, HawkcKey key,
+		const unsigned char *data, size_t data_len, unsigned char *result,
+		size_t *result_len);
+
+/**
+ * Maximum number of messages passed to one hawkc_key_hmac_batch() call.
+ */
+#define HAWKC_HMAC_BATCH_SIZE 8
+
+/**
+ * Compute the HMACs of n <= HAWKC_HMAC_BATCH_SIZE independent messages,
+ * message i of data_len[i] bytes at data[i] with key keys[i]. Like
+ * hawkc_hmac_final_raw() the results are raw digests, digest i is stored
+ * in digests[i], which must be at least MAX_HMAC_BYTES bytes long. Its
+ * length is the digest size of the algorithm of keys[i].
+ *
+ * Keys may use different algorithms. All keys must have been set up by
+ * hawkc_key_init(), so no errors can occur. Backends may compute several
+ * HMACs in parallel.
+ */
+void hawkc_key_hmac_batch(const HawkcKey *keys, const unsigned char *const *data, const size_t *data_len,
+		size_t n, unsigned char *const *digests);
+
+/*
+ * The following functions are implemented in common.c on top of the
+ * backend functions above.
+ */
+
+/**
+ * Finish an incremental HMAC computation and store the base64 encoded
+ * result in the provided buffer, which must be at least MAX_HMAC_BYTES_B64
+ * bytes long.
+ */
+HawkcError hawkc_hmac_final(HawkcContext ctx, HawkcHmacCtx *hmac_ctx, unsigned char *result, size_t *result_len);
+
+/**
+ * Start an incremental HMAC computation for the context. Uses the context's
+ * precomputed key if one has been set and password and algorithm otherwise.
+ */
+HawkcError hawkc_context_hmac_init(HawkcContext ctx, HawkcHmacCtx *hmac_ctx);
+
+/**
+ * Compute the HMAC of the supplied data for the context, see
+ * hawkc_context_hmac_init(). The result is base64 encoded.
+ */
+HawkcError hawkc_context_hmac(HawkcContext ctx, const unsigned char *data, size_t data_len, unsigned char *result, size_t *result_len);
+
+/**
+ * Store the chaining values of the inner and outer states of a key in
+ * 2 * chain_size bytes of its algorithm at buf (see common.h).
+ */
+void hawkc_key_export(HawkcKey key, unsigned char *buf);
+
+/**
+ * Restore a key of the algorithm from the chaining values stored by
+ * hawkc_key_export().
+ */
+void hawkc_key_import(HawkcKey key, HawkcAlgorithm algorithm, const unsigned char *buf);
+
+/*
+ * The following functions are implemented in nonce.c.
+ */
+
 /** Generate a random sequence of bytes and store in buffer hex-encoded.
  *
  * This function generates a byte array of the required length of nbytes and
@@ -16,17 +153,20 @@ extern "C" {
  * provided buffer must have at least that size.
  *
  * The result will not be \0 terminated.
+ *
+ * The bytes are taken from a per-thread ChaCha20 generator that is seeded
+ * with hawkc_random_bytes() and reseeded after about 1 MB of output and
+ * after fork(). No lock is taken and no system call made for most nonces.
  */
 HawkcError HAWKCAPI hawkc_generate_nonce(HawkcContext ctx, size_t nbytes,
 		unsigned char *buf);
 
 /**
- * Compute an HMAC of the supplied data using the specified algorithm.
+ * Compute the ChaCha20 (RFC 8439) keystream block for the 32 byte key, the
+ * 12 byte nonce and the block counter and store its 64 bytes in out.
+ * (Exported for testing)
  */
-HawkcError hawkc_hmac(HawkcContext ctx, HawkcAlgorithm algorithm,
-		const unsigned char *password, size_t password_len,
-		const unsigned char *data, size_t data_len, unsigned char *result,
-		size_t *result_len);
+void hawkc_chacha20_block(const unsigned char *key, unsigned long counter, const unsigned char *nonce, unsigned char *out);
 
 
 #ifdef __cplusplus
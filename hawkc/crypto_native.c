@@ -0,0 +1,326 @@
+/*
+ * This file implements the functions declared in crypto.h without any
+ * external library, using the SHA code in sha.c.
+ *
+ * It is selected with ./configure --with-crypto=native instead of
+ * crypto_openssl.c. The HMAC construction is the same as in the OpenSSL
+ * backend: keys store the digest states after hashing the key pads.
+ */
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+#include "sha.h"
+
+#ifdef HAVE_GETRANDOM
+#include <sys/random.h>
+#endif
+
+#define IPAD 0x36
+#define OPAD 0x5c
+
+typedef char sha_ctx_fits_digest_state[sizeof(HawkcShaCtx) <= HAWKC_DIGEST_STATE_SIZE ? 1 : -1];
+typedef char sha512_ctx_fits_digest_state[sizeof(HawkcSha512Ctx) <= HAWKC_DIGEST_STATE_SIZE ? 1 : -1];
+typedef char digest_fits_hmac_buffer[HAWKC_SHA512_DIGEST_BYTES <= MAX_HMAC_BYTES ? 1 : -1];
+typedef char block_fits_key_pad[HAWKC_SHA512_BLOCK_BYTES <= MAX_DIGEST_BLOCK_BYTES ? 1 : -1];
+typedef char chain_fits_chain_buffer[8 * sizeof(uint64_t) <= MAX_DIGEST_CHAIN_BYTES ? 1 : -1];
+
+/*
+ * Digest functions for the algorithm table.
+ */
+static void sha1_init(void *state) { hawkc_sha1_init((HawkcShaCtx*)state); }
+static void sha1_update(void *state, const unsigned char *data, size_t len) { hawkc_sha1_update((HawkcShaCtx*)state,data,len); }
+static void sha1_final(void *state, unsigned char *digest) { hawkc_sha1_final((HawkcShaCtx*)state,digest); }
+static void sha1_hmac_outer(const void *state, unsigned char *digest) { hawkc_sha1_hmac_outer((const HawkcShaCtx*)state,digest); }
+
+static void sha256_init(void *state) { hawkc_sha256_init((HawkcShaCtx*)state); }
+static void sha256_update(void *state, const unsigned char *data, size_t len) { hawkc_sha256_update((HawkcShaCtx*)state,data,len); }
+static void sha256_final(void *state, unsigned char *digest) { hawkc_sha256_final((HawkcShaCtx*)state,digest); }
+static void sha256_hmac_outer(const void *state, unsigned char *digest) { hawkc_sha256_hmac_outer((const HawkcShaCtx*)state,digest); }
+
+static void sha384_init(void *state) { hawkc_sha384_init((HawkcSha512Ctx*)state); }
+static void sha384_update(void *state, const unsigned char *data, size_t len) { hawkc_sha384_update((HawkcSha512Ctx*)state,data,len); }
+static void sha384_final(void *state, unsigned char *digest) { hawkc_sha384_final((HawkcSha512Ctx*)state,digest); }
+static void sha384_hmac_outer(const void *state, unsigned char *digest) { hawkc_sha384_hmac_outer((const HawkcSha512Ctx*)state,digest); }
+
+static void sha512_init(void *state) { hawkc_sha512_init((HawkcSha512Ctx*)state); }
+static void sha512_update(void *state, const unsigned char *data, size_t len) { hawkc_sha512_update((HawkcSha512Ctx*)state,data,len); }
+static void sha512_final(void *state, unsigned char *digest) { hawkc_sha512_final((HawkcSha512Ctx*)state,digest); }
+static void sha512_hmac_outer(const void *state, unsigned char *digest) { hawkc_sha512_hmac_outer((const HawkcSha512Ctx*)state,digest); }
+
+/*
+ * Chaining values of the key pad states for compact key storage. An
+ * imported state has hashed exactly one block.
+ */
+static void export_words32(const uint32_t *h, size_t nwords, unsigned char *chain) {
+	size_t i;
+	for(i = 0; i < nwords; i++) {
+		chain[4 * i] = (unsigned char)(h[i] >> 24);
+		chain[4 * i + 1] = (unsigned char)(h[i] >> 16);
+		chain[4 * i + 2] = (unsigned char)(h[i] >> 8);
+		chain[4 * i + 3] = (unsigned char)h[i];
+	}
+}
+
+static void import_words32(uint32_t *h, size_t nwords, const unsigned char *chain) {
+	size_t i;
+	for(i = 0; i < nwords; i++) {
+		h[i] = (uint32_t)chain[4 * i] << 24 | (uint32_t)chain[4 * i + 1] << 16 | (uint32_t)chain[4 * i + 2] << 8 | chain[4 * i + 3];
+	}
+}
+
+static void export_words64(const uint64_t *h, unsigned char *chain) {
+	size_t i, j;
+	for(i = 0; i < 8; i++) {
+		for(j = 0; j < 8; j++) {
+			chain[8 * i + j] = (unsigned char)(h[i] >> (56 - 8 * j));
+		}
+	}
+}
+
+static void import_words64(uint64_t *h, const unsigned char *chain) {
+	size_t i, j;
+	for(i = 0; i < 8; i++) {
+		h[i] = 0;
+		for(j = 0; j < 8; j++) {
+			h[i] = h[i] << 8 | chain[8 * i + j];
+		}
+	}
+}
+
+static void sha1_export(const void *state, unsigned char *chain) { export_words32(((const HawkcShaCtx*)state)->h,5,chain); }
+static void sha1_import(void *state, const unsigned char *chain) {
+	hawkc_sha1_init((HawkcShaCtx*)state);
+	import_words32(((HawkcShaCtx*)state)->h,5,chain);
+	((HawkcShaCtx*)state)->len = HAWKC_SHA_BLOCK_BYTES;
+}
+
+static void sha256_export(const void *state, unsigned char *chain) { export_words32(((const HawkcShaCtx*)state)->h,8,chain); }
+static void sha256_import(void *state, const unsigned char *chain) {
+	hawkc_sha256_init((HawkcShaCtx*)state);
+	import_words32(((HawkcShaCtx*)state)->h,8,chain);
+	((HawkcShaCtx*)state)->len = HAWKC_SHA_BLOCK_BYTES;
+}
+
+static void sha512_export(const void *state, unsigned char *chain) { export_words64(((const HawkcSha512Ctx*)state)->h,chain); }
+static void sha384_import(void *state, const unsigned char *chain) {
+	hawkc_sha384_init((HawkcSha512Ctx*)state);
+	import_words64(((HawkcSha512Ctx*)state)->h,chain);
+	((HawkcSha512Ctx*)state)->len = HAWKC_SHA512_BLOCK_BYTES;
+}
+static void sha512_import(void *state, const unsigned char *chain) {
+	hawkc_sha512_init((HawkcSha512Ctx*)state);
+	import_words64(((HawkcSha512Ctx*)state)->h,chain);
+	((HawkcSha512Ctx*)state)->len = HAWKC_SHA512_BLOCK_BYTES;
+}
+
+/**
+ * Algorithms provided by this backend, see crypto_openssl.c.
+ */
+#if __cplusplus
+static struct _HawkcAlgorithm _HAWKC_SHA_512 = { "sha512", HAWKC_SHA512_DIGEST_BYTES, HAWKC_SHA512_BLOCK_BYTES, sha512_init, sha512_update, sha512_final, sha512_hmac_outer, 64, sha512_export, sha512_import };
+static struct _HawkcAlgorithm _HAWKC_SHA_384 = { "sha384", HAWKC_SHA384_DIGEST_BYTES, HAWKC_SHA512_BLOCK_BYTES, sha384_init, sha384_update, sha384_final, sha384_hmac_outer, 64, sha512_export, sha384_import };
+static struct _HawkcAlgorithm _HAWKC_SHA_256 = { "sha256", HAWKC_SHA256_DIGEST_BYTES, HAWKC_SHA_BLOCK_BYTES, sha256_init, sha256_update, sha256_final, sha256_hmac_outer, 32, sha256_export, sha256_import };
+static struct _HawkcAlgorithm _HAWKC_SHA_1 = { "sha1", HAWKC_SHA1_DIGEST_BYTES, HAWKC_SHA_BLOCK_BYTES, sha1_init, sha1_update, sha1_final, sha1_hmac_outer, 20, sha1_export, sha1_import };
+#else
+static struct HawkcAlgorithm _HAWKC_SHA_512 = { "sha512", HAWKC_SHA512_DIGEST_BYTES, HAWKC_SHA512_BLOCK_BYTES, sha512_init, sha512_update, sha512_final, sha512_hmac_outer, 64, sha512_export, sha512_import };
+static struct HawkcAlgorithm _HAWKC_SHA_384 = { "sha384", HAWKC_SHA384_DIGEST_BYTES, HAWKC_SHA512_BLOCK_BYTES, sha384_init, sha384_update, sha384_final, sha384_hmac_outer, 64, sha512_export, sha384_import };
+static struct HawkcAlgorithm _HAWKC_SHA_256 = { "sha256", HAWKC_SHA256_DIGEST_BYTES, HAWKC_SHA_BLOCK_BYTES, sha256_init, sha256_update, sha256_final, sha256_hmac_outer, 32, sha256_export, sha256_import };
+static struct HawkcAlgorithm _HAWKC_SHA_1 = { "sha1", HAWKC_SHA1_DIGEST_BYTES, HAWKC_SHA_BLOCK_BYTES, sha1_init, sha1_update, sha1_final, sha1_hmac_outer, 20, sha1_export, sha1_import };
+#endif
+
+HawkcAlgorithm HAWKC_SHA_512 = &_HAWKC_SHA_512;
+HawkcAlgorithm HAWKC_SHA_384 = &_HAWKC_SHA_384;
+HawkcAlgorithm HAWKC_SHA_256 = &_HAWKC_SHA_256;
+HawkcAlgorithm HAWKC_SHA_1 = &_HAWKC_SHA_1;
+
+HawkcAlgorithm hawkc_algorithms[] = { &_HAWKC_SHA_1, &_HAWKC_SHA_256, &_HAWKC_SHA_384, &_HAWKC_SHA_512, NULL };
+
+HawkcError hawkc_random_bytes(HawkcContext ctx, unsigned char *buf, size_t nbytes) {
+#ifdef HAVE_GETRANDOM
+	size_t n = 0;
+	while(n < nbytes) {
+		ssize_t r = getrandom(buf + n, nbytes - n, 0);
+		if(r < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return hawkc_set_error(ctx, HAWKC_ERROR,"Unable to get %lu random bytes: %s", (unsigned long)nbytes,strerror(errno));
+		}
+		n += (size_t)r;
+	}
+	return HAWKC_OK;
+#else
+	FILE *f;
+	size_t n;
+	if( (f = fopen("/dev/urandom","rb")) == NULL) {
+		return hawkc_set_error(ctx, HAWKC_ERROR,"Unable to open /dev/urandom: %s", strerror(errno));
+	}
+	n = fread(buf,1,nbytes,f);
+	fclose(f);
+	if(n != nbytes) {
+		return hawkc_set_error(ctx, HAWKC_ERROR,"Unable to get %lu random bytes from /dev/urandom", (unsigned long)nbytes);
+	}
+	return HAWKC_OK;
+#endif
+}
+
+HawkcError hawkc_key_init(HawkcContext ctx, HawkcKey key, HawkcAlgorithm algorithm,
+		const unsigned char *password, size_t password_len) {
+
+	unsigned char key_block[MAX_DIGEST_BLOCK_BYTES];
+	unsigned char pad[MAX_DIGEST_BLOCK_BYTES];
+	size_t block_size, i;
+
+	if(algorithm == NULL || algorithm->init == NULL) {
+		return hawkc_set_error(ctx, HAWKC_ERROR_UNKNOWN_ALGORITHM,
+				"Algorithm %s not recognized for HMAC calculation", algorithm ? algorithm->name : "(null)");
+	}
+	block_size = algorithm->block_size;
+	memset(key_block,0,sizeof(key_block));
+
+	/*
+	 * See crypto_openssl.c: passwords longer than the block size are
+	 * replaced by their digest.
+	 */
+	if(password_len > block_size) {
+		algorithm->init(key->inner.bytes);
+		algorithm->update(key->inner.bytes,password,password_len);
+		algorithm->final(key->inner.bytes,key_block);
+	} else {
+		memcpy(key_block,password,password_len);
+	}
+	key->algorithm = algorithm;
+
+	for(i = 0; i < block_size; i++) {
+		pad[i] = key_block[i] ^ IPAD;
+	}
+	algorithm->init(key->inner.bytes);
+	algorithm->update(key->inner.bytes,pad,block_size);
+
+	for(i = 0; i < block_size; i++) {
+		pad[i] = key_block[i] ^ OPAD;
+	}
+	algorithm->init(key->outer.bytes);
+	algorithm->update(key->outer.bytes,pad,block_size);
+
+	hawkc_cleanse(key_block,sizeof(key_block));
+	hawkc_cleanse(pad,sizeof(pad));
+
+	return HAWKC_OK;
+}
+
+HawkcError hawkc_hmac_init(HawkcContext ctx, HawkcHmacCtx *hmac_ctx, HawkcKey key) {
+	hmac_ctx->state = key->inner;
+	hmac_ctx->key = key;
+	return HAWKC_OK;
+}
+
+void hawkc_hmac_update(HawkcHmacCtx *hmac_ctx, const unsigned char *data, size_t data_len) {
+	hmac_ctx->key->algorithm->update(hmac_ctx->state.bytes,data,data_len);
+}
+
+void hawkc_hmac_final_raw(HawkcHmacCtx *hmac_ctx, unsigned char *digest, size_t *digest_len) {
+
+	HawkcKey key = hmac_ctx->key;
+	HawkcAlgorithm algorithm = key->algorithm;
+
+	algorithm->final(hmac_ctx->state.bytes,digest);
+	algorithm->hmac_outer(key->outer.bytes,digest);
+	*digest_len = algorithm->digest_size;
+
+	if(key == &(hmac_ctx->password_key)) {
+		hawkc_cleanse(&(hmac_ctx->password_key),sizeof(hmac_ctx->password_key));
+	}
+	hawkc_cleanse(&(hmac_ctx->state),sizeof(hmac_ctx->state));
+}
+
+HawkcError hawkc_key_hmac(HawkcContext ctx, HawkcKey key,
+		const unsigned char *data, size_t data_len, unsigned char *result,
+		size_t *result_len) {
+
+	HawkcError e;
+	HawkcHmacCtx hmac_ctx;
+
+	if( (e = hawkc_hmac_init(ctx,&hmac_ctx,key)) != HAWKC_OK) {
+		return e;
+	}
+	hawkc_hmac_update(&hmac_ctx,data,data_len);
+	return hawkc_hmac_final(ctx,&hmac_ctx,result,result_len);
+}
+
+/*
+ * SHA-1 and SHA-256 messages are grouped by algorithm and each group is
+ * hashed in parallel by the multi-buffer kernels, see
+ * hawkc_sha256_hmac_lanes(). There are no multi-buffer kernels for
+ * SHA-384 and SHA-512, those messages are hashed one by one.
+ */
+void hawkc_key_hmac_batch(const HawkcKey *keys, const unsigned char *const *data, const size_t *data_len,
+		size_t n, unsigned char *const *digests) {
+
+	HawkcAlgorithm algorithms[2];
+	const HawkcShaCtx *inner[HAWKC_HMAC_BATCH_SIZE];
+	const HawkcShaCtx *outer[HAWKC_HMAC_BATCH_SIZE];
+	const unsigned char *lane_data[HAWKC_HMAC_BATCH_SIZE];
+	size_t lane_len[HAWKC_HMAC_BATCH_SIZE];
+	unsigned char *lane_digests[HAWKC_HMAC_BATCH_SIZE];
+	HawkcHmacCtx hmac_ctx;
+	size_t a, i, nlanes, len;
+
+	assert(n <= HAWKC_HMAC_BATCH_SIZE && HAWKC_HMAC_BATCH_SIZE <= HAWKC_SHA_MAX_LANES);
+
+	algorithms[0] = HAWKC_SHA_1;
+	algorithms[1] = HAWKC_SHA_256;
+
+	for(a = 0; a < 2; a++) {
+		nlanes = 0;
+		for(i = 0; i < n; i++) {
+			if(keys[i]->algorithm == algorithms[a]) {
+				inner[nlanes] = (const HawkcShaCtx*)keys[i]->inner.bytes;
+				outer[nlanes] = (const HawkcShaCtx*)keys[i]->outer.bytes;
+				lane_data[nlanes] = data[i];
+				lane_len[nlanes] = data_len[i];
+				lane_digests[nlanes] = digests[i];
+				nlanes++;
+			}
+		}
+		if(nlanes == 0) {
+			continue;
+		}
+		if(algorithms[a] == HAWKC_SHA_1) {
+			hawkc_sha1_hmac_lanes(inner,outer,lane_data,lane_len,nlanes,lane_digests);
+		} else {
+			hawkc_sha256_hmac_lanes(inner,outer,lane_data,lane_len,nlanes,lane_digests);
+		}
+	}
+
+	for(i = 0; i < n; i++) {
+		if(keys[i]->algorithm != HAWKC_SHA_1 && keys[i]->algorithm != HAWKC_SHA_256) {
+			hawkc_hmac_init(NULL,&hmac_ctx,keys[i]);
+			hawkc_hmac_update(&hmac_ctx,data[i],data_len[i]);
+			hawkc_hmac_final_raw(&hmac_ctx,digests[i],&len);
+		}
+	}
+}
+
+HawkcError hawkc_hmac(HawkcContext ctx, HawkcAlgorithm algorithm,
+		const unsigned char *password, size_t password_len,
+		const unsigned char *data, size_t data_len, unsigned char *result,
+		size_t *result_len) {
+
+	HawkcError e;
+	HawkcHmacCtx hmac_ctx;
+
+	if( (e = hawkc_key_init(ctx,&(hmac_ctx.password_key),algorithm,password,password_len)) != HAWKC_OK) {
+		return e;
+	}
+	if( (e = hawkc_hmac_init(ctx,&hmac_ctx,&(hmac_ctx.password_key))) != HAWKC_OK) {
+		return e;
+	}
+	hawkc_hmac_update(&hmac_ctx,data,data_len);
+	return hawkc_hmac_final(ctx,&hmac_ctx,result,result_len);
+}
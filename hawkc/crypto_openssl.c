@@ -1,57 +1,291 @@
 /*
  * This file implements the functions declared in crypto.h using libcrypto
  * of the OpenSSL library.
+ *
+ * HMACs are computed directly on top of the SHA digest functions rather
+ * than through the HMAC_* API so that the digest states after hashing
+ * the key pads can be stored in a HawkcKey and reused.
  */
+
+/* The SHA*_Init/Update/Final API is deprecated, but EVP cannot export chaining values */
+#define OPENSSL_API_COMPAT 0x10100000L
+
 #include <string.h>
 #include <assert.h>
-#include <openssl/hmac.h>
+#include <openssl/sha.h>
 #include <openssl/rand.h>
 #include <openssl/err.h>
+#include <openssl/crypto.h>
 
 #include "hawkc.h"
 #include "common.h"
 #include "crypto.h"
-#include "base64.h"
 
-HawkcError hawkc_generate_nonce(HawkcContext ctx, size_t nbytes, unsigned char *buf) {
-	int r;
-	unsigned char nonce_bytes[MAX_NONCE_BYTES];
-	assert(nbytes <= MAX_NONCE_BYTES);
+#define IPAD 0x36
+#define OPAD 0x5c
+
+/*
+ * Compile time checks that the native contexts fit into HawkcDigestState
+ * and that the buffer sizes cover all algorithms.
+ */
+typedef char sha1_ctx_fits_digest_state[sizeof(SHA_CTX) <= HAWKC_DIGEST_STATE_SIZE ? 1 : -1];
+typedef char sha256_ctx_fits_digest_state[sizeof(SHA256_CTX) <= HAWKC_DIGEST_STATE_SIZE ? 1 : -1];
+typedef char sha512_ctx_fits_digest_state[sizeof(SHA512_CTX) <= HAWKC_DIGEST_STATE_SIZE ? 1 : -1];
+typedef char digest_fits_hmac_buffer[SHA512_DIGEST_LENGTH <= MAX_HMAC_BYTES ? 1 : -1];
+typedef char block_fits_key_pad[SHA512_CBLOCK <= MAX_DIGEST_BLOCK_BYTES ? 1 : -1];
+
+/*
+ * Digest functions for the algorithm table. The return values of the
+ * libcrypto functions are ignored, they cannot fail for SHA digests.
+ */
+static void sha1_init(void *state) { SHA1_Init((SHA_CTX*)state); }
+static void sha1_update(void *state, const unsigned char *data, size_t len) { SHA1_Update((SHA_CTX*)state,data,len); }
+static void sha1_final(void *state, unsigned char *digest) { SHA1_Final(digest,(SHA_CTX*)state); }
+
+static void sha256_init(void *state) { SHA256_Init((SHA256_CTX*)state); }
+static void sha256_update(void *state, const unsigned char *data, size_t len) { SHA256_Update((SHA256_CTX*)state,data,len); }
+static void sha256_final(void *state, unsigned char *digest) { SHA256_Final(digest,(SHA256_CTX*)state); }
+
+static void sha384_init(void *state) { SHA384_Init((SHA512_CTX*)state); }
+static void sha384_update(void *state, const unsigned char *data, size_t len) { SHA384_Update((SHA512_CTX*)state,data,len); }
+static void sha384_final(void *state, unsigned char *digest) { SHA384_Final(digest,(SHA512_CTX*)state); }
+
+static void sha512_init(void *state) { SHA512_Init((SHA512_CTX*)state); }
+static void sha512_update(void *state, const unsigned char *data, size_t len) { SHA512_Update((SHA512_CTX*)state,data,len); }
+static void sha512_final(void *state, unsigned char *digest) { SHA512_Final(digest,(SHA512_CTX*)state); }
 
-	if ((r = RAND_bytes(nonce_bytes, nbytes)) != 1) {
-		return hawkc_set_error(ctx, HAWKC_ERROR,"Unable to get %d random bytes, last OpenSSL error code: %ld", nbytes,ERR_get_error());
+/*
+ * Chaining values of the key pad states for compact key storage, see
+ * common.h. Importing sets the bit count to one block, Nl counts bits.
+ */
+static void export_words32(const SHA_LONG *h, size_t nwords, unsigned char *chain) {
+	size_t i;
+	for(i = 0; i < nwords; i++) {
+		chain[4 * i] = (unsigned char)(h[i] >> 24);
+		chain[4 * i + 1] = (unsigned char)(h[i] >> 16);
+		chain[4 * i + 2] = (unsigned char)(h[i] >> 8);
+		chain[4 * i + 3] = (unsigned char)h[i];
+	}
+}
+
+static void import_words32(SHA_LONG *h, size_t nwords, const unsigned char *chain) {
+	size_t i;
+	for(i = 0; i < nwords; i++) {
+		h[i] = (SHA_LONG)chain[4 * i] << 24 | (SHA_LONG)chain[4 * i + 1] << 16 | (SHA_LONG)chain[4 * i + 2] << 8 | chain[4 * i + 3];
 	}
-	hawkc_bytes_to_hex(nonce_bytes, nbytes, buf);
+}
 
+static void export_words64(const SHA_LONG64 *h, unsigned char *chain) {
+	size_t i, j;
+	for(i = 0; i < 8; i++) {
+		for(j = 0; j < 8; j++) {
+			chain[8 * i + j] = (unsigned char)(h[i] >> (56 - 8 * j));
+		}
+	}
+}
+
+static void import_words64(SHA_LONG64 *h, const unsigned char *chain) {
+	size_t i, j;
+	for(i = 0; i < 8; i++) {
+		h[i] = 0;
+		for(j = 0; j < 8; j++) {
+			h[i] = h[i] << 8 | chain[8 * i + j];
+		}
+	}
+}
+
+static void sha1_export(const void *state, unsigned char *chain) {
+	const SHA_CTX *c = (const SHA_CTX*)state;
+	SHA_LONG h[5];
+	h[0] = c->h0; h[1] = c->h1; h[2] = c->h2; h[3] = c->h3; h[4] = c->h4;
+	export_words32(h,5,chain);
+}
+static void sha1_import(void *state, const unsigned char *chain) {
+	SHA_CTX *c = (SHA_CTX*)state;
+	SHA_LONG h[5];
+	import_words32(h,5,chain);
+	SHA1_Init(c);
+	c->h0 = h[0]; c->h1 = h[1]; c->h2 = h[2]; c->h3 = h[3]; c->h4 = h[4];
+	c->Nl = SHA_CBLOCK * 8;
+}
+
+static void sha256_export(const void *state, unsigned char *chain) { export_words32(((const SHA256_CTX*)state)->h,8,chain); }
+static void sha256_import(void *state, const unsigned char *chain) {
+	SHA256_Init((SHA256_CTX*)state);
+	import_words32(((SHA256_CTX*)state)->h,8,chain);
+	((SHA256_CTX*)state)->Nl = SHA256_CBLOCK * 8;
+}
+
+static void sha512_export(const void *state, unsigned char *chain) { export_words64(((const SHA512_CTX*)state)->h,chain); }
+static void sha384_import(void *state, const unsigned char *chain) {
+	SHA384_Init((SHA512_CTX*)state);
+	import_words64(((SHA512_CTX*)state)->h,chain);
+	((SHA512_CTX*)state)->Nl = SHA512_CBLOCK * 8;
+}
+static void sha512_import(void *state, const unsigned char *chain) {
+	SHA512_Init((SHA512_CTX*)state);
+	import_words64(((SHA512_CTX*)state)->h,chain);
+	((SHA512_CTX*)state)->Nl = SHA512_CBLOCK * 8;
+}
+
+/**
+ * Algorithms provided by this backend.
+ *
+ * If you add more algorithms here, you need to check and maybe adjust the
+ * buffer size constants MAX_HMAC_BYTES, MAX_DIGEST_BLOCK_BYTES,
+ * MAX_DIGEST_CHAIN_BYTES and HAWKC_DIGEST_STATE_SIZE.
+ */
+#if __cplusplus
+static struct _HawkcAlgorithm _HAWKC_SHA_512 = { "sha512", SHA512_DIGEST_LENGTH, SHA512_CBLOCK, sha512_init, sha512_update, sha512_final, NULL, 64, sha512_export, sha512_import };
+static struct _HawkcAlgorithm _HAWKC_SHA_384 = { "sha384", SHA384_DIGEST_LENGTH, SHA512_CBLOCK, sha384_init, sha384_update, sha384_final, NULL, 64, sha512_export, sha384_import };
+static struct _HawkcAlgorithm _HAWKC_SHA_256 = { "sha256", SHA256_DIGEST_LENGTH, SHA256_CBLOCK, sha256_init, sha256_update, sha256_final, NULL, 32, sha256_export, sha256_import };
+static struct _HawkcAlgorithm _HAWKC_SHA_1 = { "sha1", SHA_DIGEST_LENGTH, SHA_CBLOCK, sha1_init, sha1_update, sha1_final, NULL, 20, sha1_export, sha1_import };
+#else
+static struct HawkcAlgorithm _HAWKC_SHA_512 = { "sha512", SHA512_DIGEST_LENGTH, SHA512_CBLOCK, sha512_init, sha512_update, sha512_final, NULL, 64, sha512_export, sha512_import };
+static struct HawkcAlgorithm _HAWKC_SHA_384 = { "sha384", SHA384_DIGEST_LENGTH, SHA512_CBLOCK, sha384_init, sha384_update, sha384_final, NULL, 64, sha512_export, sha384_import };
+static struct HawkcAlgorithm _HAWKC_SHA_256 = { "sha256", SHA256_DIGEST_LENGTH, SHA256_CBLOCK, sha256_init, sha256_update, sha256_final, NULL, 32, sha256_export, sha256_import };
+static struct HawkcAlgorithm _HAWKC_SHA_1 = { "sha1", SHA_DIGEST_LENGTH, SHA_CBLOCK, sha1_init, sha1_update, sha1_final, NULL, 20, sha1_export, sha1_import };
+#endif
+
+HawkcAlgorithm HAWKC_SHA_512 = &_HAWKC_SHA_512;
+HawkcAlgorithm HAWKC_SHA_384 = &_HAWKC_SHA_384;
+HawkcAlgorithm HAWKC_SHA_256 = &_HAWKC_SHA_256;
+HawkcAlgorithm HAWKC_SHA_1 = &_HAWKC_SHA_1;
+
+HawkcAlgorithm hawkc_algorithms[] = { &_HAWKC_SHA_1, &_HAWKC_SHA_256, &_HAWKC_SHA_384, &_HAWKC_SHA_512, NULL };
+
+HawkcError hawkc_random_bytes(HawkcContext ctx, unsigned char *buf, size_t nbytes) {
+	if (RAND_bytes(buf, nbytes) != 1) {
+		return hawkc_set_error(ctx, HAWKC_ERROR,"Unable to get %lu random bytes, last OpenSSL error code: %lu", (unsigned long)nbytes,ERR_get_error());
+	}
 	return HAWKC_OK;
 }
 
-HawkcError hawkc_hmac(HawkcContext ctx, HawkcAlgorithm algorithm,
-		const unsigned char *password, size_t password_len,
-		const unsigned char *data, size_t data_len, unsigned char *result,
-		size_t *result_len) {
+HawkcError hawkc_key_init(HawkcContext ctx, HawkcKey key, HawkcAlgorithm algorithm,
+		const unsigned char *password, size_t password_len) {
 
-	HMAC_CTX md_ctx;
-	const EVP_MD *md;
-	unsigned char buf[MAX_HMAC_BYTES];
-	unsigned int len;
+	unsigned char key_block[MAX_DIGEST_BLOCK_BYTES];
+	unsigned char pad[MAX_DIGEST_BLOCK_BYTES];
+	size_t block_size, i;
 
-	if (strcmp(algorithm->name, HAWKC_SHA_1->name) == 0) {
-		md = EVP_sha1();
-	} else if (strcmp(algorithm->name, HAWKC_SHA_256->name) == 0) {
-		md = EVP_sha256();
-	} else {
+	if(algorithm == NULL || algorithm->init == NULL) {
 		return hawkc_set_error(ctx, HAWKC_ERROR_UNKNOWN_ALGORITHM,
-				"Algorithm %s not recognized for HMAC calculation", algorithm->name);
+				"Algorithm %s not recognized for HMAC calculation", algorithm ? algorithm->name : "(null)");
 	}
-	HMAC_CTX_init(&md_ctx);
-	HMAC_Init(&md_ctx, password, password_len, md);
-	HMAC_Update(&md_ctx, data, data_len);
+	block_size = algorithm->block_size;
+	memset(key_block,0,sizeof(key_block));
 
-	HMAC_Final(&md_ctx, buf, &len);
-	HMAC_CTX_cleanup(&md_ctx);
-	hawkc_base64_encode(buf, len, result, result_len);
+	/*
+	 * Passwords longer than the block size are replaced by their digest
+	 * as required by RFC 2104.
+	 */
+	if(password_len > block_size) {
+		algorithm->init(key->inner.bytes);
+		algorithm->update(key->inner.bytes,password,password_len);
+		algorithm->final(key->inner.bytes,key_block);
+	} else {
+		memcpy(key_block,password,password_len);
+	}
+	key->algorithm = algorithm;
+
+	for(i = 0; i < block_size; i++) {
+		pad[i] = key_block[i] ^ IPAD;
+	}
+	algorithm->init(key->inner.bytes);
+	algorithm->update(key->inner.bytes,pad,block_size);
+
+	for(i = 0; i < block_size; i++) {
+		pad[i] = key_block[i] ^ OPAD;
+	}
+	algorithm->init(key->outer.bytes);
+	algorithm->update(key->outer.bytes,pad,block_size);
+
+	OPENSSL_cleanse(key_block,sizeof(key_block));
+	OPENSSL_cleanse(pad,sizeof(pad));
 
 	return HAWKC_OK;
 }
 
+HawkcError hawkc_hmac_init(HawkcContext ctx, HawkcHmacCtx *hmac_ctx, HawkcKey key) {
+	hmac_ctx->state = key->inner;
+	hmac_ctx->key = key;
+	return HAWKC_OK;
+}
+
+void hawkc_hmac_update(HawkcHmacCtx *hmac_ctx, const unsigned char *data, size_t data_len) {
+	hmac_ctx->key->algorithm->update(hmac_ctx->state.bytes,data,data_len);
+}
+
+void hawkc_hmac_final_raw(HawkcHmacCtx *hmac_ctx, unsigned char *digest, size_t *digest_len) {
+
+	unsigned char buf[MAX_HMAC_BYTES];
+	HawkcKey key = hmac_ctx->key;
+	HawkcAlgorithm algorithm = key->algorithm;
+
+	algorithm->final(hmac_ctx->state.bytes,buf);
+	hmac_ctx->state = key->outer;
+	algorithm->update(hmac_ctx->state.bytes,buf,algorithm->digest_size);
+	algorithm->final(hmac_ctx->state.bytes,digest);
+	*digest_len = algorithm->digest_size;
+
+	/*
+	 * Do not leave key material of keys set up from a password behind.
+	 */
+	if(key == &(hmac_ctx->password_key)) {
+		OPENSSL_cleanse(&(hmac_ctx->password_key),sizeof(hmac_ctx->password_key));
+	}
+	OPENSSL_cleanse(&(hmac_ctx->state),sizeof(hmac_ctx->state));
+	OPENSSL_cleanse(buf,sizeof(buf));
+}
+
+HawkcError hawkc_key_hmac(HawkcContext ctx, HawkcKey key,
+		const unsigned char *data, size_t data_len, unsigned char *result,
+		size_t *result_len) {
+
+	HawkcError e;
+	HawkcHmacCtx hmac_ctx;
+
+	if( (e = hawkc_hmac_init(ctx,&hmac_ctx,key)) != HAWKC_OK) {
+		return e;
+	}
+	hawkc_hmac_update(&hmac_ctx,data,data_len);
+	return hawkc_hmac_final(ctx,&hmac_ctx,result,result_len);
+}
+
+/*
+ * libcrypto has no multi-buffer API, the HMACs are computed one by one.
+ * hawkc_hmac_init() cannot fail for keys set up by hawkc_key_init(), so
+ * no context is needed for errors.
+ */
+void hawkc_key_hmac_batch(const HawkcKey *keys, const unsigned char *const *data, const size_t *data_len,
+		size_t n, unsigned char *const *digests) {
+
+	HawkcHmacCtx hmac_ctx;
+	size_t i, len;
+
+	assert(n <= HAWKC_HMAC_BATCH_SIZE);
+
+	for(i = 0; i < n; i++) {
+		hawkc_hmac_init(NULL,&hmac_ctx,keys[i]);
+		hawkc_hmac_update(&hmac_ctx,data[i],data_len[i]);
+		hawkc_hmac_final_raw(&hmac_ctx,digests[i],&len);
+	}
+}
+
+HawkcError hawkc_hmac(HawkcContext ctx, HawkcAlgorithm algorithm,
+		const unsigned char *password, size_t password_len,
+		const unsigned char *data, size_t data_len, unsigned char *result,
+		size_t *result_len) {
+
+	HawkcError e;
+	HawkcHmacCtx hmac_ctx;
+
+	if( (e = hawkc_key_init(ctx,&(hmac_ctx.password_key),algorithm,password,password_len)) != HAWKC_OK) {
+		return e;
+	}
+	if( (e = hawkc_hmac_init(ctx,&hmac_ctx,&(hmac_ctx.password_key))) != HAWKC_OK) {
+		return e;
+	}
+	hawkc_hmac_update(&hmac_ctx,data,data_len);
+	return hawkc_hmac_final(ctx,&hmac_ctx,result,result_len);
+}
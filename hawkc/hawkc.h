@@ -40,16 +40,16 @@ extern "C" {
 /*
  * Must match the specifications of the supplied HMAC algorithms.
  * That is, it must be the longest key length generated by all
- * of the algorithms.
+ * of the algorithms. The crypto backends check this at compile time.
  */
-#define MAX_HMAC_BYTES 32
+#define MAX_HMAC_BYTES 64
 
 /** Maximum size necessary for storing HMACs in base64 encoded form.
  *
  * Depends on MAX_HMAC_BYTES and amounts to MAX_HMAC_BYTES * 4/3 + 2 bytes max. padding
  *
  */
-#define MAX_HMAC_BYTES_B64 45
+#define MAX_HMAC_BYTES_B64 89
 
 /*
  * Number of bytes to generate for nonce values.
@@ -62,6 +62,28 @@ extern "C" {
  */
 #define MAX_NONCE_HEX_BYTES 12
 
+/*
+ * Buffer size necessary to store any WWW-Authenticate header value, see
+ * hawkc_create_cached_www_authenticate_header(). Hawk ts="",tsm="" takes
+ * 17 bytes, a timestamp at most 20 digits and tsm MAX_HMAC_BYTES_B64 - 1.
+ */
+#define MAX_WWW_AUTHENTICATE_BYTES 128
+
+/*
+ * Size of the context buffer that holds parsed quoted values with escapes
+ * in unescaped form. Parsing a header whose escaped values add up to more
+ * fails with HAWKC_REQUIRED_BUFFER_TOO_LARGE.
+ */
+#define MAX_UNESCAPED_BYTES 1024
+
+/*
+ * Size of the storage for a running digest computation. The crypto backends
+ * keep their native hash context in a HawkcDigestState, so this must be
+ * large enough for the largest context of all supported algorithms
+ * (SHA512_CTX of OpenSSL has 216 bytes).
+ */
+#define HAWKC_DIGEST_STATE_SIZE 224
+
 /**
  * Hawkc mostly uses strings that are not null terminated but are associated with a length
  * information. HawkcString encapsulates a character array combined with a length.
@@ -87,7 +109,9 @@ typedef enum {
 	HAWKC_REQUIRED_BUFFER_TOO_LARGE, /* Required buffer size is too large */
 	HAWKC_ERROR, /* unspecific error */
 	HAWKC_BASE64_ERROR, /* Unexpected string length or padding in base64 en- or decoding */
-    HAWKC_OVERFLOW_ERROR /* Unexpected number value would cause integer overflow */
+    HAWKC_OVERFLOW_ERROR, /* Unexpected number value would cause integer overflow */
+	HAWKC_UNKNOWN_ID_ERROR, /* No credentials for the id */
+	HAWKC_INCOMPLETE_ERROR /* Input ends before the end of the request head */
 	/* If you add errors here, add them in common.c also */
 } HawkcError;
 
@@ -112,6 +136,189 @@ typedef struct _HawkcAlgorithm *HawkcAlgorithm;
 typedef struct HawkcAlgorithm *HawkcAlgorithm;
 #endif
 
+/*
+ * Type for precomputed HMAC keys. A key is created once from a password
+ * and an algorithm and holds the digest states after hashing the inner
+ * and outer key pads. Signing and validating with a key only needs to
+ * hash the base string.
+ *
+ * Keys do not depend on any context and can be shared between threads.
+ */
+#ifdef __cplusplus
+typedef struct _HawkcKey *HawkcKey;
+#else
+typedef struct HawkcKey *HawkcKey;
+#endif
+
+/*
+ * Opaque, suitably aligned storage for a backend hash context.
+ */
+typedef union HawkcDigestState {
+	unsigned char bytes[HAWKC_DIGEST_STATE_SIZE];
+	unsigned long long ull_align;
+	void *ptr_align;
+} HawkcDigestState;
+
+/** Structure for the Key typedef.
+ *
+ * inner and outer hold the digest states after hashing the password
+ * XORed with the HMAC ipad and opad blocks respectively. The structure is
+ * only defined here so that a context can hold a key, its fields are
+ * private to the library.
+ */
+#if __cplusplus
+struct _HawkcKey {
+#else
+struct HawkcKey {
+#endif
+	HawkcAlgorithm algorithm;
+	HawkcDigestState inner;
+	HawkcDigestState outer;
+};
+
+/*
+ * State of an incremental payload hash computation, see
+ * hawkc_payload_hash_init(). Like the context it can be an automatic
+ * variable.
+ */
+typedef struct HawkcPayloadHash {
+	HawkcAlgorithm algorithm;
+	HawkcDigestState state;
+} HawkcPayloadHash;
+
+/*
+ * Type for nonce replay caches, see hawkc_replay_cache_create().
+ */
+#ifdef __cplusplus
+typedef struct _HawkcReplayCache *HawkcReplayCache;
+#else
+typedef struct HawkcReplayCache *HawkcReplayCache;
+#endif
+
+/*
+ * Type for credential stores, see hawkc_credential_store_create(), and for
+ * the sets of credentials they publish.
+ */
+#ifdef __cplusplus
+typedef struct _HawkcCredentialStore *HawkcCredentialStore;
+typedef struct _HawkcCredentials *HawkcCredentials;
+#else
+typedef struct HawkcCredentialStore *HawkcCredentialStore;
+typedef struct HawkcCredentials *HawkcCredentials;
+#endif
+
+/*
+ * Type for memory-mapped credential files, see hawkc_credential_file_open().
+ */
+#ifdef __cplusplus
+typedef struct _HawkcCredentialFile *HawkcCredentialFile;
+#else
+typedef struct HawkcCredentialFile *HawkcCredentialFile;
+#endif
+
+/*
+ * Type for key derivers, see hawkc_key_deriver_create().
+ */
+#ifdef __cplusplus
+typedef struct _HawkcKeyDeriver *HawkcKeyDeriver;
+#else
+typedef struct HawkcKeyDeriver *HawkcKeyDeriver;
+#endif
+
+/*
+ * Type for resolver caches, see hawkc_resolver_cache_create().
+ */
+#ifdef __cplusplus
+typedef struct _HawkcResolverCache *HawkcResolverCache;
+#else
+typedef struct HawkcResolverCache *HawkcResolverCache;
+#endif
+
+/*
+ * Type for WWW-Authenticate header caches, see
+ * hawkc_www_authenticate_cache_create().
+ */
+#ifdef __cplusplus
+typedef struct _HawkcWwwAuthenticateCache *HawkcWwwAuthenticateCache;
+#else
+typedef struct HawkcWwwAuthenticateCache *HawkcWwwAuthenticateCache;
+#endif
+
+/*
+ * Type for clock skew estimators, see hawkc_skew_estimator_create().
+ */
+#ifdef __cplusplus
+typedef struct _HawkcSkewEstimator *HawkcSkewEstimator;
+#else
+typedef struct HawkcSkewEstimator *HawkcSkewEstimator;
+#endif
+
+/*
+ * Type for id filters, see hawkc_id_filter_create().
+ */
+#ifdef __cplusplus
+typedef struct _HawkcIdFilter *HawkcIdFilter;
+#else
+typedef struct HawkcIdFilter *HawkcIdFilter;
+#endif
+
+/*
+ * Type for incremental Authorization header parsers, see hawkc_parser_create().
+ */
+#ifdef __cplusplus
+typedef struct _HawkcParser *HawkcParser;
+#else
+typedef struct HawkcParser *HawkcParser;
+#endif
+
+/*
+ * Statistics of an id filter, see hawkc_id_filter_stats(). Counts are
+ * totals since the filter was created.
+ *
+ * checks is the number of ids checked, rejected the number of those not
+ * in the filter. false_positives counts ids that passed the filter but
+ * had no credentials. ids and size are those of the current filter, size
+ * in bytes.
+ */
+typedef struct HawkcIdFilterStats {
+	unsigned long checks;
+	unsigned long rejected;
+	unsigned long false_positives;
+	size_t ids;
+	size_t size;
+} HawkcIdFilterStats;
+
+/*
+ * Function that looks up the key for an id, see
+ * hawkc_context_set_key_resolver(). The key is stored in caller-provided
+ * storage. Returns HAWKC_UNKNOWN_ID_ERROR if there is no key for the id.
+ */
+typedef HawkcError (*HawkcKeyResolver)(HawkcContext ctx, const unsigned char *id, size_t id_len, HawkcKey key, void *data);
+
+/*
+ * Key resolver that also tells until when the key is valid, see
+ * hawkc_resolver_cache_create(). Store the expiry time in expires, for
+ * example the expiry of a sealed token used as id, or leave it at 0 if
+ * the key does not expire.
+ */
+typedef HawkcError (*HawkcExpiringKeyResolver)(HawkcContext ctx, const unsigned char *id, size_t id_len, HawkcKey key,
+		time_t *expires, void *data);
+
+/*
+ * Function that returns the current unix time, see
+ * hawkc_context_set_clock(). data is the pointer passed with it.
+ */
+typedef time_t (*HawkcClock)(void *data);
+
+/*
+ * State of the fake clock hawkc_fake_clock(), which returns now and then
+ * advances it by step seconds. Keep step 0 if several threads share it.
+ */
+typedef struct HawkcFakeClock {
+	time_t now;
+	time_t step;
+} HawkcFakeClock;
+
 /*
  * Memory allocation function pointers. Hawkc allows setting custom
  * allocation functions. For example, if you need some that do
@@ -167,10 +374,27 @@ typedef struct WwwAuthenticateHeader {
  * www_authenticate_header is used either way, depending on use on
  * the server- or client side.
  *
+ * unescape_buffer holds the quoted values of the last parsed header that
+ * contained escapes, unescaped. unescape_len bytes of it are in use.
+ *
  * hmac_buffer, ts_hmac_buffer and nonce_buffer are used as buffers to write HMAC
  * signatures and nonce to. There are three corresponding HawkcStrings to point
  * to the buffers.
  *
+ * resolver looks up the key for the id of header_in during validation. The
+ * key found is stored in resolved_key, so the context does not reference
+ * the resolver's memory afterwards. request_key then points to it until
+ * another header is parsed: it is used instead of key, password and
+ * algorithm for that request only, including the response headers.
+ *
+ * id_filter holds the known ids, parsing an Authorization header with an id
+ * that is not in it fails with HAWKC_UNKNOWN_ID_ERROR.
+ *
+ * clock returns the current time for signing and checking timestamps, the
+ * coarse clock if it is NULL.
+ *
+ * skew_estimator provides the clock offset for the host when signing, offset
+ * is used for hosts it does not know.
  *
  */
 #ifdef __cplusplus
@@ -187,6 +411,19 @@ struct HawkcContext {
 
 	HawkcAlgorithm algorithm;
 	HawkcString password;
+	HawkcKey key;
+	HawkcKeyResolver resolver;
+	void *resolver_data;
+	HawkcIdFilter id_filter;
+	HawkcClock clock;
+	void *clock_data;
+	HawkcSkewEstimator skew_estimator;
+#ifdef __cplusplus
+	struct _HawkcKey resolved_key;
+#else
+	struct HawkcKey resolved_key;
+#endif
+	HawkcKey request_key;
 
 	HawkcString method;
 	HawkcString path;
@@ -206,6 +443,10 @@ struct HawkcContext {
 	unsigned char hmac_buffer[MAX_HMAC_BYTES_B64];
 	unsigned char ts_hmac_buffer[MAX_HMAC_BYTES_B64];
 	unsigned char nonce_buffer[MAX_NONCE_HEX_BYTES];
+	unsigned char hmac_digest[MAX_HMAC_BYTES];
+	size_t hmac_digest_len;
+	unsigned char unescape_buffer[MAX_UNESCAPED_BYTES];
+	size_t unescape_len;
 	HawkcString hmac;
 	HawkcString ts_hmac;
 	HawkcString nonce;
@@ -228,6 +469,69 @@ void HAWKCAPI hawkc_context_init(HawkcContext ctx);
  */
 void HAWKCAPI hawkc_context_set_clock_offset(HawkcContext ctx,int offset);
 
+/*
+ * Create a clock skew estimator for up to hosts server hosts. It averages
+ * the offsets between the local clock and the server clocks learned from
+ * verified WWW-Authenticate headers, see
+ * hawkc_validate_www_authenticate_tsm(). Share one estimator between all
+ * contexts of a process with hawkc_context_set_skew_estimator(), so every
+ * context signs with the offset of its host once any of them got a
+ * response. Release it with hawkc_skew_estimator_free().
+ */
+HawkcError HAWKCAPI hawkc_skew_estimator_create(HawkcContext ctx, size_t hosts, HawkcSkewEstimator *estimator);
+
+/*
+ * Release the estimator. No thread may use it any more.
+ */
+void HAWKCAPI hawkc_skew_estimator_free(HawkcContext ctx, HawkcSkewEstimator estimator);
+
+/*
+ * Add the offset server_ts - now of host to its average. Each new offset
+ * moves the average a quarter of the way towards it. Updates of more hosts
+ * than the estimator was created for are ignored. Any number of threads
+ * may update and read the estimator at the same time.
+ */
+void HAWKCAPI hawkc_skew_estimator_update(HawkcSkewEstimator estimator, const unsigned char *host, size_t host_len,
+		time_t server_ts, time_t now);
+
+/*
+ * Store the average offset of host in offset, rounded to seconds. Returns 0
+ * if there is none.
+ */
+int HAWKCAPI hawkc_skew_estimator_offset(HawkcSkewEstimator estimator, const unsigned char *host, size_t host_len, int *offset);
+
+/*
+ * Sign requests with the offset the estimator has for the host of the
+ * context instead of the clock offset, and add the offsets of verified
+ * WWW-Authenticate headers to it. Pass NULL to stop using the estimator.
+ */
+void HAWKCAPI hawkc_context_set_skew_estimator(HawkcContext ctx, HawkcSkewEstimator estimator);
+
+/*
+ * Set the clock used to sign requests and check timestamps, for example
+ * hawkc_fake_clock() to get reproducible timestamps in tests and benchmarks.
+ * data is passed to the clock. Pass NULL to use hawkc_coarse_clock() again.
+ */
+void HAWKCAPI hawkc_context_set_clock(HawkcContext ctx, HawkcClock clock, void *data);
+
+/*
+ * Return the current time of the context's clock, without clock offset.
+ * Use it as now of hawkc_replay_cache_check().
+ */
+time_t HAWKCAPI hawkc_context_time(HawkcContext ctx);
+
+/*
+ * The default clock. Reads the coarse realtime clock, which the kernel
+ * updates once per tick, without a system call where the platform
+ * supports this, and falls back to time() otherwise. data is not used.
+ */
+time_t HAWKCAPI hawkc_coarse_clock(void *data);
+
+/*
+ * Clock that returns the time of the HawkcFakeClock data points to.
+ */
+time_t HAWKCAPI hawkc_fake_clock(void *data);
+
 /*
  * Set the malloc function to use internally. Defaults to standard malloc.
  */
@@ -253,6 +557,26 @@ void HAWKCAPI hawkc_context_set_password(HawkcContext ctx,unsigned char *passwor
  */
 void HAWKCAPI hawkc_context_set_algorithm(HawkcContext ctx,HawkcAlgorithm algorithm);
 
+/*
+ * Create a precomputed HMAC key for the given algorithm and password.
+ *
+ * The key is allocated using the context's allocation functions and must be
+ * released with hawkc_key_free(). The password is not referenced after this
+ * call returns.
+ */
+HawkcError HAWKCAPI hawkc_key_create(HawkcContext ctx, HawkcAlgorithm algorithm, unsigned char *password, size_t len, HawkcKey *key);
+
+/*
+ * Release a key created with hawkc_key_create().
+ */
+void HAWKCAPI hawkc_key_free(HawkcContext ctx, HawkcKey key);
+
+/*
+ * Set the precomputed key to be used for signing and signature validation.
+ * When a key is set, it takes precedence over password and algorithm.
+ */
+void HAWKCAPI hawkc_context_set_key(HawkcContext ctx, HawkcKey key);
+
 /*
  * Set the request method that will be part of the signature base string.
  */
@@ -283,11 +607,64 @@ void HAWKCAPI hawkc_context_set_id(HawkcContext ctx,unsigned char *id, size_t le
  * Set the ext-parameter to be placed in outgoing headers or which has be parsed
  * from an incoming header.
  *
- * FIXME: We need to doc here, whether double qoutes must be escaped or unescaped.
- * See https://github.com/algermissen/hawkc/issues/2
+ * ext is given unescaped. Double quotes and backslashes are escaped when
+ * the header is created, and the ext of parsed headers is unescaped. See
+ * https://github.com/algermissen/hawkc/issues/2
  */
 void HAWKCAPI hawkc_context_set_ext(HawkcContext ctx,unsigned char *ext, size_t len);
 
+/*
+ * Set the hash-parameter to be placed in outgoing headers, the base64 encoded
+ * payload hash obtained from hawkc_payload_hash_final(). The hash becomes
+ * part of the base string and is covered by the mac. Without a hash the
+ * payload is not authenticated.
+ */
+void HAWKCAPI hawkc_context_set_hash(HawkcContext ctx,unsigned char *hash, size_t len);
+
+/*
+ * Start computing the Hawk payload hash of a request or response body with
+ * the algorithm of the context (set by hawkc_context_set_algorithm() or
+ * hawkc_context_set_key(), or that of the key resolved for the request).
+ *
+ * The payload hash covers the content type, which is normalized as Hawk
+ * requires: parameters such as charset are removed, surrounding whitespace
+ * is trimmed and the remainder lowercased. Pass the value of the
+ * Content-Type header as it is, or an empty string if there is none.
+ *
+ * The body is then passed in pieces of any size to hawkc_payload_hash_update(),
+ * for example every chunk right after it has been read from the socket, so
+ * the body never needs to be held in memory as a whole. Finally call
+ * hawkc_payload_hash_final() or hawkc_validate_payload_hash().
+ */
+HawkcError HAWKCAPI hawkc_payload_hash_init(HawkcContext ctx, HawkcPayloadHash *hash, const unsigned char *content_type, size_t len);
+
+/*
+ * Add the next len bytes of the body to the payload hash.
+ */
+void HAWKCAPI hawkc_payload_hash_update(HawkcPayloadHash *hash, const unsigned char *data, size_t len);
+
+/*
+ * Finish the payload hash and store it base64 encoded in buf, which must be
+ * at least MAX_HMAC_BYTES_B64 bytes long. The number of bytes written is put
+ * into the len parameter.
+ *
+ * On the sending side pass the result to hawkc_context_set_hash() before
+ * calculating the authorization header length.
+ */
+HawkcError HAWKCAPI hawkc_payload_hash_final(HawkcContext ctx, HawkcPayloadHash *hash, unsigned char *buf, size_t *len);
+
+/*
+ * Finish the payload hash and compare it to the hash-parameter of the parsed
+ * authorization header. is_valid is set to 1 if they are equal and to 0
+ * otherwise, in particular also if the header has no hash-parameter.
+ *
+ * The hash-parameter is protected by the mac, so hawkc_validate_hmac() must
+ * succeed as well before the payload can be trusted. Since the body
+ * usually arrives after the header, validate the mac first and then the
+ * payload hash once the body has been read.
+ */
+HawkcError HAWKCAPI hawkc_validate_payload_hash(HawkcContext ctx, HawkcPayloadHash *hash, int *is_valid);
+
 /*
  * Parse incoming authorization header. On the client side this will be the used
  * for the Authorization header, on the server side, this will be used for the
@@ -295,9 +672,83 @@ void HAWKCAPI hawkc_context_set_ext(HawkcContext ctx,unsigned char *ext, size_t
  *
  * Header and number of bytes to parse are to be supplied as the value and len
  * parameters.
+ *
+ * If an id filter has been set with hawkc_context_set_id_filter() and the
+ * id of the header is not in it, HAWKC_UNKNOWN_ID_ERROR is returned.
  */
 HawkcError HAWKCAPI hawkc_parse_authorization_header(HawkcContext ctx, unsigned char *value, size_t len);
 
+/*
+ * Create a parser for Authorization headers that arrive in pieces, for
+ * example across several socket reads. The values of the known parameters
+ * are unescaped into a buffer of size bytes inside the parser, headers with
+ * more value bytes fail with HAWKC_REQUIRED_BUFFER_TOO_LARGE. Unknown
+ * parameters are skipped without being copied.
+ *
+ * Headers that are available in one piece are better parsed with
+ * hawkc_parse_authorization_header(), which does not copy the values.
+ * Release the parser with hawkc_parser_free().
+ */
+HawkcError HAWKCAPI hawkc_parser_create(HawkcContext ctx, size_t size, HawkcParser *parser);
+
+/*
+ * Release the parser. Header fields parsed with it become invalid.
+ */
+void HAWKCAPI hawkc_parser_free(HawkcContext ctx, HawkcParser parser);
+
+/*
+ * Make the parser ready for the next header. Header fields parsed with it
+ * become invalid.
+ */
+void HAWKCAPI hawkc_parser_reset(HawkcParser parser);
+
+/*
+ * Parse the next len bytes of the header value. The chunk is not
+ * referenced after the call returns.
+ *
+ * Each parameter is stored in the header fields of the context as soon as
+ * its value is complete, the last one when hawkc_parser_finish() is called.
+ * Headers of another scheme than Hawk fail with HAWKC_BAD_SCHEME_ERROR at
+ * the first byte that does not match and an id that is not in the id filter
+ * of the context fails with HAWKC_UNKNOWN_ID_ERROR as soon as the id is
+ * complete. Once feeding has failed, the parser returns the error until it
+ * is reset.
+ */
+HawkcError HAWKCAPI hawkc_parser_feed(HawkcContext ctx, HawkcParser parser, const unsigned char *chunk, size_t len);
+
+/*
+ * Signal the end of the header value. Returns HAWKC_OK if the header is
+ * complete and fails as hawkc_parse_authorization_header() would if it
+ * has been cut short.
+ */
+HawkcError HAWKCAPI hawkc_parser_finish(HawkcContext ctx, HawkcParser parser);
+
+/*
+ * Scan the head of an HTTP/1.x request, the request line and the header
+ * fields up to the empty line that ends them, and set method, path, host
+ * and port of the context to point into it. The port defaults to 443 if
+ * tls is set and to 80 otherwise. The number of bytes of the head,
+ * including the empty line, is stored in head_len.
+ *
+ * For an absolute-form request target such as http://example.com:8000/p,
+ * host and port are taken from the URI instead of the Host header, the
+ * default port from its scheme, and the path is the rest of the URI or /.
+ * Only http and https URIs without userinfo are accepted, other targets
+ * that do not start with / and are not * fail with HAWKC_PARSE_ERROR.
+ *
+ * If the request has an Authorization header, it is parsed like with
+ * hawkc_parse_authorization_header(), otherwise the header fields of the
+ * context are left empty.
+ *
+ * Lines may end with CRLF or LF. Requests with neither Host header nor
+ * absolute-form target, with duplicate Host or Authorization headers, with
+ * folded header lines or with control characters other than HT fail with
+ * HAWKC_PARSE_ERROR. If len
+ * ends before the head does, HAWKC_INCOMPLETE_ERROR is returned and the
+ * call can be repeated once more of the request has been read.
+ */
+HawkcError HAWKCAPI hawkc_parse_request_head(HawkcContext ctx, unsigned char *head, size_t len, int tls, size_t *head_len);
+
 /*
  * Caculate the buffer size necessary to store an authorization header value generated
  * from the current state of the context.
@@ -319,9 +770,430 @@ HawkcError HAWKCAPI hawkc_create_authorization_header(HawkcContext ctx, unsigned
  * parsed before using hawkc_parse_authorization_header(). This is intended
  * for use on client (Authorization hedare) and server side (Serer-Authorization
  * header).
+ *
+ * The mac of the header is base64 decoded and compared to the raw HMAC
+ * computed from the request. A mac that is not canonical base64 is rejected
+ * with HAWKC_BASE64_ERROR before any hashing is done. The computed HMAC is
+ * not base64 encoded, see hawkc_encode_validated_hmac().
+ *
+ * If a key resolver has been set, for example with
+ * hawkc_context_set_credential_store(), the key is looked up by the id of
+ * the header. An unknown id is reported as HAWKC_UNKNOWN_ID_ERROR.
  */
 HawkcError HAWKCAPI hawkc_validate_hmac(HawkcContext ctx, int *is_valid);
 
+/*
+ * Validate the HMAC of the parsed authorization header against each of the
+ * n keys, for example the old and new key of a credential during password
+ * rotation. The context is prepared as for hawkc_validate_hmac(), but the
+ * keys given are used instead of password, key or key resolver of the
+ * context. matched is set to the index of the first key the HMAC is valid
+ * for, or to -1 if there is none.
+ *
+ * The base string is built once and hashed under all keys, several keys in
+ * parallel when the crypto backend supports it, so checking two or three
+ * keys costs little more than checking one.
+ */
+HawkcError HAWKCAPI hawkc_validate_hmac_any(HawkcContext ctx, const HawkcKey *keys, size_t n, int *matched);
+
+/*
+ * Check that the timestamp of the parsed authorization header is at most
+ * skew seconds away from the time of the context's clock, see
+ * hawkc_context_set_clock(). is_valid is set to 0 if it is not, and the
+ * clock's time is then set as timestamp of the WWW-Authenticate header, so
+ * the client can adjust its clock offset.
+ */
+HawkcError HAWKCAPI hawkc_check_timestamp(HawkcContext ctx, time_t skew, int *is_valid);
+
+/*
+ * Results of hawkc_authenticate().
+ */
+typedef enum {
+	HAWKC_AUTH_OK, /* the request is authentic */
+	HAWKC_AUTH_MALFORMED, /* the header cannot be parsed or lacks id, ts, nonce or mac */
+	HAWKC_AUTH_STALE_TIMESTAMP, /* ts is more than skew seconds off */
+	HAWKC_AUTH_REPLAYED, /* the nonce has been used before */
+	HAWKC_AUTH_UNKNOWN_ID, /* there are no credentials for the id */
+	HAWKC_AUTH_INVALID_MAC, /* the mac does not match the request */
+	HAWKC_AUTH_ERROR /* an error occurred, see hawkc_get_error() */
+} HawkcAuthResult;
+
+/*
+ * Parse and validate an Authorization header in one call, with method, path,
+ * host, port and the key or key resolver set on the context as for
+ * hawkc_validate_hmac().
+ *
+ * The checks run from the cheapest to the most expensive: parsing, the id
+ * filter, decoding the mac, the timestamp (see hawkc_check_timestamp()),
+ * looking the nonce up in replay_cache, resolving the key and, only if all
+ * of these pass, the HMAC. The nonce of an authentic request is then added
+ * to replay_cache. Pass NULL to skip the replay check.
+ *
+ * The key is also resolved for a stale timestamp, so that
+ * hawkc_create_www_authenticate_header() and
+ * hawkc_create_cached_www_authenticate_header() sign the server's time with
+ * the key of the client. An unknown id then gives HAWKC_AUTH_UNKNOWN_ID.
+ *
+ * Every result but HAWKC_AUTH_OK sets the error message of the context.
+ */
+HawkcAuthResult HAWKCAPI hawkc_authenticate(HawkcContext ctx, unsigned char *value, size_t len, time_t skew,
+		HawkcReplayCache replay_cache);
+
+/*
+ * Base64 encode the HMAC computed by the last hawkc_validate_hmac(),
+ * hawkc_validate_hmac_batch() or hawkc_validate_hmac_any() call into
+ * ctx->hmac, e.g. for logging. After hawkc_validate_hmac_any() this is the
+ * HMAC of the matching key and undefined if no key matched.
+ */
+void HAWKCAPI hawkc_encode_validated_hmac(HawkcContext ctx);
+
+/*
+ * Validate the HMACs of n contexts in one call. Each context must be prepared
+ * as for hawkc_validate_hmac(). Bit i % 8 of valid[i / 8] is set if the HMAC of
+ * ctxs[i] is valid and cleared otherwise, so valid must hold (n + 7) / 8 bytes.
+ *
+ * This is faster than calling hawkc_validate_hmac() for every context when the
+ * crypto backend hashes several messages in parallel (the native backend uses
+ * multi-buffer SHA kernels).
+ *
+ * If the HMAC of a context cannot be computed, the error is set in that context
+ * and its bit is cleared. All contexts are processed in any case, the return
+ * value is the first error that occurred or HAWKC_OK.
+ */
+HawkcError HAWKCAPI hawkc_validate_hmac_batch(HawkcContext *ctxs, size_t n, unsigned char *valid);
+
+/*
+ * Create a cache of the (id, nonce, ts) triples of recently seen requests
+ * to detect replayed requests.
+ *
+ * Requests are accepted if their timestamp lies within skew seconds of the
+ * server time, so the cache remembers every triple for that long. The cache
+ * has a fixed size and must be able to hold requests_per_second requests
+ * for every second of the window. It takes about
+ * 16 * requests_per_second * (2 * skew + 1) bytes, rounded up to powers of
+ * two.
+ *
+ * The cache is shared between threads without locks. It is allocated using
+ * the context's allocation functions and must be released with
+ * hawkc_replay_cache_free().
+ */
+HawkcError HAWKCAPI hawkc_replay_cache_create(HawkcContext ctx, size_t requests_per_second, time_t skew, HawkcReplayCache *cache);
+
+/*
+ * Create or attach to a replay cache in the POSIX shared memory segment
+ * name (e.g. "/myserver-replay"), so that several processes on a host, such
+ * as the workers of a prefork server, detect replays across all of them.
+ *
+ * The first process to open the name creates and sizes the segment, later
+ * ones map it. The size of the cache is determined by its creator, but the
+ * skew must be the same for all processes. The segment outlives the
+ * processes until hawkc_replay_cache_unlink() is called.
+ *
+ * Release the mapping with hawkc_replay_cache_free().
+ */
+HawkcError HAWKCAPI hawkc_replay_cache_open_shared(HawkcContext ctx, const char *name, size_t requests_per_second, time_t skew, HawkcReplayCache *cache);
+
+/*
+ * Remove the shared memory segment name. Processes that have the cache open
+ * keep using it, processes opening the name afterwards get a new cache.
+ */
+HawkcError HAWKCAPI hawkc_replay_cache_unlink(HawkcContext ctx, const char *name);
+
+/*
+ * Release a cache created with hawkc_replay_cache_create() or
+ * hawkc_replay_cache_open_shared().
+ */
+void HAWKCAPI hawkc_replay_cache_free(HawkcContext ctx, HawkcReplayCache cache);
+
+/*
+ * Check the id, nonce and ts of the authorization header that has been
+ * parsed before using hawkc_parse_authorization_header() against the cache
+ * and remember them. now is the current server time.
+ *
+ * is_fresh is set to 1 if the triple has not been seen before and to 0 if
+ * the request is a replay or its timestamp lies outside the window of the
+ * cache. Of several concurrent checks of the same triple exactly one finds
+ * it fresh.
+ *
+ * If the cache cannot take any more requests for the second of ts,
+ * HAWKC_NO_MEM is returned and is_fresh is 0.
+ */
+HawkcError HAWKCAPI hawkc_replay_cache_check(HawkcContext ctx, HawkcReplayCache cache, time_t now, int *is_fresh);
+
+/*
+ * Results of hawkc_replay_cache_add().
+ */
+#define HAWKC_REPLAY_FRESH 1
+#define HAWKC_REPLAY_SEEN 0
+#define HAWKC_REPLAY_OUTSIDE_WINDOW (-1)
+#define HAWKC_REPLAY_FULL (-2)
+
+/*
+ * Like hawkc_replay_cache_check() but for an explicitly given triple,
+ * for example if requests are not parsed by hawkc. Returns one of the
+ * HAWKC_REPLAY_ values above.
+ */
+int HAWKCAPI hawkc_replay_cache_add(HawkcReplayCache cache, const unsigned char *id, size_t id_len,
+		const unsigned char *nonce, size_t nonce_len, time_t ts, time_t now);
+
+/*
+ * Like hawkc_replay_cache_add() but only looks the triple up without
+ * remembering it. Returns HAWKC_REPLAY_SEEN if it has been added before,
+ * HAWKC_REPLAY_OUTSIDE_WINDOW or HAWKC_REPLAY_FRESH otherwise.
+ */
+int HAWKCAPI hawkc_replay_cache_seen(HawkcReplayCache cache, const unsigned char *id, size_t id_len,
+		const unsigned char *nonce, size_t nonce_len, time_t ts, time_t now);
+
+/*
+ * Create an empty set of credentials to fill with hawkc_credentials_add()
+ * and publish in a credential store. expected is the number of credentials
+ * the set is sized for, it grows as needed.
+ *
+ * Only the HMAC key states are kept, about 100 bytes per credential for
+ * SHA-256, not the passwords.
+ */
+HawkcError HAWKCAPI hawkc_credentials_create(HawkcContext ctx, size_t expected, HawkcCredentials *credentials);
+
+/*
+ * Add the credentials for id to the set. Adding an id that is already in
+ * the set fails with HAWKC_ERROR.
+ */
+HawkcError HAWKCAPI hawkc_credentials_add(HawkcContext ctx, HawkcCredentials credentials,
+		const unsigned char *id, size_t id_len, HawkcAlgorithm algorithm, const unsigned char *password, size_t password_len);
+
+/*
+ * Release a set of credentials that has not been published.
+ */
+void HAWKCAPI hawkc_credentials_free(HawkcContext ctx, HawkcCredentials credentials);
+
+/*
+ * Create a credential store, which maps ids to HMAC keys for any number of
+ * threads validating requests. It is empty until a set of credentials is
+ * published. Release it with hawkc_credential_store_free().
+ */
+HawkcError HAWKCAPI hawkc_credential_store_create(HawkcContext ctx, HawkcCredentialStore *store);
+
+/*
+ * Release the store and the credentials published last. No thread may use
+ * the store any more.
+ */
+void HAWKCAPI hawkc_credential_store_free(HawkcContext ctx, HawkcCredentialStore store);
+
+/*
+ * Replace the credentials of the store with the set, which the store takes
+ * ownership of. Lookups see either the old or the new set and are never
+ * blocked. The call waits until no lookup uses the previous set anymore
+ * and releases it, so reloading credentials while serving requests only
+ * costs the time to build the new set, in the thread that reloads.
+ *
+ * credentials may be NULL to empty the store.
+ */
+HawkcError HAWKCAPI hawkc_credential_store_publish(HawkcContext ctx, HawkcCredentialStore store, HawkcCredentials credentials);
+
+/*
+ * Look up the credentials for id and store their key in key, which is
+ * caller-provided storage. Returns HAWKC_UNKNOWN_ID_ERROR if there are none.
+ */
+HawkcError HAWKCAPI hawkc_credential_store_lookup(HawkcContext ctx, HawkcCredentialStore store,
+		const unsigned char *id, size_t id_len, HawkcKey key);
+
+/*
+ * Look up the key for the id of parsed headers in the store when validating,
+ * see hawkc_validate_hmac(). This sets the key resolver of the context.
+ */
+void HAWKCAPI hawkc_context_set_credential_store(HawkcContext ctx, HawkcCredentialStore store);
+
+/*
+ * Write the credentials to a credential file at path, which can then be
+ * opened with hawkc_credential_file_open(). The file is written under a
+ * temporary name and renamed to path, so it can be replaced while servers
+ * use it. Like a set of credentials, the file holds the HMAC key states,
+ * not the passwords, but must be kept as secret as the passwords.
+ *
+ * The file has an index of the ids built with a minimal perfect hash
+ * function, which takes about one second per million credentials.
+ */
+HawkcError HAWKCAPI hawkc_credential_file_write(HawkcContext ctx, HawkcCredentials credentials, const char *path);
+
+/*
+ * Map a credential file written by hawkc_credential_file_write() read-only.
+ * The file is not read, lookups access the mapped pages directly, so
+ * opening takes the same time for any number of credentials and all
+ * processes that open the file share its pages. Files written on a machine
+ * of different byte order are rejected.
+ *
+ * To reload, open the new file, switch contexts over to it and close the
+ * old one. Release it with hawkc_credential_file_close().
+ */
+HawkcError HAWKCAPI hawkc_credential_file_open(HawkcContext ctx, const char *path, HawkcCredentialFile *file);
+
+/*
+ * Unmap a credential file. No thread may use it any more.
+ */
+void HAWKCAPI hawkc_credential_file_close(HawkcContext ctx, HawkcCredentialFile file);
+
+/*
+ * Look up the credentials for id and store their key in key, which is
+ * caller-provided storage. Returns HAWKC_UNKNOWN_ID_ERROR if there are none.
+ * Any number of threads may look up ids at the same time.
+ */
+HawkcError HAWKCAPI hawkc_credential_file_lookup(HawkcContext ctx, HawkcCredentialFile file,
+		const unsigned char *id, size_t id_len, HawkcKey key);
+
+/*
+ * Look up the key for the id of parsed headers in the credential file when
+ * validating, see hawkc_validate_hmac(). This sets the key resolver of the
+ * context.
+ */
+void HAWKCAPI hawkc_context_set_credential_file(HawkcContext ctx, HawkcCredentialFile file);
+
+/*
+ * Set the function that looks up the key for the id of parsed headers when
+ * validating, see hawkc_validate_hmac(). data is passed to the resolver.
+ * Pass NULL to use password and algorithm or a key set on the context again.
+ */
+void HAWKCAPI hawkc_context_set_key_resolver(HawkcContext ctx, HawkcKeyResolver resolver, void *data);
+
+/*
+ * Create a key deriver, which derives the password of every id from a
+ * master secret instead of storing it: the password of an id is the
+ * base64url encoded HMAC of the id keyed with master, using algorithm for
+ * both this HMAC and the requests of the id. Issue passwords to clients
+ * with hawkc_key_deriver_password().
+ *
+ * Every thread keeps the keys of the cache_size ids it used last, so
+ * memory depends on the cache size and the number of threads, not on the
+ * number of clients. Pass 0 to derive the key for every request, which
+ * costs about four compression function calls of the algorithm. Ids longer
+ * than 64 bytes are not cached.
+ *
+ * The master secret is not referenced after this call returns. Release the
+ * deriver with hawkc_key_deriver_free().
+ */
+HawkcError HAWKCAPI hawkc_key_deriver_create(HawkcContext ctx, HawkcAlgorithm algorithm, const unsigned char *master, size_t master_len,
+		size_t cache_size, HawkcKeyDeriver *deriver);
+
+/*
+ * Release the deriver. No thread may use it any more.
+ */
+void HAWKCAPI hawkc_key_deriver_free(HawkcContext ctx, HawkcKeyDeriver deriver);
+
+/*
+ * Derive the password of id. password must be at least MAX_HMAC_BYTES_B64
+ * bytes long, the length is stored in password_len.
+ */
+HawkcError HAWKCAPI hawkc_key_deriver_password(HawkcContext ctx, HawkcKeyDeriver deriver, const unsigned char *id, size_t id_len,
+		unsigned char *password, size_t *password_len);
+
+/*
+ * Store the key of id in key, which is caller-provided storage. Any number
+ * of threads may look up keys at the same time.
+ */
+HawkcError HAWKCAPI hawkc_key_deriver_lookup(HawkcContext ctx, HawkcKeyDeriver deriver, const unsigned char *id, size_t id_len, HawkcKey key);
+
+/*
+ * Derive the key for the id of parsed headers when validating, see
+ * hawkc_validate_hmac(). This sets the key resolver of the context.
+ */
+void HAWKCAPI hawkc_context_set_key_deriver(HawkcContext ctx, HawkcKeyDeriver deriver);
+
+/*
+ * Create a resolver cache, which remembers the keys an expensive resolver
+ * returned, for example one that unseals iron tokens used as ids with a
+ * PBKDF2 round each. Further requests with the same id then cost an HMAC
+ * of the id instead of a call to resolver. data is passed to the
+ * resolver.
+ *
+ * Keys are cached until the expiry time the resolver returned or until
+ * they are replaced by newer ones, so the cache keeps about capacity keys.
+ * Ids are not stored but a 128-bit digest of them, keyed with a random
+ * key of the cache so that colliding ids cannot be found. Errors of the
+ * resolver are not cached. Release the cache with
+ * hawkc_resolver_cache_free().
+ */
+HawkcError HAWKCAPI hawkc_resolver_cache_create(HawkcContext ctx, HawkcExpiringKeyResolver resolver, void *data, size_t capacity,
+		HawkcResolverCache *cache);
+
+/*
+ * Release the cache. No thread may use it any more.
+ */
+void HAWKCAPI hawkc_resolver_cache_free(HawkcContext ctx, HawkcResolverCache cache);
+
+/*
+ * Store the key of id in key, which is caller-provided storage, calling the
+ * resolver if the key is not cached. Any number of threads may look up
+ * keys at the same time.
+ */
+HawkcError HAWKCAPI hawkc_resolver_cache_lookup(HawkcContext ctx, HawkcResolverCache cache, const unsigned char *id, size_t id_len, HawkcKey key);
+
+/*
+ * Look up the key for the id of parsed headers in the cache when
+ * validating, see hawkc_validate_hmac(). This sets the key resolver of the
+ * context.
+ */
+void HAWKCAPI hawkc_context_set_resolver_cache(HawkcContext ctx, HawkcResolverCache cache);
+
+/*
+ * Create an id filter, which tells ids that have no credentials apart from
+ * those that may have before any lookup is done. Flooding a server with
+ * requests for random ids then costs a hash and one cache line read per
+ * request instead of a lookup, which may be a call to another service.
+ *
+ * The filter is a Bloom filter: it rejects about 99% of unknown ids at the
+ * default size and never rejects a known id. It is empty, rejecting all ids,
+ * until it is built with hawkc_id_filter_rebuild(). Release it with
+ * hawkc_id_filter_free().
+ */
+HawkcError HAWKCAPI hawkc_id_filter_create(HawkcContext ctx, HawkcIdFilter *filter);
+
+/*
+ * Release the filter. No thread may use it any more.
+ */
+void HAWKCAPI hawkc_id_filter_free(HawkcContext ctx, HawkcIdFilter filter);
+
+/*
+ * Replace the ids of the filter with the count ids given. Call it whenever
+ * the credentials are reloaded. Like publishing credentials, this does not
+ * block checks, and waits until no check uses the old ids anymore.
+ *
+ * bits_per_id sets the size of the filter; 0 selects the default of 10,
+ * which lets about 1% of unknown ids pass. At 20 bits per id about 0.04%
+ * pass.
+ */
+HawkcError HAWKCAPI hawkc_id_filter_rebuild(HawkcContext ctx, HawkcIdFilter filter, const unsigned char **ids, const size_t *id_lens,
+		size_t count, unsigned int bits_per_id);
+
+/*
+ * Like hawkc_id_filter_rebuild() with the ids of a set of credentials,
+ * typically before it is published.
+ */
+HawkcError HAWKCAPI hawkc_id_filter_rebuild_from_credentials(HawkcContext ctx, HawkcIdFilter filter, HawkcCredentials credentials,
+		unsigned int bits_per_id);
+
+/*
+ * Returns 1 if id may be a known id, 0 if it is not. Any number of threads
+ * may check ids at the same time.
+ */
+int HAWKCAPI hawkc_id_filter_contains(HawkcIdFilter filter, const unsigned char *id, size_t id_len);
+
+/*
+ * Count an id that passed the filter but had no credentials. Validation
+ * does this when the key resolver does not find the id; servers looking up
+ * credentials themselves call it on a miss.
+ */
+void HAWKCAPI hawkc_id_filter_false_positive(HawkcIdFilter filter);
+
+/*
+ * Get the statistics of the filter.
+ */
+void HAWKCAPI hawkc_id_filter_stats(HawkcIdFilter filter, HawkcIdFilterStats *stats);
+
+/*
+ * Check the id of parsed Authorization headers against the filter, see
+ * hawkc_parse_authorization_header(). Pass NULL to stop checking.
+ */
+void HAWKCAPI hawkc_context_set_id_filter(HawkcContext ctx, HawkcIdFilter filter);
+
 /*
  * Set the timestamp to be used in WWW-Authenticate header.
  */
@@ -337,6 +1209,18 @@ void HAWKCAPI hawkc_www_authenticate_header_set_ts(HawkcContext ctx, time_t ts);
  */
 HawkcError HAWKCAPI hawkc_parse_www_authenticate_header(HawkcContext ctx, unsigned char *value, size_t len);
 
+/*
+ * Verify the tsm of a parsed WWW-Authenticate header with the key or
+ * password and algorithm of the context. This is for client-side only.
+ *
+ * If tsm is valid, the clock offset of the context is set to the difference
+ * between ts and the context's clock, and the offset is added to the skew
+ * estimator of the context if there is one. A header without ts and tsm
+ * fails with HAWKC_ERROR, a tsm that is not canonical base64 with
+ * HAWKC_BASE64_ERROR.
+ */
+HawkcError HAWKCAPI hawkc_validate_www_authenticate_tsm(HawkcContext ctx, int *is_valid);
+
 /*
  * Caculate the buffer size necessary to store a WWW-Authenticate header value generated
  * from the current state of the context.
@@ -352,6 +1236,32 @@ HawkcError HAWKCAPI hawkc_calculate_www_authenticate_header_length(HawkcContext
  */
 HawkcError HAWKCAPI hawkc_create_www_authenticate_header(HawkcContext ctx, unsigned char* buf, size_t *len);
 
+/*
+ * Create a cache of WWW-Authenticate header values for capacity keys. A
+ * server that rejects many requests for their timestamp, for example from
+ * clients with a wrong clock, then signs its time once per second and key
+ * instead of once per request. Release it with
+ * hawkc_www_authenticate_cache_free().
+ */
+HawkcError HAWKCAPI hawkc_www_authenticate_cache_create(HawkcContext ctx, size_t capacity, HawkcWwwAuthenticateCache *cache);
+
+/*
+ * Release the cache. No thread may use it any more.
+ */
+void HAWKCAPI hawkc_www_authenticate_cache_free(HawkcContext ctx, HawkcWwwAuthenticateCache cache);
+
+/*
+ * Like hawkc_calculate_www_authenticate_header_length() followed by
+ * hawkc_create_www_authenticate_header(), but takes the header from the
+ * cache if it has been created for the same key or password and timestamp
+ * before. buf must be at least MAX_WWW_AUTHENTICATE_BYTES long. Any number
+ * of threads may use the cache at the same time.
+ *
+ * ts_hmac of the context is only set if the header was not cached.
+ */
+HawkcError HAWKCAPI hawkc_create_cached_www_authenticate_header(HawkcContext ctx, HawkcWwwAuthenticateCache cache,
+		unsigned char *buf, size_t *len);
+
 
 /** Obtain HMAC algorithm for specified name.
  *
@@ -394,8 +1304,10 @@ size_t HAWKCAPI hawkc_ttoa(unsigned char* buf, time_t value);
 
 /** The algorithms and options defined by hawkc.
  *
- * Please refer to common.c for their definition.
+ * They are defined by the crypto backend, see crypto_openssl.c.
  */
+extern HawkcAlgorithm HAWKC_SHA_512;
+extern HawkcAlgorithm HAWKC_SHA_384;
 extern HawkcAlgorithm HAWKC_SHA_256;
 extern HawkcAlgorithm HAWKC_SHA_1;
 
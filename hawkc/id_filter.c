@@ -0,0 +1,292 @@
+/*
+ * Id filter.
+ *
+ * A blocked Bloom filter of the known ids: the hash of an id selects one
+ * cache line sized block and K bits in it, so a check touches a single
+ * cache line. Compared to a plain Bloom filter of the same size the false
+ * positive rate is slightly higher, about 1% instead of 0.8% at 10 bits
+ * per id.
+ *
+ * Filters are rebuilt like the sets of a credential store are published:
+ * the new bits replace the old with an atomic pointer swap and the old bits
+ * are freed once no check uses them anymore (see hawkc_readers_drain()).
+ *
+ * The counters of the statistics are kept per reader slot, so checks of
+ * different threads do not write to the same cache line.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <string.h>
+#include <stdint.h>
+
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+
+#if !defined(__GNUC__)
+#error "The id filter requires the __atomic builtins of GCC or Clang"
+#endif
+
+#define BLOCK_BITS 512
+#define BLOCK_WORDS (BLOCK_BITS / 64)
+#define DEFAULT_BITS_PER_ID 10
+#define MAX_HASHES 16
+
+typedef struct Block {
+	uint64_t words[BLOCK_WORDS];
+} Block;
+
+typedef struct Bits {
+	uint64_t seed;
+	size_t nblocks;
+	size_t ids;
+	unsigned int k;
+	void *memory; /* allocation blocks is aligned in */
+	Block *blocks;
+} Bits;
+
+typedef struct StatSlot {
+	unsigned long checks;
+	unsigned long rejected;
+	unsigned long false_positives;
+	unsigned char pad[64 - 3 * sizeof(unsigned long)];
+} StatSlot;
+
+#if __cplusplus
+struct _HawkcIdFilter {
+#else
+struct HawkcIdFilter {
+#endif
+	HawkcReaders readers;
+	StatSlot stats[HAWKC_READER_SLOTS];
+	Bits *current;
+};
+
+/*
+ * The upper half of the id's hash selects the block.
+ */
+static size_t block_of(const Bits *bits, uint64_t h) {
+	return (size_t)(((h >> 32) * (uint64_t)bits->nblocks) >> 32);
+}
+
+static uint64_t mix64(uint64_t x) {
+	x ^= x >> 33;
+	x *= 0xff51afd7ed558ccdULL;
+	x ^= x >> 33;
+	x *= 0xc4ceb9fe1a85ec53ULL;
+	x ^= x >> 33;
+	return x;
+}
+
+/*
+ * The bit positions in the block are taken 9 bits at a time from hashes
+ * derived from the id's hash. Double hashing would be cheaper, but only
+ * yields 2^17 different sets of positions in a 512 bit block, which
+ * bounds the false positive rate at more than 12 bits per id.
+ */
+static void positions(const Bits *bits, uint64_t h, uint32_t *pos) {
+	uint64_t g = h;
+	unsigned int i;
+
+	for(i = 0; i < bits->k; i++) {
+		if(i % 7 == 0) {
+			g = mix64(g + 0x9E3779B97F4A7C15ULL);
+		}
+		pos[i] = (uint32_t)g & (BLOCK_BITS - 1);
+		g >>= 9;
+	}
+}
+
+static void bits_add(Bits *bits, const unsigned char *id, size_t id_len) {
+	uint64_t h = hawkc_hash_bytes(id,id_len,bits->seed);
+	Block *b = &(bits->blocks[block_of(bits,h)]);
+	uint32_t pos[MAX_HASHES];
+	unsigned int i;
+
+	positions(bits,h,pos);
+	for(i = 0; i < bits->k; i++) {
+		b->words[pos[i] >> 6] |= (uint64_t)1 << (pos[i] & 63);
+	}
+	bits->ids++;
+}
+
+static int bits_contain(const Bits *bits, const unsigned char *id, size_t id_len) {
+	uint64_t h = hawkc_hash_bytes(id,id_len,bits->seed);
+	const Block *b = &(bits->blocks[block_of(bits,h)]);
+	uint32_t pos[MAX_HASHES];
+	uint64_t miss = 0;
+	unsigned int i;
+
+	positions(bits,h,pos);
+	/* All K bits are tested without branching on each */
+	for(i = 0; i < bits->k; i++) {
+		miss |= ~(b->words[pos[i] >> 6] >> (pos[i] & 63)) & 1;
+	}
+	return miss == 0;
+}
+
+static void bits_free(HawkcContext ctx, Bits *bits) {
+	if(bits == NULL) {
+		return;
+	}
+	hawkc_free(ctx,bits->memory);
+	hawkc_free(ctx,bits);
+}
+
+static HawkcError bits_create(HawkcContext ctx, size_t expected, unsigned int bits_per_id, Bits **bits) {
+	HawkcError e;
+	Bits *b;
+	size_t nbits;
+
+	if(bits_per_id == 0) {
+		bits_per_id = DEFAULT_BITS_PER_ID;
+	}
+	if( (b = (Bits*)hawkc_calloc(ctx,1,sizeof(Bits))) == NULL) {
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate id filter");
+	}
+	if( (e = hawkc_random_bytes(ctx,(unsigned char*)&(b->seed),sizeof(b->seed))) != HAWKC_OK) {
+		hawkc_free(ctx,b);
+		return e;
+	}
+	/* K = bits per id * ln 2 minimizes the false positive rate */
+	b->k = (bits_per_id * 693 + 500) / 1000;
+	if(b->k == 0) {
+		b->k = 1;
+	} else if(b->k > MAX_HASHES) {
+		b->k = MAX_HASHES;
+	}
+	nbits = (expected > 0 ? expected : 1) * bits_per_id;
+	b->nblocks = (nbits + BLOCK_BITS - 1) / BLOCK_BITS;
+	if(b->nblocks > UINT32_MAX) {
+		hawkc_free(ctx,b);
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Id filter for %lu ids is too large", (unsigned long)expected);
+	}
+	if( (b->memory = hawkc_calloc(ctx,b->nblocks + 1,sizeof(Block))) == NULL) {
+		hawkc_free(ctx,b);
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate id filter for %lu ids", (unsigned long)expected);
+	}
+	b->blocks = (Block*)(((uintptr_t)b->memory + sizeof(Block) - 1) & ~(uintptr_t)(sizeof(Block) - 1));
+	*bits = b;
+	return HAWKC_OK;
+}
+
+static void publish(HawkcContext ctx, HawkcIdFilter filter, Bits *bits) {
+	Bits *old;
+
+	hawkc_readers_lock(&(filter->readers));
+	old = __atomic_exchange_n(&(filter->current),bits,__ATOMIC_SEQ_CST);
+	hawkc_readers_drain(&(filter->readers));
+
+	bits_free(ctx,old);
+}
+
+HawkcError hawkc_id_filter_create(HawkcContext ctx, HawkcIdFilter *filter) {
+	HawkcIdFilter f;
+#if __cplusplus
+	if( (f = (HawkcIdFilter)hawkc_calloc(ctx,1,sizeof(struct _HawkcIdFilter))) == NULL) {
+#else
+	if( (f = (HawkcIdFilter)hawkc_calloc(ctx,1,sizeof(struct HawkcIdFilter))) == NULL) {
+#endif
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate id filter");
+	}
+	*filter = f;
+	return HAWKC_OK;
+}
+
+void hawkc_id_filter_free(HawkcContext ctx, HawkcIdFilter filter) {
+	if(filter == NULL) {
+		return;
+	}
+	bits_free(ctx,filter->current);
+	hawkc_free(ctx,filter);
+}
+
+HawkcError hawkc_id_filter_rebuild(HawkcContext ctx, HawkcIdFilter filter, const unsigned char **ids, const size_t *id_lens,
+		size_t count, unsigned int bits_per_id) {
+	HawkcError e;
+	Bits *bits;
+	size_t i;
+
+	if( (e = bits_create(ctx,count,bits_per_id,&bits)) != HAWKC_OK) {
+		return e;
+	}
+	for(i = 0; i < count; i++) {
+		bits_add(bits,ids[i],id_lens[i]);
+	}
+	publish(ctx,filter,bits);
+	return HAWKC_OK;
+}
+
+static HawkcError add_visitor(HawkcContext ctx, const unsigned char *id, size_t id_len,
+		HawkcAlgorithm algorithm, const unsigned char *chain, void *data) {
+	bits_add((Bits*)data,id,id_len);
+	return HAWKC_OK;
+}
+
+HawkcError hawkc_id_filter_rebuild_from_credentials(HawkcContext ctx, HawkcIdFilter filter, HawkcCredentials credentials,
+		unsigned int bits_per_id) {
+	HawkcError e;
+	Bits *bits;
+
+	if( (e = bits_create(ctx,hawkc_credentials_count(credentials),bits_per_id,&bits)) != HAWKC_OK) {
+		return e;
+	}
+	if( (e = hawkc_credentials_each(ctx,credentials,add_visitor,bits)) != HAWKC_OK) {
+		bits_free(ctx,bits);
+		return e;
+	}
+	publish(ctx,filter,bits);
+	return HAWKC_OK;
+}
+
+int hawkc_id_filter_contains(HawkcIdFilter filter, const unsigned char *id, size_t id_len) {
+	unsigned int index = hawkc_reader_slot_index();
+	HawkcReaderSlot *slot = &(filter->readers.slots[index]);
+	StatSlot *stats = &(filter->stats[index]);
+	unsigned long parity = hawkc_readers_enter(&(filter->readers),slot);
+	Bits *bits = __atomic_load_n(&(filter->current),__ATOMIC_SEQ_CST);
+	int found = bits != NULL && bits_contain(bits,id,id_len);
+
+	hawkc_readers_leave(slot,parity);
+
+	/*
+	 * Threads may share a slot, relaxed atomic increments keep the counts
+	 * exact without ordering anything.
+	 */
+	__atomic_fetch_add(&(stats->checks),1,__ATOMIC_RELAXED);
+	if(!found) {
+		__atomic_fetch_add(&(stats->rejected),1,__ATOMIC_RELAXED);
+	}
+	return found;
+}
+
+void hawkc_id_filter_false_positive(HawkcIdFilter filter) {
+	__atomic_fetch_add(&(filter->stats[hawkc_reader_slot_index()].false_positives),1,__ATOMIC_RELAXED);
+}
+
+void hawkc_id_filter_stats(HawkcIdFilter filter, HawkcIdFilterStats *stats) {
+	unsigned long parity;
+	HawkcReaderSlot *slot;
+	Bits *bits;
+	int i;
+
+	memset(stats,0,sizeof(*stats));
+	for(i = 0; i < HAWKC_READER_SLOTS; i++) {
+		stats->checks += __atomic_load_n(&(filter->stats[i].checks),__ATOMIC_RELAXED);
+		stats->rejected += __atomic_load_n(&(filter->stats[i].rejected),__ATOMIC_RELAXED);
+		stats->false_positives += __atomic_load_n(&(filter->stats[i].false_positives),__ATOMIC_RELAXED);
+	}
+	slot = &(filter->readers.slots[hawkc_reader_slot_index()]);
+	parity = hawkc_readers_enter(&(filter->readers),slot);
+	if( (bits = __atomic_load_n(&(filter->current),__ATOMIC_SEQ_CST)) != NULL) {
+		stats->ids = bits->ids;
+		stats->size = bits->nblocks * sizeof(Block);
+	}
+	hawkc_readers_leave(slot,parity);
+}
+
+void hawkc_context_set_id_filter(HawkcContext ctx, HawkcIdFilter filter) {
+	ctx->id_filter = filter;
+}
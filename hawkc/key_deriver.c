@@ -0,0 +1,280 @@
+/*
+ * Key derivation from a master secret.
+ *
+ * The password of an id is the base64url encoded HMAC of the id keyed with
+ * the master secret, so no credentials need to be stored per id. Deriving
+ * a key costs two HMAC key setups and one HMAC, a few compression function
+ * calls, which the caches avoid for ids that send several requests.
+ *
+ * Every reader slot (see hawkc_reader_slot_index()) has its own LRU cache
+ * of derived keys. Threads are assigned their own slot as long as there
+ * are no more threads than slots, so the slot's lock is not contended. A
+ * thread that finds the lock taken derives the key without the cache
+ * instead of waiting.
+ *
+ * A cache is a chained hash table of its entries, which also form a doubly
+ * linked list in order of use. Entries are referenced by index, NIL ends
+ * lists. Only the chaining values of the derived key are cached.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <string.h>
+#include <stdint.h>
+
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+#include "base64url.h"
+
+#if !defined(__GNUC__)
+#error "The key deriver requires the __atomic builtins of GCC or Clang"
+#endif
+
+#define NIL UINT32_MAX
+
+/*
+ * Longer ids are derived on every request.
+ */
+#define MAX_CACHED_ID 64
+
+typedef struct CacheEntry {
+	uint64_t hash;
+	uint32_t prev;
+	uint32_t next;
+	uint32_t chain;
+	uint32_t id_len;
+	unsigned char id[MAX_CACHED_ID];
+	unsigned char data[2 * MAX_DIGEST_CHAIN_BYTES];
+} CacheEntry;
+
+typedef struct Cache {
+	int locked;
+	uint32_t used;
+	uint32_t head; /* most recently used */
+	uint32_t tail; /* least recently used */
+	uint32_t *buckets;
+	CacheEntry *entries;
+	unsigned char pad[64 - sizeof(int) - 3 * sizeof(uint32_t) - sizeof(uint32_t*) - sizeof(CacheEntry*)];
+} Cache;
+
+#if __cplusplus
+struct _HawkcKeyDeriver {
+#else
+struct HawkcKeyDeriver {
+#endif
+	Cache caches[HAWKC_READER_SLOTS];
+#if __cplusplus
+	struct _HawkcKey master;
+#else
+	struct HawkcKey master;
+#endif
+	HawkcAlgorithm algorithm;
+	uint64_t seed;
+	uint32_t capacity;
+	uint32_t mask;
+};
+
+static HawkcError derive(HawkcContext ctx, HawkcKeyDeriver deriver, const unsigned char *id, size_t id_len,
+		unsigned char *password, size_t *password_len) {
+	HawkcError e;
+	HawkcHmacCtx hmac;
+	unsigned char digest[MAX_HMAC_BYTES];
+	size_t digest_len;
+
+	if( (e = hawkc_hmac_init(ctx,&hmac,&(deriver->master))) != HAWKC_OK) {
+		return e;
+	}
+	hawkc_hmac_update(&hmac,id,id_len);
+	hawkc_hmac_final_raw(&hmac,digest,&digest_len);
+	hawkc_base64url_encode(digest,digest_len,password,password_len);
+	hawkc_cleanse(digest,sizeof(digest));
+	return HAWKC_OK;
+}
+
+static HawkcError derive_key(HawkcContext ctx, HawkcKeyDeriver deriver, const unsigned char *id, size_t id_len, HawkcKey key) {
+	HawkcError e;
+	unsigned char password[MAX_HMAC_BYTES_B64];
+	size_t password_len;
+
+	if( (e = derive(ctx,deriver,id,id_len,password,&password_len)) != HAWKC_OK) {
+		return e;
+	}
+	e = hawkc_key_init(ctx,key,deriver->algorithm,password,password_len);
+	hawkc_cleanse(password,sizeof(password));
+	return e;
+}
+
+static void unlink_entry(Cache *c, uint32_t i) {
+	CacheEntry *x = &(c->entries[i]);
+	if(x->prev != NIL) {
+		c->entries[x->prev].next = x->next;
+	} else {
+		c->head = x->next;
+	}
+	if(x->next != NIL) {
+		c->entries[x->next].prev = x->prev;
+	} else {
+		c->tail = x->prev;
+	}
+}
+
+static void push_front(Cache *c, uint32_t i) {
+	CacheEntry *x = &(c->entries[i]);
+	x->prev = NIL;
+	x->next = c->head;
+	if(c->head != NIL) {
+		c->entries[c->head].prev = i;
+	} else {
+		c->tail = i;
+	}
+	c->head = i;
+}
+
+static void remove_from_bucket(Cache *c, uint32_t *bucket, uint32_t i) {
+	while(*bucket != i) {
+		bucket = &(c->entries[*bucket].chain);
+	}
+	*bucket = c->entries[i].chain;
+}
+
+static HawkcError cache_init(HawkcContext ctx, HawkcKeyDeriver deriver, Cache *c) {
+	if( (c->buckets = (uint32_t*)hawkc_malloc(ctx,(deriver->mask + 1) * sizeof(uint32_t))) == NULL
+			|| (c->entries = (CacheEntry*)hawkc_malloc(ctx,deriver->capacity * sizeof(CacheEntry))) == NULL) {
+		hawkc_free(ctx,c->buckets);
+		c->buckets = NULL;
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate key cache of %lu entries", (unsigned long)deriver->capacity);
+	}
+	memset(c->buckets,0xff,(deriver->mask + 1) * sizeof(uint32_t));
+	c->used = 0;
+	c->head = NIL;
+	c->tail = NIL;
+	return HAWKC_OK;
+}
+
+/*
+ * Look up id in the locked cache, deriving and inserting its key on a miss.
+ */
+static HawkcError cache_lookup(HawkcContext ctx, HawkcKeyDeriver deriver, Cache *c,
+		const unsigned char *id, size_t id_len, HawkcKey key) {
+	HawkcError e;
+	uint64_t h = hawkc_hash_bytes(id,id_len,deriver->seed);
+	uint32_t *bucket = &(c->buckets[h & deriver->mask]);
+	uint32_t i;
+	CacheEntry *x;
+
+	for(i = *bucket; i != NIL; i = c->entries[i].chain) {
+		x = &(c->entries[i]);
+		if(x->hash == h && x->id_len == id_len && memcmp(x->id,id,id_len) == 0) {
+			if(c->head != i) {
+				unlink_entry(c,i);
+				push_front(c,i);
+			}
+			hawkc_key_import(key,deriver->algorithm,x->data);
+			return HAWKC_OK;
+		}
+	}
+
+	if( (e = derive_key(ctx,deriver,id,id_len,key)) != HAWKC_OK) {
+		return e;
+	}
+	if(c->used < deriver->capacity) {
+		i = c->used++;
+	} else {
+		i = c->tail;
+		unlink_entry(c,i);
+		remove_from_bucket(c,&(c->buckets[c->entries[i].hash & deriver->mask]),i);
+	}
+	x = &(c->entries[i]);
+	x->hash = h;
+	x->id_len = (uint32_t)id_len;
+	memcpy(x->id,id,id_len);
+	hawkc_key_export(key,x->data);
+	x->chain = *bucket;
+	*bucket = i;
+	push_front(c,i);
+	return HAWKC_OK;
+}
+
+HawkcError hawkc_key_deriver_create(HawkcContext ctx, HawkcAlgorithm algorithm, const unsigned char *master, size_t master_len,
+		size_t cache_size, HawkcKeyDeriver *deriver) {
+	HawkcError e;
+	HawkcKeyDeriver d;
+	uint32_t nbuckets = 1;
+
+	if(cache_size > UINT32_MAX / 2) {
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Key cache of %lu entries is too large", (unsigned long)cache_size);
+	}
+#if __cplusplus
+	if( (d = (HawkcKeyDeriver)hawkc_calloc(ctx,1,sizeof(struct _HawkcKeyDeriver))) == NULL) {
+#else
+	if( (d = (HawkcKeyDeriver)hawkc_calloc(ctx,1,sizeof(struct HawkcKeyDeriver))) == NULL) {
+#endif
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate key deriver");
+	}
+	if( (e = hawkc_key_init(ctx,&(d->master),algorithm,master,master_len)) != HAWKC_OK
+			|| (e = hawkc_random_bytes(ctx,(unsigned char*)&(d->seed),sizeof(d->seed))) != HAWKC_OK) {
+		hawkc_key_deriver_free(ctx,d);
+		return e;
+	}
+	while(nbuckets < cache_size) {
+		nbuckets *= 2;
+	}
+	d->algorithm = algorithm;
+	d->capacity = (uint32_t)cache_size;
+	d->mask = nbuckets - 1;
+	*deriver = d;
+	return HAWKC_OK;
+}
+
+void hawkc_key_deriver_free(HawkcContext ctx, HawkcKeyDeriver deriver) {
+	int i;
+	if(deriver == NULL) {
+		return;
+	}
+	for(i = 0; i < HAWKC_READER_SLOTS; i++) {
+		Cache *c = &(deriver->caches[i]);
+		if(c->entries != NULL) {
+			/* Do not leave the key material behind in freed memory */
+			hawkc_cleanse(c->entries,c->used * sizeof(CacheEntry));
+		}
+		hawkc_free(ctx,c->entries);
+		hawkc_free(ctx,c->buckets);
+	}
+	hawkc_cleanse(&(deriver->master),sizeof(deriver->master));
+	hawkc_free(ctx,deriver);
+}
+
+HawkcError hawkc_key_deriver_password(HawkcContext ctx, HawkcKeyDeriver deriver, const unsigned char *id, size_t id_len,
+		unsigned char *password, size_t *password_len) {
+	return derive(ctx,deriver,id,id_len,password,password_len);
+}
+
+HawkcError hawkc_key_deriver_lookup(HawkcContext ctx, HawkcKeyDeriver deriver, const unsigned char *id, size_t id_len, HawkcKey key) {
+	HawkcError e;
+	Cache *c;
+
+	if(deriver->capacity == 0 || id_len > MAX_CACHED_ID) {
+		return derive_key(ctx,deriver,id,id_len,key);
+	}
+	c = &(deriver->caches[hawkc_reader_slot_index()]);
+	if(__atomic_exchange_n(&(c->locked),1,__ATOMIC_ACQUIRE)) {
+		return derive_key(ctx,deriver,id,id_len,key);
+	}
+	if(c->entries == NULL && (e = cache_init(ctx,deriver,c)) != HAWKC_OK) {
+		__atomic_store_n(&(c->locked),0,__ATOMIC_RELEASE);
+		return e;
+	}
+	e = cache_lookup(ctx,deriver,c,id,id_len,key);
+	__atomic_store_n(&(c->locked),0,__ATOMIC_RELEASE);
+	return e;
+}
+
+static HawkcError deriver_resolver(HawkcContext ctx, const unsigned char *id, size_t id_len, HawkcKey key, void *data) {
+	return hawkc_key_deriver_lookup(ctx,(HawkcKeyDeriver)data,id,id_len,key);
+}
+
+void hawkc_context_set_key_deriver(HawkcContext ctx, HawkcKeyDeriver deriver) {
+	hawkc_context_set_key_resolver(ctx,deriver != NULL ? deriver_resolver : NULL,deriver);
+}
@@ -0,0 +1,208 @@
+/*
+ * Nonce generation.
+ *
+ * Asking the system or OpenSSL for six random bytes per signed request
+ * costs a system call or a lock on OpenSSL's shared DRBG every time.
+ * Instead every thread keeps a ChaCha20 based DRBG that is seeded with 32
+ * bytes from the crypto backend (hawkc_random_bytes()) and produces nonce
+ * bytes into a pool of POOL_BYTES, from which nonces are taken.
+ *
+ * Each refill uses the first 32 bytes of the new output as the next key
+ * and erases them ("fast key erasure"), so the current state does not
+ * reveal earlier output. The DRBG is reseeded after RESEED_REFILLS refills
+ * and in a child process after fork(), which would otherwise repeat the
+ * nonces of its parent.
+ *
+ * Without compiler support for thread-local storage every nonce is taken
+ * from hawkc_random_bytes() directly.
+ */
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+
+#ifdef HAVE_PTHREAD_ATFORK
+#include <pthread.h>
+#else
+#include <unistd.h>
+#endif
+
+#define CHACHA20_BLOCK_BYTES 64
+#define CHACHA20_KEY_BYTES 32
+
+/*
+ * Output produced per refill. The first CHACHA20_KEY_BYTES become the
+ * next key, the remainder is handed out as nonce bytes.
+ */
+#define POOL_BLOCKS 16
+#define POOL_BYTES (POOL_BLOCKS * CHACHA20_BLOCK_BYTES)
+
+/*
+ * Number of refills after which the DRBG is reseeded, about 1 MB of output.
+ */
+#define RESEED_REFILLS 1024
+
+#define ROTL32(v,n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QUARTER_ROUND(a,b,c,d) do { \
+	a += b; d ^= a; d = ROTL32(d,16); \
+	c += d; b ^= c; b = ROTL32(b,12); \
+	a += b; d ^= a; d = ROTL32(d,8); \
+	c += d; b ^= c; b = ROTL32(b,7); \
+} while(0)
+
+static uint32_t load32_le(const unsigned char *p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void store32_le(unsigned char *p, uint32_t v) {
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16);
+	p[3] = (unsigned char)(v >> 24);
+}
+
+void hawkc_chacha20_block(const unsigned char *key, unsigned long counter, const unsigned char *nonce, unsigned char *out) {
+	uint32_t s[16];
+	uint32_t x[16];
+	int i;
+
+	s[0] = 0x61707865; s[1] = 0x3320646e; s[2] = 0x79622d32; s[3] = 0x6b206574;
+	for(i = 0; i < 8; i++) {
+		s[4 + i] = load32_le(key + 4 * i);
+	}
+	s[12] = (uint32_t)counter;
+	for(i = 0; i < 3; i++) {
+		s[13 + i] = load32_le(nonce + 4 * i);
+	}
+	memcpy(x,s,sizeof(x));
+
+	for(i = 0; i < 10; i++) {
+		QUARTER_ROUND(x[0],x[4],x[8],x[12]);
+		QUARTER_ROUND(x[1],x[5],x[9],x[13]);
+		QUARTER_ROUND(x[2],x[6],x[10],x[14]);
+		QUARTER_ROUND(x[3],x[7],x[11],x[15]);
+		QUARTER_ROUND(x[0],x[5],x[10],x[15]);
+		QUARTER_ROUND(x[1],x[6],x[11],x[12]);
+		QUARTER_ROUND(x[2],x[7],x[8],x[13]);
+		QUARTER_ROUND(x[3],x[4],x[9],x[14]);
+	}
+
+	for(i = 0; i < 16; i++) {
+		store32_le(out + 4 * i,x[i] + s[i]);
+	}
+}
+
+#ifdef HAVE_THREAD_LOCAL
+
+/*
+ * Per-thread DRBG state. generation records the fork generation at
+ * seeding time, 0 means not seeded.
+ */
+typedef struct NoncePool {
+	unsigned char key[CHACHA20_KEY_BYTES];
+	unsigned char buf[POOL_BYTES];
+	size_t pos;
+	unsigned long refills;
+	unsigned long generation;
+} NoncePool;
+
+static __thread NoncePool pool;
+
+/*
+ * Fork detection. With pthread_atfork() the child handler bumps a
+ * generation counter, which only costs a comparison per nonce. Otherwise
+ * the process id serves as generation.
+ */
+#ifdef HAVE_PTHREAD_ATFORK
+static unsigned long fork_generation = 1;
+static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+
+static void atfork_child(void) {
+	fork_generation++;
+}
+
+static void register_atfork(void) {
+	pthread_atfork(NULL,NULL,atfork_child);
+}
+
+static unsigned long current_generation(void) {
+	pthread_once(&atfork_once,register_atfork);
+	return fork_generation;
+}
+#else
+static unsigned long current_generation(void) {
+	return (unsigned long)getpid();
+}
+#endif
+
+static void refill(NoncePool *p) {
+	static const unsigned char zero_nonce[12] = { 0 };
+	int i;
+
+	for(i = 0; i < POOL_BLOCKS; i++) {
+		hawkc_chacha20_block(p->key,(unsigned long)i,zero_nonce,p->buf + i * CHACHA20_BLOCK_BYTES);
+	}
+	memcpy(p->key,p->buf,CHACHA20_KEY_BYTES);
+	memset(p->buf,0,CHACHA20_KEY_BYTES);
+	p->pos = CHACHA20_KEY_BYTES;
+	p->refills++;
+}
+
+static HawkcError reseed(HawkcContext ctx, NoncePool *p, unsigned long generation) {
+	HawkcError e;
+	if( (e = hawkc_random_bytes(ctx,p->key,CHACHA20_KEY_BYTES)) != HAWKC_OK) {
+		return e;
+	}
+	p->generation = generation;
+	p->refills = 0;
+	refill(p);
+	return HAWKC_OK;
+}
+
+HawkcError hawkc_generate_nonce(HawkcContext ctx, size_t nbytes, unsigned char *buf) {
+	HawkcError e;
+	NoncePool *p = &pool;
+	unsigned long generation;
+	assert(nbytes <= MAX_NONCE_BYTES);
+
+	generation = current_generation();
+	if(p->generation != generation) {
+		if( (e = reseed(ctx,p,generation)) != HAWKC_OK) {
+			return e;
+		}
+	} else if(p->pos + nbytes > POOL_BYTES) {
+		if(p->refills >= RESEED_REFILLS) {
+			if( (e = reseed(ctx,p,generation)) != HAWKC_OK) {
+				return e;
+			}
+		} else {
+			refill(p);
+		}
+	}
+	hawkc_bytes_to_hex(p->buf + p->pos, nbytes, buf);
+	p->pos += nbytes;
+
+	return HAWKC_OK;
+}
+
+#else /* !HAVE_THREAD_LOCAL */
+
+HawkcError hawkc_generate_nonce(HawkcContext ctx, size_t nbytes, unsigned char *buf) {
+	HawkcError e;
+	unsigned char nonce_bytes[MAX_NONCE_BYTES];
+	assert(nbytes <= MAX_NONCE_BYTES);
+
+	if( (e = hawkc_random_bytes(ctx,nonce_bytes,nbytes)) != HAWKC_OK) {
+		return e;
+	}
+	hawkc_bytes_to_hex(nonce_bytes, nbytes, buf);
+
+	return HAWKC_OK;
+}
+
+#endif /* HAVE_THREAD_LOCAL */
@@ -4,21 +4,11 @@
 #include <ctype.h>
 #include "hawkc.h"
 #include "common.h"
+#include "scan.h"
 
 #define DQUOTE '"';
 #define BACKSLASH '\\';
 
-/*
- * Determine whether a given character is a token character according to
- * http://tools.ietf.org/html/draft-ietf-httpbis-p1-messaging#section-3.2.6
- */
-#define IS_TOKEN(c) ( \
-	   ( (c) >= '0' && (c) <= '9') \
-	|| ( (c) >= 'A' && (c) <= 'Z') \
-	|| ( (c) >= '^' && (c) <= 'z') \
-	|| ( (c) >= '#' && (c) <= '\'') \
-	|| ( (c) == '!') || ((c) == '*') || ((c) == '+') || ((c) == '-') || ((c) == '.') )
-
 /*
  * Determine whether a given character is a space character according to
  * http://tools.ietf.org/html/draft-ietf-httpbis-p1-messaging#section-3.2.6
@@ -44,20 +34,14 @@ static void consume_ows(HawkcContext ctx, unsigned char *s, size_t len, size_t *
   * http://tools.ietf.org/html/draft-ietf-httpbis-p1-messaging#section-3.2.6
   */
 static HawkcError parse_token(HawkcContext ctx, unsigned char *s, size_t len, HawkcString *ptoken, size_t *n) {
-	unsigned char *p = s;
-	size_t i = 0;
+	size_t i = hawkc_scan_token(s,len);
 	ptoken->data = s;
-	ptoken->len = 0;
+	ptoken->len = i;
+	*n = i;
 
-	while(i < len && IS_TOKEN(*p) ) {
-		i++;
-		p++;
-	}
 	if(i == 0) {
 		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Token must have at least one character");
 	}
-	*n = i;
-	ptoken->len = i;
 	return HAWKC_OK;
 }
 
@@ -71,12 +55,16 @@ static HawkcError parse_token(HawkcContext ctx, unsigned char *s, size_t len, Ha
  * to contain he said: \"Wow!\".
  *
  * Removing the quotes would make it necessary to make a copy
- * of the parsed string and we want to avoid that.
+ * of the parsed string and we want to avoid that. escaped is set if
+ * the string contains escapes, so callers that need the unescaped
+ * value only copy those that do.
  */
-static HawkcError parse_quoted_text(HawkcContext ctx, unsigned char *s, size_t len, HawkcString *ptoken, size_t *n) {
+static HawkcError parse_quoted_text(HawkcContext ctx, unsigned char *s, size_t len, HawkcString *ptoken, size_t *n, int *escaped) {
 	unsigned char *p = s;
 	size_t i = 0;
 
+	*escaped = 0;
+
 	if(len == 0 || *p != '"') {
 		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Quoted text must start with '\"'");
 	}
@@ -88,25 +76,25 @@ static HawkcError parse_quoted_text(HawkcContext ctx, unsigned char *s, size_t l
 	ptoken->len = 0;
 
 	/*
-	 * Consume tokens as long as we have some
+	 * Skip to the next " or \ as long as we have some text.
 	 */
-	while(i < len && *p != '"') {
+	while(i < len) {
+		i += hawkc_scan_quoted(p,len - i);
+		p = s + i;
+		if(i == len || *p == '"') {
+			break;
+		}
 		/*
 		 * Consume escaped token, make sure there is
 		 * a token following the \ which we will blindly
 		 * just consume.
 		 */
-		if(*p == '\\') {
-			if(i+1 == len) {
-				return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "\\ at end of text");
-			}
-			p++;
-			i++;
-			ptoken->len++;
+		if(i+1 == len) {
+			return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "\\ at end of text");
 		}
-		p++;
-		i++;
-		ptoken->len++;
+		*escaped = 1;
+		p += 2;
+		i += 2;
 	}
 	/*
 	 * There must be a token left (which will be ", given the while condition above).
@@ -115,8 +103,9 @@ static HawkcError parse_quoted_text(HawkcContext ctx, unsigned char *s, size_t l
 		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Quoted text must end with '\"'");
 	}
 
+	ptoken->len = i - 1;
+
 	/* consume ending " */
-	p++;
 	i++;
 
 	*n = i;
@@ -126,6 +115,105 @@ static HawkcError parse_quoted_text(HawkcContext ctx, unsigned char *s, size_t l
 
 
 
+/*
+ * Parse the scheme token and the optional whitespace after it from
+ * the header at *p with *remain bytes, advancing both.
+ */
+static HawkcError parse_scheme(HawkcContext ctx, unsigned char **p, size_t *remain, HawkcString *scheme) {
+	HawkcError e;
+	size_t n;
+
+	if( (e = parse_token(ctx,*p,*remain,scheme,&n)) != HAWKC_OK) {
+		return e;
+	}
+	*p += n;
+	*remain -= n;
+
+	consume_ows(ctx,*p,*remain,&n);
+	*p += n;
+	*remain -= n;
+	return HAWKC_OK;
+}
+
+/*
+ * Parse one key=value or key="value" pair and the optional whitespace
+ * after it, advancing *p and *remain. token68 syntax is not supported.
+ * escaped is set if value is a quoted string with escapes.
+ */
+static HawkcError parse_param(HawkcContext ctx, unsigned char **p, size_t *remain, HawkcString *key, HawkcString *value, int *escaped) {
+	HawkcError e;
+	size_t n;
+
+	*escaped = 0;
+
+	if( (e = parse_token(ctx,*p,*remain,key,&n)) != HAWKC_OK) {
+		return e;
+	}
+	*p += n;
+	*remain -= n;
+
+	/* There can be optional WS after key-token */
+	consume_ows(ctx,*p,*remain,&n);
+	*p += n;
+	*remain -= n;
+
+	/* There must be a = now */
+	if(*remain == 0 || **p != '=') {
+		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Missing '=' for parameter value");
+	}
+	/* consume '=' */
+	(*p)++;
+	(*remain)--;
+
+	/* There can be optional WS between = and value */
+	consume_ows(ctx,*p,*remain,&n);
+	*p += n;
+	*remain -= n;
+
+	/*
+	 *  Use first char of value to determine whether to consume
+	 * quoted string or token.
+	 */
+	if(*remain > 0 && **p == '"') {
+		e = parse_quoted_text(ctx,*p,*remain,value,&n,escaped);
+	} else {
+		e = parse_token(ctx,*p,*remain,value,&n);
+	}
+	if(e != HAWKC_OK) {
+		return e;
+	}
+	*p += n;
+	*remain -= n;
+
+	/* There can be optional WS after key/value pair */
+	consume_ows(ctx,*p,*remain,&n);
+	*p += n;
+	*remain -= n;
+	return HAWKC_OK;
+}
+
+/*
+ * If there is more to parse, consume the ',' delimiter and the optional
+ * whitespace after it.
+ */
+static HawkcError parse_delimiter(HawkcContext ctx, unsigned char **p, size_t *remain) {
+	size_t n;
+
+	if(*remain == 0) {
+		return HAWKC_OK;
+	}
+	if(**p != ',') {
+		/* Delimiter must be , */
+		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "',' required after parameter value");
+	}
+	(*p)++;
+	(*remain)--;
+	consume_ows(ctx,*p,*remain,&n);
+	*p += n;
+	*remain -= n;
+	return HAWKC_OK;
+}
+
 /*
  * See common.h for docs.
  */
@@ -133,111 +221,554 @@ HawkcError hawkc_parse_auth_header(HawkcContext ctx, unsigned char *value, size_
 	HawkcError e;
 	unsigned char *p = value;
 	size_t remain = len;
-	size_t n;
 	HawkcString scheme;
 
-	/*
-	 * Parse scheme part.
-	 */
-	if( (e = parse_token(ctx,p,len,&scheme,&n)) != HAWKC_OK) {
+	if( (e = parse_scheme(ctx,&p,&remain,&scheme)) != HAWKC_OK) {
 		return e;
 	}
-	p += n;
-	remain -= n;
-
 	if( (e = scheme_handler(ctx,scheme,data)) != HAWKC_OK) {
 			return e;
 	}
 
-	consume_ows(ctx,p,remain,&n);
-	p += n;
-	remain -= n;
-	if(remain <= 0) {
-		/* Scheme-only is ok */
-		return HAWKC_OK;
-	}
-
 	/*
 	 * While we have more to parse, consume key/value pairs.
-	 * token68 syntax is not supported. We always expect
-	 * key=value or key="value".
+	 * Scheme-only is ok.
 	 */
 	while(remain > 0) {
 		HawkcString key, value;
-		if( (e = parse_token(ctx,p,remain,&key,&n)) != HAWKC_OK) {
+		int escaped;
+		if( (e = parse_param(ctx,&p,&remain,&key,&value,&escaped)) != HAWKC_OK) {
+			return e;
+		}
+		/* Now pass key and value to callback */
+		if( (e = param_handler(ctx,key,value,data)) != HAWKC_OK) {
+				return e;
+		}
+		if( (e = parse_delimiter(ctx,&p,&remain)) != HAWKC_OK) {
 			return e;
 		}
-		p += n;
-		remain -= n;
+	}
+	return HAWKC_OK;
+}
 
-		/* There can be optional WS after key-token */
-		consume_ows(ctx,p,remain,&n);
-		p += n;
-		remain -= n;
+/*
+ * Hawk parameters by key length and first character.
+ */
+#define PARAM(len,c) (((len) << 8) | (c))
 
-		/* There must be a = now */
-		if(*p != '=') {
-			return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Missing '=' for parameter value");
+/*
+ * Bits of the parameters seen so far, for detecting duplicates.
+ */
+#define SEEN_ID 0x01
+#define SEEN_MAC 0x02
+#define SEEN_HASH 0x04
+#define SEEN_NONCE 0x08
+#define SEEN_TS 0x10
+#define SEEN_EXT 0x20
+#define SEEN_APP 0x40
+#define SEEN_DLG 0x80
+#define SEEN_TSM 0x100
+
+static HawkcError check_hawk_scheme(HawkcContext ctx, HawkcString scheme) {
+	if((scheme.len != 4) || memcmp(scheme.data,"Hawk",4) != 0) {
+		return hawkc_set_error(ctx,
+					HAWKC_BAD_SCHEME_ERROR, "Unsupported authentication scheme '%.*s'" , (int)scheme.len,scheme.data);
+	}
+	return HAWKC_OK;
+}
+
+/*
+ * Mark the parameter key as seen, fail if it has been seen before.
+ */
+static HawkcError see_param(HawkcContext ctx, HawkcString key, unsigned int bit, unsigned int *seen) {
+	if(*seen & bit) {
+		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Duplicate parameter '%.*s'", (int)key.len, key.data);
+	}
+	*seen |= bit;
+	return HAWKC_OK;
+}
+
+/*
+ * Replace the quoted string value by its unescaped form, appended to the
+ * context's unescape buffer. The parser has made sure that every \ is
+ * followed by a character and that the only " are escaped ones, so the
+ * runs between escapes end at the next \.
+ */
+static HawkcError unescape(HawkcContext ctx, HawkcString *value) {
+	unsigned char *dst = ctx->unescape_buffer + ctx->unescape_len;
+	size_t avail = MAX_UNESCAPED_BYTES - ctx->unescape_len;
+	size_t i = 0, n = 0, run;
+
+	while(i < value->len) {
+		run = hawkc_scan_quoted(value->data + i,value->len - i);
+		/* The run and the escaped character, if there is one */
+		if(n + run + (i + run < value->len) > avail) {
+			return hawkc_set_error(ctx, HAWKC_REQUIRED_BUFFER_TOO_LARGE,
+					"Escaped values longer than %d bytes", MAX_UNESCAPED_BYTES);
 		}
-		/* consume '=' */
-		p++;
-		remain--;
+		memcpy(dst + n,value->data + i,run);
+		n += run;
+		i += run;
+		if(i < value->len) {
+			dst[n++] = value->data[i + 1];
+			i += 2;
+		}
+	}
+	ctx->unescape_len += n;
+	value->data = dst;
+	value->len = n;
+	return HAWKC_OK;
+}
 
+/*
+ * Return the bit of an Authorization header parameter and the field it is
+ * stored in, or 0 for unknown parameters. ts has no HawkcString field.
+ */
+static unsigned int authorization_param(HawkcString key, AuthorizationHeader h, HawkcString **field) {
+	const unsigned char *k = key.data;
+
+	switch(PARAM(key.len,k[0])) {
+	case PARAM(2,'i'):
+		*field = &(h->id);
+		return k[1] == 'd' ? SEEN_ID : 0;
+	case PARAM(2,'t'):
+		*field = NULL;
+		return k[1] == 's' ? SEEN_TS : 0;
+	case PARAM(3,'m'):
+		*field = &(h->mac);
+		return !memcmp(k + 1,"ac",2) ? SEEN_MAC : 0;
+	case PARAM(3,'e'):
+		*field = &(h->ext);
+		return !memcmp(k + 1,"xt",2) ? SEEN_EXT : 0;
+	case PARAM(3,'a'):
+		*field = &(h->app);
+		return !memcmp(k + 1,"pp",2) ? SEEN_APP : 0;
+	case PARAM(3,'d'):
+		*field = &(h->dlg);
+		return !memcmp(k + 1,"lg",2) ? SEEN_DLG : 0;
+	case PARAM(4,'h'):
+		*field = &(h->hash);
+		return !memcmp(k + 1,"ash",3) ? SEEN_HASH : 0;
+	case PARAM(5,'n'):
+		*field = &(h->nonce);
+		return !memcmp(k + 1,"once",4) ? SEEN_NONCE : 0;
+	default:
+		return 0;
+	}
+}
 
-		/* There can be optional WS between = and value */
-		consume_ows(ctx,p,remain,&n);
-		p += n;
-		remain -= n;
+/*
+ * See common.h for docs.
+ */
+HawkcError hawkc_parse_hawk_authorization_header(HawkcContext ctx, unsigned char *value, size_t len, AuthorizationHeader h) {
+	HawkcError e;
+	unsigned char *p = value;
+	size_t remain = len;
+	unsigned int seen = 0, bit;
+	HawkcString scheme, key, v, *field;
+	int escaped;
 
-		/*
-		 *  Use first char of value to determine whether to consume
-		 * quoted string or token.
-		 */
-		if(*p == '"') {
-			if( (e = parse_quoted_text(ctx,p,remain,&value,&n)) != HAWKC_OK) {
-					return e;
+	if( (e = parse_scheme(ctx,&p,&remain,&scheme)) != HAWKC_OK) {
+		return e;
+	}
+	if( (e = check_hawk_scheme(ctx,scheme)) != HAWKC_OK) {
+		return e;
+	}
+	ctx->unescape_len = 0;
+	while(remain > 0) {
+		if( (e = parse_param(ctx,&p,&remain,&key,&v,&escaped)) != HAWKC_OK) {
+			return e;
+		}
+		/* Unknown parameters are ignored */
+		if( (bit = authorization_param(key,h,&field)) != 0) {
+			if( (e = see_param(ctx,key,bit,&seen)) != HAWKC_OK) {
+				return e;
 			}
-			p += n;
-			remain -= n;
-		} else {
-			if( (e = parse_token(ctx,p,remain,&value,&n)) != HAWKC_OK) {
-					return e;
+			if(escaped && (e = unescape(ctx,&v)) != HAWKC_OK) {
+				return e;
+			}
+			if(field != NULL) {
+				*field = v;
+			} else if( (e = hawkc_parse_time(ctx,v,&(h->ts))) != HAWKC_OK) {
+				return e;
 			}
-			p += n;
-			remain -= n;
 		}
+		if( (e = parse_delimiter(ctx,&p,&remain)) != HAWKC_OK) {
+			return e;
+		}
+	}
+	return HAWKC_OK;
+}
 
-		/* There can be optional WS after key/value pair */
-		consume_ows(ctx,p,remain,&n);
-		p += n;
-		remain -= n;
+/*
+ * See common.h for docs.
+ */
+HawkcError hawkc_parse_hawk_www_authenticate_header(HawkcContext ctx, unsigned char *value, size_t len, WwwAuthenticateHeader h) {
+	HawkcError e;
+	unsigned char *p = value;
+	size_t remain = len;
+	unsigned int seen = 0;
+	HawkcString scheme, key, v;
+	int escaped;
 
-		/* Now pass key and value to callback */
-		if( (e = param_handler(ctx,key,value,data)) != HAWKC_OK) {
-				return e;
+	if( (e = parse_scheme(ctx,&p,&remain,&scheme)) != HAWKC_OK) {
+		return e;
+	}
+	if( (e = check_hawk_scheme(ctx,scheme)) != HAWKC_OK) {
+		return e;
+	}
+	ctx->unescape_len = 0;
+	while(remain > 0) {
+		if( (e = parse_param(ctx,&p,&remain,&key,&v,&escaped)) != HAWKC_OK) {
+			return e;
 		}
-
-		/* If we have more, consume delimiter and optional WS */
-		if(remain > 0) {
-			if(*p == ',') {
-				p++;
-				remain--;
-				consume_ows(ctx,p,remain,&n);
-				p += n;
-				remain -= n;
-			} else {
-				/* Delimiter must be , */
-				return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "',' required after parameter value");
+		/* Unknown parameters, such as error, are ignored */
+		if(key.len == 3 && !memcmp(key.data,"tsm",3)) {
+			if( (e = see_param(ctx,key,SEEN_TSM,&seen)) != HAWKC_OK
+					|| (escaped && (e = unescape(ctx,&v)) != HAWKC_OK)) {
+				return e;
+			}
+			h->tsm = v;
+		} else if(key.len == 2 && !memcmp(key.data,"ts",2)) {
+			if( (e = see_param(ctx,key,SEEN_TS,&seen)) != HAWKC_OK
+					|| (escaped && (e = unescape(ctx,&v)) != HAWKC_OK)
+					|| (e = hawkc_parse_time(ctx,v,&(h->ts))) != HAWKC_OK) {
+				return e;
 			}
 		}
+		if( (e = parse_delimiter(ctx,&p,&remain)) != HAWKC_OK) {
+			return e;
+		}
 	}
 	return HAWKC_OK;
 }
 
+/*
+ * States of the incremental parser, named after what it expects next.
+ */
+enum {
+	FEED_SCHEME,
+	FEED_KEY_START,
+	FEED_KEY,
+	FEED_EQUALS,
+	FEED_VALUE_START,
+	FEED_TOKEN_VALUE,
+	FEED_QUOTED_VALUE,
+	FEED_ESCAPED,
+	FEED_DELIMITER,
+	FEED_FAILED
+};
+
+/*
+ * Keys are only kept up to this length, longer ones are unknown parameters.
+ */
+#define MAX_KEY_BYTES 8
+
+#if __cplusplus
+struct _HawkcParser {
+#else
+struct HawkcParser {
+#endif
+	int state;
+	HawkcError error; /* the error of FEED_FAILED */
+	size_t scheme_len;
+	unsigned char key[MAX_KEY_BYTES];
+	size_t key_len;
+	unsigned int bit; /* of the current parameter, 0 if it is unknown */
+	HawkcString *field; /* of the current parameter, NULL for ts */
+	unsigned int seen;
+	size_t value_start; /* offset of the current value in buf */
+	size_t len;
+	size_t size;
+	unsigned char *buf;
+};
+
+HawkcError hawkc_parser_create(HawkcContext ctx, size_t size, HawkcParser *parser) {
+	HawkcParser p;
+
+	/* The value buffer follows the parser */
+#if __cplusplus
+	if( (p = (HawkcParser)hawkc_calloc(ctx,1,sizeof(struct _HawkcParser) + size)) == NULL) {
+#else
+	if( (p = (HawkcParser)hawkc_calloc(ctx,1,sizeof(struct HawkcParser) + size)) == NULL) {
+#endif
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate parser for %lu bytes", (unsigned long)size);
+	}
+	p->buf = (unsigned char*)(p + 1);
+	p->size = size;
+	hawkc_parser_reset(p);
+	*parser = p;
+	return HAWKC_OK;
+}
+
+void hawkc_parser_free(HawkcContext ctx, HawkcParser parser) {
+	hawkc_free(ctx,parser);
+}
+
+void hawkc_parser_reset(HawkcParser parser) {
+	parser->state = FEED_SCHEME;
+	parser->scheme_len = 0;
+	parser->seen = 0;
+	parser->len = 0;
+}
+
+static HawkcError short_scheme_error(HawkcContext ctx, HawkcParser parser) {
+	if(parser->scheme_len == 0) {
+		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Token must have at least one character");
+	}
+	return hawkc_set_error(ctx, HAWKC_BAD_SCHEME_ERROR, "Unsupported authentication scheme '%.*s'",
+			(int)parser->scheme_len, "Hawk");
+}
+
+/*
+ * Look up the parameter of the key that has just ended.
+ */
+static HawkcError start_param(HawkcContext ctx, HawkcParser parser, HawkcString key) {
+	parser->bit = 0;
+	if(key.len > MAX_KEY_BYTES) {
+		return HAWKC_OK;
+	}
+	if( (parser->bit = authorization_param(key,&(ctx->header_in),&(parser->field))) == 0) {
+		return HAWKC_OK;
+	}
+	return see_param(ctx,key,parser->bit,&(parser->seen));
+}
 
+/*
+ * Append n bytes of the current value to the buffer, unless the parameter
+ * is unknown.
+ */
+static HawkcError append_value(HawkcContext ctx, HawkcParser parser, const unsigned char *s, size_t n) {
+	if(parser->bit == 0) {
+		return HAWKC_OK;
+	}
+	if(n > parser->size - parser->len) {
+		return hawkc_set_error(ctx, HAWKC_REQUIRED_BUFFER_TOO_LARGE,
+				"Parameter values longer than %lu bytes", (unsigned long)parser->size);
+	}
+	memcpy(parser->buf + parser->len,s,n);
+	parser->len += n;
+	return HAWKC_OK;
+}
 
+/*
+ * Store the value that has just ended in the header of the context.
+ */
+static HawkcError end_param(HawkcContext ctx, HawkcParser parser) {
+	AuthorizationHeader h = &(ctx->header_in);
+	HawkcString v;
 
+	if(parser->bit == 0) {
+		return HAWKC_OK;
+	}
+	v.data = parser->buf + parser->value_start;
+	v.len = parser->len - parser->value_start;
+	if(parser->field == NULL) {
+		/* ts is only kept as a number */
+		parser->len = parser->value_start;
+		return hawkc_parse_time(ctx,v,&(h->ts));
+	}
+	*(parser->field) = v;
+	if(parser->bit == SEEN_ID && ctx->id_filter != NULL && !hawkc_id_filter_contains(ctx->id_filter,v.data,v.len)) {
+		return hawkc_set_error(ctx, HAWKC_UNKNOWN_ID_ERROR, "No credentials for id %.*s", (int)v.len, v.data);
+	}
+	return HAWKC_OK;
+}
 
+/*
+ * See hawkc.h for docs.
+ *
+ * The states follow hawkc_parse_hawk_authorization_header(), but each of
+ * them may end at the end of a chunk. Runs of token characters and of
+ * quoted text are consumed with the scanners.
+ */
+HawkcError hawkc_parser_feed(HawkcContext ctx, HawkcParser parser, const unsigned char *chunk, size_t len) {
+	const unsigned char *p = chunk, *end = chunk + len;
+	HawkcError e = HAWKC_OK;
+	HawkcString key;
+	size_t n;
 
+	if(parser->state == FEED_FAILED) {
+		return hawkc_set_error(ctx, parser->error, "Parsing the header has failed before");
+	}
+	if(parser->state == FEED_SCHEME && parser->scheme_len == 0) {
+		/* The key resolved for the previous request must not sign this one */
+		ctx->request_key = NULL;
+	}
+	while(p < end && e == HAWKC_OK) {
+		switch(parser->state) {
+		case FEED_SCHEME:
+			/* Fail at the first byte that does not match Hawk */
+			n = hawkc_scan_token(p,end - p);
+			if(parser->scheme_len + n > 4 || memcmp(p,"Hawk" + parser->scheme_len,n) != 0) {
+				e = hawkc_set_error(ctx, HAWKC_BAD_SCHEME_ERROR, "Unsupported authentication scheme '%.*s%.*s'",
+						(int)parser->scheme_len, "Hawk", (int)n, p);
+				break;
+			}
+			parser->scheme_len += n;
+			p += n;
+			if(p < end) {
+				if(parser->scheme_len < 4) {
+					e = short_scheme_error(ctx,parser);
+				}
+				parser->state = FEED_KEY_START;
+			}
+			break;
+		case FEED_KEY_START:
+			while(p < end && IS_SPACE(*p)) {
+				p++;
+			}
+			if(p == end) {
+				break;
+			}
+			if(!IS_TOKEN(*p)) {
+				e = hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Token must have at least one character");
+				break;
+			}
+			parser->key_len = 0;
+			parser->state = FEED_KEY;
+			break;
+		case FEED_KEY:
+			n = hawkc_scan_token(p,end - p);
+			if(parser->key_len == 0 && n < (size_t)(end - p)) {
+				/* The whole key is in this chunk, look it up in place */
+				key.data = (unsigned char*)p;
+				key.len = n;
+			} else {
+				if(parser->key_len < MAX_KEY_BYTES) {
+					memcpy(parser->key + parser->key_len,p,n < MAX_KEY_BYTES - parser->key_len ? n : MAX_KEY_BYTES - parser->key_len);
+				}
+				key.data = parser->key;
+				key.len = parser->key_len + n;
+			}
+			parser->key_len += n;
+			p += n;
+			if(p < end) {
+				e = start_param(ctx,parser,key);
+				parser->state = FEED_EQUALS;
+			}
+			break;
+		case FEED_EQUALS:
+			while(p < end && IS_SPACE(*p)) {
+				p++;
+			}
+			if(p == end) {
+				break;
+			}
+			if(*p != '=') {
+				e = hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Missing '=' for parameter value");
+				break;
+			}
+			p++;
+			parser->state = FEED_VALUE_START;
+			break;
+		case FEED_VALUE_START:
+			while(p < end && IS_SPACE(*p)) {
+				p++;
+			}
+			if(p == end) {
+				break;
+			}
+			parser->value_start = parser->len;
+			if(*p == '"') {
+				p++;
+				parser->state = FEED_QUOTED_VALUE;
+			} else if(!IS_TOKEN(*p)) {
+				e = hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Token must have at least one character");
+			} else {
+				parser->state = FEED_TOKEN_VALUE;
+			}
+			break;
+		case FEED_TOKEN_VALUE:
+			n = hawkc_scan_token(p,end - p);
+			e = append_value(ctx,parser,p,n);
+			p += n;
+			if(e == HAWKC_OK && p < end) {
+				e = end_param(ctx,parser);
+				parser->state = FEED_DELIMITER;
+			}
+			break;
+		case FEED_QUOTED_VALUE:
+			n = hawkc_scan_quoted(p,end - p);
+			e = append_value(ctx,parser,p,n);
+			p += n;
+			if(e != HAWKC_OK || p == end) {
+				break;
+			}
+			if(*p == '"') {
+				e = end_param(ctx,parser);
+				parser->state = FEED_DELIMITER;
+			} else {
+				parser->state = FEED_ESCAPED;
+			}
+			p++;
+			break;
+		case FEED_ESCAPED:
+			/* Only the escaped character is kept */
+			e = append_value(ctx,parser,p,1);
+			p++;
+			parser->state = FEED_QUOTED_VALUE;
+			break;
+		case FEED_DELIMITER:
+			while(p < end && IS_SPACE(*p)) {
+				p++;
+			}
+			if(p == end) {
+				break;
+			}
+			if(*p != ',') {
+				e = hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "',' required after parameter value");
+				break;
+			}
+			p++;
+			parser->state = FEED_KEY_START;
+			break;
+		}
+	}
+	if(e != HAWKC_OK) {
+		parser->state = FEED_FAILED;
+		parser->error = e;
+	}
+	return e;
+}
 
+/*
+ * See hawkc.h for docs.
+ */
+HawkcError hawkc_parser_finish(HawkcContext ctx, HawkcParser parser) {
+	HawkcError e = HAWKC_OK;
 
+	switch(parser->state) {
+	case FEED_SCHEME:
+		if(parser->scheme_len < 4) {
+			e = short_scheme_error(ctx,parser);
+		}
+		break;
+	case FEED_KEY:
+	case FEED_EQUALS:
+		e = hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Missing '=' for parameter value");
+		break;
+	case FEED_VALUE_START:
+		e = hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Token must have at least one character");
+		break;
+	case FEED_TOKEN_VALUE:
+		e = end_param(ctx,parser);
+		parser->state = FEED_DELIMITER;
+		break;
+	case FEED_QUOTED_VALUE:
+		e = hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Quoted text must end with '\"'");
+		break;
+	case FEED_ESCAPED:
+		e = hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "\\ at end of text");
+		break;
+	case FEED_FAILED:
+		return hawkc_set_error(ctx, parser->error, "Parsing the header has failed before");
+	default:
+		break;
+	}
+	if(e != HAWKC_OK) {
+		parser->state = FEED_FAILED;
+		parser->error = e;
+	}
+	return e;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <stdarg.h>
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+#include "base64.h"
+
+static const char *HAWK_PAYLOAD_PREFIX_LINE = "hawk.1.payload\n";
+static const char LF = '\n';
+
+/*
+ * Feed the content type to the hash the way Hawk normalizes it: only
+ * the part before the first ';', without surrounding blanks and in
+ * lower case.
+ */
+static void update_content_type(HawkcPayloadHash *hash, const unsigned char *content_type, size_t len) {
+	const unsigned char *p = content_type;
+	const unsigned char *end;
+	unsigned char buf[32];
+
+	if( (end = memchr(p,';',len)) == NULL) {
+		end = p + len;
+	}
+	while(p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+	while(end > p && (end[-1] == ' ' || end[-1] == '\t')) {
+		end--;
+	}
+	while(p < end) {
+		size_t n = 0;
+		while(p < end && n < sizeof(buf)) {
+			buf[n++] = (*p >= 'A' && *p <= 'Z') ? *p + ('a' - 'A') : *p;
+			p++;
+		}
+		hash->algorithm->update(&(hash->state),buf,n);
+	}
+}
+
+HawkcError hawkc_payload_hash_init(HawkcContext ctx, HawkcPayloadHash *hash, const unsigned char *content_type, size_t len) {
+	if( (hash->algorithm = hawkc_context_active_algorithm(ctx)) == NULL) {
+		return hawkc_set_error(ctx, HAWKC_ERROR_UNKNOWN_ALGORITHM, "No algorithm set for payload hash");
+	}
+	hash->algorithm->init(&(hash->state));
+	hash->algorithm->update(&(hash->state),(const unsigned char *)HAWK_PAYLOAD_PREFIX_LINE,strlen(HAWK_PAYLOAD_PREFIX_LINE));
+	update_content_type(hash,content_type,len);
+	hash->algorithm->update(&(hash->state),(const unsigned char *)&LF,1);
+	return HAWKC_OK;
+}
+
+void hawkc_payload_hash_update(HawkcPayloadHash *hash, const unsigned char *data, size_t len) {
+	if(len > 0) {
+		hash->algorithm->update(&(hash->state),data,len);
+	}
+}
+
+/*
+ * Add the final line feed and store the raw digest in digest, which must
+ * be at least MAX_HMAC_BYTES long.
+ */
+static size_t payload_hash_final_raw(HawkcPayloadHash *hash, unsigned char *digest) {
+	hash->algorithm->update(&(hash->state),(const unsigned char *)&LF,1);
+	hash->algorithm->final(&(hash->state),digest);
+	return hash->algorithm->digest_size;
+}
+
+HawkcError hawkc_payload_hash_final(HawkcContext ctx, HawkcPayloadHash *hash, unsigned char *buf, size_t *len) {
+	unsigned char digest[MAX_HMAC_BYTES];
+	size_t n;
+
+	n = payload_hash_final_raw(hash,digest);
+	hawkc_base64_encode(digest,n,buf,len);
+	return HAWKC_OK;
+}
+
+HawkcError hawkc_validate_payload_hash(HawkcContext ctx, HawkcPayloadHash *hash, int *is_valid) {
+	HawkcError e;
+	unsigned char digest[MAX_HMAC_BYTES];
+	unsigned char expected[MAX_HMAC_BYTES_B64 / 4 * 3];
+	size_t n, expected_len;
+
+	*is_valid = 0;
+	n = payload_hash_final_raw(hash,digest);
+
+	if(ctx->header_in.hash.len == 0) {
+		return HAWKC_OK;
+	}
+	if(ctx->header_in.hash.len > MAX_HMAC_BYTES_B64) {
+		return hawkc_set_error(ctx, HAWKC_BASE64_ERROR, "hash value too long: %d bytes", (int)ctx->header_in.hash.len);
+	}
+	if( (e = hawkc_base64_decode_strict(ctx,ctx->header_in.hash.data,ctx->header_in.hash.len,expected,&expected_len)) != HAWKC_OK) {
+		return e;
+	}
+	*is_valid = (expected_len == n) && hawkc_fixed_time_equal(digest,expected,n);
+	return HAWKC_OK;
+}
@@ -0,0 +1,460 @@
+/*
+ * Nonce replay cache.
+ *
+ * An entry is a single 64-bit word: a 48-bit fingerprint of (id, nonce, ts)
+ * and a 16-bit lap number of the timestamp. Entries are stored in open
+ * addressing tables without locks, a slot is claimed with one compare and
+ * swap.
+ *
+ * The cache is split into shards, as many as there are CPUs rounded up to a
+ * power of two, each sized for its share of the requests. A key is always
+ * stored in the same shard, chosen by its fingerprint, so any thread may
+ * touch any shard; as slots are claimed without locks, there is no lock
+ * contention for the shards to spread.
+ *
+ * Each shard holds a ring of per-second buckets covering the allowed
+ * timestamp window, the bucket of a timestamp is ts % nbuckets. When the
+ * ring wraps around, the entries of a bucket belong to an earlier lap and
+ * count as free slots. Expiry is therefore implied by the lap number and
+ * never requires a scan.
+ *
+ * Fingerprints and slots are derived with hawkc_hash_bytes() and a random
+ * seed kept in the table header, so clients cannot choose nonces that pile
+ * up in one probe sequence.
+ *
+ * The table is a header followed by the slots and contains no pointers, so
+ * it can also live in a POSIX shared memory segment that several processes
+ * map, see hawkc_replay_cache_open_shared().
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+
+#ifdef HAVE_SHM_OPEN
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if !defined(__GNUC__)
+#error "The replay cache requires the __atomic builtins of GCC or Clang"
+#endif
+
+#define FINGERPRINT_BITS 48
+#define FINGERPRINT_MASK ((((uint64_t)1) << FINGERPRINT_BITS) - 1)
+#define LAP_MASK 0xffff
+
+/*
+ * Maximum number of slots probed per insert. With a load factor of at most
+ * one half, probe sequences are almost always a handful of slots long.
+ */
+#define PROBE_LIMIT 64
+
+/*
+ * Minimum number of slots per bucket and the size of a cache line, at
+ * which shards are aligned to avoid false sharing.
+ */
+#define MIN_BUCKET_SLOTS 16
+#define CACHE_LINE 64
+
+#define MAX_SKEW 32767
+
+/*
+ * Marks an initialized table. Processes attaching to a shared table wait
+ * up to ATTACH_WAIT_MS for its creator to set it.
+ */
+#define TABLE_MAGIC 0x4877524331UL
+#define ATTACH_WAIT_MS 1000
+
+/*
+ * Table header, followed by the slots. The header occupies one cache line
+ * so that the slots of each shard start on a cache line boundary.
+ * reserved[0] holds the hash seed, which processes sharing the table share.
+ */
+typedef struct ReplayTable {
+	uint64_t magic;
+	uint64_t size;
+	uint64_t nshards;
+	uint64_t bucket_slots;
+	uint64_t bucket_bits;
+	int64_t skew;
+	uint64_t reserved[2];
+} ReplayTable;
+
+typedef char replay_table_fills_cache_line[sizeof(ReplayTable) == CACHE_LINE ? 1 : -1];
+
+/*
+ * The handle keeps a copy of the table parameters. mem is the heap block
+ * of a private cache and NULL for a mapped one.
+ */
+#if __cplusplus
+struct _HawkcReplayCache {
+#else
+struct HawkcReplayCache {
+#endif
+	void *mem;
+	ReplayTable *table;
+	uint64_t *slots;
+	size_t nshards;
+	size_t bucket_slots;
+	size_t shard_slots;
+	unsigned int bucket_bits;
+	time_t skew;
+	uint64_t seed;
+};
+
+static size_t next_power_of_two(size_t n) {
+	size_t p = 1;
+	while(p < n) {
+		p <<= 1;
+	}
+	return p;
+}
+
+/*
+ * Final mix of MurmurHash3, spreads all input bits over the result.
+ */
+static uint64_t mix64(uint64_t h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/*
+ * Compute the table layout for the given load and skew and store it in
+ * the header t.
+ */
+static HawkcError table_layout(HawkcContext ctx, size_t requests_per_second, time_t skew, ReplayTable *t) {
+	long ncpu;
+	size_t nbuckets, nshards, bucket_slots;
+	unsigned int bucket_bits;
+
+	if(skew < 0 || skew > MAX_SKEW) {
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Replay cache skew must be between 0 and %d seconds", MAX_SKEW);
+	}
+	/* Every second of [now - skew, now + skew] needs its own bucket */
+	nbuckets = next_power_of_two((size_t)(2 * skew + 1));
+	for(bucket_bits = 0; ((size_t)1 << bucket_bits) < nbuckets; bucket_bits++) {
+		;
+	}
+
+	ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	nshards = next_power_of_two(ncpu > 0 ? (size_t)ncpu : 1);
+
+	/* Keep the load factor of every bucket at or below one half */
+	bucket_slots = next_power_of_two(2 * ((requests_per_second + nshards - 1) / nshards));
+	if(bucket_slots < MIN_BUCKET_SLOTS) {
+		bucket_slots = MIN_BUCKET_SLOTS;
+	}
+
+	if(bucket_slots > (((size_t)-1) - sizeof(ReplayTable)) / nbuckets / nshards / sizeof(uint64_t)) {
+		return hawkc_set_error(ctx, HAWKC_REQUIRED_BUFFER_TOO_LARGE, "Replay cache for %lu requests per second too large",
+				(unsigned long)requests_per_second);
+	}
+
+	memset(t,0,sizeof(*t));
+	t->size = sizeof(ReplayTable) + bucket_slots * nbuckets * nshards * sizeof(uint64_t);
+	t->nshards = nshards;
+	t->bucket_slots = bucket_slots;
+	t->bucket_bits = bucket_bits;
+	t->skew = skew;
+	return HAWKC_OK;
+}
+
+/*
+ * Point the handle to an initialized table.
+ */
+static void attach_table(HawkcReplayCache c, ReplayTable *t) {
+	c->table = t;
+	c->slots = (uint64_t *)(t + 1);
+	c->nshards = (size_t)t->nshards;
+	c->bucket_slots = (size_t)t->bucket_slots;
+	c->shard_slots = (size_t)t->bucket_slots << t->bucket_bits;
+	c->bucket_bits = (unsigned int)t->bucket_bits;
+	c->skew = (time_t)t->skew;
+	c->seed = t->reserved[0];
+}
+
+HawkcError hawkc_replay_cache_create(HawkcContext ctx, size_t requests_per_second, time_t skew, HawkcReplayCache *cache) {
+	HawkcError e;
+	HawkcReplayCache c;
+	ReplayTable layout;
+	ReplayTable *t;
+
+	if( (e = table_layout(ctx,requests_per_second,skew,&layout)) != HAWKC_OK) {
+		return e;
+	}
+	if( (e = hawkc_random_bytes(ctx,(unsigned char*)&(layout.reserved[0]),sizeof(layout.reserved[0]))) != HAWKC_OK) {
+		return e;
+	}
+	if( (c = hawkc_calloc(ctx,1,sizeof(*c))) == NULL) {
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate replay cache");
+	}
+	if( (c->mem = hawkc_calloc(ctx,1,(size_t)layout.size + CACHE_LINE)) == NULL) {
+		hawkc_free(ctx,c);
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate replay cache of %lu bytes", (unsigned long)layout.size);
+	}
+	t = (ReplayTable *)(((uintptr_t)c->mem + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1));
+	*t = layout;
+	t->magic = TABLE_MAGIC;
+	attach_table(c,t);
+
+	*cache = c;
+	return HAWKC_OK;
+}
+
+#ifdef HAVE_SHM_OPEN
+
+/*
+ * Wait for the creator of a shared table to size and initialize it.
+ */
+static HawkcError wait_for_table(HawkcContext ctx, int fd, const char *name, ReplayTable **table, size_t *size) {
+	struct stat st;
+	struct timespec delay;
+	ReplayTable *t;
+	int i;
+
+	delay.tv_sec = 0;
+	delay.tv_nsec = 1000000;
+	for(i = 0; i < ATTACH_WAIT_MS; i++) {
+		if(fstat(fd,&st) != 0) {
+			return hawkc_set_error(ctx, HAWKC_ERROR, "Unable to stat replay cache %s: %s", name, strerror(errno));
+		}
+		if((size_t)st.st_size >= sizeof(ReplayTable)) {
+			if( (t = mmap(NULL,(size_t)st.st_size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0)) == MAP_FAILED) {
+				return hawkc_set_error(ctx, HAWKC_ERROR, "Unable to map replay cache %s: %s", name, strerror(errno));
+			}
+			if(__atomic_load_n(&(t->magic),__ATOMIC_ACQUIRE) == TABLE_MAGIC) {
+				if(t->size != (uint64_t)st.st_size) {
+					munmap(t,(size_t)st.st_size);
+					return hawkc_set_error(ctx, HAWKC_ERROR, "Replay cache %s is corrupt", name);
+				}
+				*table = t;
+				*size = (size_t)st.st_size;
+				return HAWKC_OK;
+			}
+			munmap(t,(size_t)st.st_size);
+		}
+		nanosleep(&delay,NULL);
+	}
+	return hawkc_set_error(ctx, HAWKC_ERROR, "Replay cache %s has not been initialized", name);
+}
+
+HawkcError hawkc_replay_cache_open_shared(HawkcContext ctx, const char *name, size_t requests_per_second, time_t skew, HawkcReplayCache *cache) {
+	HawkcError e;
+	HawkcReplayCache c;
+	ReplayTable layout;
+	ReplayTable *t = NULL;
+	size_t size = 0;
+	int fd;
+
+	if( (e = table_layout(ctx,requests_per_second,skew,&layout)) != HAWKC_OK) {
+		return e;
+	}
+	if( (c = hawkc_calloc(ctx,1,sizeof(*c))) == NULL) {
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate replay cache");
+	}
+
+	if( (fd = shm_open(name,O_RDWR | O_CREAT | O_EXCL,0600)) >= 0) {
+		/* We created the segment. New pages are zero, that is, empty slots. */
+		if(ftruncate(fd,(off_t)layout.size) != 0) {
+			e = hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to size replay cache %s: %s", name, strerror(errno));
+			close(fd);
+			shm_unlink(name);
+			hawkc_free(ctx,c);
+			return e;
+		}
+		size = (size_t)layout.size;
+		if( (t = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0)) == MAP_FAILED) {
+			e = hawkc_set_error(ctx, HAWKC_ERROR, "Unable to map replay cache %s: %s", name, strerror(errno));
+			close(fd);
+			shm_unlink(name);
+			hawkc_free(ctx,c);
+			return e;
+		}
+		if( (e = hawkc_random_bytes(ctx,(unsigned char*)&(layout.reserved[0]),sizeof(layout.reserved[0]))) != HAWKC_OK) {
+			munmap(t,size);
+			close(fd);
+			shm_unlink(name);
+			hawkc_free(ctx,c);
+			return e;
+		}
+		layout.magic = 0;
+		*t = layout;
+		__atomic_store_n(&(t->magic),TABLE_MAGIC,__ATOMIC_RELEASE);
+	} else if(errno == EEXIST && (fd = shm_open(name,O_RDWR,0600)) >= 0) {
+		if( (e = wait_for_table(ctx,fd,name,&t,&size)) != HAWKC_OK) {
+			close(fd);
+			hawkc_free(ctx,c);
+			return e;
+		}
+		if(t->skew != layout.skew) {
+			e = hawkc_set_error(ctx, HAWKC_ERROR, "Replay cache %s has a skew of %ld seconds, not %ld",
+					name, (long)t->skew, (long)skew);
+			munmap(t,size);
+			close(fd);
+			hawkc_free(ctx,c);
+			return e;
+		}
+	} else {
+		e = hawkc_set_error(ctx, HAWKC_ERROR, "Unable to open replay cache %s: %s", name, strerror(errno));
+		hawkc_free(ctx,c);
+		return e;
+	}
+	/* The mapping stays valid without the descriptor */
+	close(fd);
+
+	attach_table(c,t);
+	*cache = c;
+	return HAWKC_OK;
+}
+
+HawkcError hawkc_replay_cache_unlink(HawkcContext ctx, const char *name) {
+	if(shm_unlink(name) != 0 && errno != ENOENT) {
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Unable to remove replay cache %s: %s", name, strerror(errno));
+	}
+	return HAWKC_OK;
+}
+
+#else /* !HAVE_SHM_OPEN */
+
+HawkcError hawkc_replay_cache_open_shared(HawkcContext ctx, const char *name, size_t requests_per_second, time_t skew, HawkcReplayCache *cache) {
+	return hawkc_set_error(ctx, HAWKC_ERROR, "Shared replay caches are not supported on this platform");
+}
+
+HawkcError hawkc_replay_cache_unlink(HawkcContext ctx, const char *name) {
+	return hawkc_set_error(ctx, HAWKC_ERROR, "Shared replay caches are not supported on this platform");
+}
+
+#endif /* HAVE_SHM_OPEN */
+
+void hawkc_replay_cache_free(HawkcContext ctx, HawkcReplayCache cache) {
+	if(cache == NULL) {
+		return;
+	}
+	if(cache->mem != NULL) {
+		hawkc_free(ctx,cache->mem);
+	}
+#ifdef HAVE_SHM_OPEN
+	else {
+		munmap(cache->table,(size_t)cache->table->size);
+	}
+#endif
+	hawkc_free(ctx,cache);
+}
+
+/*
+ * Compute the entry of (id, nonce, ts) and the bucket and first slot to
+ * probe for it.
+ */
+static uint64_t locate(HawkcReplayCache cache, const unsigned char *id, size_t id_len,
+		const unsigned char *nonce, size_t nonce_len, time_t ts, uint64_t **bucket, size_t *first) {
+	uint64_t fp, h, lap;
+
+	/*
+	 * XORing a hash of the nonce into a hash of id and ts keeps different
+	 * nonces of the same id and ts apart. Both are seeded, so neither the
+	 * fingerprint nor the slot can be computed by clients.
+	 */
+	h = mix64(hawkc_hash_bytes(id,id_len,cache->seed) ^ (uint64_t)ts);
+	fp = (h ^ hawkc_hash_bytes(nonce,nonce_len,cache->seed)) & FINGERPRINT_MASK;
+	if(fp == 0) {
+		fp = 1; /* An entry must never be 0, which marks empty slots */
+	}
+	lap = ((uint64_t)ts >> cache->bucket_bits) & LAP_MASK;
+
+	h = mix64(fp);
+	*bucket = cache->slots
+			+ (size_t)(h >> 32 & (cache->nshards - 1)) * cache->shard_slots
+			+ (size_t)((uint64_t)ts & (((uint64_t)1 << cache->bucket_bits) - 1)) * cache->bucket_slots;
+	*first = (size_t)h & (cache->bucket_slots - 1);
+	return (fp << (64 - FINGERPRINT_BITS)) | lap;
+}
+
+int hawkc_replay_cache_add(HawkcReplayCache cache, const unsigned char *id, size_t id_len,
+		const unsigned char *nonce, size_t nonce_len, time_t ts, time_t now) {
+	uint64_t entry, lap;
+	uint64_t *bucket;
+	size_t i, n;
+
+	if(ts < now - cache->skew || ts > now + cache->skew) {
+		return HAWKC_REPLAY_OUTSIDE_WINDOW;
+	}
+	entry = locate(cache,id,id_len,nonce,nonce_len,ts,&bucket,&i);
+	lap = entry & LAP_MASK;
+
+	n = cache->bucket_slots < PROBE_LIMIT ? cache->bucket_slots : PROBE_LIMIT;
+	while(n-- > 0) {
+		uint64_t *slot = bucket + i;
+		uint64_t cur = __atomic_load_n(slot,__ATOMIC_ACQUIRE);
+		for(;;) {
+			if(cur == entry) {
+				return HAWKC_REPLAY_SEEN;
+			}
+			/* Empty slot or entry of an earlier lap of the ring */
+			if(cur != 0 && (cur & LAP_MASK) == lap) {
+				break;
+			}
+			if(__atomic_compare_exchange_n(slot,&cur,entry,0,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE)) {
+				return HAWKC_REPLAY_FRESH;
+			}
+			/* Lost the race, cur now holds the winner's entry */
+		}
+		i = (i + 1) & (cache->bucket_slots - 1);
+	}
+	return HAWKC_REPLAY_FULL;
+}
+
+int hawkc_replay_cache_seen(HawkcReplayCache cache, const unsigned char *id, size_t id_len,
+		const unsigned char *nonce, size_t nonce_len, time_t ts, time_t now) {
+	uint64_t entry, lap;
+	uint64_t *bucket;
+	size_t i, n;
+
+	if(ts < now - cache->skew || ts > now + cache->skew) {
+		return HAWKC_REPLAY_OUTSIDE_WINDOW;
+	}
+	entry = locate(cache,id,id_len,nonce,nonce_len,ts,&bucket,&i);
+	lap = entry & LAP_MASK;
+
+	n = cache->bucket_slots < PROBE_LIMIT ? cache->bucket_slots : PROBE_LIMIT;
+	while(n-- > 0) {
+		uint64_t cur = __atomic_load_n(bucket + i,__ATOMIC_ACQUIRE);
+		if(cur == entry) {
+			return HAWKC_REPLAY_SEEN;
+		}
+		/* add() would claim a free slot here */
+		if(cur == 0 || (cur & LAP_MASK) != lap) {
+			return HAWKC_REPLAY_FRESH;
+		}
+		i = (i + 1) & (cache->bucket_slots - 1);
+	}
+	return HAWKC_REPLAY_FRESH;
+}
+
+HawkcError hawkc_replay_cache_check(HawkcContext ctx, HawkcReplayCache cache, time_t now, int *is_fresh) {
+	AuthorizationHeader h = &(ctx->header_in);
+	int r;
+
+	*is_fresh = 0;
+	r = hawkc_replay_cache_add(cache,h->id.data,h->id.len,h->nonce.data,h->nonce.len,h->ts,now);
+	if(r == HAWKC_REPLAY_FULL) {
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Replay cache bucket for ts %ld is full", (long)h->ts);
+	}
+	*is_fresh = (r == HAWKC_REPLAY_FRESH);
+	return HAWKC_OK;
+}
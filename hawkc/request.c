@@ -0,0 +1,259 @@
+/*
+ * Scanner of HTTP/1.x request heads that sets the request parts of the
+ * context to point into the scanned bytes.
+ *
+ * Lines are found with hawkc_scan_field(), which stops at CR, LF and any
+ * other control character, and header names with hawkc_scan_token(), so
+ * the head is scanned a vector at a time on CPUs with SSSE3 or AVX2. Only
+ * the Host and Authorization values are looked at again.
+ */
+#include <string.h>
+#include "hawkc.h"
+#include "common.h"
+#include "scan.h"
+
+#define IS_SPACE(c) ( ((c) == ' ') || ((c) == '\t') )
+
+/*
+ * Find the end of the line starting at s. Stores the length of the line
+ * in n and the length including its CRLF or LF in line_len.
+ */
+static HawkcError scan_line(HawkcContext ctx, const unsigned char *s, size_t len, size_t *n, size_t *line_len) {
+	size_t i = hawkc_scan_field(s,len);
+
+	*n = i;
+	if(i < len && s[i] == '\n') {
+		*line_len = i + 1;
+		return HAWKC_OK;
+	}
+	if(i + 1 < len && s[i] == '\r' && s[i + 1] == '\n') {
+		*line_len = i + 2;
+		return HAWKC_OK;
+	}
+	if(i == len || (i + 1 == len && s[i] == '\r')) {
+		return hawkc_set_error(ctx, HAWKC_INCOMPLETE_ERROR, "Request head is incomplete");
+	}
+	return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Control character 0x%02x in request head", s[i]);
+}
+
+/*
+ * Compare a header name case-insensitively with a lower case name made of
+ * letters only.
+ */
+static int name_equals(const unsigned char *name, size_t len, const char *lower, size_t lower_len) {
+	size_t i;
+
+	if(len != lower_len) {
+		return 0;
+	}
+	for(i = 0; i < len; i++) {
+		if((name[i] | 0x20) != lower[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Compare the start of s with a lower case prefix, ignoring the case of
+ * letters.
+ */
+static int has_prefix(const unsigned char *s, size_t len, const char *lower, size_t lower_len) {
+	size_t i;
+	int c;
+
+	if(len < lower_len) {
+		return 0;
+	}
+	for(i = 0; i < lower_len; i++) {
+		c = (lower[i] >= 'a' && lower[i] <= 'z') ? (s[i] | 0x20) : s[i];
+		if(c != lower[i]) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*
+ * Split an absolute-form request target (RFC 7230, 5.3.2) into the
+ * authority, which replaces the Host header, and the path. Only http and
+ * https URIs with an absolute path or none are accepted.
+ */
+static HawkcError split_absolute_target(HawkcContext ctx, unsigned char *s, size_t len, HawkcString *authority, int *tls) {
+	unsigned char *p;
+	size_t n;
+
+	if(has_prefix(s,len,"http://",7)) {
+		n = 7;
+		*tls = 0;
+	} else if(has_prefix(s,len,"https://",8)) {
+		n = 8;
+		*tls = 1;
+	} else {
+		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Unsupported request target '%.*s'", (int)len, s);
+	}
+	authority->data = s + n;
+	p = (unsigned char*)memchr(s + n,'/',len - n);
+	authority->len = (p == NULL ? s + len : p) - authority->data;
+	if(memchr(authority->data,'?',authority->len) != NULL || memchr(authority->data,'@',authority->len) != NULL) {
+		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Unsupported request target '%.*s'", (int)len, s);
+	}
+	if(p == NULL) {
+		/* The path of an URI without one is / */
+		hawkc_context_set_path(ctx,(unsigned char*)"/",1);
+	} else {
+		hawkc_context_set_path(ctx,p,s + len - p);
+	}
+	return HAWKC_OK;
+}
+
+/*
+ * Parse method SP request-target SP HTTP-version. The authority of an
+ * absolute-form target is stored in authority.
+ */
+static HawkcError parse_request_line(HawkcContext ctx, unsigned char *s, size_t len, HawkcString *authority, int *tls) {
+	HawkcError e;
+	unsigned char *sp;
+	size_t n;
+
+	n = hawkc_scan_token(s,len);
+	if(n == 0 || n == len || s[n] != ' ') {
+		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Malformed request method '%.*s'", (int)len, s);
+	}
+	hawkc_context_set_method(ctx,s,n);
+	s += n + 1;
+	len -= n + 1;
+
+	if( (sp = (unsigned char*)memchr(s,' ',len)) == NULL || sp == s) {
+		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Malformed request target '%.*s'", (int)len, s);
+	}
+	if(s[0] == '/' || (sp - s == 1 && s[0] == '*')) {
+		hawkc_context_set_path(ctx,s,sp - s);
+	} else if( (e = split_absolute_target(ctx,s,sp - s,authority,tls)) != HAWKC_OK) {
+		return e;
+	}
+	len -= sp - s + 1;
+	s = sp + 1;
+
+	if(len != 8 || memcmp(s,"HTTP/1.",7) != 0 || s[7] < '0' || s[7] > '9') {
+		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Unsupported HTTP version '%.*s'", (int)len, s);
+	}
+	return HAWKC_OK;
+}
+
+/*
+ * Split the Host header value or the authority of the request target into
+ * host and port. IPv6 literals keep their brackets, like in the Host header.
+ */
+static HawkcError parse_host(HawkcContext ctx, HawkcString value, int tls) {
+	unsigned char *s = value.data, *p;
+	size_t len = value.len, n, i;
+
+	if(len > 0 && s[0] == '[') {
+		p = (unsigned char*)memchr(s,']',len);
+		n = p == NULL ? 0 : p - s + 1;
+	} else {
+		p = (unsigned char*)memchr(s,':',len);
+		n = p == NULL ? len : p - s;
+	}
+	if(n == 0 || (n < len && s[n] != ':')) {
+		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Malformed Host header '%.*s'", (int)len, s);
+	}
+	hawkc_context_set_host(ctx,s,n);
+
+	/* An empty port is the default port too */
+	if(n + 1 >= len) {
+		if(tls) {
+			hawkc_context_set_port(ctx,(unsigned char*)"443",3);
+		} else {
+			hawkc_context_set_port(ctx,(unsigned char*)"80",2);
+		}
+		return HAWKC_OK;
+	}
+	for(i = n + 1; i < len; i++) {
+		if(s[i] < '0' || s[i] > '9') {
+			return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Malformed port in Host header '%.*s'", (int)len, s);
+		}
+	}
+	hawkc_context_set_port(ctx,s + n + 1,len - n - 1);
+	return HAWKC_OK;
+}
+
+/*
+ * See hawkc.h for docs.
+ */
+HawkcError hawkc_parse_request_head(HawkcContext ctx, unsigned char *head, size_t len, int tls, size_t *head_len) {
+	HawkcError e;
+	unsigned char *p = head, *end = head + len, *v;
+	HawkcString host = { 0, NULL }, authorization = { 0, NULL }, authority = { 0, NULL };
+	size_t n, line_len, name_len, v_len;
+
+	if( (e = scan_line(ctx,p,end - p,&n,&line_len)) != HAWKC_OK) {
+		return e;
+	}
+	if( (e = parse_request_line(ctx,p,n,&authority,&tls)) != HAWKC_OK) {
+		return e;
+	}
+	p += line_len;
+
+	for(;;) {
+		if( (e = scan_line(ctx,p,end - p,&n,&line_len)) != HAWKC_OK) {
+			return e;
+		}
+		if(n == 0) {
+			p += line_len;
+			break;
+		}
+		if(IS_SPACE(*p)) {
+			return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Folded header lines are not supported");
+		}
+		name_len = hawkc_scan_token(p,n);
+		if(name_len == 0 || name_len == n || p[name_len] != ':') {
+			return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Malformed header field '%.*s'", (int)n, p);
+		}
+
+		/* Strip the optional whitespace around the value */
+		v = p + name_len + 1;
+		v_len = n - name_len - 1;
+		while(v_len > 0 && IS_SPACE(*v)) {
+			v++;
+			v_len--;
+		}
+		while(v_len > 0 && IS_SPACE(v[v_len - 1])) {
+			v_len--;
+		}
+
+		if(name_equals(p,name_len,"host",4)) {
+			if(host.data != NULL) {
+				return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Duplicate Host header");
+			}
+			host.data = v;
+			host.len = v_len;
+		} else if(name_equals(p,name_len,"authorization",13)) {
+			if(authorization.data != NULL) {
+				return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Duplicate Authorization header");
+			}
+			authorization.data = v;
+			authorization.len = v_len;
+		}
+		p += line_len;
+	}
+
+	/* The authority of an absolute-form target overrides the Host header */
+	if(authority.data != NULL) {
+		host = authority;
+	} else if(host.data == NULL) {
+		return hawkc_set_error(ctx, HAWKC_PARSE_ERROR, "Request has no Host header");
+	}
+	if( (e = parse_host(ctx,host,tls)) != HAWKC_OK) {
+		return e;
+	}
+	*head_len = p - head;
+
+	memset(&(ctx->header_in),0,sizeof(ctx->header_in));
+	ctx->request_key = NULL;
+	if(authorization.data != NULL) {
+		return hawkc_parse_authorization_header(ctx,authorization.data,authorization.len);
+	}
+	return HAWKC_OK;
+}
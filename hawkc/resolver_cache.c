@@ -0,0 +1,236 @@
+/*
+ * Resolver cache.
+ *
+ * Memoizes a key resolver that is expensive to call, for example one that
+ * unseals iron tokens used as ids. Ids are not stored, entries are matched
+ * by a 128-bit digest of the id: the HMAC-SHA-256 of the id with a random
+ * key of the cache, truncated. As the cache decides which key authenticates
+ * an id, the digest is a keyed PRF, so ids that collide cannot be found
+ * without the key of the cache.
+ *
+ * The cache is split into shards by digest, each with its own lock. A shard
+ * is a set-associative table: the digest selects a set of WAYS entries and
+ * a new entry replaces an empty or expired one of the set, or else the one
+ * used least recently. The lock is only held to look up or store an entry,
+ * never while the resolver runs, so concurrent misses for the same id may
+ * both call the resolver.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sched.h>
+
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+
+#if !defined(__GNUC__)
+#error "The resolver cache requires the __atomic builtins of GCC or Clang"
+#endif
+
+#define SHARDS 16
+#define WAYS 4
+#define CACHE_LINE 64
+
+typedef struct Entry {
+	uint64_t h1;
+	uint64_t h2;
+	HawkcAlgorithm algorithm; /* NULL if the entry is empty */
+	time_t expires; /* 0 if it does not expire */
+	uint64_t used;
+	unsigned char data[2 * MAX_DIGEST_CHAIN_BYTES];
+} Entry;
+
+/*
+ * Each shard has a cache line of its own, so threads locking different
+ * shards do not contend for the same line.
+ */
+typedef struct Shard {
+	int locked;
+	uint64_t clock;
+	size_t mask; /* number of sets - 1 */
+	Entry *entries;
+} __attribute__((aligned(CACHE_LINE))) Shard;
+
+typedef char shard_fills_cache_line[sizeof(Shard) == CACHE_LINE ? 1 : -1];
+
+#if __cplusplus
+struct _HawkcResolverCache {
+#else
+struct HawkcResolverCache {
+#endif
+	Shard shards[SHARDS];
+	void *memory; /* allocation the cache is aligned in */
+	HawkcExpiringKeyResolver resolver;
+	void *data;
+#if __cplusplus
+	struct _HawkcKey id_key;
+#else
+	struct HawkcKey id_key;
+#endif
+};
+
+#define ID_KEY_BYTES 32
+
+static void lock_shard(Shard *s) {
+	while(__atomic_exchange_n(&(s->locked),1,__ATOMIC_ACQUIRE)) {
+		sched_yield();
+	}
+}
+
+static void unlock_shard(Shard *s) {
+	__atomic_store_n(&(s->locked),0,__ATOMIC_RELEASE);
+}
+
+static Entry *set_of(Shard *s, uint64_t h1) {
+	return s->entries + ((h1 >> 4) & s->mask) * WAYS;
+}
+
+/*
+ * Compute the digest of id that entries are matched by as h1 and h2.
+ */
+static HawkcError digest_id(HawkcContext ctx, HawkcResolverCache cache, const unsigned char *id, size_t id_len,
+		uint64_t *h1, uint64_t *h2) {
+	HawkcError e;
+	HawkcHmacCtx hmac;
+	unsigned char digest[MAX_HMAC_BYTES];
+	size_t digest_len;
+
+	if( (e = hawkc_hmac_init(ctx,&hmac,&(cache->id_key))) != HAWKC_OK) {
+		return e;
+	}
+	hawkc_hmac_update(&hmac,id,id_len);
+	hawkc_hmac_final_raw(&hmac,digest,&digest_len);
+	memcpy(h1,digest,sizeof(*h1));
+	memcpy(h2,digest + sizeof(*h1),sizeof(*h2));
+	return HAWKC_OK;
+}
+
+HawkcError hawkc_resolver_cache_create(HawkcContext ctx, HawkcExpiringKeyResolver resolver, void *data, size_t capacity,
+		HawkcResolverCache *cache) {
+	HawkcError e;
+	HawkcResolverCache c;
+	void *memory;
+	unsigned char secret[ID_KEY_BYTES];
+	size_t nsets = 1;
+	int i;
+
+#if __cplusplus
+	if( (memory = hawkc_calloc(ctx,1,sizeof(struct _HawkcResolverCache) + CACHE_LINE)) == NULL) {
+#else
+	if( (memory = hawkc_calloc(ctx,1,sizeof(struct HawkcResolverCache) + CACHE_LINE)) == NULL) {
+#endif
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate resolver cache");
+	}
+	c = (HawkcResolverCache)(((uintptr_t)memory + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1));
+	c->memory = memory;
+	if( (e = hawkc_random_bytes(ctx,secret,sizeof(secret))) != HAWKC_OK
+			|| (e = hawkc_key_init(ctx,&(c->id_key),HAWKC_SHA_256,secret,sizeof(secret))) != HAWKC_OK) {
+		hawkc_cleanse(secret,sizeof(secret));
+		hawkc_free(ctx,memory);
+		return e;
+	}
+	hawkc_cleanse(secret,sizeof(secret));
+	while(nsets * SHARDS * WAYS < capacity) {
+		nsets *= 2;
+	}
+	for(i = 0; i < SHARDS; i++) {
+		c->shards[i].mask = nsets - 1;
+		if( (c->shards[i].entries = (Entry*)hawkc_calloc(ctx,nsets * WAYS,sizeof(Entry))) == NULL) {
+			hawkc_resolver_cache_free(ctx,c);
+			return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate resolver cache of %lu entries", (unsigned long)capacity);
+		}
+	}
+	c->resolver = resolver;
+	c->data = data;
+	*cache = c;
+	return HAWKC_OK;
+}
+
+void hawkc_resolver_cache_free(HawkcContext ctx, HawkcResolverCache cache) {
+	int i;
+	if(cache == NULL) {
+		return;
+	}
+	for(i = 0; i < SHARDS; i++) {
+		if(cache->shards[i].entries != NULL) {
+			/* Do not leave the key material behind in freed memory */
+			hawkc_cleanse(cache->shards[i].entries,(cache->shards[i].mask + 1) * WAYS * sizeof(Entry));
+		}
+		hawkc_free(ctx,cache->shards[i].entries);
+	}
+	hawkc_cleanse(&(cache->id_key),sizeof(cache->id_key));
+	hawkc_free(ctx,cache->memory);
+}
+
+HawkcError hawkc_resolver_cache_lookup(HawkcContext ctx, HawkcResolverCache cache, const unsigned char *id, size_t id_len, HawkcKey key) {
+	HawkcError e;
+	uint64_t h1, h2;
+	Shard *s;
+	time_t now = hawkc_context_time(ctx);
+	time_t expires = 0;
+	Entry *set, *victim;
+	int i;
+
+	if( (e = digest_id(ctx,cache,id,id_len,&h1,&h2)) != HAWKC_OK) {
+		return e;
+	}
+	s = &(cache->shards[h1 & (SHARDS - 1)]);
+	lock_shard(s);
+	set = set_of(s,h1);
+	for(i = 0; i < WAYS; i++) {
+		Entry *x = &(set[i]);
+		if(x->algorithm != NULL && x->h1 == h1 && x->h2 == h2) {
+			if(x->expires != 0 && x->expires <= now) {
+				x->algorithm = NULL;
+				break;
+			}
+			x->used = ++(s->clock);
+			hawkc_key_import(key,x->algorithm,x->data);
+			unlock_shard(s);
+			return HAWKC_OK;
+		}
+	}
+	unlock_shard(s);
+
+	if( (e = cache->resolver(ctx,id,id_len,key,&expires,cache->data)) != HAWKC_OK) {
+		return e;
+	}
+	if(expires != 0 && expires <= now) {
+		return HAWKC_OK;
+	}
+
+	lock_shard(s);
+	set = set_of(s,h1);
+	victim = &(set[0]);
+	for(i = 0; i < WAYS; i++) {
+		Entry *x = &(set[i]);
+		if(x->algorithm == NULL || (x->h1 == h1 && x->h2 == h2) || (x->expires != 0 && x->expires <= now)) {
+			victim = x;
+			break;
+		}
+		if(x->used < victim->used) {
+			victim = x;
+		}
+	}
+	victim->h1 = h1;
+	victim->h2 = h2;
+	victim->algorithm = key->algorithm;
+	victim->expires = expires;
+	victim->used = ++(s->clock);
+	hawkc_key_export(key,victim->data);
+	unlock_shard(s);
+	return HAWKC_OK;
+}
+
+static HawkcError cache_resolver(HawkcContext ctx, const unsigned char *id, size_t id_len, HawkcKey key, void *data) {
+	return hawkc_resolver_cache_lookup(ctx,(HawkcResolverCache)data,id,id_len,key);
+}
+
+void hawkc_context_set_resolver_cache(HawkcContext ctx, HawkcResolverCache cache) {
+	hawkc_context_set_key_resolver(ctx,cache != NULL ? cache_resolver : NULL,cache);
+}
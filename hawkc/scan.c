@@ -0,0 +1,101 @@
+/*
+ * Byte scanners of the header parser and the request head scanner and the
+ * runtime selection of their kernels.
+ */
+#include "scan.h"
+
+typedef size_t (*HawkcScanFunc)(const unsigned char *s, size_t len);
+
+/*
+ * Kernels in use, NULL for the portable loops. Selected on first use by
+ * select_kernels().
+ */
+static int kernels_selected = 0;
+static HawkcScanFunc scan_token = NULL;
+static HawkcScanFunc scan_quoted = NULL;
+static HawkcScanFunc scan_field = NULL;
+
+int hawkc_scan_use_kernel(HawkcScanKernel kernel) {
+	switch(kernel) {
+	case HAWKC_SCAN_KERNEL_PORTABLE:
+		scan_token = scan_quoted = scan_field = NULL;
+		break;
+	case HAWKC_SCAN_KERNEL_SSSE3:
+		if(!hawkc_cpu_has_ssse3()) {
+			return 0;
+		}
+		scan_token = hawkc_scan_token_ssse3;
+		scan_quoted = hawkc_scan_quoted_ssse3;
+		scan_field = hawkc_scan_field_ssse3;
+		break;
+	case HAWKC_SCAN_KERNEL_AVX2:
+		if(!hawkc_cpu_has_avx2()) {
+			return 0;
+		}
+		scan_token = hawkc_scan_token_avx2;
+		scan_quoted = hawkc_scan_quoted_avx2;
+		scan_field = hawkc_scan_field_avx2;
+		break;
+	default:
+		return 0;
+	}
+	kernels_selected = 1;
+	return 1;
+}
+
+/*
+ * Select the widest kernels supported by the CPU. Concurrent first calls
+ * from several threads are harmless because all of them store the same
+ * function pointers.
+ */
+static void select_kernels(void) {
+	if(!hawkc_scan_use_kernel(HAWKC_SCAN_KERNEL_AVX2)
+			&& !hawkc_scan_use_kernel(HAWKC_SCAN_KERNEL_SSSE3)) {
+		hawkc_scan_use_kernel(HAWKC_SCAN_KERNEL_PORTABLE);
+	}
+}
+
+size_t hawkc_scan_token(const unsigned char *s, size_t len) {
+	size_t i = 0;
+
+	if(!kernels_selected) {
+		select_kernels();
+	}
+	if(scan_token != NULL) {
+		i = scan_token(s,len);
+	}
+	while(i < len && IS_TOKEN(s[i])) {
+		i++;
+	}
+	return i;
+}
+
+size_t hawkc_scan_quoted(const unsigned char *s, size_t len) {
+	size_t i = 0;
+
+	if(!kernels_selected) {
+		select_kernels();
+	}
+	if(scan_quoted != NULL) {
+		i = scan_quoted(s,len);
+	}
+	while(i < len && s[i] != '"' && s[i] != '\\') {
+		i++;
+	}
+	return i;
+}
+
+size_t hawkc_scan_field(const unsigned char *s, size_t len) {
+	size_t i = 0;
+
+	if(!kernels_selected) {
+		select_kernels();
+	}
+	if(scan_field != NULL) {
+		i = scan_field(s,len);
+	}
+	while(i < len && IS_FIELD_CHAR(s[i])) {
+		i++;
+	}
+	return i;
+}
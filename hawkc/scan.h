@@ -0,0 +1,92 @@
+#ifndef HAWKC_SCAN_H
+#define HAWKC_SCAN_H 1
+
+#include <stddef.h>
+#include "hawkc.h"
+#include "cpu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Byte scanners of the Authorization header parser and the request head
+ * scanner.
+ *
+ * The scanners are selected at runtime. On x86 CPUs with AVX2 they classify
+ * 32 bytes per step, with SSSE3 16 bytes, otherwise one byte at a time.
+ */
+
+/*
+ * Determine whether a given character is a token character according to
+ * http://tools.ietf.org/html/draft-ietf-httpbis-p1-messaging#section-3.2.6
+ *
+ * The x86 kernels use the same definition in table form, see scan_x86.c.
+ */
+#define IS_TOKEN(c) ( \
+	   ( (c) >= '0' && (c) <= '9') \
+	|| ( (c) >= 'A' && (c) <= 'Z') \
+	|| ( (c) >= '^' && (c) <= 'z') \
+	|| ( (c) >= '#' && (c) <= '\'') \
+	|| ( (c) == '!') || ((c) == '*') || ((c) == '+') || ((c) == '-') || ((c) == '.') )
+
+/*
+ * Determine whether a given character may appear in a request line or
+ * header field value: anything but control characters, except HT. Lines
+ * end at the first character that is not.
+ */
+#define IS_FIELD_CHAR(c) ( ((c) >= 0x20 && (c) != 0x7f) || (c) == '\t' )
+
+/*
+ * Scanner implementations available to hawkc_scan_use_kernel().
+ */
+typedef enum {
+	HAWKC_SCAN_KERNEL_PORTABLE,
+	HAWKC_SCAN_KERNEL_SSSE3,
+	HAWKC_SCAN_KERNEL_AVX2
+} HawkcScanKernel;
+
+/*
+ * Return the length of the longest prefix of s that consists of token
+ * characters, see IS_TOKEN.
+ */
+size_t HAWKCAPI hawkc_scan_token(const unsigned char *s, size_t len);
+
+/*
+ * Return the index of the first '"' or '\' in s, or len if there is none.
+ */
+size_t HAWKCAPI hawkc_scan_quoted(const unsigned char *s, size_t len);
+
+/*
+ * Return the length of the longest prefix of s that consists of
+ * characters for which IS_FIELD_CHAR is true.
+ */
+size_t HAWKCAPI hawkc_scan_field(const unsigned char *s, size_t len);
+
+/*
+ * Force the use of a specific kernel, mainly for testing and benchmarking.
+ * Returns 1 if the kernel is supported by the CPU and has been selected,
+ * 0 otherwise.
+ *
+ * Not thread safe, call before any header is parsed.
+ */
+int HAWKCAPI hawkc_scan_use_kernel(HawkcScanKernel kernel);
+
+/*
+ * x86 kernels (scan_x86.c). They only scan whole vectors and return the
+ * index of the first match, or the number of bytes scanned if there is none
+ * in them. The rest is left to the portable loop. The kernels must only be
+ * called if the corresponding hawkc_cpu_has_*() function returns 1.
+ */
+size_t hawkc_scan_token_ssse3(const unsigned char *s, size_t len);
+size_t hawkc_scan_token_avx2(const unsigned char *s, size_t len);
+size_t hawkc_scan_quoted_ssse3(const unsigned char *s, size_t len);
+size_t hawkc_scan_quoted_avx2(const unsigned char *s, size_t len);
+size_t hawkc_scan_field_ssse3(const unsigned char *s, size_t len);
+size_t hawkc_scan_field_avx2(const unsigned char *s, size_t len);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* !defined HAWKC_SCAN_H */
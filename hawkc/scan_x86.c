@@ -0,0 +1,182 @@
+/*
+ * x86 kernels of the header parser's byte scanners.
+ *
+ * Token characters are classified with two table lookups (pshufb) per
+ * vector, one for the low and one for the high nibble of each byte. Bit h
+ * of the low nibble table entry l is set if the character with high nibble
+ * h and low nibble l is a token character, and the high nibble table
+ * selects bit h. A byte is a token character if the two lookups have a bit
+ * in common. Bytes of 0x80 and above select no bit and are never tokens.
+ *
+ * Field characters are found with unsigned comparisons: a byte is a control
+ * character if it is at most 0x1f, which is when max(byte,0x1f) equals 0x1f,
+ * or if it is 0x7f.
+ *
+ * Kernels are compiled with function level target attributes, so the rest
+ * of hawkc does not need to be built for these instruction sets. On other
+ * architectures or compilers this file only provides stubs, which are never
+ * called because cpu.c reports the features as unavailable.
+ */
+#include "scan.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+
+#include <immintrin.h>
+
+#define SSSE3_TARGET __attribute__((target("ssse3")))
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+/*
+ * IS_TOKEN of scan.h by nibbles, see above.
+ */
+static const unsigned char token_lo[16] = {
+	0xe8, 0xfc, 0xf8, 0xfc, 0xfc, 0xfc, 0xfc, 0xfc,
+	0xf8, 0xf8, 0xf4, 0x54, 0x50, 0x54, 0x74, 0x70
+};
+static const unsigned char token_hi[16] = {
+	0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+SSSE3_TARGET
+size_t hawkc_scan_token_ssse3(const unsigned char *s, size_t len) {
+	const __m128i lo_table = _mm_loadu_si128((const __m128i*)token_lo);
+	const __m128i hi_table = _mm_loadu_si128((const __m128i*)token_hi);
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	const __m128i zero = _mm_setzero_si128();
+	size_t i;
+
+	for(i = 0; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+		__m128i lo = _mm_shuffle_epi8(lo_table,_mm_and_si128(v,nibble));
+		__m128i hi = _mm_shuffle_epi8(hi_table,_mm_and_si128(_mm_srli_epi16(v,4),nibble));
+		unsigned int m = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo,hi),zero));
+		if(m != 0) {
+			return i + (size_t)__builtin_ctz(m);
+		}
+	}
+	return i;
+}
+
+AVX2_TARGET
+size_t hawkc_scan_token_avx2(const unsigned char *s, size_t len) {
+	const __m256i lo_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)token_lo));
+	const __m256i hi_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)token_hi));
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i;
+
+	for(i = 0; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+		__m256i lo = _mm256_shuffle_epi8(lo_table,_mm256_and_si256(v,nibble));
+		__m256i hi = _mm256_shuffle_epi8(hi_table,_mm256_and_si256(_mm256_srli_epi16(v,4),nibble));
+		unsigned int m = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(lo,hi),zero));
+		if(m != 0) {
+			return i + (size_t)__builtin_ctz(m);
+		}
+	}
+	return i;
+}
+
+SSSE3_TARGET
+size_t hawkc_scan_quoted_ssse3(const unsigned char *s, size_t len) {
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	size_t i;
+
+	for(i = 0; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+		unsigned int m = (unsigned int)_mm_movemask_epi8(
+				_mm_or_si128(_mm_cmpeq_epi8(v,quote),_mm_cmpeq_epi8(v,backslash)));
+		if(m != 0) {
+			return i + (size_t)__builtin_ctz(m);
+		}
+	}
+	return i;
+}
+
+AVX2_TARGET
+size_t hawkc_scan_quoted_avx2(const unsigned char *s, size_t len) {
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	size_t i;
+
+	for(i = 0; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+		unsigned int m = (unsigned int)_mm256_movemask_epi8(
+				_mm256_or_si256(_mm256_cmpeq_epi8(v,quote),_mm256_cmpeq_epi8(v,backslash)));
+		if(m != 0) {
+			return i + (size_t)__builtin_ctz(m);
+		}
+	}
+	return i;
+}
+
+SSSE3_TARGET
+size_t hawkc_scan_field_ssse3(const unsigned char *s, size_t len) {
+	const __m128i ctl_max = _mm_set1_epi8(0x1f);
+	const __m128i del = _mm_set1_epi8(0x7f);
+	const __m128i tab = _mm_set1_epi8('\t');
+	size_t i;
+
+	for(i = 0; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+		__m128i ctl = _mm_andnot_si128(_mm_cmpeq_epi8(v,tab),_mm_cmpeq_epi8(_mm_max_epu8(v,ctl_max),ctl_max));
+		unsigned int m = (unsigned int)_mm_movemask_epi8(_mm_or_si128(ctl,_mm_cmpeq_epi8(v,del)));
+		if(m != 0) {
+			return i + (size_t)__builtin_ctz(m);
+		}
+	}
+	return i;
+}
+
+AVX2_TARGET
+size_t hawkc_scan_field_avx2(const unsigned char *s, size_t len) {
+	const __m256i ctl_max = _mm256_set1_epi8(0x1f);
+	const __m256i del = _mm256_set1_epi8(0x7f);
+	const __m256i tab = _mm256_set1_epi8('\t');
+	size_t i;
+
+	for(i = 0; i + 32 <= len; i += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(s + i));
+		__m256i ctl = _mm256_andnot_si256(_mm256_cmpeq_epi8(v,tab),_mm256_cmpeq_epi8(_mm256_max_epu8(v,ctl_max),ctl_max));
+		unsigned int m = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(ctl,_mm256_cmpeq_epi8(v,del)));
+		if(m != 0) {
+			return i + (size_t)__builtin_ctz(m);
+		}
+	}
+	return i;
+}
+
+#else
+
+/*
+ * No x86 kernels on this platform. Scanning nothing leaves all bytes to the
+ * portable loops.
+ */
+
+size_t hawkc_scan_token_ssse3(const unsigned char *s, size_t len) {
+	return 0;
+}
+
+size_t hawkc_scan_token_avx2(const unsigned char *s, size_t len) {
+	return 0;
+}
+
+size_t hawkc_scan_quoted_ssse3(const unsigned char *s, size_t len) {
+	return 0;
+}
+
+size_t hawkc_scan_quoted_avx2(const unsigned char *s, size_t len) {
+	return 0;
+}
+
+size_t hawkc_scan_field_ssse3(const unsigned char *s, size_t len) {
+	return 0;
+}
+
+size_t hawkc_scan_field_avx2(const unsigned char *s, size_t len) {
+	return 0;
+}
+
+#endif
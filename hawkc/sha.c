@@ -0,0 +1,626 @@
+/*
+ * Portable SHA-1 (FIPS 180-4, section 6.1), SHA-256 (section 6.2) and
+ * SHA-512 (section 6.4) and the runtime selection of the compression
+ * functions.
+ */
+#include <string.h>
+#include <assert.h>
+#include "sha.h"
+
+#define ROTL(x,n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROTR(x,n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define ROTR64(x,n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+#define LOAD32_BE(p) ( ((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3] )
+#define LOAD64_BE(p) ( ((uint64_t)LOAD32_BE(p) << 32) | (uint64_t)LOAD32_BE((p) + 4) )
+
+const uint32_t hawkc_sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint64_t sha512_k[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+void hawkc_sha1_compress_portable(uint32_t *h, const unsigned char *blocks, size_t nblocks) {
+	uint32_t w[80];
+	uint32_t a,b,c,d,e,t;
+	int i;
+
+	while(nblocks-- > 0) {
+		for(i = 0; i < 16; i++) {
+			w[i] = LOAD32_BE(blocks + 4*i);
+		}
+		for(i = 16; i < 80; i++) {
+			w[i] = ROTL(w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16],1);
+		}
+		a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+		for(i = 0; i < 20; i++) {
+			t = ROTL(a,5) + ((b & c) | (~b & d)) + e + 0x5a827999 + w[i];
+			e = d; d = c; c = ROTL(b,30); b = a; a = t;
+		}
+		for(i = 20; i < 40; i++) {
+			t = ROTL(a,5) + (b ^ c ^ d) + e + 0x6ed9eba1 + w[i];
+			e = d; d = c; c = ROTL(b,30); b = a; a = t;
+		}
+		for(i = 40; i < 60; i++) {
+			t = ROTL(a,5) + ((b & c) | (b & d) | (c & d)) + e + 0x8f1bbcdc + w[i];
+			e = d; d = c; c = ROTL(b,30); b = a; a = t;
+		}
+		for(i = 60; i < 80; i++) {
+			t = ROTL(a,5) + (b ^ c ^ d) + e + 0xca62c1d6 + w[i];
+			e = d; d = c; c = ROTL(b,30); b = a; a = t;
+		}
+		h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+		blocks += HAWKC_SHA_BLOCK_BYTES;
+	}
+}
+
+void hawkc_sha256_compress_portable(uint32_t *h, const unsigned char *blocks, size_t nblocks) {
+	uint32_t w[64];
+	uint32_t a,b,c,d,e,f,g,hh,t1,t2;
+	int i;
+
+	while(nblocks-- > 0) {
+		for(i = 0; i < 16; i++) {
+			w[i] = LOAD32_BE(blocks + 4*i);
+		}
+		for(i = 16; i < 64; i++) {
+			uint32_t s0 = ROTR(w[i-15],7) ^ ROTR(w[i-15],18) ^ (w[i-15] >> 3);
+			uint32_t s1 = ROTR(w[i-2],17) ^ ROTR(w[i-2],19) ^ (w[i-2] >> 10);
+			w[i] = w[i-16] + s0 + w[i-7] + s1;
+		}
+		a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+		for(i = 0; i < 64; i++) {
+			t1 = hh + (ROTR(e,6) ^ ROTR(e,11) ^ ROTR(e,25)) + ((e & f) ^ (~e & g)) + hawkc_sha256_k[i] + w[i];
+			t2 = (ROTR(a,2) ^ ROTR(a,13) ^ ROTR(a,22)) + ((a & b) ^ (a & c) ^ (b & c));
+			hh = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+		h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+		h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+		blocks += HAWKC_SHA_BLOCK_BYTES;
+	}
+}
+
+void hawkc_sha512_compress_portable(uint64_t *h, const unsigned char *blocks, size_t nblocks) {
+	uint64_t w[80];
+	uint64_t a,b,c,d,e,f,g,hh,t1,t2;
+	int i;
+
+	while(nblocks-- > 0) {
+		for(i = 0; i < 16; i++) {
+			w[i] = LOAD64_BE(blocks + 8*i);
+		}
+		for(i = 16; i < 80; i++) {
+			uint64_t s0 = ROTR64(w[i-15],1) ^ ROTR64(w[i-15],8) ^ (w[i-15] >> 7);
+			uint64_t s1 = ROTR64(w[i-2],19) ^ ROTR64(w[i-2],61) ^ (w[i-2] >> 6);
+			w[i] = w[i-16] + s0 + w[i-7] + s1;
+		}
+		a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+		for(i = 0; i < 80; i++) {
+			t1 = hh + (ROTR64(e,14) ^ ROTR64(e,18) ^ ROTR64(e,41)) + ((e & f) ^ (~e & g)) + sha512_k[i] + w[i];
+			t2 = (ROTR64(a,28) ^ ROTR64(a,34) ^ ROTR64(a,39)) + ((a & b) ^ (a & c) ^ (b & c));
+			hh = g; g = f; f = e; e = d + t1;
+			d = c; c = b; b = a; a = t1 + t2;
+		}
+		h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+		h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+		blocks += HAWKC_SHA512_BLOCK_BYTES;
+	}
+}
+
+/*
+ * Compression functions in use. Selected on first use by select_kernels().
+ *
+ * The multi-buffer kernels compress sha*_lanes_width messages at once.
+ * A NULL kernel means messages are compressed one at a time.
+ */
+static HawkcShaCompressFunc sha1_compress = NULL;
+static HawkcShaCompressFunc sha256_compress = NULL;
+static HawkcShaCompressLanesFunc sha1_lanes = NULL;
+static HawkcShaCompressLanesFunc sha256_lanes = NULL;
+static size_t sha1_lanes_width = 1;
+static size_t sha256_lanes_width = 1;
+
+/*
+ * Select the widest multi-buffer kernels the CPU supports.
+ */
+static void use_lanes(void) {
+	if(hawkc_cpu_has_avx2()) {
+		sha1_lanes = hawkc_sha1_compress_x8_avx2;
+		sha256_lanes = hawkc_sha256_compress_x8_avx2;
+		sha1_lanes_width = sha256_lanes_width = 8;
+	} else if(hawkc_cpu_has_sse2()) {
+		sha1_lanes = hawkc_sha1_compress_x4_sse2;
+		sha256_lanes = hawkc_sha256_compress_x4_sse2;
+		sha1_lanes_width = sha256_lanes_width = 4;
+	} else {
+		sha1_lanes = sha256_lanes = NULL;
+		sha1_lanes_width = sha256_lanes_width = 1;
+	}
+}
+
+int hawkc_sha_use_kernel(HawkcShaKernel kernel) {
+	switch(kernel) {
+	case HAWKC_SHA_KERNEL_PORTABLE:
+		sha1_compress = hawkc_sha1_compress_portable;
+		sha256_compress = hawkc_sha256_compress_portable;
+		sha1_lanes = sha256_lanes = NULL;
+		sha1_lanes_width = sha256_lanes_width = 1;
+		return 1;
+	case HAWKC_SHA_KERNEL_AVX2:
+		if(!hawkc_cpu_has_avx2()) {
+			return 0;
+		}
+		sha1_compress = hawkc_sha1_compress_avx2;
+		sha256_compress = hawkc_sha256_compress_avx2;
+		use_lanes();
+		return 1;
+	case HAWKC_SHA_KERNEL_SHANI:
+		if(!hawkc_cpu_has_shani()) {
+			return 0;
+		}
+		sha1_compress = hawkc_sha1_compress_shani;
+		sha256_compress = hawkc_sha256_compress_shani;
+		use_lanes();
+		/*
+		 * SHA-NI compresses a SHA-256 block faster than the multi-buffer
+		 * kernels compress one lane, for SHA-1 eight AVX2 lanes still win.
+		 */
+		sha256_lanes = NULL;
+		sha256_lanes_width = 1;
+		if(sha1_lanes_width < 8) {
+			sha1_lanes = NULL;
+			sha1_lanes_width = 1;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Select the fastest kernels supported by the CPU. Concurrent first calls
+ * from several threads are harmless because all of them store the same
+ * function pointers.
+ */
+static void select_kernels(void) {
+	if(!hawkc_sha_use_kernel(HAWKC_SHA_KERNEL_SHANI)
+			&& !hawkc_sha_use_kernel(HAWKC_SHA_KERNEL_AVX2)) {
+		hawkc_sha_use_kernel(HAWKC_SHA_KERNEL_PORTABLE);
+	}
+}
+
+/*
+ * Compress nlanes independent messages with the multi-buffer kernel, see
+ * hawkc_sha1_compress_lanes().
+ *
+ * Each round takes up to width lanes that still have blocks left and
+ * compresses as many blocks as the shortest of them has. Unused kernel
+ * lanes work on a dummy chaining value and repeat the first message's
+ * blocks. Once fewer than two lanes are left, the rest is cheaper with the
+ * single message kernel.
+ */
+static void compress_lanes(HawkcShaCompressFunc compress, HawkcShaCompressLanesFunc lanes, size_t width,
+		uint32_t *const *h, const unsigned char *const *blocks, const size_t *nblocks, size_t nlanes) {
+	const unsigned char *pos[HAWKC_SHA_MAX_LANES];
+	size_t left[HAWKC_SHA_MAX_LANES];
+	uint32_t *kh[HAWKC_SHA_MAX_LANES];
+	const unsigned char *kblocks[HAWKC_SHA_MAX_LANES];
+	size_t idx[HAWKC_SHA_MAX_LANES];
+	uint32_t dummy[HAWKC_SHA_MAX_LANES][8];
+	size_t i, n, m;
+
+	assert(nlanes <= HAWKC_SHA_MAX_LANES);
+
+	for(i = 0; i < nlanes; i++) {
+		pos[i] = blocks[i];
+		left[i] = nblocks[i];
+	}
+
+	while(lanes != NULL) {
+		n = 0;
+		for(i = 0; i < nlanes && n < width; i++) {
+			if(left[i] > 0) {
+				idx[n++] = i;
+			}
+		}
+		if(n < 2) {
+			break;
+		}
+		m = left[idx[0]];
+		for(i = 1; i < n; i++) {
+			if(left[idx[i]] < m) {
+				m = left[idx[i]];
+			}
+		}
+		for(i = 0; i < width; i++) {
+			if(i < n) {
+				kh[i] = h[idx[i]];
+				kblocks[i] = pos[idx[i]];
+			} else {
+				kh[i] = dummy[i];
+				kblocks[i] = pos[idx[0]];
+			}
+		}
+		lanes(kh,kblocks,m);
+		for(i = 0; i < n; i++) {
+			pos[idx[i]] += m * HAWKC_SHA_BLOCK_BYTES;
+			left[idx[i]] -= m;
+		}
+	}
+
+	for(i = 0; i < nlanes; i++) {
+		if(left[i] > 0) {
+			compress(h[i],pos[i],left[i]);
+		}
+	}
+}
+
+void hawkc_sha1_compress_lanes(uint32_t *const *h, const unsigned char *const *blocks, const size_t *nblocks, size_t nlanes) {
+	if(sha1_compress == NULL) {
+		select_kernels();
+	}
+	compress_lanes(sha1_compress,sha1_lanes,sha1_lanes_width,h,blocks,nblocks,nlanes);
+}
+
+void hawkc_sha256_compress_lanes(uint32_t *const *h, const unsigned char *const *blocks, const size_t *nblocks, size_t nlanes) {
+	if(sha256_compress == NULL) {
+		select_kernels();
+	}
+	compress_lanes(sha256_compress,sha256_lanes,sha256_lanes_width,h,blocks,nblocks,nlanes);
+}
+
+/*
+ * Update and finalization are the same for SHA-1 and SHA-256, except for
+ * the compression function and the digest length.
+ */
+static void sha_update(HawkcShaCtx *ctx, HawkcShaCompressFunc compress, const unsigned char *data, size_t len) {
+	size_t used = (size_t)(ctx->len % HAWKC_SHA_BLOCK_BYTES);
+	size_t nblocks;
+
+	ctx->len += len;
+
+	if(used > 0) {
+		size_t fill = HAWKC_SHA_BLOCK_BYTES - used;
+		if(len < fill) {
+			memcpy(ctx->buf + used,data,len);
+			return;
+		}
+		memcpy(ctx->buf + used,data,fill);
+		compress(ctx->h,ctx->buf,1);
+		data += fill;
+		len -= fill;
+	}
+	nblocks = len / HAWKC_SHA_BLOCK_BYTES;
+	if(nblocks > 0) {
+		compress(ctx->h,data,nblocks);
+		data += nblocks * HAWKC_SHA_BLOCK_BYTES;
+		len -= nblocks * HAWKC_SHA_BLOCK_BYTES;
+	}
+	if(len > 0) {
+		memcpy(ctx->buf,data,len);
+	}
+}
+
+static void store_digest(const uint32_t *h, unsigned char *digest, int nwords) {
+	int i;
+	for(i = 0; i < nwords; i++) {
+		digest[4*i] = (unsigned char)(h[i] >> 24);
+		digest[4*i+1] = (unsigned char)(h[i] >> 16);
+		digest[4*i+2] = (unsigned char)(h[i] >> 8);
+		digest[4*i+3] = (unsigned char)h[i];
+	}
+}
+
+/*
+ * Store the message length in bits at the end of the final block.
+ */
+static void store_bit_length(unsigned char *block_end, uint64_t len) {
+	uint64_t bits = len * 8;
+	int i;
+	for(i = 1; i <= 8; i++) {
+		block_end[-i] = (unsigned char)bits;
+		bits >>= 8;
+	}
+}
+
+static void sha_final(HawkcShaCtx *ctx, HawkcShaCompressFunc compress, unsigned char *digest, int nwords) {
+	size_t used = (size_t)(ctx->len % HAWKC_SHA_BLOCK_BYTES);
+
+	ctx->buf[used++] = 0x80;
+	if(used > HAWKC_SHA_BLOCK_BYTES - 8) {
+		memset(ctx->buf + used,0,HAWKC_SHA_BLOCK_BYTES - used);
+		compress(ctx->h,ctx->buf,1);
+		used = 0;
+	}
+	memset(ctx->buf + used,0,HAWKC_SHA_BLOCK_BYTES - 8 - used);
+	store_bit_length(ctx->buf + HAWKC_SHA_BLOCK_BYTES,ctx->len);
+	compress(ctx->h,ctx->buf,1);
+
+	store_digest(ctx->h,digest,nwords);
+}
+
+/*
+ * The outer HMAC hash covers one block of key pad and the inner digest,
+ * which leaves a single block of digest, padding and length to compress.
+ */
+static void sha_hmac_outer(const HawkcShaCtx *outer, HawkcShaCompressFunc compress, unsigned char *digest, int nwords) {
+	unsigned char block[HAWKC_SHA_BLOCK_BYTES];
+	uint32_t h[8];
+
+	memcpy(h,outer->h,sizeof(h));
+	memcpy(block,digest,4 * nwords);
+	block[4 * nwords] = 0x80;
+	memset(block + 4 * nwords + 1,0,HAWKC_SHA_BLOCK_BYTES - 8 - 4 * nwords - 1);
+	store_bit_length(block + HAWKC_SHA_BLOCK_BYTES,outer->len + 4 * nwords);
+	compress(h,block,1);
+	store_digest(h,digest,nwords);
+}
+
+/*
+ * HMACs of several messages, see hawkc_sha1_hmac_lanes().
+ *
+ * The full blocks of every message are compressed in place, then the
+ * padded tails (one or two blocks), then the single outer block.
+ */
+static void sha_hmac_lanes(void (*compress_lanes)(uint32_t *const *, const unsigned char *const *, const size_t *, size_t),
+		int nwords, const HawkcShaCtx *const *inner, const HawkcShaCtx *const *outer,
+		const unsigned char *const *data, const size_t *len, size_t nlanes, unsigned char *const *digest) {
+	uint32_t h[HAWKC_SHA_MAX_LANES][8];
+	uint32_t *hp[HAWKC_SHA_MAX_LANES] = { NULL };
+	const unsigned char *blocks[HAWKC_SHA_MAX_LANES] = { NULL };
+	size_t nblocks[HAWKC_SHA_MAX_LANES] = { 0 };
+	unsigned char tail[HAWKC_SHA_MAX_LANES][2 * HAWKC_SHA_BLOCK_BYTES];
+	size_t dlen = 4 * nwords;
+	size_t i;
+
+	assert(nlanes <= HAWKC_SHA_MAX_LANES);
+
+	for(i = 0; i < nlanes; i++) {
+		assert(inner[i]->len % HAWKC_SHA_BLOCK_BYTES == 0);
+		memcpy(h[i],inner[i]->h,sizeof(h[i]));
+		hp[i] = h[i];
+		blocks[i] = data[i];
+		nblocks[i] = len[i] / HAWKC_SHA_BLOCK_BYTES;
+	}
+	compress_lanes(hp,blocks,nblocks,nlanes);
+
+	for(i = 0; i < nlanes; i++) {
+		size_t rest = len[i] % HAWKC_SHA_BLOCK_BYTES;
+		size_t n = rest + 9 <= HAWKC_SHA_BLOCK_BYTES ? 1 : 2;
+		memcpy(tail[i],data[i] + len[i] - rest,rest);
+		tail[i][rest] = 0x80;
+		memset(tail[i] + rest + 1,0,n * HAWKC_SHA_BLOCK_BYTES - 8 - rest - 1);
+		store_bit_length(tail[i] + n * HAWKC_SHA_BLOCK_BYTES,inner[i]->len + len[i]);
+		blocks[i] = tail[i];
+		nblocks[i] = n;
+	}
+	compress_lanes(hp,blocks,nblocks,nlanes);
+
+	for(i = 0; i < nlanes; i++) {
+		store_digest(h[i],tail[i],nwords);
+		tail[i][dlen] = 0x80;
+		memset(tail[i] + dlen + 1,0,HAWKC_SHA_BLOCK_BYTES - 8 - dlen - 1);
+		store_bit_length(tail[i] + HAWKC_SHA_BLOCK_BYTES,outer[i]->len + dlen);
+		memcpy(h[i],outer[i]->h,sizeof(h[i]));
+		nblocks[i] = 1;
+	}
+	compress_lanes(hp,blocks,nblocks,nlanes);
+
+	for(i = 0; i < nlanes; i++) {
+		store_digest(h[i],digest[i],nwords);
+	}
+}
+
+void hawkc_sha1_init(HawkcShaCtx *ctx) {
+	if(sha1_compress == NULL) {
+		select_kernels();
+	}
+	ctx->h[0] = 0x67452301;
+	ctx->h[1] = 0xefcdab89;
+	ctx->h[2] = 0x98badcfe;
+	ctx->h[3] = 0x10325476;
+	ctx->h[4] = 0xc3d2e1f0;
+	ctx->len = 0;
+}
+
+void hawkc_sha1_update(HawkcShaCtx *ctx, const unsigned char *data, size_t len) {
+	sha_update(ctx,sha1_compress,data,len);
+}
+
+void hawkc_sha1_final(HawkcShaCtx *ctx, unsigned char *digest) {
+	sha_final(ctx,sha1_compress,digest,5);
+}
+
+void hawkc_sha1_hmac_outer(const HawkcShaCtx *outer, unsigned char *digest) {
+	sha_hmac_outer(outer,sha1_compress,digest,5);
+}
+
+void hawkc_sha1_hmac_lanes(const HawkcShaCtx *const *inner, const HawkcShaCtx *const *outer,
+		const unsigned char *const *data, const size_t *len, size_t nlanes, unsigned char *const *digest) {
+	sha_hmac_lanes(hawkc_sha1_compress_lanes,5,inner,outer,data,len,nlanes,digest);
+}
+
+void hawkc_sha256_init(HawkcShaCtx *ctx) {
+	if(sha256_compress == NULL) {
+		select_kernels();
+	}
+	ctx->h[0] = 0x6a09e667;
+	ctx->h[1] = 0xbb67ae85;
+	ctx->h[2] = 0x3c6ef372;
+	ctx->h[3] = 0xa54ff53a;
+	ctx->h[4] = 0x510e527f;
+	ctx->h[5] = 0x9b05688c;
+	ctx->h[6] = 0x1f83d9ab;
+	ctx->h[7] = 0x5be0cd19;
+	ctx->len = 0;
+}
+
+void hawkc_sha256_update(HawkcShaCtx *ctx, const unsigned char *data, size_t len) {
+	sha_update(ctx,sha256_compress,data,len);
+}
+
+void hawkc_sha256_final(HawkcShaCtx *ctx, unsigned char *digest) {
+	sha_final(ctx,sha256_compress,digest,8);
+}
+
+void hawkc_sha256_hmac_outer(const HawkcShaCtx *outer, unsigned char *digest) {
+	sha_hmac_outer(outer,sha256_compress,digest,8);
+}
+
+void hawkc_sha256_hmac_lanes(const HawkcShaCtx *const *inner, const HawkcShaCtx *const *outer,
+		const unsigned char *const *data, const size_t *len, size_t nlanes, unsigned char *const *digest) {
+	sha_hmac_lanes(hawkc_sha256_compress_lanes,8,inner,outer,data,len,nlanes,digest);
+}
+
+/*
+ * SHA-512 has its own block size and a 128 bit length field, of which
+ * only the low 67 bits can be non-zero with a 64 bit byte count.
+ */
+static void store_bit_length128(unsigned char *block_end, uint64_t len) {
+	store_bit_length(block_end,len);
+	memset(block_end - 16,0,8);
+	block_end[-9] = (unsigned char)(len >> 61);
+}
+
+static void store_digest64(const uint64_t *h, unsigned char *digest, int nwords) {
+	int i, j;
+	for(i = 0; i < nwords; i++) {
+		for(j = 0; j < 8; j++) {
+			digest[8*i+j] = (unsigned char)(h[i] >> (56 - 8*j));
+		}
+	}
+}
+
+void hawkc_sha512_update(HawkcSha512Ctx *ctx, const unsigned char *data, size_t len) {
+	size_t used = (size_t)(ctx->len % HAWKC_SHA512_BLOCK_BYTES);
+	size_t nblocks;
+
+	ctx->len += len;
+
+	if(used > 0) {
+		size_t fill = HAWKC_SHA512_BLOCK_BYTES - used;
+		if(len < fill) {
+			memcpy(ctx->buf + used,data,len);
+			return;
+		}
+		memcpy(ctx->buf + used,data,fill);
+		hawkc_sha512_compress_portable(ctx->h,ctx->buf,1);
+		data += fill;
+		len -= fill;
+	}
+	nblocks = len / HAWKC_SHA512_BLOCK_BYTES;
+	if(nblocks > 0) {
+		hawkc_sha512_compress_portable(ctx->h,data,nblocks);
+		data += nblocks * HAWKC_SHA512_BLOCK_BYTES;
+		len -= nblocks * HAWKC_SHA512_BLOCK_BYTES;
+	}
+	if(len > 0) {
+		memcpy(ctx->buf,data,len);
+	}
+}
+
+static void sha512_final(HawkcSha512Ctx *ctx, unsigned char *digest, int nwords) {
+	size_t used = (size_t)(ctx->len % HAWKC_SHA512_BLOCK_BYTES);
+
+	ctx->buf[used++] = 0x80;
+	if(used > HAWKC_SHA512_BLOCK_BYTES - 16) {
+		memset(ctx->buf + used,0,HAWKC_SHA512_BLOCK_BYTES - used);
+		hawkc_sha512_compress_portable(ctx->h,ctx->buf,1);
+		used = 0;
+	}
+	memset(ctx->buf + used,0,HAWKC_SHA512_BLOCK_BYTES - 16 - used);
+	store_bit_length128(ctx->buf + HAWKC_SHA512_BLOCK_BYTES,ctx->len);
+	hawkc_sha512_compress_portable(ctx->h,ctx->buf,1);
+
+	store_digest64(ctx->h,digest,nwords);
+}
+
+/*
+ * Like sha_hmac_outer(), the inner digest of 48 or 64 bytes, padding and
+ * length fit into one block.
+ */
+static void sha512_hmac_outer(const HawkcSha512Ctx *outer, unsigned char *digest, int nwords) {
+	unsigned char block[HAWKC_SHA512_BLOCK_BYTES];
+	uint64_t h[8];
+
+	memcpy(h,outer->h,sizeof(h));
+	memcpy(block,digest,8 * nwords);
+	block[8 * nwords] = 0x80;
+	memset(block + 8 * nwords + 1,0,HAWKC_SHA512_BLOCK_BYTES - 16 - 8 * nwords - 1);
+	store_bit_length128(block + HAWKC_SHA512_BLOCK_BYTES,outer->len + 8 * nwords);
+	hawkc_sha512_compress_portable(h,block,1);
+	store_digest64(h,digest,nwords);
+}
+
+void hawkc_sha384_init(HawkcSha512Ctx *ctx) {
+	ctx->h[0] = 0xcbbb9d5dc1059ed8ULL;
+	ctx->h[1] = 0x629a292a367cd507ULL;
+	ctx->h[2] = 0x9159015a3070dd17ULL;
+	ctx->h[3] = 0x152fecd8f70e5939ULL;
+	ctx->h[4] = 0x67332667ffc00b31ULL;
+	ctx->h[5] = 0x8eb44a8768581511ULL;
+	ctx->h[6] = 0xdb0c2e0d64f98fa7ULL;
+	ctx->h[7] = 0x47b5481dbefa4fa4ULL;
+	ctx->len = 0;
+}
+
+void hawkc_sha384_update(HawkcSha512Ctx *ctx, const unsigned char *data, size_t len) {
+	hawkc_sha512_update(ctx,data,len);
+}
+
+void hawkc_sha384_final(HawkcSha512Ctx *ctx, unsigned char *digest) {
+	sha512_final(ctx,digest,6);
+}
+
+void hawkc_sha384_hmac_outer(const HawkcSha512Ctx *outer, unsigned char *digest) {
+	sha512_hmac_outer(outer,digest,6);
+}
+
+void hawkc_sha512_init(HawkcSha512Ctx *ctx) {
+	ctx->h[0] = 0x6a09e667f3bcc908ULL;
+	ctx->h[1] = 0xbb67ae8584caa73bULL;
+	ctx->h[2] = 0x3c6ef372fe94f82bULL;
+	ctx->h[3] = 0xa54ff53a5f1d36f1ULL;
+	ctx->h[4] = 0x510e527fade682d1ULL;
+	ctx->h[5] = 0x9b05688c2b3e6c1fULL;
+	ctx->h[6] = 0x1f83d9abfb41bd6bULL;
+	ctx->h[7] = 0x5be0cd19137e2179ULL;
+	ctx->len = 0;
+}
+
+void hawkc_sha512_final(HawkcSha512Ctx *ctx, unsigned char *digest) {
+	sha512_final(ctx,digest,8);
+}
+
+void hawkc_sha512_hmac_outer(const HawkcSha512Ctx *outer, unsigned char *digest) {
+	sha512_hmac_outer(outer,digest,8);
+}
@@ -0,0 +1,166 @@
+#ifndef HAWKC_SHA_H
+#define HAWKC_SHA_H 1
+
+#include <stdint.h>
+#include "hawkc.h"
+#include "cpu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * SHA-1, SHA-256, SHA-384 and SHA-512 implementation of the native crypto
+ * backend.
+ *
+ * The SHA-1 and SHA-256 compression functions are selected at runtime. On
+ * x86 CPUs with the SHA extensions the SHA-NI kernels are used, otherwise
+ * the AVX2 kernels if AVX2 and BMI2 are available, and the portable C code
+ * in any other case. SHA-384 and SHA-512 are portable C, which already
+ * beats SHA-256 per byte on 64-bit CPUs without SHA-NI.
+ */
+
+#define HAWKC_SHA_BLOCK_BYTES 64
+#define HAWKC_SHA1_DIGEST_BYTES 20
+#define HAWKC_SHA256_DIGEST_BYTES 32
+#define HAWKC_SHA512_BLOCK_BYTES 128
+#define HAWKC_SHA384_DIGEST_BYTES 48
+#define HAWKC_SHA512_DIGEST_BYTES 64
+
+/*
+ * Compression function type. Processes nblocks consecutive 64 byte blocks
+ * and updates the chaining value h.
+ */
+typedef void (*HawkcShaCompressFunc)(uint32_t *h, const unsigned char *blocks, size_t nblocks);
+
+/*
+ * Multi-buffer compression function type. Processes nblocks consecutive
+ * blocks for each of a fixed number of independent messages, message i
+ * starting at blocks[i] with chaining value h[i].
+ */
+typedef void (*HawkcShaCompressLanesFunc)(uint32_t *const *h, const unsigned char *const *blocks, size_t nblocks);
+
+/*
+ * Maximum number of messages hawkc_sha*_compress_lanes() accept per call.
+ */
+#define HAWKC_SHA_MAX_LANES 8
+
+/*
+ * Running SHA-1 or SHA-256 computation. SHA-1 only uses the first five
+ * words of h.
+ */
+typedef struct HawkcShaCtx {
+	uint32_t h[8];
+	uint64_t len;
+	unsigned char buf[HAWKC_SHA_BLOCK_BYTES];
+} HawkcShaCtx;
+
+/*
+ * Running SHA-384 or SHA-512 computation.
+ */
+typedef struct HawkcSha512Ctx {
+	uint64_t h[8];
+	uint64_t len;
+	unsigned char buf[HAWKC_SHA512_BLOCK_BYTES];
+} HawkcSha512Ctx;
+
+/*
+ * Compression function implementations available to hawkc_sha_use_kernel().
+ */
+typedef enum {
+	HAWKC_SHA_KERNEL_PORTABLE,
+	HAWKC_SHA_KERNEL_AVX2,
+	HAWKC_SHA_KERNEL_SHANI
+} HawkcShaKernel;
+
+void HAWKCAPI hawkc_sha1_init(HawkcShaCtx *ctx);
+void HAWKCAPI hawkc_sha1_update(HawkcShaCtx *ctx, const unsigned char *data, size_t len);
+void HAWKCAPI hawkc_sha1_final(HawkcShaCtx *ctx, unsigned char *digest);
+
+void HAWKCAPI hawkc_sha256_init(HawkcShaCtx *ctx);
+void HAWKCAPI hawkc_sha256_update(HawkcShaCtx *ctx, const unsigned char *data, size_t len);
+void HAWKCAPI hawkc_sha256_final(HawkcShaCtx *ctx, unsigned char *digest);
+
+void HAWKCAPI hawkc_sha384_init(HawkcSha512Ctx *ctx);
+void HAWKCAPI hawkc_sha384_update(HawkcSha512Ctx *ctx, const unsigned char *data, size_t len);
+void HAWKCAPI hawkc_sha384_final(HawkcSha512Ctx *ctx, unsigned char *digest);
+
+void HAWKCAPI hawkc_sha512_init(HawkcSha512Ctx *ctx);
+void HAWKCAPI hawkc_sha512_update(HawkcSha512Ctx *ctx, const unsigned char *data, size_t len);
+void HAWKCAPI hawkc_sha512_final(HawkcSha512Ctx *ctx, unsigned char *digest);
+
+/*
+ * Compute the outer hash of an HMAC. outer is the state after hashing the
+ * outer key pad, digest holds the inner digest on input and the HMAC on
+ * output. Equivalent to update and final on a copy of outer, but the inner
+ * digest and the padding fit into a single block that is compressed
+ * directly.
+ */
+void HAWKCAPI hawkc_sha1_hmac_outer(const HawkcShaCtx *outer, unsigned char *digest);
+void HAWKCAPI hawkc_sha256_hmac_outer(const HawkcShaCtx *outer, unsigned char *digest);
+void HAWKCAPI hawkc_sha384_hmac_outer(const HawkcSha512Ctx *outer, unsigned char *digest);
+void HAWKCAPI hawkc_sha512_hmac_outer(const HawkcSha512Ctx *outer, unsigned char *digest);
+
+/*
+ * Compress independent messages in parallel using the multi-buffer kernel
+ * that goes with the selected kernel. Message i has nblocks[i] blocks
+ * starting at blocks[i] and chaining value h[i]. nlanes must not exceed
+ * HAWKC_SHA_MAX_LANES.
+ *
+ * Messages are grouped by the kernel's lane count. Lanes that are left
+ * over, or that have more blocks than the others, are finished with the
+ * single message kernel.
+ */
+void HAWKCAPI hawkc_sha1_compress_lanes(uint32_t *const *h, const unsigned char *const *blocks, const size_t *nblocks, size_t nlanes);
+void HAWKCAPI hawkc_sha256_compress_lanes(uint32_t *const *h, const unsigned char *const *blocks, const size_t *nblocks, size_t nlanes);
+
+/*
+ * Compute the HMACs of up to HAWKC_SHA_MAX_LANES messages in parallel with
+ * hawkc_sha*_compress_lanes(). inner[i] and outer[i] are the states after
+ * hashing the key pads of message i, which has len[i] bytes at data[i].
+ * The raw HMAC of message i is stored in digest[i].
+ */
+void HAWKCAPI hawkc_sha1_hmac_lanes(const HawkcShaCtx *const *inner, const HawkcShaCtx *const *outer,
+		const unsigned char *const *data, const size_t *len, size_t nlanes, unsigned char *const *digest);
+void HAWKCAPI hawkc_sha256_hmac_lanes(const HawkcShaCtx *const *inner, const HawkcShaCtx *const *outer,
+		const unsigned char *const *data, const size_t *len, size_t nlanes, unsigned char *const *digest);
+
+/*
+ * Force the use of a specific kernel, mainly for testing and benchmarking.
+ * Returns 1 if the kernel is supported by the CPU and has been selected,
+ * 0 otherwise.
+ *
+ * Not thread safe, call before any hashing is done.
+ */
+int HAWKCAPI hawkc_sha_use_kernel(HawkcShaKernel kernel);
+
+/*
+ * SHA-256 round constants.
+ */
+extern const uint32_t hawkc_sha256_k[64];
+
+/*
+ * Portable compression functions (sha.c).
+ */
+void hawkc_sha1_compress_portable(uint32_t *h, const unsigned char *blocks, size_t nblocks);
+void hawkc_sha256_compress_portable(uint32_t *h, const unsigned char *blocks, size_t nblocks);
+void hawkc_sha512_compress_portable(uint64_t *h, const unsigned char *blocks, size_t nblocks);
+
+/*
+ * x86 kernels (sha_x86.c). The kernels must only be called if the
+ * corresponding hawkc_cpu_has_*() function (cpu.h) returns 1.
+ */
+void hawkc_sha1_compress_shani(uint32_t *h, const unsigned char *blocks, size_t nblocks);
+void hawkc_sha256_compress_shani(uint32_t *h, const unsigned char *blocks, size_t nblocks);
+void hawkc_sha1_compress_avx2(uint32_t *h, const unsigned char *blocks, size_t nblocks);
+void hawkc_sha256_compress_avx2(uint32_t *h, const unsigned char *blocks, size_t nblocks);
+void hawkc_sha1_compress_x4_sse2(uint32_t *const *h, const unsigned char *const *blocks, size_t nblocks);
+void hawkc_sha256_compress_x4_sse2(uint32_t *const *h, const unsigned char *const *blocks, size_t nblocks);
+void hawkc_sha1_compress_x8_avx2(uint32_t *const *h, const unsigned char *const *blocks, size_t nblocks);
+void hawkc_sha256_compress_x8_avx2(uint32_t *const *h, const unsigned char *const *blocks, size_t nblocks);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* !defined HAWKC_SHA_H */
@@ -0,0 +1,240 @@
+/*
+ * Multi-buffer SHA-1 and SHA-256 compression functions.
+ *
+ * This file is a template that sha_x86.c includes once per vector width.
+ * Each 32-bit lane of a vector register holds the same state word of a
+ * different message, so LANES independent messages are compressed with
+ * the instructions one message would need.
+ *
+ * The includer defines:
+ *
+ *   LANES              number of 32-bit lanes of VEC
+ *   VEC                vector type
+ *   LANES_TARGET       function attributes enabling the instruction set
+ *   V_LOAD(p)          load LANES words from uint32_t array p
+ *   V_STORE(p,x)       store LANES words to uint32_t array p
+ *   V_SET1(x)          broadcast a word
+ *   V_ADD, V_XOR, V_AND, V_OR
+ *   V_ANDNOT(x,y)      ~x & y
+ *   V_SRL(x,n), V_SLL(x,n)
+ *   LANES_LOAD_W4(w,p,t) load message words t to t + 3 of every lane p[i]
+ *                      into w[t] to w[t + 3]
+ *   SHA1_LANES_FUNC    name of the SHA-1 function
+ *   SHA256_LANES_FUNC  name of the SHA-256 function
+ */
+
+#define V_ROTL(x,n) V_OR(V_SLL((x),(n)),V_SRL((x),32 - (n)))
+#define V_ROTR(x,n) V_OR(V_SRL((x),(n)),V_SLL((x),32 - (n)))
+
+/*
+ * Load word i of every lane's chaining value into a vector and back.
+ */
+#define LANES_LOAD_H(x,h,i) do { \
+	uint32_t words_[LANES]; \
+	int j_; \
+	for(j_ = 0; j_ < LANES; j_++) { \
+		words_[j_] = (h)[j_][i]; \
+	} \
+	(x) = V_LOAD(words_); \
+} while(0)
+
+#define LANES_STORE_H(x,h,i) do { \
+	uint32_t words_[LANES]; \
+	int j_; \
+	V_STORE(words_,(x)); \
+	for(j_ = 0; j_ < LANES; j_++) { \
+		(h)[j_][i] = words_[j_]; \
+	} \
+} while(0)
+
+/*
+ * Message schedule. w is a ring of the last 16 words, w[i & 15] holds
+ * word i - 16 on entry and word i on exit.
+ */
+#define SHA1_LANES_W(w,p,i) do { \
+	if((i) >= 16) { \
+		(w)[(i) & 15] = V_ROTL(V_XOR(V_XOR((w)[((i) - 3) & 15],(w)[((i) - 8) & 15]), \
+				V_XOR((w)[((i) - 14) & 15],(w)[(i) & 15])),1); \
+	} \
+} while(0)
+
+/*
+ * One SHA-1 round with round function F and constant k. The caller
+ * rotates the roles of the state variables instead of moving them.
+ */
+#define SHA1_LANES_ROUND(F,k,a,b,c,d,e,i) do { \
+	SHA1_LANES_W(w,p,i); \
+	e = V_ADD(V_ADD(e,V_ROTL(a,5)),V_ADD(F(b,c,d),V_ADD(k,w[(i) & 15]))); \
+	b = V_ROTL(b,30); \
+} while(0)
+
+#define SHA1_LANES_CH(b,c,d) V_OR(V_AND(b,c),V_ANDNOT(b,d))
+#define SHA1_LANES_PARITY(b,c,d) V_XOR(V_XOR(b,c),d)
+#define SHA1_LANES_MAJ(b,c,d) V_OR(V_AND(b,c),V_AND(d,V_OR(b,c)))
+
+/*
+ * Five rounds, after which the state variables are back in their roles.
+ * The rounds are fully unrolled so that all message word indices are
+ * constants and w can live in registers.
+ */
+#define SHA1_LANES_5(F,k,i) do { \
+	SHA1_LANES_ROUND(F,k,a,b,c,d,e,(i)); \
+	SHA1_LANES_ROUND(F,k,e,a,b,c,d,(i) + 1); \
+	SHA1_LANES_ROUND(F,k,d,e,a,b,c,(i) + 2); \
+	SHA1_LANES_ROUND(F,k,c,d,e,a,b,(i) + 3); \
+	SHA1_LANES_ROUND(F,k,b,c,d,e,a,(i) + 4); \
+} while(0)
+
+/*
+ * Twenty rounds sharing round function and constant.
+ */
+#define SHA1_LANES_STAGE(F,kval,i) do { \
+	VEC k_ = V_SET1(kval); \
+	SHA1_LANES_5(F,k_,(i)); \
+	SHA1_LANES_5(F,k_,(i) + 5); \
+	SHA1_LANES_5(F,k_,(i) + 10); \
+	SHA1_LANES_5(F,k_,(i) + 15); \
+} while(0)
+
+LANES_TARGET
+void SHA1_LANES_FUNC(uint32_t *const *h, const unsigned char *const *blocks, size_t nblocks) {
+	const unsigned char *p[LANES];
+	VEC w[16];
+	VEC a, b, c, d, e;
+	VEC h0, h1, h2, h3, h4;
+	int i;
+
+	for(i = 0; i < LANES; i++) {
+		p[i] = blocks[i];
+	}
+	LANES_LOAD_H(h0,h,0);
+	LANES_LOAD_H(h1,h,1);
+	LANES_LOAD_H(h2,h,2);
+	LANES_LOAD_H(h3,h,3);
+	LANES_LOAD_H(h4,h,4);
+
+	while(nblocks-- > 0) {
+		LANES_LOAD_W4(w,p,0);
+		LANES_LOAD_W4(w,p,4);
+		LANES_LOAD_W4(w,p,8);
+		LANES_LOAD_W4(w,p,12);
+		a = h0; b = h1; c = h2; d = h3; e = h4;
+		SHA1_LANES_STAGE(SHA1_LANES_CH,0x5a827999,0);
+		SHA1_LANES_STAGE(SHA1_LANES_PARITY,0x6ed9eba1,20);
+		SHA1_LANES_STAGE(SHA1_LANES_MAJ,0x8f1bbcdc,40);
+		SHA1_LANES_STAGE(SHA1_LANES_PARITY,0xca62c1d6,60);
+		h0 = V_ADD(h0,a); h1 = V_ADD(h1,b); h2 = V_ADD(h2,c);
+		h3 = V_ADD(h3,d); h4 = V_ADD(h4,e);
+		for(i = 0; i < LANES; i++) {
+			p[i] += HAWKC_SHA_BLOCK_BYTES;
+		}
+	}
+
+	LANES_STORE_H(h0,h,0);
+	LANES_STORE_H(h1,h,1);
+	LANES_STORE_H(h2,h,2);
+	LANES_STORE_H(h3,h,3);
+	LANES_STORE_H(h4,h,4);
+}
+
+#define SHA256_LANES_W(w,p,i) do { \
+	if((i) >= 16) { \
+		(w)[(i) & 15] = V_ADD(V_ADD((w)[(i) & 15],(w)[((i) - 7) & 15]), \
+				V_ADD(SHA256_LANES_S0((w)[((i) - 15) & 15]),SHA256_LANES_S1((w)[((i) - 2) & 15]))); \
+	} \
+} while(0)
+
+#define SHA256_LANES_S0(x) V_XOR(V_XOR(V_ROTR(x,7),V_ROTR(x,18)),V_SRL(x,3))
+#define SHA256_LANES_S1(x) V_XOR(V_XOR(V_ROTR(x,17),V_ROTR(x,19)),V_SRL(x,10))
+
+/*
+ * One SHA-256 round. The caller rotates the roles of the state variables
+ * instead of moving them.
+ */
+#define SHA256_LANES_ROUND(a,b,c,d,e,f,g,hh,i) do { \
+	VEC t1_, t2_; \
+	SHA256_LANES_W(w,p,i); \
+	t1_ = V_ADD(hh,V_XOR(V_XOR(V_ROTR(e,6),V_ROTR(e,11)),V_ROTR(e,25))); \
+	t1_ = V_ADD(t1_,V_XOR(V_AND(e,f),V_ANDNOT(e,g))); \
+	t1_ = V_ADD(t1_,V_ADD(V_SET1(hawkc_sha256_k[i]),w[(i) & 15])); \
+	t2_ = V_XOR(V_XOR(V_ROTR(a,2),V_ROTR(a,13)),V_ROTR(a,22)); \
+	t2_ = V_ADD(t2_,V_OR(V_AND(a,b),V_AND(c,V_OR(a,b)))); \
+	d = V_ADD(d,t1_); \
+	hh = V_ADD(t1_,t2_); \
+} while(0)
+
+/*
+ * Eight rounds, after which the state variables are back in their roles.
+ * Fully unrolled like the SHA-1 rounds.
+ */
+#define SHA256_LANES_8(i) do { \
+	SHA256_LANES_ROUND(a,b,c,d,e,f,g,hh,(i)); \
+	SHA256_LANES_ROUND(hh,a,b,c,d,e,f,g,(i) + 1); \
+	SHA256_LANES_ROUND(g,hh,a,b,c,d,e,f,(i) + 2); \
+	SHA256_LANES_ROUND(f,g,hh,a,b,c,d,e,(i) + 3); \
+	SHA256_LANES_ROUND(e,f,g,hh,a,b,c,d,(i) + 4); \
+	SHA256_LANES_ROUND(d,e,f,g,hh,a,b,c,(i) + 5); \
+	SHA256_LANES_ROUND(c,d,e,f,g,hh,a,b,(i) + 6); \
+	SHA256_LANES_ROUND(b,c,d,e,f,g,hh,a,(i) + 7); \
+} while(0)
+
+LANES_TARGET
+void SHA256_LANES_FUNC(uint32_t *const *h, const unsigned char *const *blocks, size_t nblocks) {
+	const unsigned char *p[LANES];
+	VEC w[16];
+	VEC a, b, c, d, e, f, g, hh;
+	VEC hv[8];
+	int i;
+
+	for(i = 0; i < LANES; i++) {
+		p[i] = blocks[i];
+	}
+	for(i = 0; i < 8; i++) {
+		LANES_LOAD_H(hv[i],h,i);
+	}
+
+	while(nblocks-- > 0) {
+		LANES_LOAD_W4(w,p,0);
+		LANES_LOAD_W4(w,p,4);
+		LANES_LOAD_W4(w,p,8);
+		LANES_LOAD_W4(w,p,12);
+		a = hv[0]; b = hv[1]; c = hv[2]; d = hv[3];
+		e = hv[4]; f = hv[5]; g = hv[6]; hh = hv[7];
+		SHA256_LANES_8(0);
+		SHA256_LANES_8(8);
+		SHA256_LANES_8(16);
+		SHA256_LANES_8(24);
+		SHA256_LANES_8(32);
+		SHA256_LANES_8(40);
+		SHA256_LANES_8(48);
+		SHA256_LANES_8(56);
+		hv[0] = V_ADD(hv[0],a); hv[1] = V_ADD(hv[1],b);
+		hv[2] = V_ADD(hv[2],c); hv[3] = V_ADD(hv[3],d);
+		hv[4] = V_ADD(hv[4],e); hv[5] = V_ADD(hv[5],f);
+		hv[6] = V_ADD(hv[6],g); hv[7] = V_ADD(hv[7],hh);
+		for(i = 0; i < LANES; i++) {
+			p[i] += HAWKC_SHA_BLOCK_BYTES;
+		}
+	}
+
+	for(i = 0; i < 8; i++) {
+		LANES_STORE_H(hv[i],h,i);
+	}
+}
+
+#undef V_ROTL
+#undef V_ROTR
+#undef LANES_LOAD_H
+#undef LANES_STORE_H
+#undef SHA1_LANES_W
+#undef SHA1_LANES_ROUND
+#undef SHA1_LANES_CH
+#undef SHA1_LANES_PARITY
+#undef SHA1_LANES_MAJ
+#undef SHA1_LANES_5
+#undef SHA1_LANES_STAGE
+#undef SHA256_LANES_W
+#undef SHA256_LANES_S0
+#undef SHA256_LANES_S1
+#undef SHA256_LANES_ROUND
+#undef SHA256_LANES_8
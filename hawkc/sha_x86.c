@@ -0,0 +1,474 @@
+/*
+ * x86 SHA-1 and SHA-256 compression kernels for the native crypto backend.
+ *
+ * SHA-NI kernels use the Intel SHA extensions and process four rounds per
+ * instruction pair. They follow the structure of Intel's reference code
+ * ("Intel SHA Extensions", 2013).
+ *
+ * The AVX2 kernels are meant for CPUs without SHA extensions. They compute
+ * the message schedule four words at a time in vector registers and run
+ * the rounds in scalar code compiled for BMI2 (rorx, andn).
+ *
+ * The multi-buffer kernels compress four (SSE2) or eight (AVX2) independent
+ * messages at once, see sha_lanes.h.
+ *
+ * Kernels are compiled with function level target attributes, so the rest
+ * of hawkc does not need to be built for these instruction sets. On other
+ * architectures or compilers this file only provides stubs, which are never
+ * called because cpu.c reports the features as unavailable.
+ */
+#include <string.h>
+#include "sha.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+
+#include <immintrin.h>
+
+#define SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#define AVX2_TARGET __attribute__((target("avx2,bmi,bmi2")))
+
+/*
+ * SHA-1 using SHA-NI.
+ *
+ * Each group g of four rounds feeds message words m[g % 4] into the state.
+ * sha1msg1, xor and sha1msg2 compute the schedule for groups g+1 .. g+3
+ * in the shadow of the rounds.
+ */
+#define SHA1_GROUP(g,m0,m1,m2,m3,e_in,e_out) do { \
+	if((g) == 0) { \
+		e_in = _mm_add_epi32(e_in,m0); \
+	} else { \
+		e_in = _mm_sha1nexte_epu32(e_in,m0); \
+	} \
+	e_out = abcd; \
+	if((g) >= 3 && (g) <= 18) { m1 = _mm_sha1msg2_epu32(m1,m0); } \
+	abcd = _mm_sha1rnds4_epu32(abcd,e_in,(g) / 5); \
+	if((g) >= 1 && (g) <= 16) { m3 = _mm_sha1msg1_epu32(m3,m0); } \
+	if((g) >= 2 && (g) <= 17) { m2 = _mm_xor_si128(m2,m0); } \
+} while(0)
+
+SHANI_TARGET
+void hawkc_sha1_compress_shani(uint32_t *h, const unsigned char *blocks, size_t nblocks) {
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i abcd, abcd_save, e0, e0_save, e1;
+	__m128i m0, m1, m2, m3;
+
+	abcd = _mm_loadu_si128((const __m128i*)h);
+	abcd = _mm_shuffle_epi32(abcd,0x1b);
+	e0 = _mm_set_epi32((int)h[4],0,0,0);
+
+	while(nblocks-- > 0) {
+		abcd_save = abcd;
+		e0_save = e0;
+
+		m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 0)),mask);
+		m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 16)),mask);
+		m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 32)),mask);
+		m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 48)),mask);
+
+		/* m1 is the register updated by sha1msg2, m3 by sha1msg1, m2 by xor */
+		SHA1_GROUP(0,m0,m1,m2,m3,e0,e1);
+		SHA1_GROUP(1,m1,m2,m3,m0,e1,e0);
+		SHA1_GROUP(2,m2,m3,m0,m1,e0,e1);
+		SHA1_GROUP(3,m3,m0,m1,m2,e1,e0);
+		SHA1_GROUP(4,m0,m1,m2,m3,e0,e1);
+		SHA1_GROUP(5,m1,m2,m3,m0,e1,e0);
+		SHA1_GROUP(6,m2,m3,m0,m1,e0,e1);
+		SHA1_GROUP(7,m3,m0,m1,m2,e1,e0);
+		SHA1_GROUP(8,m0,m1,m2,m3,e0,e1);
+		SHA1_GROUP(9,m1,m2,m3,m0,e1,e0);
+		SHA1_GROUP(10,m2,m3,m0,m1,e0,e1);
+		SHA1_GROUP(11,m3,m0,m1,m2,e1,e0);
+		SHA1_GROUP(12,m0,m1,m2,m3,e0,e1);
+		SHA1_GROUP(13,m1,m2,m3,m0,e1,e0);
+		SHA1_GROUP(14,m2,m3,m0,m1,e0,e1);
+		SHA1_GROUP(15,m3,m0,m1,m2,e1,e0);
+		SHA1_GROUP(16,m0,m1,m2,m3,e0,e1);
+		SHA1_GROUP(17,m1,m2,m3,m0,e1,e0);
+		SHA1_GROUP(18,m2,m3,m0,m1,e0,e1);
+		SHA1_GROUP(19,m3,m0,m1,m2,e1,e0);
+
+		e0 = _mm_sha1nexte_epu32(e0,e0_save);
+		abcd = _mm_add_epi32(abcd,abcd_save);
+
+		blocks += HAWKC_SHA_BLOCK_BYTES;
+	}
+
+	abcd = _mm_shuffle_epi32(abcd,0x1b);
+	_mm_storeu_si128((__m128i*)h,abcd);
+	h[4] = (uint32_t)_mm_extract_epi32(e0,3);
+}
+
+/*
+ * SHA-256 using SHA-NI.
+ *
+ * Each group g of four rounds adds the round constants to message words
+ * m[g % 4]. sha256msg1 and sha256msg2 compute the schedule for later
+ * groups in the shadow of the rounds.
+ */
+#define SHA256_GROUP(g,m0,m1,m2,m3) do { \
+	msg = _mm_add_epi32(m0,_mm_loadu_si128((const __m128i*)(hawkc_sha256_k + 4*(g)))); \
+	state1 = _mm_sha256rnds2_epu32(state1,state0,msg); \
+	if((g) >= 3 && (g) <= 14) { \
+		tmp = _mm_alignr_epi8(m0,m3,4); \
+		m1 = _mm_add_epi32(m1,tmp); \
+		m1 = _mm_sha256msg2_epu32(m1,m0); \
+	} \
+	msg = _mm_shuffle_epi32(msg,0x0e); \
+	state0 = _mm_sha256rnds2_epu32(state0,state1,msg); \
+	if((g) >= 1 && (g) <= 12) { m3 = _mm_sha256msg1_epu32(m3,m0); } \
+} while(0)
+
+SHANI_TARGET
+void hawkc_sha256_compress_shani(uint32_t *h, const unsigned char *blocks, size_t nblocks) {
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i state0, state1, msg, tmp;
+	__m128i m0, m1, m2, m3;
+	__m128i abef_save, cdgh_save;
+
+	tmp = _mm_loadu_si128((const __m128i*)&h[0]);
+	state1 = _mm_loadu_si128((const __m128i*)&h[4]);
+	tmp = _mm_shuffle_epi32(tmp,0xb1);          /* CDAB */
+	state1 = _mm_shuffle_epi32(state1,0x1b);    /* EFGH */
+	state0 = _mm_alignr_epi8(tmp,state1,8);     /* ABEF */
+	state1 = _mm_blend_epi16(state1,tmp,0xf0);  /* CDGH */
+
+	while(nblocks-- > 0) {
+		abef_save = state0;
+		cdgh_save = state1;
+
+		m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 0)),mask);
+		m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 16)),mask);
+		m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 32)),mask);
+		m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 48)),mask);
+
+		/* m1 is the register completed by sha256msg2, m3 the one started by sha256msg1 */
+		SHA256_GROUP(0,m0,m1,m2,m3);
+		SHA256_GROUP(1,m1,m2,m3,m0);
+		SHA256_GROUP(2,m2,m3,m0,m1);
+		SHA256_GROUP(3,m3,m0,m1,m2);
+		SHA256_GROUP(4,m0,m1,m2,m3);
+		SHA256_GROUP(5,m1,m2,m3,m0);
+		SHA256_GROUP(6,m2,m3,m0,m1);
+		SHA256_GROUP(7,m3,m0,m1,m2);
+		SHA256_GROUP(8,m0,m1,m2,m3);
+		SHA256_GROUP(9,m1,m2,m3,m0);
+		SHA256_GROUP(10,m2,m3,m0,m1);
+		SHA256_GROUP(11,m3,m0,m1,m2);
+		SHA256_GROUP(12,m0,m1,m2,m3);
+		SHA256_GROUP(13,m1,m2,m3,m0);
+		SHA256_GROUP(14,m2,m3,m0,m1);
+		SHA256_GROUP(15,m3,m0,m1,m2);
+
+		state0 = _mm_add_epi32(state0,abef_save);
+		state1 = _mm_add_epi32(state1,cdgh_save);
+
+		blocks += HAWKC_SHA_BLOCK_BYTES;
+	}
+
+	tmp = _mm_shuffle_epi32(state0,0x1b);       /* FEBA */
+	state1 = _mm_shuffle_epi32(state1,0xb1);    /* DCHG */
+	state0 = _mm_blend_epi16(tmp,state1,0xf0);  /* DCBA */
+	state1 = _mm_alignr_epi8(state1,tmp,8);     /* HGFE */
+	_mm_storeu_si128((__m128i*)&h[0],state0);
+	_mm_storeu_si128((__m128i*)&h[4],state1);
+}
+
+/*
+ * Vector helpers for the AVX2 kernels.
+ */
+#define VROTL(x,n) _mm_or_si128(_mm_slli_epi32((x),(n)),_mm_srli_epi32((x),32 - (n)))
+#define VROTR(x,n) _mm_or_si128(_mm_srli_epi32((x),(n)),_mm_slli_epi32((x),32 - (n)))
+
+#define ROTL(x,n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROTR(x,n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/*
+ * Load the 16 big endian words of a block into w.
+ */
+AVX2_TARGET
+static void load_block_be(uint32_t *w, const unsigned char *block) {
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	int i;
+	for(i = 0; i < 16; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(block + 4*i));
+		_mm_store_si128((__m128i*)(w + i),_mm_shuffle_epi8(x,mask));
+	}
+}
+
+/*
+ * SHA-1 with a vectorized message schedule.
+ *
+ * W[t..t+3] = rotl1(W[t-3..t] ^ W[t-8..t-5] ^ W[t-14..t-11] ^ W[t-16..t-13])
+ * needs W[t] for the last lane. That lane is computed with W[t] = 0 first
+ * and then corrected by rotl1(W[t]), since rotl1 distributes over xor.
+ */
+AVX2_TARGET
+void hawkc_sha1_compress_avx2(uint32_t *h, const unsigned char *blocks, size_t nblocks) {
+	uint32_t w[80] __attribute__((aligned(16)));
+	uint32_t a,b,c,d,e,t;
+	int i;
+
+	while(nblocks-- > 0) {
+		load_block_be(w,blocks);
+		for(i = 16; i < 80; i += 4) {
+			__m128i x = _mm_srli_si128(_mm_load_si128((const __m128i*)(w + i - 4)),4);
+			x = _mm_xor_si128(x,_mm_load_si128((const __m128i*)(w + i - 8)));
+			x = _mm_xor_si128(x,_mm_loadu_si128((const __m128i*)(w + i - 14)));
+			x = _mm_xor_si128(x,_mm_load_si128((const __m128i*)(w + i - 16)));
+			x = VROTL(x,1);
+			x = _mm_xor_si128(x,VROTL(_mm_slli_si128(x,12),1));
+			_mm_store_si128((__m128i*)(w + i),x);
+		}
+		a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+		for(i = 0; i < 20; i++) {
+			t = ROTL(a,5) + ((b & c) | (~b & d)) + e + 0x5a827999 + w[i];
+			e = d; d = c; c = ROTL(b,30); b = a; a = t;
+		}
+		for(i = 20; i < 40; i++) {
+			t = ROTL(a,5) + (b ^ c ^ d) + e + 0x6ed9eba1 + w[i];
+			e = d; d = c; c = ROTL(b,30); b = a; a = t;
+		}
+		for(i = 40; i < 60; i++) {
+			t = ROTL(a,5) + ((b & c) | (d & (b | c))) + e + 0x8f1bbcdc + w[i];
+			e = d; d = c; c = ROTL(b,30); b = a; a = t;
+		}
+		for(i = 60; i < 80; i++) {
+			t = ROTL(a,5) + (b ^ c ^ d) + e + 0xca62c1d6 + w[i];
+			e = d; d = c; c = ROTL(b,30); b = a; a = t;
+		}
+		h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+		blocks += HAWKC_SHA_BLOCK_BYTES;
+	}
+}
+
+/*
+ * SHA-256 with a vectorized message schedule.
+ *
+ * W[t..t+3] = W[t-16..t-13] + s0(W[t-15..t-12]) + W[t-7..t-4] + s1(W[t-2..t+1])
+ * where the s1 terms of the upper two lanes depend on the lower two lanes
+ * of the result, so s1 is added in two steps. The round constants are
+ * added to the schedule as well, taking an addition off the rounds.
+ */
+/*
+ * One SHA-256 round on precomputed W[i] + K[i]. The caller rotates the
+ * roles of the state variables instead of moving them.
+ */
+#define SHA256_ROUND(a,b,c,d,e,f,g,hh,i) do { \
+	uint32_t t1_ = hh + (ROTR(e,6) ^ ROTR(e,11) ^ ROTR(e,25)) + ((e & f) ^ (~e & g)) + wk[i]; \
+	uint32_t t2_ = (ROTR(a,2) ^ ROTR(a,13) ^ ROTR(a,22)) + ((a & b) | (c & (a | b))); \
+	d += t1_; \
+	hh = t1_ + t2_; \
+} while(0)
+
+AVX2_TARGET
+void hawkc_sha256_compress_avx2(uint32_t *h, const unsigned char *blocks, size_t nblocks) {
+	uint32_t w[64] __attribute__((aligned(16)));
+	uint32_t wk[64] __attribute__((aligned(16)));
+	uint32_t a,b,c,d,e,f,g,hh;
+	int i;
+
+	while(nblocks-- > 0) {
+		load_block_be(w,blocks);
+		for(i = 16; i < 64; i += 4) {
+			__m128i y = _mm_loadu_si128((const __m128i*)(w + i - 15));
+			__m128i x = _mm_add_epi32(_mm_load_si128((const __m128i*)(w + i - 16)),
+					_mm_loadu_si128((const __m128i*)(w + i - 7)));
+			__m128i s;
+			/* s0 */
+			s = _mm_xor_si128(_mm_xor_si128(VROTR(y,7),VROTR(y,18)),_mm_srli_epi32(y,3));
+			x = _mm_add_epi32(x,s);
+			/* s1 of W[t-2], W[t-1] for the lower lanes */
+			y = _mm_loadl_epi64((const __m128i*)(w + i - 2));
+			s = _mm_xor_si128(_mm_xor_si128(VROTR(y,17),VROTR(y,19)),_mm_srli_epi32(y,10));
+			x = _mm_add_epi32(x,s);
+			/* s1 of W[t], W[t+1] for the upper lanes */
+			y = _mm_slli_si128(x,8);
+			s = _mm_xor_si128(_mm_xor_si128(VROTR(y,17),VROTR(y,19)),_mm_srli_epi32(y,10));
+			x = _mm_add_epi32(x,s);
+			_mm_store_si128((__m128i*)(w + i),x);
+		}
+		for(i = 0; i < 64; i += 4) {
+			_mm_store_si128((__m128i*)(wk + i),_mm_add_epi32(_mm_load_si128((const __m128i*)(w + i)),
+					_mm_loadu_si128((const __m128i*)(hawkc_sha256_k + i))));
+		}
+		a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+		for(i = 0; i < 64; i += 8) {
+			SHA256_ROUND(a,b,c,d,e,f,g,hh,i);
+			SHA256_ROUND(hh,a,b,c,d,e,f,g,i + 1);
+			SHA256_ROUND(g,hh,a,b,c,d,e,f,i + 2);
+			SHA256_ROUND(f,g,hh,a,b,c,d,e,i + 3);
+			SHA256_ROUND(e,f,g,hh,a,b,c,d,i + 4);
+			SHA256_ROUND(d,e,f,g,hh,a,b,c,i + 5);
+			SHA256_ROUND(c,d,e,f,g,hh,a,b,i + 6);
+			SHA256_ROUND(b,c,d,e,f,g,hh,a,i + 7);
+		}
+		h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+		h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+		blocks += HAWKC_SHA_BLOCK_BYTES;
+	}
+}
+
+/*
+ * Multi-buffer kernels, instantiated from sha_lanes.h.
+ */
+
+/*
+ * Transpose words t to t + 3 of four lanes, so that w[t + k] holds word
+ * t + k of every lane, and convert them from big endian. SSE2 has no byte
+ * shuffle, so the bytes are swapped with 16 bit shuffles and shifts.
+ */
+__attribute__((target("sse2")))
+static inline void load_w4_x4(__m128i *w, const unsigned char *const *p, int t) {
+	__m128i r0 = _mm_loadu_si128((const __m128i*)(p[0] + 4 * t));
+	__m128i r1 = _mm_loadu_si128((const __m128i*)(p[1] + 4 * t));
+	__m128i r2 = _mm_loadu_si128((const __m128i*)(p[2] + 4 * t));
+	__m128i r3 = _mm_loadu_si128((const __m128i*)(p[3] + 4 * t));
+	__m128i t0 = _mm_unpacklo_epi32(r0,r1);
+	__m128i t1 = _mm_unpacklo_epi32(r2,r3);
+	__m128i t2 = _mm_unpackhi_epi32(r0,r1);
+	__m128i t3 = _mm_unpackhi_epi32(r2,r3);
+	__m128i x[4];
+	int k;
+
+	x[0] = _mm_unpacklo_epi64(t0,t1);
+	x[1] = _mm_unpackhi_epi64(t0,t1);
+	x[2] = _mm_unpacklo_epi64(t2,t3);
+	x[3] = _mm_unpackhi_epi64(t2,t3);
+	for(k = 0; k < 4; k++) {
+		__m128i y = _mm_shufflehi_epi16(_mm_shufflelo_epi16(x[k],0xb1),0xb1);
+		w[t + k] = _mm_or_si128(_mm_slli_epi16(y,8),_mm_srli_epi16(y,8));
+	}
+}
+
+/*
+ * Same for eight lanes, lanes 0 to 3 go to the lower and lanes 4 to 7 to
+ * the upper 128 bits.
+ */
+__attribute__((target("avx2")))
+static inline void load_w4_x8(__m256i *w, const unsigned char *const *p, int t) {
+	const __m256i mask = _mm256_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL,
+			0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m256i r0 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(p[0] + 4 * t))),
+			_mm_loadu_si128((const __m128i*)(p[4] + 4 * t)),1);
+	__m256i r1 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(p[1] + 4 * t))),
+			_mm_loadu_si128((const __m128i*)(p[5] + 4 * t)),1);
+	__m256i r2 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(p[2] + 4 * t))),
+			_mm_loadu_si128((const __m128i*)(p[6] + 4 * t)),1);
+	__m256i r3 = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(p[3] + 4 * t))),
+			_mm_loadu_si128((const __m128i*)(p[7] + 4 * t)),1);
+	__m256i t0 = _mm256_unpacklo_epi32(r0,r1);
+	__m256i t1 = _mm256_unpacklo_epi32(r2,r3);
+	__m256i t2 = _mm256_unpackhi_epi32(r0,r1);
+	__m256i t3 = _mm256_unpackhi_epi32(r2,r3);
+
+	w[t] = _mm256_shuffle_epi8(_mm256_unpacklo_epi64(t0,t1),mask);
+	w[t + 1] = _mm256_shuffle_epi8(_mm256_unpackhi_epi64(t0,t1),mask);
+	w[t + 2] = _mm256_shuffle_epi8(_mm256_unpacklo_epi64(t2,t3),mask);
+	w[t + 3] = _mm256_shuffle_epi8(_mm256_unpackhi_epi64(t2,t3),mask);
+}
+
+#define LANES 4
+#define VEC __m128i
+#define LANES_TARGET __attribute__((target("sse2")))
+#define V_LOAD(p) _mm_loadu_si128((const __m128i*)(p))
+#define V_STORE(p,x) _mm_storeu_si128((__m128i*)(p),(x))
+#define V_SET1(x) _mm_set1_epi32((int)(x))
+#define V_ADD(x,y) _mm_add_epi32((x),(y))
+#define V_XOR(x,y) _mm_xor_si128((x),(y))
+#define V_AND(x,y) _mm_and_si128((x),(y))
+#define V_OR(x,y) _mm_or_si128((x),(y))
+#define V_ANDNOT(x,y) _mm_andnot_si128((x),(y))
+#define V_SRL(x,n) _mm_srli_epi32((x),(n))
+#define V_SLL(x,n) _mm_slli_epi32((x),(n))
+#define SHA1_LANES_FUNC hawkc_sha1_compress_x4_sse2
+#define SHA256_LANES_FUNC hawkc_sha256_compress_x4_sse2
+#define LANES_LOAD_W4(w,p,t) load_w4_x4((w),(p),(t))
+#include "sha_lanes.h"
+#undef LANES
+#undef VEC
+#undef LANES_TARGET
+#undef V_LOAD
+#undef V_STORE
+#undef V_SET1
+#undef V_ADD
+#undef V_XOR
+#undef V_AND
+#undef V_OR
+#undef V_ANDNOT
+#undef V_SRL
+#undef V_SLL
+#undef SHA1_LANES_FUNC
+#undef SHA256_LANES_FUNC
+#undef LANES_LOAD_W4
+
+#define LANES 8
+#define VEC __m256i
+#define LANES_TARGET __attribute__((target("avx2")))
+#define V_LOAD(p) _mm256_loadu_si256((const __m256i*)(p))
+#define V_STORE(p,x) _mm256_storeu_si256((__m256i*)(p),(x))
+#define V_SET1(x) _mm256_set1_epi32((int)(x))
+#define V_ADD(x,y) _mm256_add_epi32((x),(y))
+#define V_XOR(x,y) _mm256_xor_si256((x),(y))
+#define V_AND(x,y) _mm256_and_si256((x),(y))
+#define V_OR(x,y) _mm256_or_si256((x),(y))
+#define V_ANDNOT(x,y) _mm256_andnot_si256((x),(y))
+#define V_SRL(x,n) _mm256_srli_epi32((x),(n))
+#define V_SLL(x,n) _mm256_slli_epi32((x),(n))
+#define SHA1_LANES_FUNC hawkc_sha1_compress_x8_avx2
+#define SHA256_LANES_FUNC hawkc_sha256_compress_x8_avx2
+#define LANES_LOAD_W4(w,p,t) load_w4_x8((w),(p),(t))
+#include "sha_lanes.h"
+
+#else
+
+/*
+ * No x86 kernels on this platform. The kernel functions are never selected
+ * because the feature checks fail; they only exist to satisfy the linker.
+ */
+
+void hawkc_sha1_compress_shani(uint32_t *h, const unsigned char *blocks, size_t nblocks) {
+	hawkc_sha1_compress_portable(h,blocks,nblocks);
+}
+
+void hawkc_sha256_compress_shani(uint32_t *h, const unsigned char *blocks, size_t nblocks) {
+	hawkc_sha256_compress_portable(h,blocks,nblocks);
+}
+
+void hawkc_sha1_compress_avx2(uint32_t *h, const unsigned char *blocks, size_t nblocks) {
+	hawkc_sha1_compress_portable(h,blocks,nblocks);
+}
+
+void hawkc_sha256_compress_avx2(uint32_t *h, const unsigned char *blocks, size_t nblocks) {
+	hawkc_sha256_compress_portable(h,blocks,nblocks);
+}
+
+void hawkc_sha1_compress_x4_sse2(uint32_t *const *h, const unsigned char *const *blocks, size_t nblocks) {
+	int i;
+	for(i = 0; i < 4; i++) {
+		hawkc_sha1_compress_portable(h[i],blocks[i],nblocks);
+	}
+}
+
+void hawkc_sha256_compress_x4_sse2(uint32_t *const *h, const unsigned char *const *blocks, size_t nblocks) {
+	int i;
+	for(i = 0; i < 4; i++) {
+		hawkc_sha256_compress_portable(h[i],blocks[i],nblocks);
+	}
+}
+
+void hawkc_sha1_compress_x8_avx2(uint32_t *const *h, const unsigned char *const *blocks, size_t nblocks) {
+	int i;
+	for(i = 0; i < 8; i++) {
+		hawkc_sha1_compress_portable(h[i],blocks[i],nblocks);
+	}
+}
+
+void hawkc_sha256_compress_x8_avx2(uint32_t *const *h, const unsigned char *const *blocks, size_t nblocks) {
+	int i;
+	for(i = 0; i < 8; i++) {
+		hawkc_sha256_compress_portable(h[i],blocks[i],nblocks);
+	}
+}
+
+#endif
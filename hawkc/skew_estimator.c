@@ -0,0 +1,174 @@
+/*
+ * Clock skew estimator.
+ *
+ * Keeps the offset between the local clock and the clock of every server
+ * host as an exponentially weighted moving average of the offsets measured
+ * from verified WWW-Authenticate timestamps. Contexts of all threads share
+ * the estimator, so a client learns the skew of a host from the first
+ * response of any of them.
+ *
+ * The hosts are an open addressing table of 64-bit host hashes, claimed with
+ * compare-and-swap and never removed. Offsets are kept in 1/256 seconds and
+ * updated with a compare-and-swap loop, so neither readers nor writers take
+ * a lock.
+ */
+#include <string.h>
+#include <stdint.h>
+
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+
+#if !defined(__GNUC__)
+#error "The skew estimator requires the __atomic builtins of GCC or Clang"
+#endif
+
+/*
+ * Offsets are fixed point numbers with this many fractional bits.
+ */
+#define SCALE_BITS 8
+
+/*
+ * Every sample moves the average by 1 / 2^WEIGHT_BITS of its difference.
+ */
+#define WEIGHT_BITS 2
+
+#define NO_SAMPLE INT64_MIN
+
+typedef struct Entry {
+	uint64_t host; /* 0 if the entry is free */
+	int64_t offset;
+} Entry;
+
+#if __cplusplus
+struct _HawkcSkewEstimator {
+#else
+struct HawkcSkewEstimator {
+#endif
+	Entry *entries;
+	size_t mask;
+	uint64_t seed;
+};
+
+HawkcError hawkc_skew_estimator_create(HawkcContext ctx, size_t hosts, HawkcSkewEstimator *estimator) {
+	HawkcError e;
+	HawkcSkewEstimator s;
+	size_t i, n = 2;
+
+#if __cplusplus
+	if( (s = (HawkcSkewEstimator)hawkc_calloc(ctx,1,sizeof(struct _HawkcSkewEstimator))) == NULL) {
+#else
+	if( (s = (HawkcSkewEstimator)hawkc_calloc(ctx,1,sizeof(struct HawkcSkewEstimator))) == NULL) {
+#endif
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate skew estimator");
+	}
+	if( (e = hawkc_random_bytes(ctx,(unsigned char*)&(s->seed),sizeof(s->seed))) != HAWKC_OK) {
+		hawkc_free(ctx,s);
+		return e;
+	}
+	/* Keep the table at most half full */
+	while(n < 2 * hosts) {
+		n *= 2;
+	}
+	if( (s->entries = (Entry*)hawkc_calloc(ctx,n,sizeof(Entry))) == NULL) {
+		hawkc_free(ctx,s);
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate skew estimator for %lu hosts", (unsigned long)hosts);
+	}
+	for(i = 0; i < n; i++) {
+		s->entries[i].offset = NO_SAMPLE;
+	}
+	s->mask = n - 1;
+	*estimator = s;
+	return HAWKC_OK;
+}
+
+void hawkc_skew_estimator_free(HawkcContext ctx, HawkcSkewEstimator estimator) {
+	if(estimator == NULL) {
+		return;
+	}
+	hawkc_free(ctx,estimator->entries);
+	hawkc_free(ctx,estimator);
+}
+
+/*
+ * Find the entry of host, claiming a free one if insert is set. Returns
+ * NULL if the host is not in the table or the table is full.
+ */
+static Entry *find(HawkcSkewEstimator estimator, const unsigned char *host, size_t host_len, int insert) {
+	uint64_t h = hawkc_hash_bytes(host,host_len,estimator->seed);
+	size_t i, n;
+
+	if(h == 0) {
+		h = 1;
+	}
+	i = (size_t)h & estimator->mask;
+	for(n = 0; n <= estimator->mask; n++) {
+		Entry *x = &(estimator->entries[i]);
+		uint64_t k = __atomic_load_n(&(x->host),__ATOMIC_ACQUIRE);
+		if(k == 0) {
+			if(!insert) {
+				return NULL;
+			}
+			if(__atomic_compare_exchange_n(&(x->host),&k,h,0,__ATOMIC_ACQ_REL,__ATOMIC_ACQUIRE)) {
+				return x;
+			}
+			/* k now holds the host that claimed the entry first */
+		}
+		if(k == h) {
+			return x;
+		}
+		i = (i + 1) & estimator->mask;
+	}
+	return NULL;
+}
+
+void hawkc_skew_estimator_update(HawkcSkewEstimator estimator, const unsigned char *host, size_t host_len,
+		time_t server_ts, time_t now) {
+	Entry *x;
+	int64_t sample = (int64_t)(server_ts - now) * (1 << SCALE_BITS);
+	int64_t old, avg;
+
+	if( (x = find(estimator,host,host_len,1)) == NULL) {
+		return;
+	}
+	old = __atomic_load_n(&(x->offset),__ATOMIC_RELAXED);
+	do {
+		if(old == NO_SAMPLE) {
+			avg = sample;
+		} else {
+			avg = old + (sample - old) / (1 << WEIGHT_BITS);
+		}
+	} while(!__atomic_compare_exchange_n(&(x->offset),&old,avg,0,__ATOMIC_RELAXED,__ATOMIC_RELAXED));
+}
+
+int hawkc_skew_estimator_offset(HawkcSkewEstimator estimator, const unsigned char *host, size_t host_len, int *offset) {
+	Entry *x;
+	int64_t v;
+
+	if( (x = find(estimator,host,host_len,0)) == NULL) {
+		return 0;
+	}
+	if( (v = __atomic_load_n(&(x->offset),__ATOMIC_RELAXED)) == NO_SAMPLE) {
+		return 0;
+	}
+	/* Round to the nearest second */
+	if(v >= 0) {
+		*offset = (int)((v + (1 << (SCALE_BITS - 1))) >> SCALE_BITS);
+	} else {
+		*offset = -(int)((-v + (1 << (SCALE_BITS - 1))) >> SCALE_BITS);
+	}
+	return 1;
+}
+
+void hawkc_context_set_skew_estimator(HawkcContext ctx, HawkcSkewEstimator estimator) {
+	ctx->skew_estimator = estimator;
+}
+
+int hawkc_context_clock_offset(HawkcContext ctx) {
+	int offset;
+	if(ctx->skew_estimator != NULL
+			&& hawkc_skew_estimator_offset(ctx->skew_estimator,ctx->host.data,ctx->host.len,&offset)) {
+		return offset;
+	}
+	return ctx->offset;
+}
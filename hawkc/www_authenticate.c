@@ -6,48 +6,16 @@
 #include "hawkc.h"
 #include "common.h"
 #include "crypto.h"
+#include "base64.h"
 
 static const char *HAWK_TS_PREFIX = "hawk.1.ts";
 static const char LF = '\n';
 
 /*
- * Scheme callback for parsing www-authenticate header.
- */
-static HawkcError www_authenticate_scheme_handler(HawkcContext ctx,HawkcString scheme,void *data) {
-	if((scheme.len != 4) || memcmp(scheme.data,"Hawk",4) != 0) {
-		return hawkc_set_error(ctx,
-					HAWKC_BAD_SCHEME_ERROR, "Unsupported authentication scheme '%.*s'" , scheme.len,scheme.data);
-	}
-	return HAWKC_OK;
-}
-
-/*
- * Parameter callback for parsing www-authenticate header.
- */
-static HawkcError www_authenticate_param_handler(HawkcContext ctx,HawkcString key, HawkcString value,void *data) {
-
-	WwwAuthenticateHeader h = (WwwAuthenticateHeader)data;
-	if(key.len == 3 && !memcmp(key.data,"tsm",key.len)) {
-		h->tsm.data = value.data;
-		h->tsm.len = value.len;
-	} else if(key.len == 2 && !memcmp(key.data,"ts",key.len)) {
-		HawkcError e;
-		if( (e = hawkc_parse_time(ctx,value,&(h->ts))) != HAWKC_OK) {
-			return e;
-		}
-	} else {
-		; /* ignore unknown parameter */
-	}
-
-	return HAWKC_OK;
-}
-
-/*
- * Parse an www-authenticate header. Using the internal auth header parser with the
- * appropriate callbacks.
+ * Parse an www-authenticate header with the Hawk specific parser.
  */
 HawkcError hawkc_parse_www_authenticate_header(HawkcContext ctx, unsigned char *value, size_t len) {
-	return hawkc_parse_auth_header(ctx,value,len,www_authenticate_scheme_handler, www_authenticate_param_handler,&(ctx->www_authenticate_header));
+	return hawkc_parse_hawk_www_authenticate_header(ctx,value,len,&(ctx->www_authenticate_header));
 }
 
 
@@ -111,7 +79,7 @@ HawkcError hawkc_calculate_www_authenticate_header_length(HawkcContext ctx, size
 	/*
 	 * Create signature.
 	 */
-	if( (e = hawkc_hmac(ctx, ctx->algorithm, ctx->password.data, ctx->password.len, base_buf, base_len,ctx->ts_hmac.data,&(ctx->ts_hmac.len) )) != HAWKC_OK) {
+	if( (e = hawkc_context_hmac(ctx, base_buf, base_len,ctx->ts_hmac.data,&(ctx->ts_hmac.len) )) != HAWKC_OK) {
 		return e;
 	}
 
@@ -134,6 +102,52 @@ HawkcError hawkc_calculate_www_authenticate_header_length(HawkcContext ctx, size
 	return HAWKC_OK;
 }
 
+/*
+ * Verify tsm against the HMAC of the ts base string and take the server's
+ * clock offset from a valid ts.
+ */
+HawkcError hawkc_validate_www_authenticate_tsm(HawkcContext ctx, int *is_valid) {
+	HawkcError e;
+	WwwAuthenticateHeader ah = &(ctx->www_authenticate_header);
+	unsigned char base_buf[TS_BASE_BUFFER_SIZE];
+	size_t base_len;
+	unsigned char tsm[MAX_HMAC_BYTES_B64 / 4 * 3];
+	size_t tsm_len;
+	unsigned char digest[MAX_HMAC_BYTES];
+	size_t digest_len;
+	HawkcHmacCtx hmac_ctx;
+	time_t now;
+
+	*is_valid = 0;
+	if(ah->ts == 0 || ah->tsm.len == 0) {
+		return hawkc_set_error(ctx, HAWKC_ERROR, "WWW-Authenticate header has no ts and tsm");
+	}
+	if(ah->tsm.len > MAX_HMAC_BYTES_B64) {
+		return hawkc_set_error(ctx, HAWKC_BASE64_ERROR, "tsm value too long: %d bytes", (int)ah->tsm.len);
+	}
+	if( (e = hawkc_base64_decode_strict(ctx,ah->tsm.data,ah->tsm.len,tsm,&tsm_len)) != HAWKC_OK) {
+		return e;
+	}
+
+	hawkc_create_ts_base_string(ctx,ah,base_buf,&base_len);
+	if( (e = hawkc_context_hmac_init(ctx,&hmac_ctx)) != HAWKC_OK) {
+		return e;
+	}
+	hawkc_hmac_update(&hmac_ctx,base_buf,base_len);
+	hawkc_hmac_final_raw(&hmac_ctx,digest,&digest_len);
+	if(tsm_len != digest_len || !hawkc_fixed_time_equal(tsm,digest,digest_len)) {
+		return HAWKC_OK;
+	}
+	*is_valid = 1;
+
+	now = hawkc_context_time(ctx);
+	ctx->offset = (int)(ah->ts - now);
+	if(ctx->skew_estimator != NULL) {
+		hawkc_skew_estimator_update(ctx->skew_estimator,ctx->host.data,ctx->host.len,ah->ts,now);
+	}
+	return HAWKC_OK;
+}
+
 /*
  * Set the timestamp value.
  */
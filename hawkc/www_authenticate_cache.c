@@ -0,0 +1,152 @@
+/*
+ * WWW-Authenticate header cache.
+ *
+ * A server that rejects a request for its timestamp answers with its own
+ * time signed under the client's key. Within a second the header is the
+ * same for all requests with the same key, so the rendered header is
+ * cached by key and replaced when the second changes.
+ *
+ * Keys are identified by a 128-bit hash, two XXH64 hashes with independent
+ * random seeds, of the key's chaining values, or of the password if no key
+ * is set. The cache is direct-mapped, every entry has its own lock. A
+ * thread that finds the lock taken renders the header itself instead of
+ * waiting, so the lock is never contended for longer than a memcpy.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <string.h>
+#include <stdint.h>
+
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+
+#if !defined(__GNUC__)
+#error "The WWW-Authenticate cache requires the __atomic builtins of GCC or Clang"
+#endif
+
+typedef struct Entry {
+	int locked;
+	uint32_t len; /* 0 if the entry is empty */
+	time_t ts;
+	uint64_t h1;
+	uint64_t h2;
+	unsigned char header[MAX_WWW_AUTHENTICATE_BYTES];
+} Entry;
+
+#if __cplusplus
+struct _HawkcWwwAuthenticateCache {
+#else
+struct HawkcWwwAuthenticateCache {
+#endif
+	Entry *entries;
+	size_t mask;
+	uint64_t seed1;
+	uint64_t seed2;
+};
+
+HawkcError hawkc_www_authenticate_cache_create(HawkcContext ctx, size_t capacity, HawkcWwwAuthenticateCache *cache) {
+	HawkcError e;
+	HawkcWwwAuthenticateCache c;
+	size_t n = 1;
+
+#if __cplusplus
+	if( (c = (HawkcWwwAuthenticateCache)hawkc_calloc(ctx,1,sizeof(struct _HawkcWwwAuthenticateCache))) == NULL) {
+#else
+	if( (c = (HawkcWwwAuthenticateCache)hawkc_calloc(ctx,1,sizeof(struct HawkcWwwAuthenticateCache))) == NULL) {
+#endif
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate WWW-Authenticate cache");
+	}
+	if( (e = hawkc_random_bytes(ctx,(unsigned char*)&(c->seed1),sizeof(c->seed1))) != HAWKC_OK
+			|| (e = hawkc_random_bytes(ctx,(unsigned char*)&(c->seed2),sizeof(c->seed2))) != HAWKC_OK) {
+		hawkc_free(ctx,c);
+		return e;
+	}
+	while(n < capacity) {
+		n *= 2;
+	}
+	if( (c->entries = (Entry*)hawkc_calloc(ctx,n,sizeof(Entry))) == NULL) {
+		hawkc_free(ctx,c);
+		return hawkc_set_error(ctx, HAWKC_NO_MEM, "Unable to allocate WWW-Authenticate cache of %lu entries", (unsigned long)capacity);
+	}
+	c->mask = n - 1;
+	*cache = c;
+	return HAWKC_OK;
+}
+
+void hawkc_www_authenticate_cache_free(HawkcContext ctx, HawkcWwwAuthenticateCache cache) {
+	if(cache == NULL) {
+		return;
+	}
+	hawkc_free(ctx,cache->entries);
+	hawkc_free(ctx,cache);
+}
+
+/*
+ * Hash the key or password and algorithm of the context. The seeds differ
+ * by algorithm and between keys and passwords.
+ */
+static void hash_key(HawkcContext ctx, HawkcWwwAuthenticateCache cache, uint64_t *h1, uint64_t *h2) {
+	unsigned char data[2 * MAX_DIGEST_CHAIN_BYTES];
+	uint64_t tweak;
+	HawkcKey key = hawkc_context_active_key(ctx);
+
+	if(key != NULL) {
+		tweak = (uint64_t)(uintptr_t)key->algorithm << 1;
+		hawkc_key_export(key,data);
+		*h1 = hawkc_hash_bytes(data,2 * key->algorithm->chain_size,cache->seed1 ^ tweak);
+		*h2 = hawkc_hash_bytes(data,2 * key->algorithm->chain_size,cache->seed2 ^ tweak);
+		hawkc_cleanse(data,sizeof(data));
+	} else {
+		tweak = ((uint64_t)(uintptr_t)ctx->algorithm << 1) | 1;
+		*h1 = hawkc_hash_bytes(ctx->password.data,ctx->password.len,cache->seed1 ^ tweak);
+		*h2 = hawkc_hash_bytes(ctx->password.data,ctx->password.len,cache->seed2 ^ tweak);
+	}
+}
+
+HawkcError hawkc_create_cached_www_authenticate_header(HawkcContext ctx, HawkcWwwAuthenticateCache cache,
+		unsigned char *buf, size_t *len) {
+	HawkcError e;
+	size_t required_len;
+	time_t ts = ctx->www_authenticate_header.ts;
+	uint64_t h1, h2;
+	Entry *x;
+
+	if(ts == 0) {
+		return hawkc_create_www_authenticate_header(ctx,buf,len);
+	}
+	hash_key(ctx,cache,&h1,&h2);
+	x = &(cache->entries[h1 & cache->mask]);
+
+	if(!__atomic_exchange_n(&(x->locked),1,__ATOMIC_ACQUIRE)) {
+		if(x->len != 0 && x->ts == ts && x->h1 == h1 && x->h2 == h2) {
+			memcpy(buf,x->header,x->len);
+			*len = x->len;
+			__atomic_store_n(&(x->locked),0,__ATOMIC_RELEASE);
+			return HAWKC_OK;
+		}
+		__atomic_store_n(&(x->locked),0,__ATOMIC_RELEASE);
+	}
+
+	if( (e = hawkc_calculate_www_authenticate_header_length(ctx,&required_len)) != HAWKC_OK) {
+		return e;
+	}
+	if(required_len > MAX_WWW_AUTHENTICATE_BYTES) {
+		return hawkc_set_error(ctx, HAWKC_REQUIRED_BUFFER_TOO_LARGE, "WWW-Authenticate header of %lu bytes is too long", (unsigned long)required_len);
+	}
+	if( (e = hawkc_create_www_authenticate_header(ctx,buf,len)) != HAWKC_OK) {
+		return e;
+	}
+
+	if(!__atomic_exchange_n(&(x->locked),1,__ATOMIC_ACQUIRE)) {
+		x->ts = ts;
+		x->h1 = h1;
+		x->h2 = h2;
+		memcpy(x->header,buf,*len);
+		x->len = (uint32_t)*len;
+		__atomic_store_n(&(x->locked),0,__ATOMIC_RELEASE);
+	}
+	return HAWKC_OK;
+}
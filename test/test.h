@@ -18,6 +18,73 @@ extern "C" {
 
 #define EXPECT_RETVAL(expected,actual,ctx) do { if( (expected)  != (actual) ) { printf("Test failed in %s line %d: expected " #actual "=" #expected ", but context has %s\n", __FILE__ , __LINE__ , hawkc_get_error( (ctx)) ); return 1; } } while(0)
 
+#ifdef _POSIX_C_SOURCE
+#include <pthread.h>
+
+/*
+ * Harness of the concurrency tests, for tests that ask for POSIX threads
+ * by defining _POSIX_C_SOURCE.
+ *
+ * start_test_threads() runs run(threads,t) on TEST_THREADS threads, t being
+ * the index of the thread, with the object under test in threads->data.
+ * run returns a count, usually of failures, and loops until threads->stop
+ * is set if it does not do a fixed amount of work. join_test_threads() sets
+ * stop, waits for the threads and returns the sum of their counts.
+ */
+#define TEST_THREADS 4
+
+typedef struct TestThreads TestThreads;
+
+typedef struct TestThread {
+	TestThreads *threads;
+	int t;
+	int count;
+	pthread_t id;
+} TestThread;
+
+struct TestThreads {
+	TestThread thread[TEST_THREADS];
+	int (*run)(TestThreads *threads, int t);
+	void *data;
+	volatile int stop;
+};
+
+static inline void *test_thread_main(void *arg) {
+	TestThread *x = (TestThread*)arg;
+	x->count = x->threads->run(x->threads,x->t);
+	return NULL;
+}
+
+/*
+ * Return 0 if all threads have been started.
+ */
+static inline int start_test_threads(TestThreads *threads, int (*run)(TestThreads *threads, int t), void *data) {
+	int t;
+	threads->run = run;
+	threads->data = data;
+	threads->stop = 0;
+	for(t = 0; t < TEST_THREADS; t++) {
+		threads->thread[t].threads = threads;
+		threads->thread[t].t = t;
+		threads->thread[t].count = 0;
+		if(pthread_create(&(threads->thread[t].id),NULL,test_thread_main,&(threads->thread[t])) != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static inline int join_test_threads(TestThreads *threads) {
+	int t, sum = 0;
+	threads->stop = 1;
+	for(t = 0; t < TEST_THREADS; t++) {
+		pthread_join(threads->thread[t].id,NULL);
+		sum += threads->thread[t].count;
+	}
+	return sum;
+}
+#endif
+
 
 
 
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include "hawkc.h"
+#include "common.h"
+#include "test.h"
+
+static struct HawkcContext ctx;
+
+#define NOW 1353788437
+
+static HawkcFakeClock fake_clock = { NOW, 0 };
+
+/*
+ * Sign a request of id with the given ts and nonce into header.
+ */
+static int sign_as(const char *id, const char *password, time_t ts, const char *nonce, char *header, size_t *len) {
+	struct HawkcContext c;
+	HawkcError e;
+	size_t required_len;
+
+	hawkc_context_init(&c);
+	hawkc_context_set_algorithm(&c,HAWKC_SHA_256);
+	hawkc_context_set_password(&c,(unsigned char *)password,strlen(password));
+	hawkc_context_set_id(&c,(unsigned char *)id,strlen(id));
+	hawkc_context_set_method(&c,(unsigned char *)"GET",3);
+	hawkc_context_set_path(&c,(unsigned char *)"/some/path/to/foo",17);
+	hawkc_context_set_host(&c,(unsigned char *)"example.com",11);
+	hawkc_context_set_port(&c,(unsigned char *)"80",2);
+	c.header_out.ts = ts;
+	c.header_out.nonce.data = (unsigned char *)nonce;
+	c.header_out.nonce.len = strlen(nonce);
+	e = hawkc_calculate_authorization_header_length(&c,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&c);
+	EXPECT_TRUE(required_len < 1024);
+	e = hawkc_create_authorization_header(&c,(unsigned char *)header,len);
+	EXPECT_RETVAL(HAWKC_OK,e,&c);
+	return 0;
+}
+
+static int sign(const char *password, time_t ts, const char *nonce, char *header, size_t *len) {
+	return sign_as("someId",password,ts,nonce,header,len);
+}
+
+static void setup(void) {
+	hawkc_context_init(&ctx);
+	hawkc_context_set_clock(&ctx,hawkc_fake_clock,&fake_clock);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	hawkc_context_set_password(&ctx,(unsigned char *)"test",4);
+	hawkc_context_set_method(&ctx,(unsigned char *)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char *)"/some/path/to/foo",17);
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char *)"80",2);
+}
+
+static HawkcAuthResult authenticate(const char *header, size_t len, HawkcReplayCache cache) {
+	return hawkc_authenticate(&ctx,(unsigned char *)header,len,60,cache);
+}
+
+int test_authenticate() {
+	HawkcReplayCache cache;
+	HawkcError e;
+	char header[1024];
+	size_t len;
+
+	setup();
+	e = hawkc_replay_cache_create(&ctx,100,60,&cache);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	EXPECT_INT_EQUAL(0,sign("test",NOW - 10,"abc",header,&len));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_OK,authenticate(header,len,cache));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_REPLAYED,authenticate(header,len,cache));
+
+	/* Without replay cache the nonce is not checked */
+	EXPECT_INT_EQUAL(HAWKC_AUTH_OK,authenticate(header,len,NULL));
+
+	/* A forged request does not use up the nonce */
+	EXPECT_INT_EQUAL(0,sign("wrong",NOW,"def",header,&len));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_INVALID_MAC,authenticate(header,len,cache));
+	EXPECT_INT_EQUAL(0,sign("test",NOW,"def",header,&len));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_OK,authenticate(header,len,cache));
+
+	hawkc_replay_cache_free(&ctx,cache);
+	return 0;
+}
+
+/*
+ * Requests rejected by the cheap checks do not get to the HMAC.
+ */
+int test_authenticate_rejects_before_hmac() {
+	HawkcReplayCache cache;
+	HawkcError e;
+	char header[1024];
+	size_t len;
+	char *missing_nonce = "Hawk id=\"someId\", ts=\"1353788437\", mac=\"zy79QQ5/EYFmQqutVnYb73gAc/U=\"";
+	char *bad_mac = "Hawk id=\"someId\", ts=\"1353788437\", nonce=\"abc\", mac=\"zy79QQ5*EYFmQqutVnYb73gAc/U=\"";
+
+	setup();
+	e = hawkc_replay_cache_create(&ctx,100,60,&cache);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	EXPECT_INT_EQUAL(HAWKC_AUTH_MALFORMED,authenticate("Basic abc",9,cache));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_MALFORMED,authenticate(missing_nonce,strlen(missing_nonce),cache));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_MALFORMED,authenticate(bad_mac,strlen(bad_mac),cache));
+
+	EXPECT_INT_EQUAL(0,sign("test",NOW - 61,"abc",header,&len));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_STALE_TIMESTAMP,authenticate(header,len,cache));
+	EXPECT_INT_EQUAL(NOW,(int)ctx.www_authenticate_header.ts);
+	EXPECT_INT_EQUAL(0,sign("test",NOW + 61,"abc",header,&len));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_STALE_TIMESTAMP,authenticate(header,len,cache));
+
+	EXPECT_INT_EQUAL(0,sign("test",NOW,"abc",header,&len));
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_FRESH,hawkc_replay_cache_add(cache,(unsigned char*)"someId",6,(unsigned char*)"abc",3,NOW,NOW));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_REPLAYED,authenticate(header,len,cache));
+
+	EXPECT_INT_EQUAL(0,(int)ctx.hmac_digest_len);
+	hawkc_replay_cache_free(&ctx,cache);
+	return 0;
+}
+
+/*
+ * Ids are resolved before the HMAC.
+ */
+int test_authenticate_unknown_id() {
+	HawkcCredentialStore store;
+	HawkcCredentials credentials;
+	HawkcError e;
+	char header[1024];
+	size_t len;
+
+	setup();
+	e = hawkc_credential_store_create(&ctx,&store);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credentials_create(&ctx,10,&credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credentials_add(&ctx,credentials,(unsigned char*)"otherId",7,HAWKC_SHA_256,(unsigned char*)"test",4);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credential_store_publish(&ctx,store,credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_context_set_credential_store(&ctx,store);
+
+	EXPECT_INT_EQUAL(0,sign("test",NOW,"abc",header,&len));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_UNKNOWN_ID,authenticate(header,len,NULL));
+	EXPECT_INT_EQUAL(0,(int)ctx.hmac_digest_len);
+
+	e = hawkc_credentials_create(&ctx,10,&credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credentials_add(&ctx,credentials,(unsigned char*)"someId",6,HAWKC_SHA_256,(unsigned char*)"test",4);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credential_store_publish(&ctx,store,credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(HAWKC_AUTH_OK,authenticate(header,len,NULL));
+
+	hawkc_credential_store_free(&ctx,store);
+	return 0;
+}
+
+/*
+ * The WWW-Authenticate header for a stale timestamp is signed with the key
+ * of the client, also after a request of another client.
+ */
+int test_authenticate_stale_resolved() {
+	HawkcCredentialStore store;
+	HawkcCredentials credentials;
+	struct HawkcContext client;
+	HawkcError e;
+	char header[1024];
+	unsigned char www[1024];
+	size_t len, www_len;
+	int is_valid;
+
+	setup();
+	hawkc_context_set_password(&ctx,NULL,0);
+	hawkc_context_set_algorithm(&ctx,NULL);
+	e = hawkc_credential_store_create(&ctx,&store);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credentials_create(&ctx,10,&credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credentials_add(&ctx,credentials,(unsigned char*)"someId",6,HAWKC_SHA_256,(unsigned char*)"test",4);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credentials_add(&ctx,credentials,(unsigned char*)"otherId",7,HAWKC_SHA_1,(unsigned char*)"other",5);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credential_store_publish(&ctx,store,credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_context_set_credential_store(&ctx,store);
+
+	EXPECT_INT_EQUAL(0,sign_as("otherId","other",NOW,"abc",header,&len));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_INVALID_MAC,authenticate(header,len,NULL));
+	EXPECT_INT_EQUAL(0,sign("test",NOW - 61,"abc",header,&len));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_STALE_TIMESTAMP,authenticate(header,len,NULL));
+
+	e = hawkc_calculate_www_authenticate_header_length(&ctx,&www_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(www_len < sizeof(www));
+	e = hawkc_create_www_authenticate_header(&ctx,www,&www_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	hawkc_context_init(&client);
+	hawkc_context_set_clock(&client,hawkc_fake_clock,&fake_clock);
+	hawkc_context_set_algorithm(&client,HAWKC_SHA_256);
+	hawkc_context_set_password(&client,(unsigned char *)"test",4);
+	e = hawkc_parse_www_authenticate_header(&client,www,www_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&client);
+	e = hawkc_validate_www_authenticate_tsm(&client,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&client);
+	EXPECT_TRUE(is_valid);
+
+	EXPECT_INT_EQUAL(0,sign_as("unknown","test",NOW - 61,"abc",header,&len));
+	EXPECT_INT_EQUAL(HAWKC_AUTH_UNKNOWN_ID,authenticate(header,len,NULL));
+
+	hawkc_credential_store_free(&ctx,store);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	RUNTEST(argv[0],test_authenticate);
+	RUNTEST(argv[0],test_authenticate_rejects_before_hmac);
+	RUNTEST(argv[0],test_authenticate_unknown_id);
+	RUNTEST(argv[0],test_authenticate_stale_resolved);
+
+	return 0;
+}
@@ -52,6 +52,95 @@ int test_parse_with_app() {
 }
 
 
+/*
+ * Store parameters like the callback used with the generic parser before
+ * the Hawk specific parser existed.
+ */
+static HawkcError generic_param_handler(HawkcContext ctx,HawkcString key, HawkcString value,void *data) {
+	AuthorizationHeader h = (AuthorizationHeader)data;
+	if(key.len == 2 && !memcmp(key.data,"id",key.len)) {
+		h->id = value;
+	} else if(key.len == 3 && !memcmp(key.data,"mac",key.len)) {
+		h->mac = value;
+	} else if(key.len == 4 && !memcmp(key.data,"hash",key.len)) {
+		h->hash = value;
+	} else if(key.len == 5 && !memcmp(key.data,"nonce",key.len)) {
+		h->nonce = value;
+	} else if(key.len == 2 && !memcmp(key.data,"ts",key.len)) {
+		return hawkc_parse_time(ctx,value,&(h->ts));
+	} else if(key.len == 3 && !memcmp(key.data,"ext",key.len)) {
+		h->ext = value;
+	} else if(key.len == 3 && !memcmp(key.data,"app",key.len)) {
+		h->app = value;
+	} else if(key.len == 3 && !memcmp(key.data,"dlg",key.len)) {
+		h->dlg = value;
+	}
+	return HAWKC_OK;
+}
+
+static HawkcError generic_scheme_handler(HawkcContext ctx,HawkcString scheme,void *data) {
+	if((scheme.len != 4) || memcmp(scheme.data,"Hawk",4) != 0) {
+		return hawkc_set_error(ctx, HAWKC_BAD_SCHEME_ERROR, "Unsupported authentication scheme");
+	}
+	return HAWKC_OK;
+}
+
+#define EXPECT_FIELD_EQUAL(a,b) do { EXPECT_TRUE((a).data == (b).data); EXPECT_INT_EQUAL((int)(a).len,(int)(b).len); } while(0)
+
+/*
+ * The Hawk parser stores the same fields as the generic parser with a
+ * parameter callback.
+ */
+int test_parse_matches_generic_parser() {
+	char *headers[] = {
+		"Hawk id=\"someId\",mac=\"abc\",ts=\"1373805459\",nonce=\"abc\"",
+		"Hawk id=\"someId\", ts=\"1373805459\", nonce=\"n\", hash=\"h\", ext=\"e x\", mac=\"m\", app=\"a\", dlg=\"d\"",
+		"Hawk  dlg = \"d\" ,app=a,ext=\"\",hash=\"h\",nonce=n,ts=1,mac=m,id=i",
+		"Hawk id=\"someId\", Id=\"x\", ix=\"x\", tz=\"1\", macs=\"x\", nonce2=\"x\", hashes=\"x\", dl=\"x\", error=\"x\"",
+		"Hawk",
+		"Hawk id=\"someId\", ts=\"12a\"",
+		"Basic id=\"someId\"",
+		"Hawk id=\"someId\" mac=\"abc\""
+	};
+	struct AuthorizationHeader expected, actual;
+	HawkcError expected_e;
+	size_t i;
+
+	for(i = 0; i < sizeof(headers) / sizeof(headers[0]); i++) {
+		unsigned char *h = (unsigned char*)headers[i];
+		memset(&expected,0,sizeof(expected));
+		memset(&actual,0,sizeof(actual));
+		expected_e = hawkc_parse_auth_header(&ctx,h,strlen(headers[i]),generic_scheme_handler,generic_param_handler,&expected);
+		e = hawkc_parse_hawk_authorization_header(&ctx,h,strlen(headers[i]),&actual);
+		EXPECT_INT_EQUAL(expected_e,e);
+		EXPECT_FIELD_EQUAL(expected.id,actual.id);
+		EXPECT_FIELD_EQUAL(expected.mac,actual.mac);
+		EXPECT_FIELD_EQUAL(expected.hash,actual.hash);
+		EXPECT_FIELD_EQUAL(expected.nonce,actual.nonce);
+		EXPECT_FIELD_EQUAL(expected.ext,actual.ext);
+		EXPECT_FIELD_EQUAL(expected.app,actual.app);
+		EXPECT_FIELD_EQUAL(expected.dlg,actual.dlg);
+		EXPECT_INT_EQUAL((int)expected.ts,(int)actual.ts);
+	}
+	return 0;
+}
+
+int test_parse_duplicate() {
+	char *h1 = "Hawk id=\"someId\", ts=\"1373805459\", nonce=\"abc\", id=\"otherId\", mac=\"abc\"";
+	char *h2 = "Hawk id=\"someId\", ts=\"1373805459\", ts=\"1373805460\"";
+	char *h3 = "Hawk id=\"someId\", foo=\"a\", foo=\"b\"";
+
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h1,strlen(h1));
+	EXPECT_RETVAL(HAWKC_PARSE_ERROR,e,&ctx);
+	EXPECT_STR_EQUAL("Duplicate parameter 'id'",hawkc_get_error(&ctx));
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h2,strlen(h2));
+	EXPECT_RETVAL(HAWKC_PARSE_ERROR,e,&ctx);
+
+	/* Unknown parameters are not checked */
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h3,strlen(h3));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	return 0;
+}
 
 int main(int argc, char **argv) {
 
@@ -59,6 +148,8 @@ int main(int argc, char **argv) {
 
 	RUNTEST(argv[0],test_parse);
 	RUNTEST(argv[0],test_parse_with_app);
+	RUNTEST(argv[0],test_parse_matches_generic_parser);
+	RUNTEST(argv[0],test_parse_duplicate);
 
 	return 0;
 }
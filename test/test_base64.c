@@ -133,10 +133,71 @@ int test_base64_decodes_correctly() {
 	return 0;
 }
 
+int test_base64_strict_decode() {
+
+	struct HawkcContext ctx;
+	unsigned char bytes[256];
+	size_t len;
+	HawkcError e;
+	unsigned char b7[] = { 62, 1, 2, 3, 4, 5, 6, 7, 120, 60, 61, 63, 65, 44, 21, 22, 23,
+			24, 30, 31, 32, 45, 92, 93, 94, 95, 80, 81, 82, 83, 84 };
+
+	hawkc_context_init(&ctx);
+
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"", 0, bytes, &len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(len == 0);
+
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"Zg==", 4, bytes, &len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(len == 1);
+	EXPECT_BYTE_EQUAL("f", bytes, 1);
+
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"Zm8=", 4, bytes, &len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(len == 2);
+	EXPECT_BYTE_EQUAL("fo", bytes, 2);
+
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"Zm9vYmFy", 8, bytes, &len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(len == 6);
+	EXPECT_BYTE_EQUAL("foobar", bytes, 6);
+
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"PgECAwQFBgd4PD0/QSwVFhcYHh8gLVxdXl9QUVJTVA==", 44,
+			bytes, &len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(len == 31);
+	EXPECT_BYTE_EQUAL(b7, bytes, 31);
+
+	/* Length not a multiple of 4 */
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"Zm9vYmE", 7, bytes, &len);
+	EXPECT_TRUE(e == HAWKC_BASE64_ERROR);
+	/* Characters outside the alphabet */
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"Zm9v-mFy", 8, bytes, &len);
+	EXPECT_TRUE(e == HAWKC_BASE64_ERROR);
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"Zm9vYmF\"", 8, bytes, &len);
+	EXPECT_TRUE(e == HAWKC_BASE64_ERROR);
+	/* Padding in the middle or too much of it */
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"Zg==Zm8=", 8, bytes, &len);
+	EXPECT_TRUE(e == HAWKC_BASE64_ERROR);
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"Z===", 4, bytes, &len);
+	EXPECT_TRUE(e == HAWKC_BASE64_ERROR);
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"Zg=a", 4, bytes, &len);
+	EXPECT_TRUE(e == HAWKC_BASE64_ERROR);
+	/* Non-canonical encodings of "f" and "fo" */
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"Zh==", 4, bytes, &len);
+	EXPECT_TRUE(e == HAWKC_BASE64_ERROR);
+	e = hawkc_base64_decode_strict(&ctx,(unsigned char*)"Zm9=", 4, bytes, &len);
+	EXPECT_TRUE(e == HAWKC_BASE64_ERROR);
+
+	return 0;
+}
+
 int main(int argc, char **argv) {
 
 	RUNTEST(argv[0], test_base64_encodes_correctly);
 	RUNTEST(argv[0], test_base64_decodes_correctly);
+	RUNTEST(argv[0], test_base64_strict_decode);
 
 	return 0;
 }
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include "hawkc.h"
+#include "common.h"
+#include "test.h"
+
+static struct HawkcContext ctx;
+static HawkcError e;
+
+/*
+ * The coarse clock agrees with time() and is the default.
+ */
+int test_coarse_clock() {
+	time_t t, c;
+
+	hawkc_context_init(&ctx);
+	t = time(NULL);
+	c = hawkc_context_time(&ctx);
+	EXPECT_TRUE(c >= t - 1 && c <= t + 1);
+	c = hawkc_coarse_clock(NULL);
+	EXPECT_TRUE(c >= t - 1 && c <= t + 1);
+	return 0;
+}
+
+int test_fake_clock() {
+	HawkcFakeClock clock = { 1000, 0 };
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_clock(&ctx,hawkc_fake_clock,&clock);
+	EXPECT_INT_EQUAL(1000,(int)hawkc_context_time(&ctx));
+	EXPECT_INT_EQUAL(1000,(int)hawkc_context_time(&ctx));
+
+	clock.step = 5;
+	EXPECT_INT_EQUAL(1000,(int)hawkc_context_time(&ctx));
+	EXPECT_INT_EQUAL(1005,(int)hawkc_context_time(&ctx));
+
+	hawkc_context_set_clock(&ctx,NULL,NULL);
+	EXPECT_TRUE(hawkc_context_time(&ctx) > 1010);
+	return 0;
+}
+
+/*
+ * Timestamps inside the window pass, others make the WWW-Authenticate
+ * header carry the server time.
+ */
+int test_check_timestamp() {
+	HawkcFakeClock clock = { 1353788437, 0 };
+	char *h = "Hawk id=\"someId\",mac=\"t81/bBJPDw53kKCs5u5YeSmL7cs=\",ts=\"1353788437\",nonce=\"abc\"";
+	int is_valid;
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_clock(&ctx,hawkc_fake_clock,&clock);
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h,strlen(h));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	e = hawkc_check_timestamp(&ctx,60,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+	EXPECT_INT_EQUAL(0,(int)ctx.www_authenticate_header.ts);
+
+	clock.now = 1353788437 + 60;
+	e = hawkc_check_timestamp(&ctx,60,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+	clock.now = 1353788437 - 60;
+	e = hawkc_check_timestamp(&ctx,60,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+
+	clock.now = 1353788437 + 61;
+	e = hawkc_check_timestamp(&ctx,60,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!is_valid);
+	EXPECT_INT_EQUAL(1353788437 + 61,(int)ctx.www_authenticate_header.ts);
+
+	clock.now = 1353788437 - 61;
+	e = hawkc_check_timestamp(&ctx,60,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!is_valid);
+	return 0;
+}
+
+/*
+ * Signing takes the timestamp from the clock, plus the clock offset.
+ */
+int test_sign_with_clock() {
+	HawkcFakeClock clock = { 1353788437, 0 };
+	unsigned char header[1024];
+	size_t required_len, len;
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_clock(&ctx,hawkc_fake_clock,&clock);
+	hawkc_context_set_clock_offset(&ctx,3);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	hawkc_context_set_password(&ctx,(unsigned char *)"test",4);
+	hawkc_context_set_id(&ctx,(unsigned char *)"someId",6);
+	hawkc_context_set_method(&ctx,(unsigned char *)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char *)"/some/path/to/foo",17);
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char *)"80",2);
+	e = hawkc_calculate_authorization_header_length(&ctx,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(required_len <= sizeof(header));
+	e = hawkc_create_authorization_header(&ctx,header,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(1353788440,(int)ctx.header_out.ts);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	RUNTEST(argv[0],test_coarse_clock);
+	RUNTEST(argv[0],test_fake_clock);
+	RUNTEST(argv[0],test_check_timestamp);
+	RUNTEST(argv[0],test_sign_with_clock);
+
+	return 0;
+}
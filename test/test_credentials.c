@@ -0,0 +1,397 @@
+/*
+ * POSIX threads, which -std=c99 hides otherwise.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+#include "test.h"
+
+static struct HawkcContext ctx;
+static HawkcError e;
+
+/*
+ * Reference values of XXH64.
+ */
+int test_hash_bytes() {
+	unsigned char buf[100];
+	int i;
+
+	EXPECT_TRUE(hawkc_hash_bytes((unsigned char*)"",0,0) == 0xEF46DB3751D8E999ULL);
+	EXPECT_TRUE(hawkc_hash_bytes((unsigned char*)"a",1,0) == 0xD24EC4F1A98C6E5BULL);
+	EXPECT_TRUE(hawkc_hash_bytes((unsigned char*)"abc",3,0) == 0x44BC2CF5AD770999ULL);
+
+	/* All lengths around the 32 byte blocks hash differently */
+	for(i = 0; i < 100; i++) {
+		buf[i] = (unsigned char)i;
+	}
+	for(i = 1; i < 100; i++) {
+		EXPECT_TRUE(hawkc_hash_bytes(buf,i,1) != hawkc_hash_bytes(buf,i - 1,1));
+		EXPECT_TRUE(hawkc_hash_bytes(buf,i,1) != hawkc_hash_bytes(buf,i,2));
+	}
+	return 0;
+}
+
+/*
+ * A key restored from its chaining values computes the same HMACs.
+ */
+int test_key_export_import() {
+	struct HawkcKey key, imported;
+	unsigned char chain[2 * MAX_DIGEST_CHAIN_BYTES];
+	unsigned char a[MAX_HMAC_BYTES_B64], b[MAX_HMAC_BYTES_B64];
+	size_t alen, blen;
+	HawkcAlgorithm *algorithm;
+	const char *data = "hawk.1.header\n1373805459\nabc\nGET\n/some/path/to/foo\nexample.com\n80\n\nfoo\n";
+
+	hawkc_context_init(&ctx);
+	for(algorithm = hawkc_algorithms; *algorithm != NULL; algorithm++) {
+		e = hawkc_key_init(&ctx,&key,*algorithm,(unsigned char*)"test",4);
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+		hawkc_key_export(&key,chain);
+		memset(&imported,0xaa,sizeof(imported));
+		hawkc_key_import(&imported,*algorithm,chain);
+
+		e = hawkc_key_hmac(&ctx,&key,(unsigned char*)data,strlen(data),a,&alen);
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+		e = hawkc_key_hmac(&ctx,&imported,(unsigned char*)data,strlen(data),b,&blen);
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+		EXPECT_INT_EQUAL((int)alen,(int)blen);
+		EXPECT_BYTE_EQUAL(a,b,(int)alen);
+	}
+	return 0;
+}
+
+static HawkcError add(HawkcCredentials credentials, const char *id, HawkcAlgorithm algorithm, const char *password) {
+	return hawkc_credentials_add(&ctx,credentials,(unsigned char*)id,strlen(id),algorithm,(unsigned char*)password,strlen(password));
+}
+
+static HawkcError lookup(HawkcCredentialStore store, const char *id, HawkcKey key) {
+	return hawkc_credential_store_lookup(&ctx,store,(unsigned char*)id,strlen(id),key);
+}
+
+int test_credential_store_lookup() {
+	HawkcCredentialStore store;
+	HawkcCredentials credentials;
+	struct HawkcKey key;
+	char id[32];
+	int i;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_credential_store_create(&ctx,&store);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = lookup(store,"someId",&key);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+
+	/* Sized for fewer ids than added, so the set has to grow */
+	e = hawkc_credentials_create(&ctx,2,&credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = add(credentials,"someId",HAWKC_SHA_1,"test");
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = add(credentials,"other",HAWKC_SHA_512,"secret");
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	for(i = 0; i < 1000; i++) {
+		sprintf(id,"id%d",i);
+		e = add(credentials,id,HAWKC_SHA_256,id);
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	}
+	e = add(credentials,"someId",HAWKC_SHA_256,"test");
+	EXPECT_RETVAL(HAWKC_ERROR,e,&ctx);
+
+	e = hawkc_credential_store_publish(&ctx,store,credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	e = lookup(store,"someId",&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(key.algorithm == HAWKC_SHA_1);
+	e = lookup(store,"other",&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(key.algorithm == HAWKC_SHA_512);
+	for(i = 0; i < 1000; i++) {
+		sprintf(id,"id%d",i);
+		e = lookup(store,id,&key);
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+		EXPECT_TRUE(key.algorithm == HAWKC_SHA_256);
+	}
+	e = lookup(store,"someid",&key);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+	e = lookup(store,"",&key);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+
+	/* Emptying the store */
+	e = hawkc_credential_store_publish(&ctx,store,NULL);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = lookup(store,"someId",&key);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+
+	hawkc_credential_store_free(&ctx,store);
+	return 0;
+}
+
+/*
+ * Validation takes the key from the store by the id of the header.
+ */
+int test_validate_with_store() {
+	HawkcCredentialStore store;
+	HawkcCredentials credentials;
+	HawkcContext ctxs[1];
+	unsigned char valid;
+	int is_valid;
+	char *h1 = "Hawk id=\"someId\",mac=\"t81/bBJPDw53kKCs5u5YeSmL7cs=\",ts=\"1373805459\",nonce=\"abc\", ext=\"foo\"";
+	char *h2 = "Hawk id=\"unknown\",mac=\"t81/bBJPDw53kKCs5u5YeSmL7cs=\",ts=\"1373805459\",nonce=\"abc\", ext=\"foo\"";
+
+	hawkc_context_init(&ctx);
+	e = hawkc_credential_store_create(&ctx,&store);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credentials_create(&ctx,10,&credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = add(credentials,"someId",HAWKC_SHA_1,"test");
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credential_store_publish(&ctx,store,credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	hawkc_context_set_credential_store(&ctx,store);
+	hawkc_context_set_method(&ctx,(unsigned char *)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char *)"/some/path/to/foo",17);
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char *)"80",2);
+
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h1,strlen(h1));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+	EXPECT_TRUE(hawkc_context_active_algorithm(&ctx) == HAWKC_SHA_1);
+	/* The resolved key is only used for the request */
+	EXPECT_TRUE(ctx.key == NULL);
+	EXPECT_TRUE(ctx.algorithm == NULL);
+
+	ctxs[0] = &ctx;
+	e = hawkc_validate_hmac_batch(ctxs,1,&valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(1,valid);
+
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h2,strlen(h2));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+	EXPECT_TRUE(!is_valid);
+	e = hawkc_validate_hmac_batch(ctxs,1,&valid);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+	EXPECT_INT_EQUAL(0,valid);
+
+	/* Without the store, password and algorithm of the context are used again */
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h1,strlen(h1));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+	hawkc_context_set_credential_store(&ctx,NULL);
+	hawkc_context_set_password(&ctx,(unsigned char*)"wrong",5);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_1);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!is_valid);
+
+	hawkc_credential_store_free(&ctx,store);
+	return 0;
+}
+
+/*
+ * A credential file finds every id written to it and none else.
+ */
+int test_credential_file_lookup() {
+	HawkcCredentials credentials;
+	HawkcCredentialFile file;
+	struct HawkcKey key;
+	char id[32];
+	const char *path = "test/test_credentials.hcf";
+	struct stat st;
+	FILE *f;
+	int i;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_credentials_create(&ctx,10,&credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	/* An empty file has no ids */
+	e = hawkc_credential_file_write(&ctx,credentials,path);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credential_file_open(&ctx,path,&file);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credential_file_lookup(&ctx,file,(unsigned char*)"someId",6,&key);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+	hawkc_credential_file_close(&ctx,file);
+
+	e = add(credentials,"someId",HAWKC_SHA_1,"test");
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = add(credentials,"other",HAWKC_SHA_512,"secret");
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	for(i = 0; i < 10000; i++) {
+		sprintf(id,"id%d",i);
+		e = add(credentials,id,(i & 1) ? HAWKC_SHA_256 : HAWKC_SHA_384,id);
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	}
+	e = hawkc_credential_file_write(&ctx,credentials,path);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_credentials_free(&ctx,credentials);
+
+	/* Only the owner may read the chaining values */
+	EXPECT_TRUE(stat(path,&st) == 0);
+	EXPECT_INT_EQUAL(0600,(int)(st.st_mode & 0777));
+
+	e = hawkc_credential_file_open(&ctx,path,&file);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credential_file_lookup(&ctx,file,(unsigned char*)"someId",6,&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(key.algorithm == HAWKC_SHA_1);
+	e = hawkc_credential_file_lookup(&ctx,file,(unsigned char*)"other",5,&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(key.algorithm == HAWKC_SHA_512);
+	for(i = 0; i < 10000; i++) {
+		sprintf(id,"id%d",i);
+		e = hawkc_credential_file_lookup(&ctx,file,(unsigned char*)id,strlen(id),&key);
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+		EXPECT_TRUE(key.algorithm == ((i & 1) ? HAWKC_SHA_256 : HAWKC_SHA_384));
+	}
+	for(i = 10000; i < 20000; i++) {
+		sprintf(id,"id%d",i);
+		e = hawkc_credential_file_lookup(&ctx,file,(unsigned char*)id,strlen(id),&key);
+		EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+	}
+	e = hawkc_credential_file_lookup(&ctx,file,(unsigned char*)"",0,&key);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+	hawkc_credential_file_close(&ctx,file);
+
+	/* Truncated files are rejected */
+	EXPECT_TRUE( (f = fopen(path,"wb")) != NULL);
+	EXPECT_TRUE(fwrite("HAWKCRD1",1,8,f) == 8);
+	fclose(f);
+	e = hawkc_credential_file_open(&ctx,path,&file);
+	EXPECT_RETVAL(HAWKC_ERROR,e,&ctx);
+
+	remove(path);
+	e = hawkc_credential_file_open(&ctx,path,&file);
+	EXPECT_RETVAL(HAWKC_ERROR,e,&ctx);
+	return 0;
+}
+
+/*
+ * Validation takes the key from the credential file by the id of the header.
+ */
+int test_validate_with_credential_file() {
+	HawkcCredentials credentials;
+	HawkcCredentialFile file;
+	int is_valid;
+	const char *path = "test/test_credentials.hcf";
+	char *h1 = "Hawk id=\"someId\",mac=\"t81/bBJPDw53kKCs5u5YeSmL7cs=\",ts=\"1373805459\",nonce=\"abc\", ext=\"foo\"";
+	char *h2 = "Hawk id=\"unknown\",mac=\"t81/bBJPDw53kKCs5u5YeSmL7cs=\",ts=\"1373805459\",nonce=\"abc\", ext=\"foo\"";
+
+	hawkc_context_init(&ctx);
+	e = hawkc_credentials_create(&ctx,10,&credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = add(credentials,"someId",HAWKC_SHA_1,"test");
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credential_file_write(&ctx,credentials,path);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_credentials_free(&ctx,credentials);
+	e = hawkc_credential_file_open(&ctx,path,&file);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	remove(path);
+
+	hawkc_context_set_credential_file(&ctx,file);
+	hawkc_context_set_method(&ctx,(unsigned char *)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char *)"/some/path/to/foo",17);
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char *)"80",2);
+
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h1,strlen(h1));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+	EXPECT_TRUE(hawkc_context_active_algorithm(&ctx) == HAWKC_SHA_1);
+
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h2,strlen(h2));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+
+	hawkc_context_set_credential_file(&ctx,NULL);
+	hawkc_credential_file_close(&ctx,file);
+	return 0;
+}
+
+#define IDS 1000
+#define RELOADS 200
+
+/*
+ * Every published set maps "id<i>" to a SHA-256 key, readers must always
+ * find it while sets are replaced.
+ */
+static int read_all(TestThreads *threads, int t) {
+	HawkcCredentialStore store = (HawkcCredentialStore)threads->data;
+	struct HawkcContext c;
+	struct HawkcKey key;
+	char id[32];
+	int i = 0, failures = 0;
+
+	hawkc_context_init(&c);
+	while(!threads->stop) {
+		sprintf(id,"id%d",i++ % IDS);
+		if(hawkc_credential_store_lookup(&c,store,(unsigned char*)id,strlen(id),&key) != HAWKC_OK
+				|| key.algorithm != HAWKC_SHA_256) {
+			failures++;
+		}
+	}
+	return failures;
+}
+
+int test_credential_store_reload() {
+	HawkcCredentialStore store;
+	TestThreads threads;
+	HawkcCredentials credentials;
+	char id[32];
+	int i, r;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_credential_store_create(&ctx,&store);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	for(r = 0; r <= RELOADS; r++) {
+		e = hawkc_credentials_create(&ctx,IDS,&credentials);
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+		for(i = 0; i < IDS; i++) {
+			sprintf(id,"id%d",i);
+			e = add(credentials,id,HAWKC_SHA_256,id);
+			EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+		}
+		e = hawkc_credential_store_publish(&ctx,store,credentials);
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+		if(r == 0) {
+			EXPECT_INT_EQUAL(0,start_test_threads(&threads,read_all,store));
+		}
+	}
+	EXPECT_INT_EQUAL(0,join_test_threads(&threads));
+
+	hawkc_credential_store_free(&ctx,store);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	RUNTEST(argv[0],test_hash_bytes);
+	RUNTEST(argv[0],test_key_export_import);
+	RUNTEST(argv[0],test_credential_store_lookup);
+	RUNTEST(argv[0],test_validate_with_store);
+	RUNTEST(argv[0],test_credential_store_reload);
+	RUNTEST(argv[0],test_credential_file_lookup);
+	RUNTEST(argv[0],test_validate_with_credential_file);
+
+	return 0;
+}
@@ -32,11 +32,115 @@ int test_hmac() {
 
 
 
+int test_key_hmac() {
+
+	unsigned char buf[1024];
+	unsigned char buf2[1024];
+	size_t len;
+	size_t len2;
+	HawkcKey key;
+	char *long_pwd = "a password that is longer than the sixty-four byte block size of sha1 and sha256";
+
+	e = hawkc_key_create(&ctx,HAWKC_SHA_256,(unsigned char *)"test",4,&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_key_hmac(&ctx, key,(unsigned char *)"Das ist die Message",19,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_hmac(&ctx, HAWKC_SHA_256,(unsigned char *)"test",4,(unsigned char *)"Das ist die Message",19,buf2,&len2);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL((int)len,(int)len2);
+	EXPECT_BYTE_EQUAL(buf,buf2,(int)len);
+	hawkc_key_free(&ctx,key);
+
+	/* RFC 2202 test case 2 */
+	e = hawkc_key_create(&ctx,HAWKC_SHA_1,(unsigned char *)"Jefe",4,&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_key_hmac(&ctx, key,(unsigned char *)"what do ya want for nothing?",28,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(28,(int)len);
+	EXPECT_BYTE_EQUAL("7/zfauXrL6LSdBbV8YTfnCWafHk=",buf,28);
+	hawkc_key_free(&ctx,key);
+
+	/* Passwords longer than the block size are hashed first */
+	e = hawkc_key_create(&ctx,HAWKC_SHA_1,(unsigned char *)long_pwd,strlen(long_pwd),&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_key_hmac(&ctx, key,(unsigned char *)"Das ist die Message",19,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_hmac(&ctx, HAWKC_SHA_1,(unsigned char *)long_pwd,strlen(long_pwd),(unsigned char *)"Das ist die Message",19,buf2,&len2);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL((int)len,(int)len2);
+	EXPECT_BYTE_EQUAL(buf,buf2,(int)len);
+	hawkc_key_free(&ctx,key);
+
+	return 0;
+}
+
+
+/*
+ * RFC 4231 test case 2 for the SHA-2 algorithms and the same key set up
+ * from a password longer than the SHA-512 block size.
+ */
+int test_sha2_hmac() {
+
+	unsigned char buf[MAX_HMAC_BYTES_B64];
+	unsigned char buf2[MAX_HMAC_BYTES_B64];
+	size_t len;
+	size_t len2;
+	HawkcKey key;
+	char *data = "what do ya want for nothing?";
+	char long_pwd[200];
+
+	e = hawkc_hmac(&ctx, HAWKC_SHA_256,(unsigned char *)"Jefe",4,(unsigned char *)data,strlen(data),buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(44,(int)len);
+	EXPECT_BYTE_EQUAL("W9zBRr9gdU5qBCQmCJV1x1oAPwidJzmDnexYuWTsOEM=",buf,44);
+
+	e = hawkc_hmac(&ctx, HAWKC_SHA_384,(unsigned char *)"Jefe",4,(unsigned char *)data,strlen(data),buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(64,(int)len);
+	EXPECT_BYTE_EQUAL("r0XS43ZIQDFhf3jStYprG5x+9GT1oBtH5C7Dc2MiRF6OIkDKXmnix4syOez6shZJ",buf,64);
+
+	e = hawkc_key_create(&ctx,HAWKC_SHA_512,(unsigned char *)"Jefe",4,&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_key_hmac(&ctx, key,(unsigned char *)data,strlen(data),buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(88,(int)len);
+	EXPECT_BYTE_EQUAL("Fkt6e/z4GeLjlfvnO1bgo4e9ZCIugx/WECcM1+olBVSXWL91wFqZSm0DT2X48Ob9yuqxo01Ka0tjbgcKOLznNw==",buf,88);
+	hawkc_key_free(&ctx,key);
+
+	memset(long_pwd,'x',sizeof(long_pwd));
+	e = hawkc_key_create(&ctx,HAWKC_SHA_512,(unsigned char *)long_pwd,sizeof(long_pwd),&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_key_hmac(&ctx, key,(unsigned char *)data,strlen(data),buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_hmac(&ctx, HAWKC_SHA_512,(unsigned char *)long_pwd,sizeof(long_pwd),(unsigned char *)data,strlen(data),buf2,&len2);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL((int)len,(int)len2);
+	EXPECT_BYTE_EQUAL(buf,buf2,(int)len);
+	hawkc_key_free(&ctx,key);
+
+	return 0;
+}
+
+int test_algorithm_by_name() {
+	EXPECT_TRUE(hawkc_algorithm_by_name("sha1",4) == HAWKC_SHA_1);
+	EXPECT_TRUE(hawkc_algorithm_by_name("sha256",6) == HAWKC_SHA_256);
+	EXPECT_TRUE(hawkc_algorithm_by_name("sha384",6) == HAWKC_SHA_384);
+	EXPECT_TRUE(hawkc_algorithm_by_name("sha512",6) == HAWKC_SHA_512);
+	EXPECT_TRUE(hawkc_algorithm_by_name("sha5123",6) == HAWKC_SHA_512);
+	EXPECT_TRUE(hawkc_algorithm_by_name("sha",3) == NULL);
+	EXPECT_TRUE(hawkc_algorithm_by_name("md5",3) == NULL);
+	return 0;
+}
+
+
 int main(int argc, char **argv) {
 
 	hawkc_context_init(&ctx);
 
 	RUNTEST(argv[0],test_hmac);
+	RUNTEST(argv[0],test_key_hmac);
+	RUNTEST(argv[0],test_sha2_hmac);
+	RUNTEST(argv[0],test_algorithm_by_name);
 
 	return 0;
 }
@@ -0,0 +1,208 @@
+/*
+ * POSIX threads, which -std=c99 hides otherwise.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include "hawkc.h"
+#include "common.h"
+#include "test.h"
+
+static struct HawkcContext ctx;
+static HawkcError e;
+
+#define IDS 10000
+
+static char ids[IDS][16];
+static const unsigned char *id_ptrs[IDS];
+static size_t id_lens[IDS];
+
+static void make_ids(const char *prefix) {
+	int i;
+	for(i = 0; i < IDS; i++) {
+		sprintf(ids[i],"%s%d",prefix,i);
+		id_ptrs[i] = (unsigned char*)ids[i];
+		id_lens[i] = strlen(ids[i]);
+	}
+}
+
+static int contains(HawkcIdFilter filter, const char *id) {
+	return hawkc_id_filter_contains(filter,(unsigned char*)id,strlen(id));
+}
+
+/*
+ * Known ids always pass, about 1% of unknown ids pass at the default size.
+ */
+int test_id_filter_contains() {
+	HawkcIdFilter filter;
+	HawkcIdFilterStats stats;
+	char id[16];
+	int i, passed = 0;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_id_filter_create(&ctx,&filter);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!contains(filter,"id0"));
+
+	make_ids("id");
+	e = hawkc_id_filter_rebuild(&ctx,filter,id_ptrs,id_lens,IDS,0);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	for(i = 0; i < IDS; i++) {
+		EXPECT_TRUE(contains(filter,ids[i]));
+	}
+	for(i = 0; i < 10 * IDS; i++) {
+		sprintf(id,"unknown%d",i);
+		passed += contains(filter,id);
+	}
+	EXPECT_TRUE(passed < 10 * IDS / 40);
+
+	hawkc_id_filter_stats(filter,&stats);
+	EXPECT_INT_EQUAL(IDS,(int)stats.ids);
+	EXPECT_TRUE(stats.size >= IDS * 10 / 8);
+	EXPECT_INT_EQUAL(11 * IDS + 1,(int)stats.checks);
+	EXPECT_INT_EQUAL(10 * IDS - passed + 1,(int)stats.rejected);
+	EXPECT_INT_EQUAL(0,(int)stats.false_positives);
+
+	/* More bits per id, fewer false positives */
+	e = hawkc_id_filter_rebuild(&ctx,filter,id_ptrs,id_lens,IDS,20);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	passed = 0;
+	for(i = 0; i < 10 * IDS; i++) {
+		sprintf(id,"unknown%d",i);
+		passed += contains(filter,id);
+	}
+	EXPECT_TRUE(passed < 10 * IDS / 1000);
+
+	/* Rebuilding replaces the ids */
+	e = hawkc_id_filter_rebuild(&ctx,filter,NULL,NULL,0,0);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!contains(filter,"id0"));
+
+	hawkc_id_filter_free(&ctx,filter);
+	return 0;
+}
+
+/*
+ * Headers with unknown ids are rejected by the parser, ids that pass the
+ * filter but are not in the store are counted as false positives.
+ */
+int test_id_filter_parse() {
+	HawkcIdFilter filter;
+	HawkcIdFilterStats stats;
+	HawkcCredentialStore store;
+	HawkcCredentials credentials;
+	int is_valid;
+	const unsigned char *known[2];
+	size_t known_lens[2];
+	char *h1 = "Hawk id=\"someId\",mac=\"t81/bBJPDw53kKCs5u5YeSmL7cs=\",ts=\"1373805459\",nonce=\"abc\", ext=\"foo\"";
+	char *h2 = "Hawk id=\"unknown\",mac=\"t81/bBJPDw53kKCs5u5YeSmL7cs=\",ts=\"1373805459\",nonce=\"abc\", ext=\"foo\"";
+	char *h3 = "Hawk id=\"removed\",mac=\"t81/bBJPDw53kKCs5u5YeSmL7cs=\",ts=\"1373805459\",nonce=\"abc\", ext=\"foo\"";
+
+	hawkc_context_init(&ctx);
+	e = hawkc_id_filter_create(&ctx,&filter);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credential_store_create(&ctx,&store);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credentials_create(&ctx,10,&credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_credentials_add(&ctx,credentials,(unsigned char*)"someId",6,HAWKC_SHA_1,(unsigned char*)"test",4);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_id_filter_rebuild_from_credentials(&ctx,filter,credentials,0);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(contains(filter,"someId"));
+	e = hawkc_credential_store_publish(&ctx,store,credentials);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	hawkc_context_set_credential_store(&ctx,store);
+	hawkc_context_set_id_filter(&ctx,filter);
+	hawkc_context_set_method(&ctx,(unsigned char *)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char *)"/some/path/to/foo",17);
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char *)"80",2);
+
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h1,strlen(h1));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h2,strlen(h2));
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+
+	/* The filter still knows an id the store does not have anymore */
+	known[0] = (unsigned char*)"someId";
+	known_lens[0] = 6;
+	known[1] = (unsigned char*)"removed";
+	known_lens[1] = 7;
+	e = hawkc_id_filter_rebuild(&ctx,filter,known,known_lens,2,0);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h3,strlen(h3));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+
+	hawkc_id_filter_stats(filter,&stats);
+	EXPECT_INT_EQUAL(4,(int)stats.checks);
+	EXPECT_INT_EQUAL(1,(int)stats.rejected);
+	EXPECT_INT_EQUAL(1,(int)stats.false_positives);
+
+	/* Without filter the parser does not check the id */
+	hawkc_context_set_id_filter(&ctx,NULL);
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h2,strlen(h2));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	hawkc_credential_store_free(&ctx,store);
+	hawkc_id_filter_free(&ctx,filter);
+	return 0;
+}
+
+#define REBUILDS 100
+
+/*
+ * Every rebuilt filter has the same ids, readers must always find them.
+ */
+static int check_all(TestThreads *threads, int t) {
+	HawkcIdFilter filter = (HawkcIdFilter)threads->data;
+	int i = 0, failures = 0;
+
+	while(!threads->stop) {
+		if(!contains(filter,ids[i++ % IDS])) {
+			failures++;
+		}
+	}
+	return failures;
+}
+
+int test_id_filter_rebuild() {
+	HawkcIdFilter filter;
+	TestThreads threads;
+	int r;
+
+	hawkc_context_init(&ctx);
+	make_ids("id");
+	e = hawkc_id_filter_create(&ctx,&filter);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	for(r = 0; r <= REBUILDS; r++) {
+		e = hawkc_id_filter_rebuild(&ctx,filter,id_ptrs,id_lens,IDS,0);
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+		if(r == 0) {
+			EXPECT_INT_EQUAL(0,start_test_threads(&threads,check_all,filter));
+		}
+	}
+	EXPECT_INT_EQUAL(0,join_test_threads(&threads));
+
+	hawkc_id_filter_free(&ctx,filter);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	RUNTEST(argv[0],test_id_filter_contains);
+	RUNTEST(argv[0],test_id_filter_parse);
+	RUNTEST(argv[0],test_id_filter_rebuild);
+
+	return 0;
+}
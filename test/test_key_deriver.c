@@ -0,0 +1,204 @@
+/*
+ * POSIX threads, which -std=c99 hides otherwise.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+#include "test.h"
+
+static struct HawkcContext ctx;
+static HawkcError e;
+
+#define MASTER "master secret"
+
+/*
+ * Passwords are the base64url encoded HMAC of the id.
+ */
+int test_key_deriver_password() {
+	HawkcKeyDeriver deriver;
+	unsigned char password[MAX_HMAC_BYTES_B64];
+	size_t len;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_key_deriver_create(&ctx,HAWKC_SHA_256,(unsigned char*)MASTER,strlen(MASTER),16,&deriver);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_key_deriver_password(&ctx,deriver,(unsigned char*)"someId",6,password,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(43,(int)len);
+	EXPECT_BYTE_EQUAL("n8Vx47ih7wDZIlvThRMpqjz5G5pJHpmCrm3NHtxM_Go",password,43);
+	hawkc_key_deriver_free(&ctx,deriver);
+
+	e = hawkc_key_deriver_create(&ctx,HAWKC_SHA_1,(unsigned char*)MASTER,strlen(MASTER),0,&deriver);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_key_deriver_password(&ctx,deriver,(unsigned char*)"someId",6,password,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(27,(int)len);
+	EXPECT_BYTE_EQUAL("G5mEi0z8UHARGGOjmSCUuYB7Oq4",password,27);
+	hawkc_key_deriver_free(&ctx,deriver);
+	return 0;
+}
+
+/*
+ * Compare the key of id with one set up from the derived password.
+ */
+static int check_key(HawkcKeyDeriver deriver, HawkcAlgorithm algorithm, const char *id) {
+	struct HawkcKey key, expected;
+	unsigned char password[MAX_HMAC_BYTES_B64];
+	unsigned char a[2 * MAX_DIGEST_CHAIN_BYTES], b[2 * MAX_DIGEST_CHAIN_BYTES];
+	size_t len;
+
+	e = hawkc_key_deriver_lookup(&ctx,deriver,(unsigned char*)id,strlen(id),&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_key_deriver_password(&ctx,deriver,(unsigned char*)id,strlen(id),password,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_key_init(&ctx,&expected,algorithm,password,len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(key.algorithm == algorithm);
+	hawkc_key_export(&key,a);
+	hawkc_key_export(&expected,b);
+	EXPECT_BYTE_EQUAL(a,b,(int)(2 * algorithm->chain_size));
+	return 0;
+}
+
+/*
+ * Keys stay correct while the cache evicts ids, also for ids that are too
+ * long to be cached.
+ */
+int test_key_deriver_cache() {
+	HawkcKeyDeriver deriver;
+	char id[128];
+	int i, r;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_key_deriver_create(&ctx,HAWKC_SHA_512,(unsigned char*)MASTER,strlen(MASTER),8,&deriver);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	for(r = 0; r < 3; r++) {
+		for(i = 0; i < 20; i++) {
+			/* A hot id between the others stays in the cache */
+			EXPECT_INT_EQUAL(0,check_key(deriver,HAWKC_SHA_512,"hot"));
+			sprintf(id,"id%d",(i * 7) % 13);
+			EXPECT_INT_EQUAL(0,check_key(deriver,HAWKC_SHA_512,id));
+		}
+	}
+	memset(id,'x',100);
+	id[100] = '\0';
+	EXPECT_INT_EQUAL(0,check_key(deriver,HAWKC_SHA_512,id));
+	hawkc_key_deriver_free(&ctx,deriver);
+	return 0;
+}
+
+/*
+ * Validation needs only the master secret.
+ */
+int test_validate_with_key_deriver() {
+	HawkcKeyDeriver deriver;
+	unsigned char password[MAX_HMAC_BYTES_B64];
+	unsigned char header[1024];
+	size_t password_len, required_len, len;
+	int is_valid;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_key_deriver_create(&ctx,HAWKC_SHA_256,(unsigned char*)MASTER,strlen(MASTER),16,&deriver);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_key_deriver_password(&ctx,deriver,(unsigned char*)"someId",6,password,&password_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	/* The client signs with the issued password */
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	hawkc_context_set_password(&ctx,password,password_len);
+	hawkc_context_set_id(&ctx,(unsigned char *)"someId",6);
+	hawkc_context_set_method(&ctx,(unsigned char *)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char *)"/some/path/to/foo",17);
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char *)"80",2);
+	e = hawkc_calculate_authorization_header_length(&ctx,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(required_len <= sizeof(header));
+	e = hawkc_create_authorization_header(&ctx,header,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_key_deriver(&ctx,deriver);
+	hawkc_context_set_method(&ctx,(unsigned char *)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char *)"/some/path/to/foo",17);
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char *)"80",2);
+	e = hawkc_parse_authorization_header(&ctx,header,len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+
+	/* A header of another id with the same mac is not valid */
+	header[11] = 'X';
+	e = hawkc_parse_authorization_header(&ctx,header,len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!is_valid);
+
+	hawkc_key_deriver_free(&ctx,deriver);
+	return 0;
+}
+
+#define LOOKUPS 20000
+
+/*
+ * Each thread has a cache of its own, so this checks that threads get
+ * their reader slots right. Counts the keys that are not those of their id.
+ */
+static int lookup_all(TestThreads *threads, int t) {
+	HawkcKeyDeriver deriver = (HawkcKeyDeriver)threads->data;
+	struct HawkcContext c;
+	struct HawkcKey key, expected;
+	unsigned char password[MAX_HMAC_BYTES_B64];
+	unsigned char a[2 * MAX_DIGEST_CHAIN_BYTES], b[2 * MAX_DIGEST_CHAIN_BYTES];
+	size_t len;
+	char id[32];
+	int i, failures = 0;
+
+	hawkc_context_init(&c);
+	for(i = 0; i < LOOKUPS; i++) {
+		sprintf(id,"id%d",(i * 31) % 100);
+		if(hawkc_key_deriver_lookup(&c,deriver,(unsigned char*)id,strlen(id),&key) != HAWKC_OK
+				|| hawkc_key_deriver_password(&c,deriver,(unsigned char*)id,strlen(id),password,&len) != HAWKC_OK
+				|| hawkc_key_init(&c,&expected,HAWKC_SHA_256,password,len) != HAWKC_OK) {
+			failures++;
+			continue;
+		}
+		hawkc_key_export(&key,a);
+		hawkc_key_export(&expected,b);
+		if(memcmp(a,b,2 * HAWKC_SHA_256->chain_size) != 0) {
+			failures++;
+		}
+	}
+	return failures;
+}
+
+int test_key_deriver_threads() {
+	HawkcKeyDeriver deriver;
+	TestThreads threads;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_key_deriver_create(&ctx,HAWKC_SHA_256,(unsigned char*)MASTER,strlen(MASTER),32,&deriver);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(0,start_test_threads(&threads,lookup_all,deriver));
+	EXPECT_INT_EQUAL(0,join_test_threads(&threads));
+	hawkc_key_deriver_free(&ctx,deriver);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	RUNTEST(argv[0],test_key_deriver_password);
+	RUNTEST(argv[0],test_key_deriver_cache);
+	RUNTEST(argv[0],test_validate_with_key_deriver);
+	RUNTEST(argv[0],test_key_deriver_threads);
+
+	return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * fork() and pipe() are POSIX, which -std=c99 hides otherwise.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+#include "test.h"
+
+static struct HawkcContext ctx;
+static HawkcError e;
+
+/*
+ * RFC 8439, section 2.3.2.
+ */
+int test_chacha20_block() {
+	unsigned char key[32];
+	unsigned char nonce[12] = { 0,0,0,0x09, 0,0,0,0x4a, 0,0,0,0 };
+	unsigned char out[64];
+	unsigned char expected[64] = {
+		0x10,0xf1,0xe7,0xe4,0xd1,0x3b,0x59,0x15,0x50,0x0f,0xdd,0x1f,0xa3,0x20,0x71,0xc4,
+		0xc7,0xd1,0xf4,0xc7,0x33,0xc0,0x68,0x03,0x04,0x22,0xaa,0x9a,0xc3,0xd4,0x6c,0x4e,
+		0xd2,0x82,0x64,0x46,0x07,0x9f,0xaa,0x09,0x14,0xc2,0xd7,0x05,0xd9,0x8b,0x02,0xa2,
+		0xb5,0x12,0x9c,0xd1,0xde,0x16,0x4e,0xb9,0xcb,0xd0,0x83,0xe8,0xa2,0x50,0x3c,0x4e };
+	int i;
+
+	for(i = 0; i < 32; i++) {
+		key[i] = (unsigned char)i;
+	}
+	hawkc_chacha20_block(key,1,nonce,out);
+	EXPECT_BYTE_EQUAL(expected,out,64);
+
+	return 0;
+}
+
+/*
+ * Nonces are hex encoded and successive nonces differ, also across
+ * refills of the generator's pool.
+ */
+int test_generate_nonce() {
+	unsigned char prev[MAX_NONCE_HEX_BYTES];
+	unsigned char buf[MAX_NONCE_HEX_BYTES];
+	int i, j;
+
+	hawkc_context_init(&ctx);
+	memset(prev,0,sizeof(prev));
+	for(i = 0; i < 10000; i++) {
+		e = hawkc_generate_nonce(&ctx,MAX_NONCE_BYTES,buf);
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+		for(j = 0; j < MAX_NONCE_HEX_BYTES; j++) {
+			EXPECT_TRUE((buf[j] >= '0' && buf[j] <= '9') || (buf[j] >= 'a' && buf[j] <= 'f'));
+		}
+		EXPECT_TRUE(memcmp(prev,buf,MAX_NONCE_HEX_BYTES) != 0);
+		memcpy(prev,buf,MAX_NONCE_HEX_BYTES);
+	}
+
+	/* Odd sizes */
+	e = hawkc_generate_nonce(&ctx,1,buf);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_generate_nonce(&ctx,5,buf);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	return 0;
+}
+
+/*
+ * A child process must not repeat the nonces of its parent.
+ */
+int test_generate_nonce_after_fork() {
+	unsigned char parent[MAX_NONCE_HEX_BYTES];
+	unsigned char child[MAX_NONCE_HEX_BYTES];
+	int fds[2];
+	pid_t pid;
+	int status;
+
+	hawkc_context_init(&ctx);
+	/* Make sure the generator is seeded before forking */
+	e = hawkc_generate_nonce(&ctx,MAX_NONCE_BYTES,parent);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	EXPECT_TRUE(pipe(fds) == 0);
+	pid = fork();
+	EXPECT_TRUE(pid >= 0);
+	if(pid == 0) {
+		close(fds[0]);
+		if(hawkc_generate_nonce(&ctx,MAX_NONCE_BYTES,child) != HAWKC_OK) {
+			_exit(1);
+		}
+		_exit(write(fds[1],child,MAX_NONCE_HEX_BYTES) == MAX_NONCE_HEX_BYTES ? 0 : 1);
+	}
+	close(fds[1]);
+	e = hawkc_generate_nonce(&ctx,MAX_NONCE_BYTES,parent);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(MAX_NONCE_HEX_BYTES,(int)read(fds[0],child,MAX_NONCE_HEX_BYTES));
+	close(fds[0]);
+	EXPECT_TRUE(waitpid(pid,&status,0) == pid);
+	EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	EXPECT_TRUE(memcmp(parent,child,MAX_NONCE_HEX_BYTES) != 0);
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	RUNTEST(argv[0],test_chacha20_block);
+	RUNTEST(argv[0],test_generate_nonce);
+	RUNTEST(argv[0],test_generate_nonce_after_fork);
+
+	return 0;
+}
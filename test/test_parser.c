@@ -1,6 +1,7 @@
 #include <string.h>
 #include "hawkc.h"
 #include "common.h"
+#include "scan.h"
 #include "test.h"
 
 static struct HawkcContext ctx;
@@ -140,12 +141,147 @@ int test_quoted_string() {
 	return 0;
 }
 
+static const HawkcScanKernel kernels[] = { HAWKC_SCAN_KERNEL_SSSE3, HAWKC_SCAN_KERNEL_AVX2 };
+
+/*
+ * Every kernel finds the same first non-token and the same first '"' or '\'
+ * as the portable loops, for every byte value at every position.
+ */
+int test_scan_kernels() {
+	unsigned char s[100];
+	size_t k, pos, len, token_len, quoted_len, field_len;
+	int c;
+
+	for(k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+		for(len = 0; len <= sizeof(s); len += 33) {
+			for(pos = 0; pos < len; pos++) {
+				for(c = 0; c < 256; c++) {
+					memset(s,'a',sizeof(s));
+					s[pos] = (unsigned char)c;
+					hawkc_scan_use_kernel(HAWKC_SCAN_KERNEL_PORTABLE);
+					token_len = hawkc_scan_token(s,len);
+					quoted_len = hawkc_scan_quoted(s,len);
+					field_len = hawkc_scan_field(s,len);
+					if(!hawkc_scan_use_kernel(kernels[k])) {
+						continue;
+					}
+					EXPECT_INT_EQUAL((int)token_len,(int)hawkc_scan_token(s,len));
+					EXPECT_INT_EQUAL((int)quoted_len,(int)hawkc_scan_quoted(s,len));
+					EXPECT_INT_EQUAL((int)field_len,(int)hawkc_scan_field(s,len));
+				}
+			}
+		}
+	}
+	hawkc_scan_use_kernel(HAWKC_SCAN_KERNEL_PORTABLE);
+	return 0;
+}
+
+/*
+ * Record of the callbacks of one parse, with the parts as offsets into the
+ * parsed header to check that they are not copied.
+ */
+typedef struct Record {
+	const unsigned char *header;
+	char calls[8192];
+	size_t len;
+} Record;
+
+static HawkcError record_scheme(HawkcContext ctx, HawkcString scheme, void *data) {
+	Record *r = (Record*)data;
+	r->len += sprintf(r->calls + r->len,"%d+%d",(int)(scheme.data - r->header),(int)scheme.len);
+	return HAWKC_OK;
+}
+
+static HawkcError record_param(HawkcContext ctx, HawkcString key, HawkcString value, void *data) {
+	Record *r = (Record*)data;
+	if(r->len + 64 > sizeof(r->calls)) {
+		return hawkc_set_error(ctx, HAWKC_ERROR, "Too many parameters");
+	}
+	r->len += sprintf(r->calls + r->len,"<%d+%d:%d+%d>",(int)(key.data - r->header),(int)key.len,
+			(int)(value.data - r->header),(int)value.len);
+	return HAWKC_OK;
+}
+
+static HawkcError parse_recorded(const unsigned char *header, size_t len, Record *r) {
+	r->header = header;
+	r->len = 0;
+	r->calls[0] = '\0';
+	return hawkc_parse_auth_header(&ctx,(unsigned char*)header,len,record_scheme,record_param,r);
+}
+
+/*
+ * Random headers made of the characters that matter to the parser, with
+ * long runs of token characters and quoted text so that tokens, quotes and
+ * escapes fall on every position of a vector.
+ */
+static size_t random_header(unsigned char *h, size_t max, unsigned int *seed) {
+	static const char special[] = " \t=,\"\\\"\\=,  \x80\x7f\x01|~:;@";
+	size_t len = 0, run;
+
+	len += sprintf((char*)h,"Hawk ");
+	while(len < max) {
+		*seed = *seed * 1103515245 + 12345;
+		run = (*seed >> 16) % 80;
+		while(run-- > 0 && len < max) {
+			*seed = *seed * 1103515245 + 12345;
+			h[len++] = "abcXYZ019-._~!#"[(*seed >> 16) % 15];
+		}
+		if(len < max) {
+			*seed = *seed * 1103515245 + 12345;
+			h[len++] = (unsigned char)special[(*seed >> 16) % (sizeof(special) - 1)];
+		}
+	}
+	return len;
+}
+
+/*
+ * Differential test of the parser with each kernel against the portable
+ * loops, on valid headers with long ids and on random input.
+ */
+int test_parse_kernels_match_portable() {
+	static Record expected, actual;
+	unsigned char h[700];
+	char id[500];
+	size_t k, len, i;
+	unsigned int seed = 42;
+	HawkcError expected_e, actual_e;
+
+	for(i = 0; i < 2000; i++) {
+		if(i < 200) {
+			/* Valid headers with ids of 300 to 499 bytes and an escape in ext */
+			memset(id,'a' + (char)(i % 26),sizeof(id));
+			id[300 + i] = '\0';
+			len = sprintf((char*)h,"Hawk id=\"%s\", ts=\"1353788437\", nonce=\"k3j4h2\", ext=\"%.*s\\\"x\", mac=\"abc=\"",
+					id,(int)(i % 40),"0123456789012345678901234567890123456789");
+		} else {
+			len = random_header(h,(i % 300) + 200,&seed);
+		}
+		hawkc_scan_use_kernel(HAWKC_SCAN_KERNEL_PORTABLE);
+		expected_e = parse_recorded(h,len,&expected);
+		if(i < 200) {
+			EXPECT_RETVAL(HAWKC_OK,expected_e,&ctx);
+		}
+		for(k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+			if(!hawkc_scan_use_kernel(kernels[k])) {
+				continue;
+			}
+			actual_e = parse_recorded(h,len,&actual);
+			EXPECT_INT_EQUAL(expected_e,actual_e);
+			EXPECT_STR_EQUAL(expected.calls,actual.calls);
+		}
+	}
+	hawkc_scan_use_kernel(HAWKC_SCAN_KERNEL_PORTABLE);
+	return 0;
+}
+
 int main(int argc, char **argv) {
 
 	hawkc_context_init(&ctx);
 
 	RUNTEST(argv[0],test_scheme_only);
 	RUNTEST(argv[0],test_quoted_string);
+	RUNTEST(argv[0],test_scan_kernels);
+	RUNTEST(argv[0],test_parse_kernels_match_portable);
 
 	return 0;
 }
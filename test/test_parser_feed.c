@@ -0,0 +1,162 @@
+#include "hawkc.h"
+#include "common.h"
+#include "test.h"
+
+static struct HawkcContext ctx;
+static struct HawkcContext expected_ctx;
+static HawkcError e;
+
+static const char *headers[] = {
+	"Hawk id=\"someId\",mac=\"2D320BF8A5948601F9FA3FBA4800C8F7A1D203A317945330854D65228864468D\",ts=\"1373805459\",nonce=\"abc\"",
+	"Hawk id=\"someId\", ts=\"1373805459\", nonce=\"n\", hash=\"h\", ext=\"a \\\"b\\\" \\\\c\", mac=\"m\", app=\"a\", dlg=\"d\"",
+	"Hawk  dlg = \"d\" ,app=a,ext=\"\",hash=\"h\",nonce=n,ts=1,mac=m,id=i , ",
+	"Hawk id=\"someId\", Id=\"x\", ix=\"x\", tz=\"1\", macs=\"x\", nonce2=\"x\", hashes=\"x\", dl=\"x\", error=\"x\"",
+	"Hawk",
+	"Hawk ",
+	"",
+	"Haw",
+	"Hawks id=\"someId\"",
+	"Basic id=\"someId\"",
+	"Hawk,",
+	"Hawk id",
+	"Hawk id=",
+	"Hawk id=\"abc",
+	"Hawk id=\"abc\\",
+	"Hawk id=\"someId\", ts=\"12a\"",
+	"Hawk id=\"someId\" mac=\"abc\"",
+	"Hawk id=a, id=b"
+};
+
+#define EXPECT_FIELD_EQUAL(a,b) do { \
+	EXPECT_INT_EQUAL((int)(a).len,(int)(b).len); \
+	EXPECT_TRUE((a).len == 0 || !memcmp((a).data,(b).data,(a).len)); \
+} while(0)
+
+/*
+ * Feed the header to the parser in chunks of size chunk, with the first
+ * chunk of size first.
+ */
+static HawkcError feed(HawkcParser parser, const char *h, size_t first, size_t chunk) {
+	size_t len = strlen(h), i = 0, n;
+	HawkcError e;
+
+	hawkc_parser_reset(parser);
+	memset(&(ctx.header_in),0,sizeof(ctx.header_in));
+	n = first;
+	while(i < len) {
+		if(n > len - i) {
+			n = len - i;
+		}
+		if( (e = hawkc_parser_feed(&ctx,parser,(const unsigned char*)h + i,n)) != HAWKC_OK) {
+			return e;
+		}
+		i += n;
+		n = chunk;
+	}
+	return hawkc_parser_finish(&ctx,parser);
+}
+
+static int expect_same_result(HawkcParser parser, const char *h, size_t first, size_t chunk) {
+	HawkcError expected_e;
+	AuthorizationHeader expected = &(expected_ctx.header_in);
+	AuthorizationHeader actual = &(ctx.header_in);
+
+	memset(expected,0,sizeof(*expected));
+	expected_e = hawkc_parse_authorization_header(&expected_ctx,(unsigned char*)h,strlen(h));
+	e = feed(parser,h,first,chunk);
+	EXPECT_INT_EQUAL(expected_e,e);
+	if(e == HAWKC_OK) {
+		EXPECT_FIELD_EQUAL(expected->id,actual->id);
+		EXPECT_FIELD_EQUAL(expected->mac,actual->mac);
+		EXPECT_FIELD_EQUAL(expected->hash,actual->hash);
+		EXPECT_FIELD_EQUAL(expected->nonce,actual->nonce);
+		EXPECT_FIELD_EQUAL(expected->ext,actual->ext);
+		EXPECT_FIELD_EQUAL(expected->app,actual->app);
+		EXPECT_FIELD_EQUAL(expected->dlg,actual->dlg);
+		EXPECT_INT_EQUAL((int)expected->ts,(int)actual->ts);
+	}
+	return 0;
+}
+
+/*
+ * The incremental parser gives the same result as the Hawk parser wherever
+ * the header is split.
+ */
+int test_feed_matches_parser() {
+	HawkcParser parser;
+	size_t i, split;
+
+	e = hawkc_parser_create(&ctx,256,&parser);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	for(i = 0; i < sizeof(headers) / sizeof(headers[0]); i++) {
+		EXPECT_INT_EQUAL(0,expect_same_result(parser,headers[i],1,1));
+		for(split = 0; split <= strlen(headers[i]); split++) {
+			EXPECT_INT_EQUAL(0,expect_same_result(parser,headers[i],split,strlen(headers[i])));
+		}
+	}
+	hawkc_parser_free(&ctx,parser);
+	return 0;
+}
+
+int test_feed_rejects_early() {
+	HawkcParser parser;
+	HawkcIdFilter filter;
+	const char *h = "Hawk id=\"otherId\", ts=";
+
+	e = hawkc_parser_create(&ctx,256,&parser);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	e = hawkc_parser_feed(&ctx,parser,(const unsigned char*)"B",1);
+	EXPECT_RETVAL(HAWKC_BAD_SCHEME_ERROR,e,&ctx);
+	e = hawkc_parser_feed(&ctx,parser,(const unsigned char*)"Hawk",4);
+	EXPECT_RETVAL(HAWKC_BAD_SCHEME_ERROR,e,&ctx);
+
+	hawkc_parser_reset(parser);
+	e = hawkc_parser_feed(&ctx,parser,(const unsigned char*)"Haw",3);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_parser_feed(&ctx,parser,(const unsigned char*)"kins",4);
+	EXPECT_RETVAL(HAWKC_BAD_SCHEME_ERROR,e,&ctx);
+
+	/* Unknown ids are rejected before the rest of the header arrives */
+	e = hawkc_id_filter_create(&ctx,&filter);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_id_filter_rebuild(&ctx,filter,NULL,NULL,0,0);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_context_set_id_filter(&ctx,filter);
+	hawkc_parser_reset(parser);
+	e = hawkc_parser_feed(&ctx,parser,(const unsigned char*)h,strlen(h));
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+	hawkc_context_set_id_filter(&ctx,NULL);
+
+	hawkc_id_filter_free(&ctx,filter);
+	hawkc_parser_free(&ctx,parser);
+	return 0;
+}
+
+int test_feed_buffer_too_small() {
+	HawkcParser parser;
+	const char *h = "Hawk id=\"someId\", ts=\"1373805459\", unknown=\"values that are not copied\", nonce=\"abc\"";
+
+	e = hawkc_parser_create(&ctx,16,&parser);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	/* ts is not kept in the buffer once it has been parsed, unknown values are not copied */
+	e = feed(parser,h,strlen(h),0);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_BYTE_EQUAL(ctx.header_in.nonce.data,"abc",3);
+	e = feed(parser,"Hawk id=\"someId\", nonce=\"abcdefghijk\"",7,7);
+	EXPECT_RETVAL(HAWKC_REQUIRED_BUFFER_TOO_LARGE,e,&ctx);
+	hawkc_parser_free(&ctx,parser);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	hawkc_context_init(&ctx);
+	hawkc_context_init(&expected_ctx);
+
+	RUNTEST(argv[0],test_feed_matches_parser);
+	RUNTEST(argv[0],test_feed_rejects_early);
+	RUNTEST(argv[0],test_feed_buffer_too_small);
+
+	return 0;
+}
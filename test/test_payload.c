@@ -0,0 +1,169 @@
+#include "hawkc.h"
+#include "common.h"
+#include "test.h"
+
+static struct HawkcContext ctx;
+static HawkcError e;
+
+static const char *PWD = "werxhqb98rpaxn39848xrunpaw3489ruxnpa98w4rxn";
+static const char *PAYLOAD = "Thank you for flying Hawk";
+
+/*
+ * Payload hash example from the Hawk README.
+ */
+int test_payload_hash() {
+	HawkcPayloadHash hash;
+	unsigned char buf[MAX_HMAC_BYTES_B64];
+	size_t len;
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+
+	e = hawkc_payload_hash_init(&ctx,&hash,(unsigned char*)"text/plain",10);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_payload_hash_update(&hash,(unsigned char*)PAYLOAD,strlen(PAYLOAD));
+	e = hawkc_payload_hash_final(&ctx,&hash,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	EXPECT_INT_EQUAL(44,(int)len);
+	EXPECT_BYTE_EQUAL("Yi9LfIIFRtBEPt74PVmbTF/xVAwPn7ub15ePICfgnuY=",buf,44);
+
+	return 0;
+}
+
+/*
+ * Feeding the payload in chunks of any size and spelling the content type
+ * differently must not change the hash.
+ */
+int test_payload_hash_chunked() {
+	const char *content_types[] = { "text/plain", " Text/Plain ; charset=utf-8", "TEXT/PLAIN;", "\ttext/plain" };
+	HawkcPayloadHash hash;
+	unsigned char buf[MAX_HMAC_BYTES_B64];
+	size_t len;
+	size_t chunk, i, n;
+	int c;
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+
+	for(c = 0; c < 4; c++) {
+		for(chunk = 1; chunk <= strlen(PAYLOAD); chunk++) {
+			e = hawkc_payload_hash_init(&ctx,&hash,(unsigned char*)content_types[c],strlen(content_types[c]));
+			EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+			for(i = 0; i < strlen(PAYLOAD); i += n) {
+				n = strlen(PAYLOAD) - i < chunk ? strlen(PAYLOAD) - i : chunk;
+				hawkc_payload_hash_update(&hash,(unsigned char*)PAYLOAD + i,n);
+			}
+			hawkc_payload_hash_final(&ctx,&hash,buf,&len);
+			EXPECT_INT_EQUAL(44,(int)len);
+			EXPECT_BYTE_EQUAL("Yi9LfIIFRtBEPt74PVmbTF/xVAwPn7ub15ePICfgnuY=",buf,44);
+		}
+	}
+
+	/* No content type and no payload */
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_1);
+	e = hawkc_payload_hash_init(&ctx,&hash,(unsigned char*)"",0);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_payload_hash_final(&ctx,&hash,buf,&len);
+	EXPECT_INT_EQUAL(28,(int)len);
+	EXPECT_BYTE_EQUAL("404ghL7K+hfyhByKKejFBRGgTjU=",buf,28);
+
+	return 0;
+}
+
+/*
+ * Sign a request with a payload hash and check the header against the
+ * Hawk README example, then validate mac and payload on the server side.
+ */
+int test_payload_signing() {
+	char *METHOD = "POST";
+	char *PATH = "/resource/1?b=1&a=2";
+	char *HOST = "example.com";
+	char *PORT = "8000";
+	char *ID = "dh37fgj492je";
+	char *EXT = "some-app-ext-data";
+	char *expected = "Hawk id=\"dh37fgj492je\",nonce=\"j4h3g2\",mac=\"aSe1DERmZuRl3pI36/9BdZmnErTw3sNzOOAUlfeKjVw=\",ts=\"1353832234\",hash=\"Yi9LfIIFRtBEPt74PVmbTF/xVAwPn7ub15ePICfgnuY=\",ext=\"some-app-ext-data\"";
+	struct HawkcContext client;
+	HawkcPayloadHash hash;
+	unsigned char hash_buf[MAX_HMAC_BYTES_B64];
+	unsigned char header[512];
+	size_t hash_len, required_len, len;
+	int is_valid;
+
+	hawkc_context_init(&client);
+	hawkc_context_set_password(&client,(unsigned char*)PWD,strlen(PWD));
+	hawkc_context_set_algorithm(&client,HAWKC_SHA_256);
+	hawkc_context_set_method(&client,(unsigned char*)METHOD,strlen(METHOD));
+	hawkc_context_set_path(&client,(unsigned char*)PATH,strlen(PATH));
+	hawkc_context_set_host(&client,(unsigned char*)HOST,strlen(HOST));
+	hawkc_context_set_port(&client,(unsigned char*)PORT,strlen(PORT));
+	hawkc_context_set_id(&client,(unsigned char*)ID,strlen(ID));
+	hawkc_context_set_ext(&client,(unsigned char*)EXT,strlen(EXT));
+	client.header_out.ts = 1353832234;
+	client.header_out.nonce.data = (unsigned char*)"j4h3g2";
+	client.header_out.nonce.len = 6;
+
+	e = hawkc_payload_hash_init(&client,&hash,(unsigned char*)"text/plain",10);
+	EXPECT_RETVAL(HAWKC_OK,e,&client);
+	hawkc_payload_hash_update(&hash,(unsigned char*)PAYLOAD,strlen(PAYLOAD));
+	e = hawkc_payload_hash_final(&client,&hash,hash_buf,&hash_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&client);
+	hawkc_context_set_hash(&client,hash_buf,hash_len);
+
+	e = hawkc_calculate_authorization_header_length(&client,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&client);
+	EXPECT_INT_EQUAL((int)strlen(expected),(int)required_len);
+	e = hawkc_create_authorization_header(&client,header,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&client);
+	EXPECT_INT_EQUAL((int)required_len,(int)len);
+	EXPECT_BYTE_EQUAL(expected,header,(int)len);
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_password(&ctx,(unsigned char*)PWD,strlen(PWD));
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	hawkc_context_set_method(&ctx,(unsigned char*)METHOD,strlen(METHOD));
+	hawkc_context_set_path(&ctx,(unsigned char*)PATH,strlen(PATH));
+	hawkc_context_set_host(&ctx,(unsigned char*)HOST,strlen(HOST));
+	hawkc_context_set_port(&ctx,(unsigned char*)PORT,strlen(PORT));
+
+	e = hawkc_parse_authorization_header(&ctx,header,len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+
+	e = hawkc_payload_hash_init(&ctx,&hash,(unsigned char*)"text/plain",10);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_payload_hash_update(&hash,(unsigned char*)PAYLOAD,strlen(PAYLOAD));
+	e = hawkc_validate_payload_hash(&ctx,&hash,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+
+	/* Tampered payload */
+	e = hawkc_payload_hash_init(&ctx,&hash,(unsigned char*)"text/plain",10);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_payload_hash_update(&hash,(unsigned char*)PAYLOAD,strlen(PAYLOAD) - 1);
+	e = hawkc_validate_payload_hash(&ctx,&hash,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!is_valid);
+
+	/* A header without hash never validates a payload */
+	ctx.header_in.hash.len = 0;
+	e = hawkc_payload_hash_init(&ctx,&hash,(unsigned char*)"text/plain",10);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_payload_hash_update(&hash,(unsigned char*)PAYLOAD,strlen(PAYLOAD));
+	e = hawkc_validate_payload_hash(&ctx,&hash,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!is_valid);
+
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	RUNTEST(argv[0],test_payload_hash);
+	RUNTEST(argv[0],test_payload_hash_chunked);
+	RUNTEST(argv[0],test_payload_signing);
+
+	return 0;
+}
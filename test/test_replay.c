@@ -0,0 +1,251 @@
+/*
+ * POSIX threads and processes, which -std=c99 hides otherwise.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "hawkc.h"
+#include "common.h"
+#include "test.h"
+
+static struct HawkcContext ctx;
+static HawkcError e;
+
+#define NOW 1353832234
+
+static int add(HawkcReplayCache cache, const char *id, const char *nonce, time_t ts, time_t now) {
+	return hawkc_replay_cache_add(cache,(unsigned char*)id,strlen(id),(unsigned char*)nonce,strlen(nonce),ts,now);
+}
+
+int test_replay_detected() {
+	HawkcReplayCache cache;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_replay_cache_create(&ctx,100,60,&cache);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_FRESH,add(cache,"dh37fgj492je","0123456789ab",NOW,NOW));
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_SEEN,add(cache,"dh37fgj492je","0123456789ab",NOW,NOW));
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_SEEN,add(cache,"dh37fgj492je","0123456789ab",NOW,NOW + 30));
+
+	/* Any part of the triple differs */
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_FRESH,add(cache,"dh37fgj492je","0123456789ac",NOW,NOW));
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_FRESH,add(cache,"dh37fgj492jf","0123456789ab",NOW,NOW));
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_FRESH,add(cache,"dh37fgj492je","0123456789ab",NOW + 1,NOW));
+
+	/* Nonces that are not 12 hex digits */
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_FRESH,add(cache,"dh37fgj492je","j4h3g2",NOW,NOW));
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_SEEN,add(cache,"dh37fgj492je","j4h3g2",NOW,NOW));
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_FRESH,add(cache,"dh37fgj492je","0123456789xy",NOW,NOW));
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_SEEN,add(cache,"dh37fgj492je","0123456789xy",NOW,NOW));
+
+	/* Outside of the window */
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_OUTSIDE_WINDOW,add(cache,"dh37fgj492je","0123456789ab",NOW,NOW + 61));
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_OUTSIDE_WINDOW,add(cache,"dh37fgj492je","0123456789ab",NOW + 61,NOW));
+
+	hawkc_replay_cache_free(&ctx,cache);
+	return 0;
+}
+
+/*
+ * Fill the bucket of one second, then check that its slots are available
+ * again once the ring of buckets has wrapped around.
+ */
+int test_replay_expiry() {
+	HawkcReplayCache cache;
+	char nonce[16];
+	time_t ts;
+	int i, r, fresh;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_replay_cache_create(&ctx,1,2,&cache);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	for(ts = NOW; ts < NOW + 64; ts++) {
+		fresh = 0;
+		for(i = 0; i < 10000; i++) {
+			sprintf(nonce,"%012x",i);
+			if( (r = add(cache,"id",nonce,ts,ts)) == HAWKC_REPLAY_FULL) {
+				break;
+			}
+			EXPECT_INT_EQUAL(HAWKC_REPLAY_FRESH,r);
+			fresh++;
+		}
+		/* The cache is sized for at least one request per second */
+		EXPECT_TRUE(fresh >= 1);
+		EXPECT_TRUE(i < 10000);
+	}
+
+	hawkc_replay_cache_free(&ctx,cache);
+	return 0;
+}
+
+int test_replay_cache_check() {
+	HawkcReplayCache cache;
+	int is_fresh;
+	char *h1 = "Hawk id=\"dh37fgj492je\", ts=\"1353832234\", nonce=\"j4h3g2\", mac=\"m8r1rHbXN6NgO+KIIhjO7sFRyd78RNGVUwehe8Cp2dU=\", ext=\"some-app-data\"";
+
+	hawkc_context_init(&ctx);
+	e = hawkc_replay_cache_create(&ctx,100,60,&cache);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h1,strlen(h1));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	e = hawkc_replay_cache_check(&ctx,cache,NOW,&is_fresh);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_fresh);
+	e = hawkc_replay_cache_check(&ctx,cache,NOW,&is_fresh);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!is_fresh);
+
+	hawkc_replay_cache_free(&ctx,cache);
+	return 0;
+}
+
+#define KEYS 20000
+
+/*
+ * Counts the keys that were fresh for this thread.
+ */
+static int insert_all(TestThreads *threads, int t) {
+	char nonce[16];
+	int i, fresh = 0;
+
+	for(i = 0; i < KEYS; i++) {
+		sprintf(nonce,"%012x",i);
+		if(add((HawkcReplayCache)threads->data,"id",nonce,NOW + i % 4,NOW) == HAWKC_REPLAY_FRESH) {
+			fresh++;
+		}
+	}
+	return fresh;
+}
+
+/*
+ * All threads insert the same keys. Every key must be fresh for exactly
+ * one of them.
+ */
+int test_replay_concurrent() {
+	HawkcReplayCache cache;
+	TestThreads threads;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_replay_cache_create(&ctx,KEYS / 4,60,&cache);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	EXPECT_INT_EQUAL(0,start_test_threads(&threads,insert_all,cache));
+	EXPECT_INT_EQUAL(KEYS,join_test_threads(&threads));
+
+	hawkc_replay_cache_free(&ctx,cache);
+	return 0;
+}
+
+static char shm_name[64];
+
+/*
+ * A second open of the same name attaches to the existing cache.
+ */
+int test_replay_shared_attach() {
+	HawkcReplayCache a, b;
+
+	hawkc_context_init(&ctx);
+	snprintf(shm_name,sizeof(shm_name),"/hawkc-test-replay-%d",(int)getpid());
+	hawkc_replay_cache_unlink(&ctx,shm_name);
+
+	e = hawkc_replay_cache_open_shared(&ctx,shm_name,100,60,&a);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_replay_cache_open_shared(&ctx,shm_name,100,60,&b);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_FRESH,add(a,"dh37fgj492je","0123456789ab",NOW,NOW));
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_SEEN,add(b,"dh37fgj492je","0123456789ab",NOW,NOW));
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_FRESH,add(b,"dh37fgj492je","j4h3g2",NOW,NOW));
+	EXPECT_INT_EQUAL(HAWKC_REPLAY_SEEN,add(a,"dh37fgj492je","j4h3g2",NOW,NOW));
+
+	/* The skew must match */
+	e = hawkc_replay_cache_open_shared(&ctx,shm_name,100,30,&b);
+	EXPECT_RETVAL(HAWKC_ERROR,e,&ctx);
+
+	hawkc_replay_cache_free(&ctx,a);
+	hawkc_replay_cache_free(&ctx,b);
+	e = hawkc_replay_cache_unlink(&ctx,shm_name);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	return 0;
+}
+
+#define PROCESSES 8
+
+/*
+ * PROCESSES forked processes open the cache by name at the same time and
+ * insert the same keys. Every key must be fresh in exactly one of them.
+ */
+int test_replay_shared_processes() {
+	pid_t pids[PROCESSES];
+	int fds[2];
+	int i, status, count, total = 0;
+
+	hawkc_context_init(&ctx);
+	snprintf(shm_name,sizeof(shm_name),"/hawkc-test-replay-%d",(int)getpid());
+	hawkc_replay_cache_unlink(&ctx,shm_name);
+
+	EXPECT_TRUE(pipe(fds) == 0);
+	for(i = 0; i < PROCESSES; i++) {
+		pids[i] = fork();
+		EXPECT_TRUE(pids[i] >= 0);
+		if(pids[i] == 0) {
+			struct HawkcContext child_ctx;
+			HawkcReplayCache cache;
+			char nonce[16];
+			int k;
+
+			close(fds[0]);
+			hawkc_context_init(&child_ctx);
+			if(hawkc_replay_cache_open_shared(&child_ctx,shm_name,KEYS / 4,60,&cache) != HAWKC_OK) {
+				printf("%s\n",hawkc_get_error(&child_ctx));
+				_exit(1);
+			}
+			count = 0;
+			for(k = 0; k < KEYS; k++) {
+				/* Start at different keys to make the processes collide */
+				int key = (k + i * (KEYS / PROCESSES)) % KEYS;
+				sprintf(nonce,"%012x",key);
+				if(add(cache,"id",nonce,NOW + key % 4,NOW) == HAWKC_REPLAY_FRESH) {
+					count++;
+				}
+			}
+			hawkc_replay_cache_free(&child_ctx,cache);
+			_exit(write(fds[1],&count,sizeof(count)) == sizeof(count) ? 0 : 1);
+		}
+	}
+	close(fds[1]);
+	for(i = 0; i < PROCESSES; i++) {
+		EXPECT_INT_EQUAL((int)sizeof(count),(int)read(fds[0],&count,sizeof(count)));
+		total += count;
+	}
+	close(fds[0]);
+	for(i = 0; i < PROCESSES; i++) {
+		EXPECT_TRUE(waitpid(pids[i],&status,0) == pids[i]);
+		EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+	EXPECT_INT_EQUAL(KEYS,total);
+
+	e = hawkc_replay_cache_unlink(&ctx,shm_name);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	RUNTEST(argv[0],test_replay_detected);
+	RUNTEST(argv[0],test_replay_expiry);
+	RUNTEST(argv[0],test_replay_cache_check);
+	RUNTEST(argv[0],test_replay_concurrent);
+	RUNTEST(argv[0],test_replay_shared_attach);
+	RUNTEST(argv[0],test_replay_shared_processes);
+
+	return 0;
+}
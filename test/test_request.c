@@ -0,0 +1,196 @@
+#include "hawkc.h"
+#include "common.h"
+#include "scan.h"
+#include "test.h"
+
+static struct HawkcContext ctx;
+static HawkcError e;
+
+#define EXPECT_STRING(s,str) do { \
+	EXPECT_INT_EQUAL((int)strlen(str),(int)(s).len); \
+	EXPECT_BYTE_EQUAL((s).data,str,(int)(s).len); \
+} while(0)
+
+static HawkcError parse(const char *request, int tls, size_t *head_len) {
+	return hawkc_parse_request_head(&ctx,(unsigned char*)request,strlen(request),tls,head_len);
+}
+
+int test_request() {
+	const char *request =
+		"GET /some/path/to/foo HTTP/1.1\r\n"
+		"User-Agent: test\r\n"
+		"Host: example.com\r\n"
+		"authorization: Hawk id=\"someId\",mac=\"t81/bBJPDw53kKCs5u5YeSmL7cs=\",ts=\"1373805459\",nonce=\"abc\", ext=\"foo\"  \r\n"
+		"\r\n"
+		"body";
+	size_t head_len;
+	int is_valid;
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_password(&ctx,(unsigned char*)"test",4);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_1);
+
+	e = parse(request,0,&head_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL((int)strlen(request) - 4,(int)head_len);
+	EXPECT_STRING(ctx.method,"GET");
+	EXPECT_STRING(ctx.path,"/some/path/to/foo");
+	EXPECT_STRING(ctx.host,"example.com");
+	EXPECT_STRING(ctx.port,"80");
+	EXPECT_STRING(ctx.header_in.ext,"foo");
+	/* Parts point into the request */
+	EXPECT_TRUE(ctx.path.data == (unsigned char*)request + 4);
+
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+	return 0;
+}
+
+int test_request_host() {
+	size_t head_len;
+
+	hawkc_context_init(&ctx);
+	e = parse("GET / HTTP/1.1\r\nHost: example.com\r\n\r\n",1,&head_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_STRING(ctx.port,"443");
+	EXPECT_INT_EQUAL(0,(int)ctx.header_in.id.len);
+
+	e = parse("GET / HTTP/1.0\nHost:example.com:8080\t\n\n",1,&head_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_STRING(ctx.host,"example.com");
+	EXPECT_STRING(ctx.port,"8080");
+
+	e = parse("GET / HTTP/1.1\r\nHost: [::1]:8000\r\n\r\n",0,&head_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_STRING(ctx.host,"[::1]");
+	EXPECT_STRING(ctx.port,"8000");
+
+	e = parse("GET / HTTP/1.1\r\nHost: [::1]:\r\n\r\n",0,&head_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_STRING(ctx.host,"[::1]");
+	EXPECT_STRING(ctx.port,"80");
+	return 0;
+}
+
+/*
+ * Host and port of an absolute-form target override the Host header.
+ */
+int test_request_absolute_form() {
+	const char *request =
+		"GET http://example.com/some/path/to/foo HTTP/1.1\r\n"
+		"Host: other.example.com:8080\r\n"
+		"Authorization: Hawk id=\"someId\",mac=\"t81/bBJPDw53kKCs5u5YeSmL7cs=\",ts=\"1373805459\",nonce=\"abc\", ext=\"foo\"\r\n"
+		"\r\n";
+	size_t head_len;
+	int is_valid;
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_password(&ctx,(unsigned char*)"test",4);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_1);
+
+	e = parse(request,1,&head_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_STRING(ctx.path,"/some/path/to/foo");
+	EXPECT_STRING(ctx.host,"example.com");
+	EXPECT_STRING(ctx.port,"80");
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+
+	e = parse("GET HTTPS://[::1]:8000/p?a=1 HTTP/1.1\r\n\r\n",0,&head_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_STRING(ctx.path,"/p?a=1");
+	EXPECT_STRING(ctx.host,"[::1]");
+	EXPECT_STRING(ctx.port,"8000");
+
+	e = parse("GET https://example.com HTTP/1.1\r\n\r\n",0,&head_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_STRING(ctx.path,"/");
+	EXPECT_STRING(ctx.port,"443");
+
+	e = parse("OPTIONS * HTTP/1.1\r\nHost: a\r\n\r\n",0,&head_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_STRING(ctx.path,"*");
+	return 0;
+}
+
+int test_request_malformed() {
+	const char *requests[] = {
+		"GET / HTTP/1.1\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost: a\r\nHost: b\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost: a\r\nAuthorization: Hawk\r\nAuthorization: Hawk\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost: a\r\nAuthorization: Basic abc\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost: a:80x\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost: [::1\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost: \r\n\r\n",
+		"GET / HTTP/1.1\r\nHost: a\r\n folded\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost : a\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost: a\rb\r\n\r\n",
+		"GET / HTTP/1.1\r\nHost: a\x01\r\n\r\n",
+		"GET / HTTP/2.0\r\nHost: a\r\n\r\n",
+		"GET  / HTTP/1.1\r\nHost: a\r\n\r\n",
+		"GET /\r\nHost: a\r\n\r\n",
+		" GET / HTTP/1.1\r\nHost: a\r\n\r\n",
+		"GET example.com/ HTTP/1.1\r\nHost: a\r\n\r\n",
+		"CONNECT example.com:443 HTTP/1.1\r\nHost: a\r\n\r\n",
+		"GET ftp://example.com/ HTTP/1.1\r\nHost: a\r\n\r\n",
+		"GET http://user@example.com/ HTTP/1.1\r\nHost: a\r\n\r\n",
+		"GET http://example.com?a=1 HTTP/1.1\r\nHost: a\r\n\r\n",
+		"GET http:///p HTTP/1.1\r\nHost: a\r\n\r\n"
+	};
+	size_t i, head_len;
+
+	hawkc_context_init(&ctx);
+	for(i = 0; i < sizeof(requests) / sizeof(requests[0]); i++) {
+		e = parse(requests[i],0,&head_len);
+		EXPECT_TRUE(e == HAWKC_PARSE_ERROR || e == HAWKC_BAD_SCHEME_ERROR);
+	}
+	return 0;
+}
+
+/*
+ * Every prefix of a request head is incomplete, and the result does not
+ * depend on the scanner kernel.
+ */
+int test_request_incomplete() {
+	HawkcScanKernel kernels[] = { HAWKC_SCAN_KERNEL_PORTABLE, HAWKC_SCAN_KERNEL_SSSE3, HAWKC_SCAN_KERNEL_AVX2 };
+	const char *request =
+		"POST /resource/1?b=1&a=2 HTTP/1.1\r\n"
+		"Host: example.com:8000\r\n"
+		"Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+		"Authorization: Hawk id=\"dh37fgj492je\", ts=\"1353832234\", nonce=\"j4h3g2\", ext=\"some-app-ext-data\", mac=\"6R4rV5iE+NPoym+WwjeHzjAGXUtLNIxmo1vpMofpLAE=\"\r\n"
+		"\r\n";
+	size_t k, len, head_len;
+
+	hawkc_context_init(&ctx);
+	for(k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+		if(!hawkc_scan_use_kernel(kernels[k])) {
+			continue;
+		}
+		for(len = 0; len < strlen(request); len++) {
+			e = hawkc_parse_request_head(&ctx,(unsigned char*)request,len,0,&head_len);
+			EXPECT_RETVAL(HAWKC_INCOMPLETE_ERROR,e,&ctx);
+		}
+		e = parse(request,0,&head_len);
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+		EXPECT_INT_EQUAL((int)strlen(request),(int)head_len);
+		EXPECT_STRING(ctx.method,"POST");
+		EXPECT_STRING(ctx.path,"/resource/1?b=1&a=2");
+		EXPECT_STRING(ctx.port,"8000");
+		EXPECT_STRING(ctx.header_in.id,"dh37fgj492je");
+	}
+	hawkc_scan_use_kernel(HAWKC_SCAN_KERNEL_PORTABLE);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	RUNTEST(argv[0],test_request);
+	RUNTEST(argv[0],test_request_host);
+	RUNTEST(argv[0],test_request_absolute_form);
+	RUNTEST(argv[0],test_request_malformed);
+	RUNTEST(argv[0],test_request_incomplete);
+
+	return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * POSIX threads, which -std=c99 hides otherwise.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include "hawkc.h"
+#include "common.h"
+#include "crypto.h"
+#include "test.h"
+
+static struct HawkcContext ctx;
+static HawkcError e;
+
+/*
+ * Stands in for unsealing a token: the password is the id reversed, ids
+ * starting with "x" are unknown, and ids starting with "old" are expired.
+ */
+static int calls;
+static time_t expiry;
+
+static HawkcError resolve(HawkcContext c, const unsigned char *id, size_t id_len, HawkcKey key, time_t *expires, void *data) {
+	unsigned char password[64];
+	size_t i;
+
+	__atomic_add_fetch(&calls,1,__ATOMIC_RELAXED);
+	if(id_len == 0 || id_len > sizeof(password) || id[0] == 'x') {
+		return hawkc_set_error(c, HAWKC_UNKNOWN_ID_ERROR, "Unknown id");
+	}
+	for(i = 0; i < id_len; i++) {
+		password[i] = id[id_len - 1 - i];
+	}
+	*expires = (id_len >= 3 && memcmp(id,"old",3) == 0) ? time(NULL) - 10 : expiry;
+	return hawkc_key_init(c,key,(HawkcAlgorithm)data,password,id_len);
+}
+
+static int check_key(HawkcResolverCache cache, const char *id) {
+	struct HawkcKey key, expected;
+	unsigned char password[64];
+	unsigned char a[2 * MAX_DIGEST_CHAIN_BYTES], b[2 * MAX_DIGEST_CHAIN_BYTES];
+	size_t i, len = strlen(id);
+
+	e = hawkc_resolver_cache_lookup(&ctx,cache,(unsigned char*)id,len,&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	for(i = 0; i < len; i++) {
+		password[i] = id[len - 1 - i];
+	}
+	e = hawkc_key_init(&ctx,&expected,HAWKC_SHA_256,password,len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(key.algorithm == HAWKC_SHA_256);
+	hawkc_key_export(&key,a);
+	hawkc_key_export(&expected,b);
+	EXPECT_BYTE_EQUAL(a,b,(int)(2 * HAWKC_SHA_256->chain_size));
+	return 0;
+}
+
+/*
+ * The resolver is called once per id until the key expires, errors and
+ * expired keys are not cached.
+ */
+int test_resolver_cache_lookup() {
+	HawkcResolverCache cache;
+	struct HawkcKey key;
+	char id[32];
+	int i;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_resolver_cache_create(&ctx,resolve,(void*)HAWKC_SHA_256,64,&cache);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	calls = 0;
+	expiry = 0;
+	EXPECT_INT_EQUAL(0,check_key(cache,"someId"));
+	EXPECT_INT_EQUAL(0,check_key(cache,"someId"));
+	EXPECT_INT_EQUAL(1,calls);
+
+	expiry = time(NULL) + 3600;
+	EXPECT_INT_EQUAL(0,check_key(cache,"otherId"));
+	EXPECT_INT_EQUAL(0,check_key(cache,"otherId"));
+	EXPECT_INT_EQUAL(2,calls);
+
+	EXPECT_INT_EQUAL(0,check_key(cache,"oldId"));
+	EXPECT_INT_EQUAL(0,check_key(cache,"oldId"));
+	EXPECT_INT_EQUAL(4,calls);
+
+	e = hawkc_resolver_cache_lookup(&ctx,cache,(unsigned char*)"xId",3,&key);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+	e = hawkc_resolver_cache_lookup(&ctx,cache,(unsigned char*)"xId",3,&key);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+	EXPECT_INT_EQUAL(6,calls);
+
+	/* Keys stay correct when more ids are used than fit */
+	for(i = 0; i < 1000; i++) {
+		sprintf(id,"id%d",(i * 7) % 300);
+		EXPECT_INT_EQUAL(0,check_key(cache,id));
+	}
+
+	hawkc_resolver_cache_free(&ctx,cache);
+	return 0;
+}
+
+/*
+ * Validation resolves the key of the parsed id through the cache.
+ */
+int test_validate_with_resolver_cache() {
+	HawkcResolverCache cache;
+	unsigned char header[1024];
+	size_t required_len, len;
+	int is_valid;
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	hawkc_context_set_password(&ctx,(unsigned char *)"dIemos",6);
+	hawkc_context_set_id(&ctx,(unsigned char *)"someId",6);
+	hawkc_context_set_method(&ctx,(unsigned char *)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char *)"/some/path/to/foo",17);
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char *)"80",2);
+	e = hawkc_calculate_authorization_header_length(&ctx,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(required_len <= sizeof(header));
+	e = hawkc_create_authorization_header(&ctx,header,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	hawkc_context_init(&ctx);
+	e = hawkc_resolver_cache_create(&ctx,resolve,(void*)HAWKC_SHA_256,64,&cache);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_context_set_resolver_cache(&ctx,cache);
+	hawkc_context_set_method(&ctx,(unsigned char *)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char *)"/some/path/to/foo",17);
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char *)"80",2);
+
+	calls = 0;
+	expiry = 0;
+	e = hawkc_parse_authorization_header(&ctx,header,len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+	EXPECT_INT_EQUAL(1,calls);
+
+	/* Unknown ids fail validation */
+	header[9] = 'x';
+	e = hawkc_parse_authorization_header(&ctx,header,len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_UNKNOWN_ID_ERROR,e,&ctx);
+
+	hawkc_resolver_cache_free(&ctx,cache);
+	return 0;
+}
+
+#define LOOKUPS 20000
+
+/*
+ * Ids of the threads overlap and far exceed the capacity, so lookups
+ * evict entries others are about to hit, and every fifth id has expired
+ * and must not be cached. Counts the keys that are not those of their id.
+ */
+static int lookup_all(TestThreads *threads, int t) {
+	struct HawkcContext c;
+	struct HawkcKey key, expected;
+	unsigned char password[32];
+	unsigned char a[2 * MAX_DIGEST_CHAIN_BYTES], b[2 * MAX_DIGEST_CHAIN_BYTES];
+	char id[32];
+	size_t j, len;
+	int i, failures = 0;
+
+	hawkc_context_init(&c);
+	for(i = 0; i < LOOKUPS; i++) {
+		sprintf(id,i % 5 == 0 ? "old%d" : "id%d",(i * 31 + t) % 500);
+		len = strlen(id);
+		for(j = 0; j < len; j++) {
+			password[j] = id[len - 1 - j];
+		}
+		if(hawkc_resolver_cache_lookup(&c,(HawkcResolverCache)threads->data,(unsigned char*)id,len,&key) != HAWKC_OK
+				|| hawkc_key_init(&c,&expected,HAWKC_SHA_256,password,len) != HAWKC_OK) {
+			failures++;
+			continue;
+		}
+		hawkc_key_export(&key,a);
+		hawkc_key_export(&expected,b);
+		if(memcmp(a,b,2 * HAWKC_SHA_256->chain_size) != 0) {
+			failures++;
+		}
+	}
+	return failures;
+}
+
+int test_resolver_cache_threads() {
+	HawkcResolverCache cache;
+	TestThreads threads;
+
+	hawkc_context_init(&ctx);
+	expiry = 0;
+	calls = 0;
+	e = hawkc_resolver_cache_create(&ctx,resolve,(void*)HAWKC_SHA_256,64,&cache);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(0,start_test_threads(&threads,lookup_all,cache));
+	EXPECT_INT_EQUAL(0,join_test_threads(&threads));
+	/* Expired keys are resolved on every lookup */
+	EXPECT_TRUE(calls >= TEST_THREADS * LOOKUPS / 5);
+	hawkc_resolver_cache_free(&ctx,cache);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	RUNTEST(argv[0],test_resolver_cache_lookup);
+	RUNTEST(argv[0],test_validate_with_resolver_cache);
+	RUNTEST(argv[0],test_resolver_cache_threads);
+
+	return 0;
+}
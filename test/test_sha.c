@@ -0,0 +1,382 @@
+#include "hawkc.h"
+#include "sha.h"
+#include "test.h"
+
+/*
+ * Tests of the SHA implementation of the native crypto backend. Every
+ * kernel supported by the CPU is checked against the FIPS 180 test vectors
+ * and against the portable kernel.
+ */
+
+static const char *kernel_names[] = { "portable", "avx2", "shani" };
+
+static void to_hex(const unsigned char *digest, size_t len, char *hex) {
+	size_t i;
+	for(i = 0; i < len; i++) {
+		sprintf(hex + 2*i,"%02x",digest[i]);
+	}
+}
+
+static void sha1(const unsigned char *data, size_t len, char *hex) {
+	HawkcShaCtx ctx;
+	unsigned char digest[HAWKC_SHA1_DIGEST_BYTES];
+	hawkc_sha1_init(&ctx);
+	hawkc_sha1_update(&ctx,data,len);
+	hawkc_sha1_final(&ctx,digest);
+	to_hex(digest,sizeof(digest),hex);
+}
+
+static void sha256(const unsigned char *data, size_t len, char *hex) {
+	HawkcShaCtx ctx;
+	unsigned char digest[HAWKC_SHA256_DIGEST_BYTES];
+	hawkc_sha256_init(&ctx);
+	hawkc_sha256_update(&ctx,data,len);
+	hawkc_sha256_final(&ctx,digest);
+	to_hex(digest,sizeof(digest),hex);
+}
+
+/*
+ * Test vectors from FIPS 180-2 appendix A and B.
+ */
+static int check_vectors() {
+	char hex[2*HAWKC_SHA256_DIGEST_BYTES + 1];
+	const char *abc = "abc";
+	const char *two_blocks = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+	HawkcShaCtx ctx;
+	unsigned char a[1000];
+	unsigned char digest[HAWKC_SHA256_DIGEST_BYTES];
+	int i;
+
+	sha1((unsigned char*)"",0,hex);
+	EXPECT_STR_EQUAL("da39a3ee5e6b4b0d3255bfef95601890afd80709",hex);
+	sha1((unsigned char*)abc,strlen(abc),hex);
+	EXPECT_STR_EQUAL("a9993e364706816aba3e25717850c26c9cd0d89d",hex);
+	sha1((unsigned char*)two_blocks,strlen(two_blocks),hex);
+	EXPECT_STR_EQUAL("84983e441c3bd26ebaae4aa1f95129e5e54670f1",hex);
+
+	sha256((unsigned char*)"",0,hex);
+	EXPECT_STR_EQUAL("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",hex);
+	sha256((unsigned char*)abc,strlen(abc),hex);
+	EXPECT_STR_EQUAL("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",hex);
+	sha256((unsigned char*)two_blocks,strlen(two_blocks),hex);
+	EXPECT_STR_EQUAL("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",hex);
+
+	/* One million times 'a' */
+	memset(a,'a',sizeof(a));
+	hawkc_sha1_init(&ctx);
+	for(i = 0; i < 1000; i++) {
+		hawkc_sha1_update(&ctx,a,sizeof(a));
+	}
+	hawkc_sha1_final(&ctx,digest);
+	to_hex(digest,HAWKC_SHA1_DIGEST_BYTES,hex);
+	EXPECT_STR_EQUAL("34aa973cd4c4daa4f61eeb2bdbad27316534016f",hex);
+
+	hawkc_sha256_init(&ctx);
+	for(i = 0; i < 1000; i++) {
+		hawkc_sha256_update(&ctx,a,sizeof(a));
+	}
+	hawkc_sha256_final(&ctx,digest);
+	to_hex(digest,HAWKC_SHA256_DIGEST_BYTES,hex);
+	EXPECT_STR_EQUAL("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",hex);
+
+	return 0;
+}
+
+int test_sha_vectors() {
+	HawkcShaKernel k;
+
+	for(k = HAWKC_SHA_KERNEL_PORTABLE; k <= HAWKC_SHA_KERNEL_SHANI; k++) {
+		if(!hawkc_sha_use_kernel(k)) {
+			printf(" (%s not supported)",kernel_names[k]);
+			continue;
+		}
+		if(check_vectors() != 0) {
+			printf("Kernel %s failed\n",kernel_names[k]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Compare all kernels to the portable one for every message length up to
+ * several blocks, hashing the data in one piece and in odd sized chunks.
+ */
+int test_sha_kernels_agree() {
+	unsigned char data[300];
+	char expected1[300][2*HAWKC_SHA1_DIGEST_BYTES + 1];
+	char expected256[300][2*HAWKC_SHA256_DIGEST_BYTES + 1];
+	char hex[2*HAWKC_SHA256_DIGEST_BYTES + 1];
+	unsigned char digest[HAWKC_SHA256_DIGEST_BYTES];
+	HawkcShaKernel k;
+	HawkcShaCtx ctx;
+	size_t len, i;
+	unsigned int seed = 12345;
+
+	for(i = 0; i < sizeof(data); i++) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = (unsigned char)(seed >> 16);
+	}
+
+	hawkc_sha_use_kernel(HAWKC_SHA_KERNEL_PORTABLE);
+	for(len = 0; len < sizeof(data); len++) {
+		sha1(data,len,expected1[len]);
+		sha256(data,len,expected256[len]);
+	}
+
+	for(k = HAWKC_SHA_KERNEL_AVX2; k <= HAWKC_SHA_KERNEL_SHANI; k++) {
+		if(!hawkc_sha_use_kernel(k)) {
+			continue;
+		}
+		for(len = 0; len < sizeof(data); len++) {
+			sha1(data,len,hex);
+			EXPECT_STR_EQUAL(expected1[len],hex);
+			sha256(data,len,hex);
+			EXPECT_STR_EQUAL(expected256[len],hex);
+
+			hawkc_sha1_init(&ctx);
+			for(i = 0; i < len; i += 7) {
+				hawkc_sha1_update(&ctx,data + i,len - i < 7 ? len - i : 7);
+			}
+			hawkc_sha1_final(&ctx,digest);
+			to_hex(digest,HAWKC_SHA1_DIGEST_BYTES,hex);
+			EXPECT_STR_EQUAL(expected1[len],hex);
+
+			hawkc_sha256_init(&ctx);
+			for(i = 0; i < len; i += 7) {
+				hawkc_sha256_update(&ctx,data + i,len - i < 7 ? len - i : 7);
+			}
+			hawkc_sha256_final(&ctx,digest);
+			to_hex(digest,HAWKC_SHA256_DIGEST_BYTES,hex);
+			EXPECT_STR_EQUAL(expected256[len],hex);
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * Compare the multi-buffer kernels the CPU supports to the portable kernel.
+ */
+int test_sha_lane_kernels() {
+	unsigned char data[HAWKC_SHA_MAX_LANES][3 * HAWKC_SHA_BLOCK_BYTES];
+	uint32_t h[HAWKC_SHA_MAX_LANES][8];
+	uint32_t expected[HAWKC_SHA_MAX_LANES][8];
+	uint32_t *hp[HAWKC_SHA_MAX_LANES];
+	const unsigned char *blocks[HAWKC_SHA_MAX_LANES];
+	unsigned int seed = 4711;
+	size_t i, j;
+
+	for(i = 0; i < HAWKC_SHA_MAX_LANES; i++) {
+		for(j = 0; j < sizeof(data[i]); j++) {
+			seed = seed * 1103515245 + 12345;
+			data[i][j] = (unsigned char)(seed >> 16);
+		}
+		hp[i] = h[i];
+		blocks[i] = data[i];
+	}
+
+	for(i = 0; i < HAWKC_SHA_MAX_LANES; i++) {
+		for(j = 0; j < 8; j++) {
+			expected[i][j] = h[i][j] = (uint32_t)(i * 8 + j) * 0x9e3779b9u;
+		}
+		hawkc_sha1_compress_portable(expected[i],data[i],3);
+	}
+	if(hawkc_cpu_has_sse2()) {
+		hawkc_sha1_compress_x4_sse2(hp,blocks,3);
+		EXPECT_BYTE_EQUAL(expected,h,4 * (int)sizeof(h[0]));
+	}
+	if(hawkc_cpu_has_avx2()) {
+		for(i = 0; i < HAWKC_SHA_MAX_LANES; i++) {
+			for(j = 0; j < 8; j++) {
+				h[i][j] = (uint32_t)(i * 8 + j) * 0x9e3779b9u;
+			}
+		}
+		hawkc_sha1_compress_x8_avx2(hp,blocks,3);
+		EXPECT_BYTE_EQUAL(expected,h,8 * (int)sizeof(h[0]));
+	}
+
+	for(i = 0; i < HAWKC_SHA_MAX_LANES; i++) {
+		for(j = 0; j < 8; j++) {
+			expected[i][j] = h[i][j] = (uint32_t)(i * 8 + j) * 0x9e3779b9u;
+		}
+		hawkc_sha256_compress_portable(expected[i],data[i],3);
+	}
+	if(hawkc_cpu_has_sse2()) {
+		hawkc_sha256_compress_x4_sse2(hp,blocks,3);
+		EXPECT_BYTE_EQUAL(expected,h,4 * (int)sizeof(h[0]));
+	}
+	if(hawkc_cpu_has_avx2()) {
+		for(i = 0; i < HAWKC_SHA_MAX_LANES; i++) {
+			for(j = 0; j < 8; j++) {
+				h[i][j] = (uint32_t)(i * 8 + j) * 0x9e3779b9u;
+			}
+		}
+		hawkc_sha256_compress_x8_avx2(hp,blocks,3);
+		EXPECT_BYTE_EQUAL(expected,h,8 * (int)sizeof(h[0]));
+	}
+	return 0;
+}
+
+/*
+ * Compute HMAC style digests of messages of different lengths in parallel
+ * and compare them to the one message at a time functions, with every
+ * kernel selection.
+ */
+int test_sha_hmac_lanes() {
+	unsigned char pad[HAWKC_SHA_BLOCK_BYTES];
+	unsigned char data[HAWKC_SHA_MAX_LANES][300];
+	const unsigned char *data_ptrs[HAWKC_SHA_MAX_LANES];
+	size_t len[HAWKC_SHA_MAX_LANES];
+	unsigned char digest[HAWKC_SHA_MAX_LANES][HAWKC_SHA256_DIGEST_BYTES];
+	unsigned char *digest_ptrs[HAWKC_SHA_MAX_LANES];
+	unsigned char expected[HAWKC_SHA256_DIGEST_BYTES];
+	HawkcShaCtx inner1, outer1, inner256, outer256, ctx;
+	const HawkcShaCtx *inner_ptrs[HAWKC_SHA_MAX_LANES];
+	const HawkcShaCtx *outer_ptrs[HAWKC_SHA_MAX_LANES];
+	HawkcShaKernel k;
+	size_t i, j, nlanes;
+
+	memset(pad,0x36,sizeof(pad));
+	for(i = 0; i < HAWKC_SHA_MAX_LANES; i++) {
+		for(j = 0; j < sizeof(data[i]); j++) {
+			data[i][j] = (unsigned char)(i * 31 + j);
+		}
+		data_ptrs[i] = data[i];
+		digest_ptrs[i] = digest[i];
+	}
+
+	for(k = HAWKC_SHA_KERNEL_PORTABLE; k <= HAWKC_SHA_KERNEL_SHANI; k++) {
+		if(!hawkc_sha_use_kernel(k)) {
+			continue;
+		}
+		hawkc_sha1_init(&inner1);
+		hawkc_sha1_update(&inner1,pad,sizeof(pad));
+		hawkc_sha1_init(&outer1);
+		hawkc_sha1_update(&outer1,pad,sizeof(pad) / 2);
+		hawkc_sha1_update(&outer1,pad,sizeof(pad) / 2);
+		hawkc_sha256_init(&inner256);
+		hawkc_sha256_update(&inner256,pad,sizeof(pad));
+		hawkc_sha256_init(&outer256);
+		hawkc_sha256_update(&outer256,pad,sizeof(pad));
+
+		for(nlanes = 1; nlanes <= HAWKC_SHA_MAX_LANES; nlanes++) {
+			for(i = 0; i < nlanes; i++) {
+				/* Around the one and two tail block boundaries and several full blocks */
+				len[i] = (nlanes * 53 + i * 71) % sizeof(data[i]);
+				inner_ptrs[i] = &inner1;
+				outer_ptrs[i] = &outer1;
+			}
+			hawkc_sha1_hmac_lanes(inner_ptrs,outer_ptrs,data_ptrs,len,nlanes,digest_ptrs);
+			for(i = 0; i < nlanes; i++) {
+				ctx = inner1;
+				hawkc_sha1_update(&ctx,data[i],len[i]);
+				hawkc_sha1_final(&ctx,expected);
+				hawkc_sha1_hmac_outer(&outer1,expected);
+				EXPECT_BYTE_EQUAL(expected,digest[i],HAWKC_SHA1_DIGEST_BYTES);
+			}
+
+			for(i = 0; i < nlanes; i++) {
+				inner_ptrs[i] = &inner256;
+				outer_ptrs[i] = &outer256;
+			}
+			hawkc_sha256_hmac_lanes(inner_ptrs,outer_ptrs,data_ptrs,len,nlanes,digest_ptrs);
+			for(i = 0; i < nlanes; i++) {
+				ctx = inner256;
+				hawkc_sha256_update(&ctx,data[i],len[i]);
+				hawkc_sha256_final(&ctx,expected);
+				hawkc_sha256_hmac_outer(&outer256,expected);
+				EXPECT_BYTE_EQUAL(expected,digest[i],HAWKC_SHA256_DIGEST_BYTES);
+			}
+		}
+	}
+	return 0;
+}
+
+
+static void sha384(const unsigned char *data, size_t len, char *hex) {
+	HawkcSha512Ctx ctx;
+	unsigned char digest[HAWKC_SHA384_DIGEST_BYTES];
+	hawkc_sha384_init(&ctx);
+	hawkc_sha384_update(&ctx,data,len);
+	hawkc_sha384_final(&ctx,digest);
+	to_hex(digest,sizeof(digest),hex);
+}
+
+static void sha512(const unsigned char *data, size_t len, char *hex) {
+	HawkcSha512Ctx ctx;
+	unsigned char digest[HAWKC_SHA512_DIGEST_BYTES];
+	hawkc_sha512_init(&ctx);
+	hawkc_sha512_update(&ctx,data,len);
+	hawkc_sha512_final(&ctx,digest);
+	to_hex(digest,sizeof(digest),hex);
+}
+
+/*
+ * Test vectors from FIPS 180-2 appendix C and D, and hashing the two block
+ * message in one piece and in odd sized chunks.
+ */
+int test_sha512_vectors() {
+	char hex[2*HAWKC_SHA512_DIGEST_BYTES + 1];
+	const char *abc = "abc";
+	const char *two_blocks = "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmno"
+			"ijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu";
+	HawkcSha512Ctx ctx;
+	unsigned char a[1000];
+	unsigned char digest[HAWKC_SHA512_DIGEST_BYTES];
+	size_t i;
+
+	sha384((unsigned char*)"",0,hex);
+	EXPECT_STR_EQUAL("38b060a751ac96384cd9327eb1b1e36a21fdb71114be07434c0cc7bf63f6e1da274edebfe76f65fbd51ad2f14898b95b",hex);
+	sha384((unsigned char*)abc,strlen(abc),hex);
+	EXPECT_STR_EQUAL("cb00753f45a35e8bb5a03d699ac65007272c32ab0eded1631a8b605a43ff5bed8086072ba1e7cc2358baeca134c825a7",hex);
+	sha384((unsigned char*)two_blocks,strlen(two_blocks),hex);
+	EXPECT_STR_EQUAL("09330c33f71147e83d192fc782cd1b4753111b173b3b05d22fa08086e3b0f712fcc7c71a557e2db966c3e9fa91746039",hex);
+
+	sha512((unsigned char*)"",0,hex);
+	EXPECT_STR_EQUAL("cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e",hex);
+	sha512((unsigned char*)abc,strlen(abc),hex);
+	EXPECT_STR_EQUAL("ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f",hex);
+	sha512((unsigned char*)two_blocks,strlen(two_blocks),hex);
+	EXPECT_STR_EQUAL("8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909",hex);
+
+	hawkc_sha512_init(&ctx);
+	for(i = 0; i < strlen(two_blocks); i += 7) {
+		hawkc_sha512_update(&ctx,(unsigned char*)two_blocks + i,strlen(two_blocks) - i < 7 ? strlen(two_blocks) - i : 7);
+	}
+	hawkc_sha512_final(&ctx,digest);
+	to_hex(digest,HAWKC_SHA512_DIGEST_BYTES,hex);
+	EXPECT_STR_EQUAL("8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909",hex);
+
+	/* One million times 'a' */
+	memset(a,'a',sizeof(a));
+	hawkc_sha384_init(&ctx);
+	for(i = 0; i < 1000; i++) {
+		hawkc_sha384_update(&ctx,a,sizeof(a));
+	}
+	hawkc_sha384_final(&ctx,digest);
+	to_hex(digest,HAWKC_SHA384_DIGEST_BYTES,hex);
+	EXPECT_STR_EQUAL("9d0e1809716474cb086e834e310a4a1ced149e9c00f248527972cec5704c2a5b07b8b3dc38ecc4ebae97ddd87f3d8985",hex);
+
+	hawkc_sha512_init(&ctx);
+	for(i = 0; i < 1000; i++) {
+		hawkc_sha512_update(&ctx,a,sizeof(a));
+	}
+	hawkc_sha512_final(&ctx,digest);
+	to_hex(digest,HAWKC_SHA512_DIGEST_BYTES,hex);
+	EXPECT_STR_EQUAL("e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973ebde0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b",hex);
+
+	return 0;
+}
+
+
+int main(int argc, char **argv) {
+
+	RUNTEST(argv[0],test_sha_vectors);
+	RUNTEST(argv[0],test_sha_kernels_agree);
+	RUNTEST(argv[0],test_sha_lane_kernels);
+	RUNTEST(argv[0],test_sha_hmac_lanes);
+	RUNTEST(argv[0],test_sha512_vectors);
+
+	return 0;
+}
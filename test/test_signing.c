@@ -204,6 +204,388 @@ int test_hawk_capatibility2() {
 	return 0;
 }
 
+/*
+ * Same as test_hawk_capatibility2 but validating with a precomputed key.
+ */
+int test_signing_with_key() {
+
+	char *METHOD = "GET";
+	char *PATH = "/resource/1?b=1&a=2";
+	char *HOST = "example.com";
+	char *PORT = "8000";
+	int is_valid;
+	HawkcKey key;
+
+	const char *pwd = "werxhqb98rpaxn39848xrunpaw3489ruxnpa98w4rxn";
+
+	char *h1 = "Hawk id=\"dh37fgj492je\", ts=\"1353832234\", nonce=\"j4h3g2\", mac=\"m8r1rHbXN6NgO+KIIhjO7sFRyd78RNGVUwehe8Cp2dU=\", ext=\"some-app-data\"";
+
+	hawkc_context_init(&ctx);
+	e = hawkc_key_create(&ctx,HAWKC_SHA_256,(unsigned char*)pwd, strlen(pwd),&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_context_set_key(&ctx,key);
+
+	hawkc_context_set_method(&ctx,(unsigned char*)METHOD,strlen(METHOD));
+	hawkc_context_set_path(&ctx,(unsigned char*)PATH,strlen(PATH));
+	hawkc_context_set_host(&ctx,(unsigned char*)HOST,strlen(HOST));
+	hawkc_context_set_port(&ctx,(unsigned char*)PORT,strlen(PORT));
+
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h1,strlen(h1));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+
+	hawkc_key_free(&ctx,key);
+
+	return 0;
+}
+
+/*
+ * Sign and validate a request whose base string is far larger than any
+ * fixed buffer. The base string is streamed into the HMAC, so there is no
+ * size limit.
+ */
+int test_signing_long_path() {
+
+	static char path[8192];
+	static unsigned char header[256];
+	struct HawkcContext client;
+	size_t required_len, len;
+	int is_valid;
+	int i;
+
+	memcpy(path,"/search?q=",10);
+	for(i = 10; i < (int)sizeof(path) - 1; i++) {
+		path[i] = 'a' + (i % 26);
+	}
+	path[sizeof(path) - 1] = '\0';
+
+	hawkc_context_init(&client);
+	hawkc_context_set_password(&client,(unsigned char*)"test", (size_t)4);
+	hawkc_context_set_algorithm(&client,HAWKC_SHA_256);
+	hawkc_context_set_method(&client,(unsigned char*)"GET",3);
+	hawkc_context_set_path(&client,(unsigned char*)path,strlen(path));
+	hawkc_context_set_host(&client,(unsigned char*)"example.com",11);
+	hawkc_context_set_port(&client,(unsigned char*)"443",3);
+	hawkc_context_set_id(&client,(unsigned char*)"someId",6);
+
+	e = hawkc_calculate_authorization_header_length(&client,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&client);
+	EXPECT_TRUE(required_len <= sizeof(header));
+	e = hawkc_create_authorization_header(&client,header,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&client);
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_password(&ctx,(unsigned char*)"test", (size_t)4);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	hawkc_context_set_method(&ctx,(unsigned char*)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char*)path,strlen(path));
+	hawkc_context_set_host(&ctx,(unsigned char*)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char*)"443",3);
+
+	e = hawkc_parse_authorization_header(&ctx,header,len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+
+	/* A different path must not validate */
+	path[20] = '/';
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!is_valid);
+
+	return 0;
+}
+
+/*
+ * The mac is compared in binary form. Malformed mac values are rejected
+ * before hashing and the computed HMAC is only encoded on request.
+ */
+int test_validate_mac_decoding() {
+
+	int is_valid;
+	int i;
+	char *mac = "m8r1rHbXN6NgO+KIIhjO7sFRyd78RNGVUwehe8Cp2dU=";
+	const char *pwd = "werxhqb98rpaxn39848xrunpaw3489ruxnpa98w4rxn";
+	const char *headers[] = {
+		/* valid */
+		"Hawk id=\"dh37fgj492je\", ts=\"1353832234\", nonce=\"j4h3g2\", mac=\"m8r1rHbXN6NgO+KIIhjO7sFRyd78RNGVUwehe8Cp2dU=\", ext=\"some-app-data\"",
+		/* not canonical: non-zero padding bits */
+		"Hawk id=\"dh37fgj492je\", ts=\"1353832234\", nonce=\"j4h3g2\", mac=\"m8r1rHbXN6NgO+KIIhjO7sFRyd78RNGVUwehe8Cp2dV=\", ext=\"some-app-data\"",
+		/* invalid character */
+		"Hawk id=\"dh37fgj492je\", ts=\"1353832234\", nonce=\"j4h3g2\", mac=\"m8r1rHbXN6NgO+KIIhjO7sFRyd78RNGVUwehe8Cp2d_=\", ext=\"some-app-data\"",
+		/* well formed, but a SHA-1 length mac */
+		"Hawk id=\"dh37fgj492je\", ts=\"1353832234\", nonce=\"j4h3g2\", mac=\"zy79QQ5/EYFmQqutVnYb73gAc/U=\", ext=\"some-app-data\""
+	};
+	HawkcError expected[] = { HAWKC_OK, HAWKC_BASE64_ERROR, HAWKC_BASE64_ERROR, HAWKC_OK };
+	int expected_valid[] = { 1, 0, 0, 0 };
+
+	for(i = 0; i < 4; i++) {
+		hawkc_context_init(&ctx);
+		hawkc_context_set_password(&ctx,(unsigned char*)pwd, strlen(pwd));
+		hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+		hawkc_context_set_method(&ctx,(unsigned char*)"GET",3);
+		hawkc_context_set_path(&ctx,(unsigned char*)"/resource/1?b=1&a=2",19);
+		hawkc_context_set_host(&ctx,(unsigned char*)"example.com",11);
+		hawkc_context_set_port(&ctx,(unsigned char*)"8000",4);
+
+		e = hawkc_parse_authorization_header(&ctx,(unsigned char*)headers[i],strlen(headers[i]));
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+		is_valid = -1;
+		e = hawkc_validate_hmac(&ctx,&is_valid);
+		EXPECT_INT_EQUAL(expected[i],e);
+		EXPECT_INT_EQUAL(expected_valid[i],is_valid);
+	}
+
+	/* The computed HMAC is the same in each case */
+	EXPECT_INT_EQUAL(0,(int)ctx.hmac.len);
+	hawkc_encode_validated_hmac(&ctx);
+	EXPECT_INT_EQUAL((int)strlen(mac),(int)ctx.hmac.len);
+	EXPECT_BYTE_EQUAL(mac,ctx.hmac.data,(int)strlen(mac));
+
+	return 0;
+}
+
+#define BATCH_N 19
+
+/*
+ * Validate a batch of requests with different algorithms, keys and
+ * passwords, base string lengths around block boundaries and beyond the
+ * batch buffer size, and some tampered requests.
+ */
+int test_validate_hmac_batch() {
+
+	static struct HawkcContext ctxs[BATCH_N];
+	static char paths[BATCH_N][1024];
+	static unsigned char headers[BATCH_N][256];
+	HawkcContext ctx_ptrs[BATCH_N];
+	HawkcAlgorithm algorithms[4];
+	HawkcKey keys[4];
+	unsigned char valid[(BATCH_N + 7) / 8];
+	struct HawkcContext client;
+	size_t required_len, len, path_len;
+	int i, j, is_valid;
+
+	algorithms[0] = HAWKC_SHA_1;
+	algorithms[1] = HAWKC_SHA_256;
+	algorithms[2] = HAWKC_SHA_384;
+	algorithms[3] = HAWKC_SHA_512;
+	for(i = 0; i < 4; i++) {
+		e = hawkc_key_create(&ctx,algorithms[i],(unsigned char*)"test", (size_t)4,&(keys[i]));
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	}
+
+	for(i = 0; i < BATCH_N; i++) {
+		HawkcAlgorithm algorithm = algorithms[i % 4];
+		path_len = 1 + i * 37;
+		if(i == BATCH_N - 1) {
+			path_len = sizeof(paths[i]) - 1;
+		}
+		paths[i][0] = '/';
+		for(j = 1; j < (int)path_len; j++) {
+			paths[i][j] = 'a' + ((i + j) % 26);
+		}
+
+		hawkc_context_init(&client);
+		hawkc_context_set_password(&client,(unsigned char*)"test", (size_t)4);
+		hawkc_context_set_algorithm(&client,algorithm);
+		hawkc_context_set_method(&client,(unsigned char*)"GET",3);
+		hawkc_context_set_path(&client,(unsigned char*)paths[i],path_len);
+		hawkc_context_set_host(&client,(unsigned char*)"example.com",11);
+		hawkc_context_set_port(&client,(unsigned char*)"443",3);
+		hawkc_context_set_id(&client,(unsigned char*)"someId",6);
+		e = hawkc_calculate_authorization_header_length(&client,&required_len);
+		EXPECT_RETVAL(HAWKC_OK,e,&client);
+		e = hawkc_create_authorization_header(&client,headers[i],&len);
+		EXPECT_RETVAL(HAWKC_OK,e,&client);
+
+		hawkc_context_init(&(ctxs[i]));
+		if(i % 8 < 4) {
+			hawkc_context_set_key(&(ctxs[i]),keys[i % 4]);
+		} else {
+			hawkc_context_set_password(&(ctxs[i]),(unsigned char*)"test", (size_t)4);
+			hawkc_context_set_algorithm(&(ctxs[i]),algorithm);
+		}
+		hawkc_context_set_method(&(ctxs[i]),(unsigned char*)"GET",3);
+		hawkc_context_set_path(&(ctxs[i]),(unsigned char*)paths[i],path_len);
+		hawkc_context_set_host(&(ctxs[i]),(unsigned char*)"example.com",11);
+		hawkc_context_set_port(&(ctxs[i]),(unsigned char*)"443",3);
+		e = hawkc_parse_authorization_header(&(ctxs[i]),headers[i],len);
+		EXPECT_RETVAL(HAWKC_OK,e,&(ctxs[i]));
+		ctx_ptrs[i] = &(ctxs[i]);
+
+		/* Tamper with every third request */
+		if(i % 3 == 0) {
+			paths[i][0] = 'x';
+		}
+	}
+
+	e = hawkc_validate_hmac_batch(ctx_ptrs,BATCH_N,valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	for(i = 0; i < BATCH_N; i++) {
+		int bit = (valid[i / 8] >> (i % 8)) & 1;
+		EXPECT_INT_EQUAL(i % 3 != 0,bit);
+		e = hawkc_validate_hmac(&(ctxs[i]),&is_valid);
+		EXPECT_RETVAL(HAWKC_OK,e,&(ctxs[i]));
+		EXPECT_INT_EQUAL(is_valid,bit);
+	}
+
+	for(i = 0; i < 4; i++) {
+		hawkc_key_free(&ctx,keys[i]);
+	}
+
+	return 0;
+}
+
+
+/*
+ * Validate against several candidate keys, more than fit one batch, with a
+ * short and a streamed long base string.
+ */
+int test_validate_hmac_any() {
+	static char path[2048];
+	static unsigned char header[256];
+	struct HawkcContext client;
+	HawkcKey keys[11];
+	char password[16];
+	size_t required_len, len;
+	int matched, is_valid;
+	int i, p, k;
+
+	memset(path,'a',sizeof(path) - 1);
+	path[0] = '/';
+	path[sizeof(path) - 1] = '\0';
+
+	for(i = 0; i < 11; i++) {
+		sprintf(password,"secret%d",i);
+		e = hawkc_key_create(&ctx,i % 3 == 0 ? HAWKC_SHA_1 : HAWKC_SHA_256,(unsigned char*)password,strlen(password),&(keys[i]));
+		EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	}
+
+	for(p = 0; p < 2; p++) {
+		const char *request_path = p == 0 ? "/some/path" : path;
+		for(k = 0; k < 11; k += 4) {
+			sprintf(password,"secret%d",k);
+			hawkc_context_init(&client);
+			hawkc_context_set_password(&client,(unsigned char*)password,strlen(password));
+			hawkc_context_set_algorithm(&client,k % 3 == 0 ? HAWKC_SHA_1 : HAWKC_SHA_256);
+			hawkc_context_set_method(&client,(unsigned char*)"GET",3);
+			hawkc_context_set_path(&client,(unsigned char*)request_path,strlen(request_path));
+			hawkc_context_set_host(&client,(unsigned char*)"example.com",11);
+			hawkc_context_set_port(&client,(unsigned char*)"443",3);
+			hawkc_context_set_id(&client,(unsigned char*)"someId",6);
+			e = hawkc_calculate_authorization_header_length(&client,&required_len);
+			EXPECT_RETVAL(HAWKC_OK,e,&client);
+			EXPECT_TRUE(required_len <= sizeof(header));
+			e = hawkc_create_authorization_header(&client,header,&len);
+			EXPECT_RETVAL(HAWKC_OK,e,&client);
+
+			hawkc_context_init(&ctx);
+			hawkc_context_set_method(&ctx,(unsigned char*)"GET",3);
+			hawkc_context_set_path(&ctx,(unsigned char*)request_path,strlen(request_path));
+			hawkc_context_set_host(&ctx,(unsigned char*)"example.com",11);
+			hawkc_context_set_port(&ctx,(unsigned char*)"443",3);
+			e = hawkc_parse_authorization_header(&ctx,header,len);
+			EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+			e = hawkc_validate_hmac_any(&ctx,keys,11,&matched);
+			EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+			EXPECT_INT_EQUAL(k,matched);
+
+			/* Same HMAC as validating with the matching key alone */
+			hawkc_encode_validated_hmac(&ctx);
+			EXPECT_TRUE(ctx.hmac.len == ctx.header_in.mac.len);
+			EXPECT_BYTE_EQUAL(ctx.hmac.data,ctx.header_in.mac.data,(int)ctx.hmac.len);
+			hawkc_context_set_key(&ctx,keys[k]);
+			e = hawkc_validate_hmac(&ctx,&is_valid);
+			EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+			EXPECT_TRUE(is_valid);
+
+			/* Without the matching key */
+			e = hawkc_validate_hmac_any(&ctx,keys,k,&matched);
+			EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+			EXPECT_INT_EQUAL(-1,matched);
+		}
+	}
+
+	for(i = 0; i < 11; i++) {
+		hawkc_key_free(&ctx,keys[i]);
+	}
+	return 0;
+}
+
+/*
+ * ext with double quotes and a backslash. The parser unescapes ext, the
+ * base string has \\ for the backslash like the reference implementation
+ * (the mac was computed with it), and signing escapes ext again.
+ */
+int test_signing_escaped_ext() {
+	char *h1 = "Hawk id=\"someId\", ts=\"1373805459\", nonce=\"abc\", ext=\"say \\\"hi\\\" \\\\ now\", mac=\"MTaeul3UK8/nBgZ0wSyFmfSBs9adNyVyThCinzBOvDo=\"";
+	char *ext = "say \"hi\" \\ now";
+	char b[] = "hawk.1.header\n1373805459\nabc\nGET\n/some/path/to/foo\nexample.com\n80\n\nsay \"hi\" \\\\ now\n";
+	char long_ext[1200];
+	unsigned char buf[2048];
+	size_t len, required_len;
+	int is_valid;
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_password(&ctx,(unsigned char*)"test", (size_t)4);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	hawkc_context_set_method(&ctx,(unsigned char *)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char *)"/some/path/to/foo",17);
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char *)"80",2);
+
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)h1,strlen(h1));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL((int)strlen(ext),(int)ctx.header_in.ext.len);
+	EXPECT_BYTE_EQUAL(ext,ctx.header_in.ext.data,(int)strlen(ext));
+	EXPECT_TRUE(ctx.header_in.ext.data == ctx.unescape_buffer);
+	/* Values without escapes are not copied */
+	EXPECT_TRUE(ctx.header_in.id.data == (unsigned char*)h1 + 9);
+
+	EXPECT_INT_EQUAL((int)strlen(b),(int)hawkc_calculate_base_string_length(&ctx,&(ctx.header_in)));
+	hawkc_create_base_string(&ctx,&(ctx.header_in),buf,&len);
+	EXPECT_INT_EQUAL((int)strlen(b),(int)len);
+	EXPECT_BYTE_EQUAL(b,buf,(int)len);
+	e = hawkc_validate_hmac(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+
+	/* Sign with the unescaped ext */
+	hawkc_context_set_id(&ctx,(unsigned char *)"someId",6);
+	hawkc_context_set_ext(&ctx,(unsigned char *)ext,strlen(ext));
+	ctx.header_out.ts = 1373805459;
+	ctx.header_out.nonce.data = (unsigned char *)"abc";
+	ctx.header_out.nonce.len = 3;
+	e = hawkc_calculate_authorization_header_length(&ctx,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(required_len <= sizeof(buf));
+	e = hawkc_create_authorization_header(&ctx,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL((int)required_len,(int)len);
+	buf[len] = '\0';
+	EXPECT_TRUE(strstr((char*)buf,"ext=\"say \\\"hi\\\" \\\\ now\"") != NULL);
+	EXPECT_TRUE(strstr((char*)buf,"mac=\"MTaeul3UK8/nBgZ0wSyFmfSBs9adNyVyThCinzBOvDo=\"") != NULL);
+
+	/* Escaped values must fit the context's buffer */
+	memset(long_ext,'a',sizeof(long_ext));
+	memcpy(long_ext,"Hawk ext=\"\\\"",12);
+	long_ext[sizeof(long_ext) - 1] = '"';
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)long_ext,sizeof(long_ext));
+	EXPECT_RETVAL(HAWKC_REQUIRED_BUFFER_TOO_LARGE,e,&ctx);
+	long_ext[11] = 'a';
+	long_ext[10] = 'a';
+	e = hawkc_parse_authorization_header(&ctx,(unsigned char*)long_ext,sizeof(long_ext));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL((int)sizeof(long_ext) - 11,(int)ctx.header_in.ext.len);
+
+	return 0;
+}
 
 int main(int argc, char **argv) {
 
@@ -212,6 +594,12 @@ int main(int argc, char **argv) {
 	RUNTEST(argv[0],test_signing_iron);
 	RUNTEST(argv[0],test_hawk_capatibility);
 	RUNTEST(argv[0],test_hawk_capatibility2);
+	RUNTEST(argv[0],test_signing_with_key);
+	RUNTEST(argv[0],test_signing_long_path);
+	RUNTEST(argv[0],test_validate_mac_decoding);
+	RUNTEST(argv[0],test_validate_hmac_batch);
+	RUNTEST(argv[0],test_validate_hmac_any);
+	RUNTEST(argv[0],test_signing_escaped_ext);
 
 	return 0;
 }
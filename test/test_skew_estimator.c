@@ -0,0 +1,221 @@
+/*
+ * POSIX threads, which -std=c99 hides otherwise.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <stdio.h>
+#include "hawkc.h"
+#include "common.h"
+#include "test.h"
+
+static struct HawkcContext ctx;
+static HawkcError e;
+
+static int offset_of(HawkcSkewEstimator estimator, const char *host, int *offset) {
+	return hawkc_skew_estimator_offset(estimator,(unsigned char*)host,strlen(host),offset);
+}
+
+static void update(HawkcSkewEstimator estimator, const char *host, time_t server_ts, time_t now) {
+	hawkc_skew_estimator_update(estimator,(unsigned char*)host,strlen(host),server_ts,now);
+}
+
+/*
+ * The first offset is taken as is, later ones move the average a quarter
+ * of the way.
+ */
+int test_skew_estimator_average() {
+	HawkcSkewEstimator estimator;
+	int offset;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_skew_estimator_create(&ctx,4,&estimator);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!offset_of(estimator,"example.com",&offset));
+
+	update(estimator,"example.com",1100,1000);
+	EXPECT_TRUE(offset_of(estimator,"example.com",&offset));
+	EXPECT_INT_EQUAL(100,offset);
+	update(estimator,"example.com",1020,1000);
+	EXPECT_TRUE(offset_of(estimator,"example.com",&offset));
+	EXPECT_INT_EQUAL(80,offset);
+
+	update(estimator,"example.org",1000,1010);
+	EXPECT_TRUE(offset_of(estimator,"example.org",&offset));
+	EXPECT_INT_EQUAL(-10,offset);
+	update(estimator,"example.org",1000,1000);
+	EXPECT_TRUE(offset_of(estimator,"example.org",&offset));
+	EXPECT_INT_EQUAL(-8,offset);
+	EXPECT_TRUE(offset_of(estimator,"example.com",&offset));
+	EXPECT_INT_EQUAL(80,offset);
+
+	hawkc_skew_estimator_free(&ctx,estimator);
+	return 0;
+}
+
+/*
+ * Hosts beyond the table size are ignored.
+ */
+int test_skew_estimator_full() {
+	HawkcSkewEstimator estimator;
+	char host[32];
+	int i, offset, known = 0;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_skew_estimator_create(&ctx,4,&estimator);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	for(i = 0; i < 100; i++) {
+		sprintf(host,"host%d",i);
+		update(estimator,host,1000 + i,1000);
+	}
+	for(i = 0; i < 100; i++) {
+		sprintf(host,"host%d",i);
+		if(offset_of(estimator,host,&offset)) {
+			EXPECT_INT_EQUAL(i,offset);
+			known++;
+		}
+	}
+	EXPECT_INT_EQUAL(8,known);
+	hawkc_skew_estimator_free(&ctx,estimator);
+	return 0;
+}
+
+/*
+ * A context with the estimator signs with the offset of its host.
+ */
+int test_sign_with_skew_estimator() {
+	HawkcFakeClock clock = { 1353788437, 0 };
+	HawkcSkewEstimator estimator;
+	unsigned char header[1024];
+	size_t required_len, len;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_skew_estimator_create(&ctx,4,&estimator);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	update(estimator,"example.com",1353788437 + 42,1353788437);
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_clock(&ctx,hawkc_fake_clock,&clock);
+	hawkc_context_set_clock_offset(&ctx,3);
+	hawkc_context_set_skew_estimator(&ctx,estimator);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	hawkc_context_set_password(&ctx,(unsigned char *)"test",4);
+	hawkc_context_set_id(&ctx,(unsigned char *)"someId",6);
+	hawkc_context_set_method(&ctx,(unsigned char *)"GET",3);
+	hawkc_context_set_path(&ctx,(unsigned char *)"/some/path/to/foo",17);
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.com",11);
+	hawkc_context_set_port(&ctx,(unsigned char *)"80",2);
+	e = hawkc_calculate_authorization_header_length(&ctx,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(required_len <= sizeof(header));
+	e = hawkc_create_authorization_header(&ctx,header,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(1353788437 + 42,(int)ctx.header_out.ts);
+
+	/* Hosts the estimator does not know use the clock offset */
+	ctx.header_out.ts = 0;
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.org",11);
+	e = hawkc_calculate_authorization_header_length(&ctx,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(1353788437 + 3,(int)ctx.header_out.ts);
+
+	hawkc_skew_estimator_free(&ctx,estimator);
+	return 0;
+}
+
+/*
+ * A verified WWW-Authenticate header updates the shared estimator.
+ */
+int test_validate_tsm_updates_estimator() {
+	HawkcFakeClock clock = { 1375085388 - 30, 0 };
+	HawkcSkewEstimator estimator;
+	unsigned char buf[MAX_WWW_AUTHENTICATE_BYTES];
+	size_t len, required_len;
+	int is_valid, offset;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_skew_estimator_create(&ctx,4,&estimator);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_context_set_password(&ctx,(unsigned char*)"test", (size_t)4);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	hawkc_www_authenticate_header_set_ts(&ctx,1375085388);
+	e = hawkc_calculate_www_authenticate_header_length(&ctx,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_create_www_authenticate_header(&ctx,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_clock(&ctx,hawkc_fake_clock,&clock);
+	hawkc_context_set_skew_estimator(&ctx,estimator);
+	hawkc_context_set_host(&ctx,(unsigned char *)"example.com",11);
+	hawkc_context_set_password(&ctx,(unsigned char*)"test", (size_t)4);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	e = hawkc_parse_www_authenticate_header(&ctx,buf,len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_www_authenticate_tsm(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+	EXPECT_TRUE(offset_of(estimator,"example.com",&offset));
+	EXPECT_INT_EQUAL(30,offset);
+
+	/* An invalid tsm does not */
+	hawkc_context_set_password(&ctx,(unsigned char*)"other", (size_t)5);
+	clock.now -= 100;
+	e = hawkc_validate_www_authenticate_tsm(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!is_valid);
+	EXPECT_TRUE(offset_of(estimator,"example.com",&offset));
+	EXPECT_INT_EQUAL(30,offset);
+
+	hawkc_skew_estimator_free(&ctx,estimator);
+	return 0;
+}
+
+#define UPDATES 100000
+
+/*
+ * All threads report the same offsets for a few hosts, so every average
+ * stays exact.
+ */
+static int update_all(TestThreads *threads, int t) {
+	char host[16];
+	int i;
+
+	for(i = 0; i < UPDATES; i++) {
+		sprintf(host,"host%d",i % 10);
+		update((HawkcSkewEstimator)threads->data,host,1000 + i % 10,1000);
+	}
+	return 0;
+}
+
+int test_skew_estimator_threads() {
+	HawkcSkewEstimator estimator;
+	TestThreads threads;
+	char host[16];
+	int i, offset;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_skew_estimator_create(&ctx,16,&estimator);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(0,start_test_threads(&threads,update_all,estimator));
+	EXPECT_INT_EQUAL(0,join_test_threads(&threads));
+	for(i = 0; i < 10; i++) {
+		sprintf(host,"host%d",i);
+		EXPECT_TRUE(offset_of(estimator,host,&offset));
+		EXPECT_INT_EQUAL(i,offset);
+	}
+	hawkc_skew_estimator_free(&ctx,estimator);
+	return 0;
+}
+
+int main(int argc, char **argv) {
+
+	RUNTEST(argv[0],test_skew_estimator_average);
+	RUNTEST(argv[0],test_skew_estimator_full);
+	RUNTEST(argv[0],test_sign_with_skew_estimator);
+	RUNTEST(argv[0],test_validate_tsm_updates_estimator);
+	RUNTEST(argv[0],test_skew_estimator_threads);
+
+	return 0;
+}
@@ -42,10 +42,199 @@ int test_parse_ts() {
 	return 0;
 }
 
+int test_parse_duplicate() {
 
+	char *h1 = "Hawk ts=\"1375085388\",tsm=\"QP6wolOP0oaoxuvFhPpxcGCm\",tsm=\"abc\"";
+	char *h2 = "Hawk ts=\"1375085388\", error=\"Stale timestamp\", tsm=\"QP6wolOP0oaoxuvFhPpxcGCm\"";
 
+	e = hawkc_parse_www_authenticate_header(&ctx,(unsigned char*)h1,strlen(h1));
+	EXPECT_RETVAL(HAWKC_PARSE_ERROR,e,&ctx);
+
+	e = hawkc_parse_www_authenticate_header(&ctx,(unsigned char*)h2,strlen(h2));
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(24,(int)ctx.www_authenticate_header.tsm.len);
+
+	return 0;
+}
+
+int test_create_tsm_with_key() {
+
+	unsigned char buf[256];
+	unsigned char buf2[256];
+	size_t len,len2,required_len;
+	HawkcKey key;
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_password(&ctx,(unsigned char*)"test", (size_t)4);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	hawkc_www_authenticate_header_set_ts(&ctx,1375085388);
+
+	e = hawkc_calculate_www_authenticate_header_length(&ctx,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_create_www_authenticate_header(&ctx,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL((int)required_len,(int)len);
+
+	hawkc_context_init(&ctx);
+	e = hawkc_key_create(&ctx,HAWKC_SHA_256,(unsigned char*)"test", (size_t)4,&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_context_set_key(&ctx,key);
+	hawkc_www_authenticate_header_set_ts(&ctx,1375085388);
+
+	e = hawkc_calculate_www_authenticate_header_length(&ctx,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_create_www_authenticate_header(&ctx,buf2,&len2);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	EXPECT_INT_EQUAL((int)len,(int)len2);
+	EXPECT_BYTE_EQUAL(buf,buf2,(int)len);
+
+	hawkc_key_free(&ctx,key);
+
+	return 0;
+}
+
+/*
+ * Render the header of the context without the cache.
+ */
+static int create_uncached(unsigned char *buf, size_t *len) {
+	size_t required_len;
+
+	e = hawkc_calculate_www_authenticate_header_length(&ctx,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(required_len <= MAX_WWW_AUTHENTICATE_BYTES);
+	e = hawkc_create_www_authenticate_header(&ctx,buf,len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	return 0;
+}
+
+int test_create_cached() {
+
+	unsigned char buf[MAX_WWW_AUTHENTICATE_BYTES];
+	unsigned char expected[MAX_WWW_AUTHENTICATE_BYTES];
+	size_t len,expected_len;
+	HawkcWwwAuthenticateCache cache;
+	HawkcKey key;
+
+	hawkc_context_init(&ctx);
+	e = hawkc_www_authenticate_cache_create(&ctx,16,&cache);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_context_set_password(&ctx,(unsigned char*)"test", (size_t)4);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
 
+	/* Without timestamp there is nothing to sign */
+	e = hawkc_create_cached_www_authenticate_header(&ctx,cache,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(4,(int)len);
+	EXPECT_BYTE_EQUAL("Hawk",buf,4);
+
+	hawkc_www_authenticate_header_set_ts(&ctx,1375085388);
+	EXPECT_INT_EQUAL(0,create_uncached(expected,&expected_len));
+	e = hawkc_create_cached_www_authenticate_header(&ctx,cache,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL((int)expected_len,(int)len);
+	EXPECT_BYTE_EQUAL(expected,buf,(int)len);
+
+	/* The second header comes from the cache without computing the HMAC */
+	ctx.ts_hmac.len = 0;
+	e = hawkc_create_cached_www_authenticate_header(&ctx,cache,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(0,(int)ctx.ts_hmac.len);
+	EXPECT_INT_EQUAL((int)expected_len,(int)len);
+	EXPECT_BYTE_EQUAL(expected,buf,(int)len);
+
+	/* A new second or another password are signed again */
+	hawkc_www_authenticate_header_set_ts(&ctx,1375085389);
+	EXPECT_INT_EQUAL(0,create_uncached(expected,&expected_len));
+	e = hawkc_create_cached_www_authenticate_header(&ctx,cache,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_BYTE_EQUAL(expected,buf,(int)len);
+
+	hawkc_context_set_password(&ctx,(unsigned char*)"other", (size_t)5);
+	EXPECT_INT_EQUAL(0,create_uncached(expected,&expected_len));
+	e = hawkc_create_cached_www_authenticate_header(&ctx,cache,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL((int)expected_len,(int)len);
+	EXPECT_BYTE_EQUAL(expected,buf,(int)len);
+
+	/* Keys are cached like passwords */
+	e = hawkc_key_create(&ctx,HAWKC_SHA_1,(unsigned char*)"test", (size_t)4,&key);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	hawkc_context_set_key(&ctx,key);
+	EXPECT_INT_EQUAL(0,create_uncached(expected,&expected_len));
+	e = hawkc_create_cached_www_authenticate_header(&ctx,cache,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	ctx.ts_hmac.len = 0;
+	e = hawkc_create_cached_www_authenticate_header(&ctx,cache,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_INT_EQUAL(0,(int)ctx.ts_hmac.len);
+	EXPECT_INT_EQUAL((int)expected_len,(int)len);
+	EXPECT_BYTE_EQUAL(expected,buf,(int)len);
+
+	hawkc_key_free(&ctx,key);
+	hawkc_www_authenticate_cache_free(&ctx,cache);
+	return 0;
+}
+
+/*
+ * A client verifies the tsm the server created with the same password and
+ * takes the server's clock offset from it.
+ */
+int test_validate_tsm() {
+
+	HawkcFakeClock clock = { 1375085388 - 30, 0 };
+	unsigned char buf[MAX_WWW_AUTHENTICATE_BYTES];
+	size_t len,required_len;
+	int is_valid;
 
+	hawkc_context_init(&ctx);
+	hawkc_context_set_password(&ctx,(unsigned char*)"test", (size_t)4);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	hawkc_www_authenticate_header_set_ts(&ctx,1375085388);
+	e = hawkc_calculate_www_authenticate_header_length(&ctx,&required_len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_create_www_authenticate_header(&ctx,buf,&len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+
+	hawkc_context_init(&ctx);
+	hawkc_context_set_clock(&ctx,hawkc_fake_clock,&clock);
+	hawkc_context_set_password(&ctx,(unsigned char*)"test", (size_t)4);
+	hawkc_context_set_algorithm(&ctx,HAWKC_SHA_256);
+	e = hawkc_parse_www_authenticate_header(&ctx,buf,len);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_www_authenticate_tsm(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(is_valid);
+	EXPECT_INT_EQUAL(30,ctx.offset);
+
+	/* Another password or a changed ts are not valid */
+	hawkc_context_set_clock_offset(&ctx,0);
+	hawkc_context_set_password(&ctx,(unsigned char*)"other", (size_t)5);
+	e = hawkc_validate_www_authenticate_tsm(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!is_valid);
+	EXPECT_INT_EQUAL(0,ctx.offset);
+
+	hawkc_context_set_password(&ctx,(unsigned char*)"test", (size_t)4);
+	ctx.www_authenticate_header.ts++;
+	e = hawkc_validate_www_authenticate_tsm(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	EXPECT_TRUE(!is_valid);
+
+	/* Without ts there is nothing to verify */
+	e = hawkc_parse_www_authenticate_header(&ctx,(unsigned char*)"Hawk",4);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	ctx.www_authenticate_header.ts = 0;
+	e = hawkc_validate_www_authenticate_tsm(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_ERROR,e,&ctx);
+
+	e = hawkc_parse_www_authenticate_header(&ctx,(unsigned char*)"Hawk ts=\"1375085388\",tsm=\"a*b\"",30);
+	EXPECT_RETVAL(HAWKC_OK,e,&ctx);
+	e = hawkc_validate_www_authenticate_tsm(&ctx,&is_valid);
+	EXPECT_RETVAL(HAWKC_BASE64_ERROR,e,&ctx);
+
+	return 0;
+}
 
 int main(int argc, char **argv) {
 
@@ -53,6 +242,10 @@ int main(int argc, char **argv) {
 
 	RUNTEST(argv[0],test_parse);
 	RUNTEST(argv[0],test_parse_ts);
+	RUNTEST(argv[0],test_parse_duplicate);
+	RUNTEST(argv[0],test_create_tsm_with_key);
+	RUNTEST(argv[0],test_create_cached);
+	RUNTEST(argv[0],test_validate_tsm);
 
 	return 0;
 }